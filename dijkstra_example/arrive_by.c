@@ -0,0 +1,392 @@
+/*
+* Filename:				arrive_by.c
+* Description:			Arrive-by queries for the Amazing Race flight planner: "be at the
+*						destination by this time, leaving as late as possible". Answered by a
+*						Dijkstra search run backwards from the destination, which settles airports
+*						in order of the latest time the flyer can be there and still make it.
+*
+*						The search works over an arrival-indexed view of the timetable, built once
+*						by buildArrivalIndex(): the legs into each airport, and each leg's flights
+*						in order of when they land. As soonestArrival() finds the soonest landing
+*						after a time with a binary search and a run of minimums, latestDeparture()
+*						finds the latest takeoff that lands by a time with a binary search and a
+*						run of maximums.
+*
+*						The answer is the latest start time: the latest the flyer can be at the
+*						origin for an ordinary query to give a plan that arrives by the deadline.
+*						Since a flight leaving at exactly the start time has been missed, that is
+*						one minute before the first flight leaves.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+/* The arrival-indexed view of the loaded timetable. Empty until buildArrivalIndex().
+incomingLegs[] holds every leg grouped by the airport it flies to, with airport i's legs from
+incomingOffsets[i] up to incomingOffsets[i + 1]. Each leg's flights keep the leg's own slots,
+departureOffsets[leg] up to departureOffsets[leg + 1], but in order of landing time. */
+static int* incomingOffsets = NULL;
+static int* incomingLegs = NULL;
+static int* incomingOrigins = NULL;		// The airport each of incomingLegs[] flies from.
+
+/* For each slot, in each leg's landing order: the landing time, in minutes after midnight
+UTC, and of the flights landing no later than this one, the one that leaves last. Its takeoff
+is kept as minutes from midnight UTC of the day it lands (negative if that's the day before),
+so flights landing on a later day than they leave can be compared directly. */
+static int* landingTimes = NULL;
+static int* latestFlights = NULL;
+static int* latestTakeoffs = NULL;
+
+// A flight and when it lands, in minutes after midnight UTC, for sorting a leg into landing order.
+typedef struct
+{
+	int landingTime;
+	int flight;
+} LandingSlot;
+
+
+
+static int latestDeparture(const int latestLanding, int leg, const Flight** latestFlight);
+static int compareLandingSlots(const void* first, const void* second);
+
+
+
+/*
+* Function:			buildArrivalIndex()
+* Description:		Builds the arrival-indexed view of the loaded timetable, for
+*					findLatestStart(). Must be called again whenever the timetable changes.
+* Return Values:	1 if the view was built, 0 if there wasn't enough memory.
+*/
+int buildArrivalIndex(void)
+{
+	const Timetable* network = flightTimetable();
+	int slotCount = network->flightCount + 1;
+	LandingSlot* landingOrder = NULL;
+
+	freeArrivalIndex();
+
+	incomingOffsets = (int*)calloc(network->airportCount + 2, sizeof(int));
+	incomingLegs = (int*)malloc((network->legCount + 1) * sizeof(int));
+	incomingOrigins = (int*)malloc((network->legCount + 1) * sizeof(int));
+	landingTimes = (int*)malloc(slotCount * sizeof(int));
+	latestFlights = (int*)malloc(slotCount * sizeof(int));
+	latestTakeoffs = (int*)malloc(slotCount * sizeof(int));
+	landingOrder = (LandingSlot*)malloc(slotCount * sizeof(LandingSlot));
+
+	if ((incomingOffsets == NULL) || (incomingLegs == NULL) || (incomingOrigins == NULL)
+		|| (landingTimes == NULL) || (latestFlights == NULL) || (latestTakeoffs == NULL)
+		|| (landingOrder == NULL))
+	{
+		free(landingOrder);
+		freeArrivalIndex();
+		return 0;
+	}
+
+	/* Group the legs by destination: count each airport's incoming legs, turn the counts into
+	offsets, then place each leg. Placing moves each offset up to the next airport's. */
+	for (int leg = 0; leg < network->legCount; leg++)
+	{
+		incomingOffsets[network->legDestinations[leg] + 1]++;
+	}
+
+	for (int i = 1; i <= network->airportCount + 1; i++)
+	{
+		incomingOffsets[i] += incomingOffsets[i - 1];
+	}
+
+	for (int airport = 1; airport <= network->airportCount; airport++)
+	{
+		for (int leg = network->legOffsets[airport]; leg < network->legOffsets[airport + 1]; leg++)
+		{
+			int slot = incomingOffsets[network->legDestinations[leg]]++;
+
+			incomingLegs[slot] = leg;
+			incomingOrigins[slot] = airport;
+		}
+	}
+
+	for (int i = network->airportCount + 1; i > 0; i--)
+	{
+		incomingOffsets[i] = incomingOffsets[i - 1];
+	}
+	incomingOffsets[0] = 0;
+
+	// <Leg loop>
+	// Put each leg's flights in landing order. A hub's busiest legs run to hundreds of flights,
+	// so they're sorted with qsort(), with ties left in flight order.
+	for (int leg = 0; leg < network->legCount; leg++)
+	{
+		int firstFlight = network->departureOffsets[leg];
+		int lastFlight = network->departureOffsets[leg + 1];
+
+		for (int flight = firstFlight; flight < lastFlight; flight++)
+		{
+			landingOrder[flight].landingTime = network->arrivalMinutes[flight] % kMinutesPerDay;
+			landingOrder[flight].flight = flight;
+		}
+
+		if (lastFlight - firstFlight > 1)
+		{
+			qsort(&landingOrder[firstFlight], lastFlight - firstFlight, sizeof(LandingSlot),
+				compareLandingSlots);
+		}
+
+		for (int slot = firstFlight; slot < lastFlight; slot++)
+		{
+			landingTimes[slot] = landingOrder[slot].landingTime;
+			latestFlights[slot] = landingOrder[slot].flight;
+		}
+
+		// Then keep a running best: the flight leaving last, of all those landing so far.
+		for (int slot = firstFlight; slot < lastFlight; slot++)
+		{
+			int flight = latestFlights[slot];
+			int takeoff = network->departureMinutes[flight]
+				- (network->arrivalMinutes[flight] / kMinutesPerDay) * kMinutesPerDay;
+
+			if ((slot > firstFlight) && (latestTakeoffs[slot - 1] >= takeoff))
+			{
+				latestFlights[slot] = latestFlights[slot - 1];
+				takeoff = latestTakeoffs[slot - 1];
+			}
+
+			latestTakeoffs[slot] = takeoff;
+		}
+	} // End of leg loop.
+
+	free(landingOrder);
+
+	return 1;
+}
+
+
+
+/*
+* Function:			freeArrivalIndex()
+* Description:		Releases the arrival-indexed view.
+*/
+void freeArrivalIndex(void)
+{
+	free(incomingOffsets);
+	free(incomingLegs);
+	free(incomingOrigins);
+	free(landingTimes);
+	free(latestFlights);
+	free(latestTakeoffs);
+
+	incomingOffsets = NULL;
+	incomingLegs = NULL;
+	incomingOrigins = NULL;
+	landingTimes = NULL;
+	latestFlights = NULL;
+	latestTakeoffs = NULL;
+}
+
+
+
+/*
+* Function:			findLatestStart()
+* Description:		Finds the latest the flyer can be at the origin and still reach the
+*					destination by a deadline, and the flights that get them there. Airports
+*					are settled backwards from the destination, latest first, and the search
+*					stops once the origin is settled.
+* Parameters:		QueryScratch* scratch		Working memory for the search.
+*					int deadlineInMinutes		When the flyer must be at the destination, in
+*												minutes since midnight in its local timezone.
+*					int originAirport			The user's starting airport.
+*					int destinationAirport		The airport to be at by the deadline.
+*					int* latestStartInMinutes	Set to the latest start time, in minutes since
+*												midnight of the deadline's day in the origin's
+*												local timezone. Negative for an earlier day.
+* Return Values:	1 if the destination can be reached, with the plan in scratch->flightPlan;
+*					0 if it can't, with scratch->flightPlan left empty.
+*/
+int findLatestStart(QueryScratch* scratch, const int deadlineInMinutes, int originAirport,
+	int destinationAirport, int* latestStartInMinutes)
+{
+	const Timetable* network = flightTimetable();
+
+	int deadlineUTC = deadlineInMinutes - timezoneOffset(destinationAirport);
+
+	/* How long before the deadline each airport must be reached, at the latest. The heap
+	takes the smallest first, so airports are settled from the latest time backwards. */
+	int* timeBeforeDeadline = scratch->groundTimes;
+
+	// The flight to take out of each airport, for the latest start from there.
+	const Flight** latestDepartures = scratch->latestDepartures;
+
+	char* airportSettled = scratch->airportFlags;
+	AirportHeap* unsettledAirports = &scratch->heap;
+
+	int arrivalAirport = 0;
+	int stepsTaken = 0;
+
+	memset(timeBeforeDeadline, 0, (network->airportCount + 1) * sizeof(int));
+	memset(airportSettled, 0, (network->airportCount + 1) * sizeof(char));
+	memset((void*)latestDepartures, 0, (network->airportCount + 1) * sizeof(const Flight*));
+
+	scratch->flightPlan[0] = NULL;
+
+	pushAirport(unsettledAirports, destinationAirport, timeBeforeDeadline);
+
+	// <Airport settle loop>
+	while (unsettledAirports->size > 0)
+	{
+		int latestGroundTime = 0;
+
+		arrivalAirport = popEarliestAirport(unsettledAirports, timeBeforeDeadline);
+
+		airportSettled[arrivalAirport] = 1;
+		countSearch(airportsSettled, 1);
+
+		if (arrivalAirport == originAirport)
+		{
+			emptyAirportHeap(unsettledAirports);
+			break;
+		}
+
+		latestGroundTime = deadlineUTC - timeBeforeDeadline[arrivalAirport];
+
+		// <Leg into airport check loop>
+		for (int slot = incomingOffsets[arrivalAirport]; slot < incomingOffsets[arrivalAirport + 1];
+			slot++)
+		{
+			int departureAirport = incomingOrigins[slot];
+			const Flight* latestFlight = NULL;
+			int candidate = 0;
+
+			if ((departureAirport == destinationAirport) || (airportSettled[departureAirport] == 1))
+			{
+				continue;
+			}
+
+			countSearch(legsRelaxed, 1);
+
+			/* Flights leaving at exactly the ground time have been missed, so the flyer must
+			be on the ground a minute before the flight takes off. */
+			candidate = deadlineUTC
+				- (latestDeparture(latestGroundTime, incomingLegs[slot], &latestFlight) - 1);
+
+			if ((latestDepartures[departureAirport] == NULL)
+				|| (candidate < timeBeforeDeadline[departureAirport]))
+			{
+				timeBeforeDeadline[departureAirport] = candidate;
+				pushAirport(unsettledAirports, departureAirport, timeBeforeDeadline);
+				countSearch(improvements, 1);
+
+				latestDepartures[departureAirport] = latestFlight;
+			}
+		} // End of leg into airport check loop.
+
+	} // End of airport settle loop.
+
+	if (latestDepartures[originAirport] == NULL)
+	{
+		return 0;
+	}
+
+	*latestStartInMinutes = deadlineUTC - timeBeforeDeadline[originAirport]
+		+ timezoneOffset(originAirport);
+
+	// The plan runs forwards from the origin, one airport's flight out at a time.
+	for (int airport = originAirport; airport != destinationAirport;
+		airport = latestDepartures[airport]->destinationCity)
+	{
+		scratch->flightPlan[stepsTaken] = latestDepartures[airport];
+		stepsTaken++;
+	}
+	scratch->flightPlan[stepsTaken] = NULL;
+
+	countSearch(planFlights, stepsTaken);
+
+	return 1;
+}
+
+
+
+/*
+* Function:			latestDeparture()
+* Description:		Finds the flight on a leg that leaves last, of those that land by a given
+*					time on some day. The reverse of soonestArrival().
+* Parameters:		int latestLanding			The latest the flight may land, in minutes since
+*												midnight UTC of the first day.
+*					int leg						The timetable leg to search.
+*					Flight* latestFlight		Set to the flight.
+* Return Values:	The flight's takeoff time, in minutes since midnight UTC of the first day.
+*/
+static int latestDeparture(const int latestLanding, int leg, const Flight** latestFlight)
+{
+	const Timetable* network = flightTimetable();
+
+	int firstSlot = network->departureOffsets[leg];
+	int lastSlot = network->departureOffsets[leg + 1];
+
+	int day = dayOfTime(latestLanding);
+	int timeInDay = latestLanding - day * kMinutesPerDay;
+
+	/* Binary search for the first flight landing after timeInDay. Those before it can land
+	by latestLanding on the same day; any flight can land by it on the day before. */
+	int low = firstSlot;
+	int high = lastSlot;
+
+	while (low < high)
+	{
+		int middle = low + (high - low) / 2;
+
+		countSearch(flightsScanned, 1);
+
+		if (landingTimes[middle] <= timeInDay)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	/* Any flight can land by latestLanding the day before, so the latest of the whole day,
+	taken a day earlier, is always a choice. A long flight landing yesterday can leave later
+	than a short one landing today, so both are compared. */
+	int bestYesterday = latestFlights[lastSlot - 1];
+	int takeoffYesterday = (day - 1) * kMinutesPerDay + latestTakeoffs[lastSlot - 1];
+
+	if ((low > firstSlot) && (day * kMinutesPerDay + latestTakeoffs[low - 1] >= takeoffYesterday))
+	{
+		*latestFlight = &network->departures[latestFlights[low - 1]];
+		return day * kMinutesPerDay + latestTakeoffs[low - 1];
+	}
+
+	countSearch(dayWraps, 1);
+
+	*latestFlight = &network->departures[bestYesterday];
+	return takeoffYesterday;
+}
+
+
+
+/*
+* Function:			compareLandingSlots()
+* Description:		qsort() comparison that orders a leg's flights by landing time, then by
+*					flight, so flights landing together keep the order they leave in.
+* Parameters:		const void* first		The first LandingSlot.
+*					const void* second		The second LandingSlot.
+* Return Values:	Negative, 0 or positive as first sorts before, with or after second.
+*/
+static int compareLandingSlots(const void* first, const void* second)
+{
+	const LandingSlot* firstSlot = (const LandingSlot*)first;
+	const LandingSlot* secondSlot = (const LandingSlot*)second;
+	int difference = firstSlot->landingTime - secondSlot->landingTime;
+
+	if (difference == 0)
+	{
+		difference = firstSlot->flight - secondSlot->flight;
+	}
+
+	return difference;
+}
@@ -0,0 +1,469 @@
+/*
+* Filename:				astar.c
+* Description:			The goal-directed (A*) engine for the Amazing Race flight planner. It is
+*						the same time-dependent Dijkstra search as mapEarliestArrivals(), but the
+*						heap is ordered by each airport's ground time plus a lower bound on the
+*						time still needed to reach the destination. Airports heading the wrong
+*						way are put off until they can no longer be skipped, and the search stops
+*						as soon as the destination is settled.
+*
+*						The lower bounds come from landmarks: a few airports chosen far apart when
+*						the timetable is loaded. For each landmark, the shortest flying time to
+*						and from every airport is found once, counting each leg as its shortest
+*						flight and ignoring waits. Flying time can never be shorter than that, so
+*						by the triangle inequality, how much further the destination is from a
+*						landmark than an airport is (or the other way) never overestimates the
+*						time left. Since the bound never drops by more than a flight takes, each
+*						airport is still settled only once, at its earliest ground time.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+/* The shortest flying time from each landmark to each airport, and from each airport to each
+landmark, in minutes. An airport's distances are together: [airport * landmarkCount + landmark].
+INT_MAX where there's no way there. Built by buildLandmarks(); empty until then. */
+static int* distancesFromLandmarks = NULL;
+static int* distancesToLandmarks = NULL;
+static int landmarkCount = 0;
+
+
+
+static int remainingTimeBound(int airport, int destinationAirport);
+static void findFlyingTimes(const int offsets[], const int neighbours[], const int durations[],
+	int sourceAirport, int distances[], AirportHeap* heap);
+
+
+
+/*
+* Function:			buildLandmarks()
+* Description:		Chooses the landmarks for the loaded timetable, and finds the shortest
+*					flying time between each of them and every airport. The first landmark is
+*					the airport furthest from airport 1; each one after that is the airport
+*					furthest from the landmarks already chosen. Must be called again whenever
+*					the timetable changes.
+* Parameters:		int count		The number of landmarks to choose. Fewer are used if there
+*									aren't enough airports.
+* Return Values:	1 if the landmarks were built, 0 if there wasn't enough memory.
+*/
+int buildLandmarks(int count)
+{
+	const Timetable* network = flightTimetable();
+	int airportCount = network->airportCount;
+
+	int* legDurations = (int*)malloc((network->legCount + 1) * sizeof(int));
+	int* reverseOffsets = (int*)calloc(airportCount + 2, sizeof(int));
+	int* reverseOrigins = (int*)malloc((network->legCount + 1) * sizeof(int));
+	int* reverseDurations = (int*)malloc((network->legCount + 1) * sizeof(int));
+	int* distances = (int*)malloc((airportCount + 1) * sizeof(int));
+	int* nearestLandmark = (int*)malloc((airportCount + 1) * sizeof(int));
+	int* newFromLandmarks = (int*)malloc((size_t)(airportCount + 1) * count * sizeof(int));
+	int* newToLandmarks = (int*)malloc((size_t)(airportCount + 1) * count * sizeof(int));
+	AirportHeap heap = { 0 };
+
+	int isBuilt = 0;
+	int chosen = 0;
+	int nextLandmark = 0;
+
+	if ((legDurations != NULL) && (reverseOffsets != NULL) && (reverseOrigins != NULL)
+		&& (reverseDurations != NULL) && (distances != NULL) && (nearestLandmark != NULL)
+		&& (newFromLandmarks != NULL) && (newToLandmarks != NULL)
+		&& (initAirportHeap(&heap, airportCount) == 1))
+	{
+		// Each leg counts as its shortest flight.
+		for (int leg = 0; leg < network->legCount; leg++)
+		{
+			legDurations[leg] = INT_MAX;
+
+			for (int flight = network->departureOffsets[leg];
+				flight < network->departureOffsets[leg + 1]; flight++)
+			{
+				int duration = network->arrivalMinutes[flight] - network->departureMinutes[flight];
+
+				if (duration < legDurations[leg])
+				{
+					legDurations[leg] = duration;
+				}
+			}
+		}
+
+		/* The legs turned around, grouped by destination, for the flying times to a landmark.
+		Count each destination's legs, turn the counts into offsets, then fill them in. */
+		for (int leg = 0; leg < network->legCount; leg++)
+		{
+			reverseOffsets[network->legDestinations[leg] + 1]++;
+		}
+
+		for (int i = 1; i <= airportCount + 1; i++)
+		{
+			reverseOffsets[i] += reverseOffsets[i - 1];
+		}
+
+		for (int airport = 1; airport <= airportCount; airport++)
+		{
+			for (int leg = network->legOffsets[airport]; leg < network->legOffsets[airport + 1];
+				leg++)
+			{
+				int slot = reverseOffsets[network->legDestinations[leg]]++;
+
+				reverseOrigins[slot] = airport;
+				reverseDurations[slot] = legDurations[leg];
+			}
+		}
+
+		// Filling in moved each offset up to the next destination's, so move them back.
+		for (int i = airportCount + 1; i > 0; i--)
+		{
+			reverseOffsets[i] = reverseOffsets[i - 1];
+		}
+		reverseOffsets[0] = 0;
+
+		// Start as far from airport 1 as possible.
+		findFlyingTimes(network->legOffsets, network->legDestinations, legDurations, 1, distances,
+			&heap);
+
+		for (int i = 1; i <= airportCount; i++)
+		{
+			nearestLandmark[i] = distances[i];
+		}
+
+		// <Landmark loop>
+		while (chosen < count)
+		{
+			/* The airport furthest from every landmark so far. One no landmark can reach at all
+			is best of all, as the landmarks then cover a part of the network they didn't. */
+			nextLandmark = 0;
+
+			for (int i = 1; i <= airportCount; i++)
+			{
+				if ((nearestLandmark[i] > 0)
+					&& ((nextLandmark == 0) || (nearestLandmark[i] > nearestLandmark[nextLandmark])))
+				{
+					nextLandmark = i;
+				}
+			}
+
+			// Every airport is already a landmark, or can't be told apart from one.
+			if (nextLandmark == 0)
+			{
+				break;
+			}
+
+			findFlyingTimes(network->legOffsets, network->legDestinations, legDurations,
+				nextLandmark, distances, &heap);
+
+			for (int i = 0; i <= airportCount; i++)
+			{
+				newFromLandmarks[(size_t)i * count + chosen] = distances[i];
+
+				if ((chosen == 0) || (distances[i] < nearestLandmark[i]))
+				{
+					nearestLandmark[i] = distances[i];
+				}
+			}
+
+			findFlyingTimes(reverseOffsets, reverseOrigins, reverseDurations, nextLandmark,
+				distances, &heap);
+
+			for (int i = 0; i <= airportCount; i++)
+			{
+				newToLandmarks[(size_t)i * count + chosen] = distances[i];
+			}
+
+			chosen++;
+		} // End of landmark loop.
+
+		// Close up the gaps left if fewer landmarks were chosen than there was room for.
+		for (int i = 0; i <= airportCount; i++)
+		{
+			for (int landmark = 0; landmark < chosen; landmark++)
+			{
+				newFromLandmarks[(size_t)i * chosen + landmark]
+					= newFromLandmarks[(size_t)i * count + landmark];
+				newToLandmarks[(size_t)i * chosen + landmark]
+					= newToLandmarks[(size_t)i * count + landmark];
+			}
+		}
+
+		freeLandmarks();
+		distancesFromLandmarks = newFromLandmarks;
+		distancesToLandmarks = newToLandmarks;
+		landmarkCount = chosen;
+		newFromLandmarks = NULL;
+		newToLandmarks = NULL;
+		isBuilt = 1;
+	}
+
+	free(legDurations);
+	free(reverseOffsets);
+	free(reverseOrigins);
+	free(reverseDurations);
+	free(distances);
+	free(nearestLandmark);
+	free(newFromLandmarks);
+	free(newToLandmarks);
+	freeAirportHeap(&heap);
+
+	return isBuilt;
+}
+
+
+
+/*
+* Function:			freeLandmarks()
+* Description:		Releases the landmark tables.
+*/
+void freeLandmarks(void)
+{
+	free(distancesFromLandmarks);
+	free(distancesToLandmarks);
+	distancesFromLandmarks = NULL;
+	distancesToLandmarks = NULL;
+	landmarkCount = 0;
+}
+
+
+
+/*
+* Function:			astarEarliestArrivals()
+* Description:		Finds the earliest possible arrival at one destination, searching towards
+*					it first. Only the flights back from the destination are filled in as a
+*					plan; other airports' entries in earliestArrivals[] may not be final.
+* Parameters:		QueryScratch* scratch		Working memory for the search.
+*					int startTimeInMinutes		The user's starting time, in the local timezone.
+*					int originAirport			The user's starting airport.
+*					int destinationAirport		The airport to find the flights to.
+*					Flight earliestArrivals[]	An array to pass a list of flights to, representing
+*												the earliest flights available to each airport.
+*/
+void astarEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	int destinationAirport, const Flight* earliestArrivals[])
+{
+	const Timetable* network = flightTimetable();
+
+	// The earliest time each airport can be reached, in minutes since midnight UTC.
+	int* earliestGroundTime = scratch->groundTimes;
+
+	/* Each reached airport's ground time plus the least time left to the destination: the
+	soonest the destination could be reached through it. The heap is ordered by this. */
+	int* estimatedArrival = scratch->estimatedArrivals;
+
+	AirportHeap* unsettledAirports = &scratch->heap;
+
+	// Whether each airport has been reached or settled yet (see mapEarliestArrivals()).
+	unsigned int* airportStamps = scratch->airportStamps;
+	unsigned int reachedStamp = 0;
+	unsigned int settledStamp = 0;
+	int listReached = 0;
+
+	int departureAirport = 0;
+	int arrivalAirport = 0;
+	int bound = remainingTimeBound(originAirport, destinationAirport);
+
+	// If no flying reaches the destination at all, there's nothing to search.
+	if (bound < 0)
+	{
+		return;
+	}
+
+	reachedStamp = startSearchGeneration(scratch);
+	settledStamp = reachedStamp + 1;
+
+	listReached = beginReachedList(scratch, earliestArrivals);
+
+	earliestGroundTime[originAirport] = startTimeInMinutes - timezoneOffset(originAirport);
+	estimatedArrival[originAirport] = earliestGroundTime[originAirport] + bound;
+	airportStamps[originAirport] = reachedStamp;
+
+	pushAirport(unsettledAirports, originAirport, estimatedArrival);
+
+	// <Airport settle loop>
+	while (unsettledAirports->size > 0)
+	{
+		departureAirport = popEarliestAirport(unsettledAirports, estimatedArrival);
+
+		airportStamps[departureAirport] = settledStamp;
+		countSearch(airportsSettled, 1);
+
+		// Every airport left could only reach the destination later than it already has.
+		if (departureAirport == destinationAirport)
+		{
+			emptyAirportHeap(unsettledAirports);
+			break;
+		}
+
+		// <Destination from airport check loop>
+		for (int leg = network->legOffsets[departureAirport];
+			leg < network->legOffsets[departureAirport + 1]; leg++)
+		{
+			int arrivalTime = 0;
+			const Flight* quickestFlightToGround = NULL;
+
+			arrivalAirport = network->legDestinations[leg];
+
+			if ((arrivalAirport == originAirport) || (airportStamps[arrivalAirport] == settledStamp))
+			{
+				continue;
+			}
+
+			countSearch(legsRelaxed, 1);
+
+			arrivalTime = soonestArrival(earliestGroundTime[departureAirport], leg,
+				&quickestFlightToGround);
+
+			if ((quickestFlightToGround == NULL) || ((earliestArrivals[arrivalAirport] != NULL)
+				&& (arrivalTime >= earliestGroundTime[arrivalAirport])))
+			{
+				continue;
+			}
+
+			// An airport's bound never changes, so only work it out the first time it's reached.
+			if (earliestArrivals[arrivalAirport] == NULL)
+			{
+				bound = remainingTimeBound(arrivalAirport, destinationAirport);
+			}
+			else
+			{
+				bound = estimatedArrival[arrivalAirport] - earliestGroundTime[arrivalAirport];
+			}
+
+			/* Skip airports the destination can't be flown to from, and flights that can't
+			beat the destination's best time so far. */
+			if ((bound < 0) || ((earliestArrivals[destinationAirport] != NULL)
+				&& (arrivalTime + bound >= earliestGroundTime[destinationAirport])))
+			{
+				continue;
+			}
+
+			if (airportStamps[arrivalAirport] != reachedStamp)
+			{
+				airportStamps[arrivalAirport] = reachedStamp;
+
+				if (listReached == 1)
+				{
+					scratch->reachedAirports[scratch->reachedCount] = arrivalAirport;
+					scratch->reachedCount++;
+				}
+			}
+
+			earliestGroundTime[arrivalAirport] = arrivalTime;
+			estimatedArrival[arrivalAirport] = arrivalTime + bound;
+			pushAirport(unsettledAirports, arrivalAirport, estimatedArrival);
+			countSearch(improvements, 1);
+
+			earliestArrivals[arrivalAirport] = quickestFlightToGround;
+		} // End of destination check loop.
+
+	} // End of airport settle loop.
+}
+
+
+
+/*
+* Function:			remainingTimeBound()
+* Description:		Gives a lower bound on the time it takes to get from an airport to the
+*					destination, from the landmark tables.
+* Parameters:		int airport					The airport to start from.
+*					int destinationAirport		The destination.
+* Return Values:	The bound, in minutes, or -1 if the destination can't be flown to from the
+*					airport at all.
+*/
+static int remainingTimeBound(int airport, int destinationAirport)
+{
+	const int* fromLandmarksToAirport = &distancesFromLandmarks[(size_t)airport * landmarkCount];
+	const int* fromLandmarksToDestination
+		= &distancesFromLandmarks[(size_t)destinationAirport * landmarkCount];
+	const int* toLandmarksFromAirport = &distancesToLandmarks[(size_t)airport * landmarkCount];
+	const int* toLandmarksFromDestination
+		= &distancesToLandmarks[(size_t)destinationAirport * landmarkCount];
+
+	int bound = 0;
+
+	for (int landmark = 0; landmark < landmarkCount; landmark++)
+	{
+		int landmarkToAirport = fromLandmarksToAirport[landmark];
+		int landmarkToDestination = fromLandmarksToDestination[landmark];
+		int airportToLandmark = toLandmarksFromAirport[landmark];
+		int destinationToLandmark = toLandmarksFromDestination[landmark];
+
+		/* Through the landmark: landmark to destination is no more than landmark to airport,
+		then on to the destination. If the landmark reaches the airport but not the
+		destination, the airport can't reach the destination either. */
+		if (landmarkToAirport != INT_MAX)
+		{
+			if (landmarkToDestination == INT_MAX)
+			{
+				return -1;
+			}
+
+			if (landmarkToDestination - landmarkToAirport > bound)
+			{
+				bound = landmarkToDestination - landmarkToAirport;
+			}
+		}
+
+		// And the other way: the airport to the landmark is no more than via the destination.
+		if (destinationToLandmark != INT_MAX)
+		{
+			if (airportToLandmark == INT_MAX)
+			{
+				return -1;
+			}
+
+			if (airportToLandmark - destinationToLandmark > bound)
+			{
+				bound = airportToLandmark - destinationToLandmark;
+			}
+		}
+	}
+
+	return bound;
+}
+
+
+
+/*
+* Function:			findFlyingTimes()
+* Description:		Finds the shortest flying time from one airport to every other, over a
+*					graph of legs with a fixed time each (a plain Dijkstra search).
+* Parameters:		int offsets[]			The first leg out of each airport, [airportCount + 2].
+*					int neighbours[]		The airport at the other end of each leg.
+*					int durations[]			The time each leg takes, in minutes.
+*					int sourceAirport		The airport to start from.
+*					int distances[]			Set to each airport's flying time from the source,
+*											or INT_MAX if it can't be reached.
+*					AirportHeap* heap		An empty heap, left empty.
+*/
+static void findFlyingTimes(const int offsets[], const int neighbours[], const int durations[],
+	int sourceAirport, int distances[], AirportHeap* heap)
+{
+	int airportCount = flightTimetable()->airportCount;
+
+	for (int i = 0; i <= airportCount; i++)
+	{
+		distances[i] = INT_MAX;
+	}
+
+	distances[sourceAirport] = 0;
+	pushAirport(heap, sourceAirport, distances);
+
+	while (heap->size > 0)
+	{
+		int airport = popEarliestAirport(heap, distances);
+
+		for (int leg = offsets[airport]; leg < offsets[airport + 1]; leg++)
+		{
+			int distance = distances[airport] + durations[leg];
+
+			if (distance < distances[neighbours[leg]])
+			{
+				distances[neighbours[leg]] = distance;
+				pushAirport(heap, neighbours[leg], distances);
+			}
+		}
+	}
+}
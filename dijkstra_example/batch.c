@@ -0,0 +1,1350 @@
+/*
+* Filename:				batch.c
+* Description:			Non-interactive batch mode for the Amazing Race flight planner. Reads one
+*						query per line from a file or stdin, runs each through the same search and
+*						flight plan functions as the interactive menu, and writes one
+*						machine-readable result per line to stdout, as JSON lines or TSV, or as
+*						one binary record per line (see serializer.c).
+*
+*						A query line is an origin, a destination and a start time (HHMM, origin
+*						local time). Airports may be given by number or by name. Fields are split on
+*						tabs or commas if the line has any, so names with spaces ("Santa Fe") can be
+*						used; otherwise they are split on spaces. Blank lines and lines starting
+*						with # are skipped. Every other line gets exactly one result line, in order.
+*						With --profile, the start time is the start of a 24 hour window instead,
+*						and may be left off to mean midnight. Each result lists every departure in
+*						the window worth taking, as found by profileEarliestArrivals().
+*						With --arrive-by, the time is a deadline at the destination (in its local
+*						time), and the result is the plan from the latest start that makes it.
+*						With --pareto, the result lists every plan that arrives sooner by taking
+*						more flights, as found by paretoEarliestArrivals().
+*						With --updates, a line may instead delay or cancel a flight:
+*						  delay <origin> <destination> <departure HHMM> <minutes>
+*						  cancel <origin> <destination> <departure HHMM>
+*						The departure is the flight's current one, in origin local time. An
+*						update applies to every query after it and none before it, and repairs
+*						the cached trees (see updates.c).
+*
+*						Queries are independent of each other, so a batch is shared out between
+*						worker threads (--threads) and put back in order before it is written.
+*						An update waits for every query before it to be answered, and is applied
+*						by the main thread while the workers have nothing to do.
+*						With --counters, each result also gives the search counters for its query,
+*						or the counters for the whole batch are printed to stderr at the end.
+*/
+
+#include "dijkstra_example.h"
+
+#include <stdarg.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+
+#pragma warning(disable: 4996)
+
+
+
+/* One block of batch lines, handed to a worker as a unit. The main thread reads lines into
+it, a worker answers them into its output, and the main thread writes that output once every
+block before it has been written. */
+typedef struct
+{
+	char lines[kBatchBlockLines][kTimetableLineMax];	// The lines, as read.
+	char isTooLong[kBatchBlockLines];	// 1 for a line that didn't fit, and was skipped.
+	int firstLineNumber;			// The line number of lines[0] in the batch file.
+	int lineCount;					// The number of lines in use.
+	int isAnswered;					// 1 once a worker has answered every line.
+	int rejectedLines;				// The number of lines that weren't valid queries.
+	OutputBuffer output;			// The results for every line, in order.
+} BatchBlock;
+
+/* The blocks shared between the main thread and the workers. Blocks are numbered in the
+order they're read, and block n lives in blocks[n % blockCount], so the ring holds at most
+blockCount blocks that haven't been written yet. */
+typedef struct
+{
+	const ProgramOptions* options;
+	BatchBlock* blocks;
+	int blockCount;
+
+	int blocksRead;					// Blocks the main thread has filled.
+	int blocksClaimed;				// Blocks taken by a worker.
+	int inputFinished;				// 1 once the last block has been read.
+
+	WorkerLock lock;				// Held while changing any of the above, or isAnswered.
+	WorkerSignal blockRead;			// Sent when a block is read, or the input ends.
+	WorkerSignal blockAnswered;		// Sent when a worker finishes a block.
+} BatchQueue;
+
+// What each worker thread is given: the shared queue, and its own working memory.
+typedef struct
+{
+	BatchQueue* queue;
+	QueryScratch scratch;
+} BatchWorker;
+
+
+
+static int runBatchSequential(const ProgramOptions* options, FILE* input,
+	SearchCounters* searchTotals);
+static int runBatchThreaded(const ProgramOptions* options, FILE* input, int threadCount,
+	SearchCounters* searchTotals);
+static void answerBatchBlocks(void* worker);
+static int readBatchBlock(FILE* input, BatchBlock* block, int* lineNumber, char updateLine[]);
+static int readBatchLine(FILE* input, char line[]);
+static int isUpdateLine(const char* line);
+static int answerUpdateLine(const ProgramOptions* options, QueryScratch* scratch, char* line,
+	int lineNumber, OutputBuffer* output);
+static int splitBatchFields(char* line, char* fields[], int maxFields);
+static int parseQueryLine(char* line, int isTimeOptional, int* originCity, int* destinationCity,
+	int* startTime, const char** errorMessage);
+static int parseAirportField(const char* field);
+static void writeJSONString(OutputBuffer* output, const char* text);
+static void writeProfileResult(OutputBuffer* output, int format, int lineNumber, int originCity,
+	int destinationCity, int windowStart, const QueryScratch* scratch,
+	const SearchCounters* counters);
+static void writeParetoResult(OutputBuffer* output, int format, int lineNumber, int originCity,
+	int destinationCity, int startTime, QueryScratch* scratch, const SearchCounters* counters);
+
+
+
+/*
+* Function:			runBatch()
+* Description:		Answers every query in a batch file, writing the results to stdout in the
+*					order the queries were given. With more than one thread, blocks of queries are
+*					shared out between worker threads, each with its own QueryScratch.
+* Parameters:		const ProgramOptions* options	The engine to use, the batch file ("-" for
+*													stdin), the output format and thread count.
+* Return Values:	0 if every line was a valid query, 1 if any line was rejected or the
+*					batch file couldn't be opened.
+*/
+int runBatch(const ProgramOptions* options)
+{
+	FILE* input = stdin;
+	int threadCount = (options->threadCount > 0) ? options->threadCount : processorCount();
+	int batchResult = 0;
+	SearchCounters searchTotals = { 0 };
+	const char* counterColumns = (options->searchCounters == kQueryCounters)
+		? kSearchCounterColumns : "";
+
+	if (strcmp(options->batchFile, "-") != 0)
+	{
+		input = fopen(options->batchFile, "r");
+
+		if (input == NULL)
+		{
+			fprintf(stderr, "Unable to open the batch file \"%s\".\n", options->batchFile);
+			return 1;
+		}
+	}
+
+	// Results are written in large blocks rather than a line at a time.
+	setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+
+#ifdef _WIN32
+	// A text mode stdout would write every 10 byte in a binary record as 13 10.
+	if (options->outputFormat == kBinaryOutput)
+	{
+		_setmode(_fileno(stdout), _O_BINARY);
+	}
+#endif
+
+	if ((options->outputFormat == kTSVOutput) && (options->profileQueries == 1))
+	{
+		printf("line\torigin\tdestination\twindow_start\toptions\tprofile%s\n", counterColumns);
+	}
+	else if ((options->outputFormat == kTSVOutput) && (options->pareto == 1))
+	{
+		printf("line\torigin\tdestination\tstart\toptions\tpareto%s\n", counterColumns);
+	}
+	else if (options->outputFormat == kTSVOutput)
+	{
+		printf("line\torigin\tdestination\tstart\tarrival\tarrival_day\ttravel_minutes\tflights\t"
+			"plan%s\n", counterColumns);
+	}
+
+	if (threadCount > 1)
+	{
+		batchResult = runBatchThreaded(options, input, threadCount, &searchTotals);
+	}
+	else
+	{
+		batchResult = runBatchSequential(options, input, &searchTotals);
+	}
+
+	fflush(stdout);
+
+	if (options->searchCounters == kTotalCounters)
+	{
+		printSearchCounters(&searchTotals);
+	}
+
+	if (input != stdin)
+	{
+		fclose(input);
+	}
+
+	return batchResult;
+}
+
+
+
+/*
+* Function:			runBatchSequential()
+* Description:		Answers every query in the batch on this thread alone.
+* Parameters:		const ProgramOptions* options	The engine and output format.
+*					FILE* input						The open batch file.
+*					SearchCounters* searchTotals	Set to the search counters for every query.
+* Return Values:	0 if every line was a valid query, 1 if any line was rejected or there
+*					wasn't enough memory.
+*/
+static int runBatchSequential(const ProgramOptions* options, FILE* input,
+	SearchCounters* searchTotals)
+{
+	QueryScratch scratch = { 0 };
+	OutputBuffer output = { 0 };
+
+	char line[kTimetableLineMax] = "";
+	int lineNumber = 0;
+	int rejectedLines = 0;
+
+	if (initQueryScratch(&scratch) == 0)
+	{
+		fprintf(stderr, "Not enough memory for %d airports.\n", flightTimetable()->airportCount);
+		return 1;
+	}
+
+	for (int lineRead = readBatchLine(input, line); lineRead != 0;
+		lineRead = readBatchLine(input, line))
+	{
+		lineNumber++;
+		if (lineRead == 2)
+		{
+			writeQueryError(&output, options->outputFormat, lineNumber, "line too long");
+			rejectedLines++;
+		}
+		else
+		{
+			rejectedLines += answerQueryLine(options, &scratch, line, lineNumber, &output);
+		}
+
+		// Hand the results on to stdout once there's a good amount of them.
+		if (output.length >= (1 << 16))
+		{
+			fwrite(output.text, 1, output.length, stdout);
+			output.length = 0;
+		}
+	}
+
+	fwrite(output.text, 1, output.length, stdout);
+
+	*searchTotals = scratch.searchTotals;
+
+	freeOutputBuffer(&output);
+	freeQueryScratch(&scratch);
+
+	return (rejectedLines > 0) ? 1 : 0;
+}
+
+
+
+/*
+* Function:			runBatchThreaded()
+* Description:		Answers every query in the batch on a pool of worker threads. This thread
+*					reads the batch into blocks and writes each block's results out in order, as
+*					soon as it and every block before it have been answered; the workers answer
+*					whichever block is next, so a slow block doesn't hold up the others. Each
+*					worker keeps its own QueryScratch, and each block keeps its line and output
+*					buffers, so nothing is allocated per query once the first few blocks are done.
+*					An update line is held back until every block before it is written, then
+*					applied here before any later block is read.
+* Parameters:		const ProgramOptions* options	The engine and output format.
+*					FILE* input						The open batch file.
+*					int threadCount					The number of worker threads to use.
+*					SearchCounters* searchTotals	Set to the search counters for every query.
+* Return Values:	0 if every line was a valid query, 1 if any line was rejected or there
+*					wasn't enough memory.
+*/
+static int runBatchThreaded(const ProgramOptions* options, FILE* input, int threadCount,
+	SearchCounters* searchTotals)
+{
+	BatchQueue queue;
+	BatchWorker* workers = (BatchWorker*)calloc(threadCount, sizeof(BatchWorker));
+	WorkerThread* threads = (WorkerThread*)calloc(threadCount, sizeof(WorkerThread));
+
+	// Updates are applied here, between blocks, with their own scratch and output.
+	QueryScratch updateScratch = { 0 };
+	OutputBuffer updateOutput = { 0 };
+	char updateLine[kTimetableLineMax] = "";
+	int updateLineNumber = 0;
+	int isUpdatePending = 0;
+
+	int startedThreads = 0;
+	int blocksWritten = 0;
+	int lineNumber = 0;
+	int rejectedLines = 0;
+	int isValid = 1;
+
+	queue.options = options;
+	queue.blockCount = threadCount * kBatchBlocksPerThread;
+	queue.blocks = (BatchBlock*)calloc(queue.blockCount, sizeof(BatchBlock));
+	queue.blocksRead = 0;
+	queue.blocksClaimed = 0;
+	queue.inputFinished = 0;
+
+	if ((workers == NULL) || (threads == NULL) || (queue.blocks == NULL))
+	{
+		fprintf(stderr, "Not enough memory for %d batch threads.\n", threadCount);
+		free(workers);
+		free(threads);
+		free(queue.blocks);
+		return 1;
+	}
+
+	if ((options->liveUpdates == 1) && (initQueryScratch(&updateScratch) == 0))
+	{
+		fprintf(stderr, "Not enough memory for %d airports.\n", flightTimetable()->airportCount);
+		isValid = 0;
+	}
+
+	initWorkerLock(&queue.lock);
+	initWorkerSignal(&queue.blockRead);
+	initWorkerSignal(&queue.blockAnswered);
+
+	for (int i = 0; (i < threadCount) && (isValid == 1); i++)
+	{
+		workers[i].queue = &queue;
+
+		if (initQueryScratch(&workers[i].scratch) == 0)
+		{
+			fprintf(stderr, "Not enough memory for %d airports.\n", flightTimetable()->airportCount);
+			isValid = 0;
+			break;
+		}
+		if (startWorkerThread(&threads[i], answerBatchBlocks, &workers[i]) == 0)
+		{
+			fprintf(stderr, "Unable to start batch thread %d.\n", i + 1);
+			freeQueryScratch(&workers[i].scratch);
+			isValid = 0;
+			break;
+		}
+
+		startedThreads++;
+	}
+
+	// <Reorder loop>
+	// Keep the ring full of blocks to answer, and write out answered blocks in order.
+	while (isValid == 1)
+	{
+		int isEndOfInput = 0;
+
+		// Read the next block, as long as the ring has a free slot for it and no update is waiting.
+		if ((queue.inputFinished == 0) && (isUpdatePending == 0)
+			&& (queue.blocksRead - blocksWritten < queue.blockCount))
+		{
+			BatchBlock* block = &queue.blocks[queue.blocksRead % queue.blockCount];
+			int readResult = readBatchBlock(input, block, &lineNumber,
+				(options->liveUpdates == 1) ? updateLine : NULL);
+
+			isEndOfInput = (readResult == 0);
+			if (readResult == 2)
+			{
+				isUpdatePending = 1;
+				updateLineNumber = lineNumber;
+			}
+
+			lockWorkers(&queue.lock);
+			if (block->lineCount > 0)
+			{
+				block->isAnswered = 0;
+				queue.blocksRead++;
+				sendSignal(&queue.blockRead);
+			}
+			if (isEndOfInput == 1)
+			{
+				queue.inputFinished = 1;
+				broadcastSignal(&queue.blockRead);
+			}
+			unlockWorkers(&queue.lock);
+		}
+
+		if ((queue.inputFinished == 1) && (blocksWritten == queue.blocksRead))
+		{
+			break;
+		}
+
+		/* Every block before the update has been written, so no worker is searching: the
+		timetable and the cache can be changed. */
+		if ((isUpdatePending == 1) && (blocksWritten == queue.blocksRead))
+		{
+			updateOutput.length = 0;
+			rejectedLines += answerUpdateLine(options, &updateScratch, updateLine, updateLineNumber,
+				&updateOutput);
+			fwrite(updateOutput.text, 1, updateOutput.length, stdout);
+			isUpdatePending = 0;
+			continue;
+		}
+
+		/* Write the oldest block once it has been answered. Only wait for it when there's
+		nothing else to do: the ring is full, or there's nothing left to read. */
+		{
+			BatchBlock* block = &queue.blocks[blocksWritten % queue.blockCount];
+			int mustWait = (queue.inputFinished == 1) || (isUpdatePending == 1)
+				|| (queue.blocksRead - blocksWritten == queue.blockCount);
+			int isAnswered = 0;
+
+			lockWorkers(&queue.lock);
+			while ((mustWait == 1) && (block->isAnswered == 0))
+			{
+				waitForSignal(&queue.blockAnswered, &queue.lock);
+			}
+			isAnswered = (blocksWritten < queue.blocksRead) && (block->isAnswered == 1);
+			unlockWorkers(&queue.lock);
+
+			if (isAnswered == 1)
+			{
+				fwrite(block->output.text, 1, block->output.length, stdout);
+				rejectedLines += block->rejectedLines;
+				blocksWritten++;
+			}
+		}
+	} // End of reorder loop.
+
+	// Let every worker know there's nothing more coming, and wait for them to stop.
+	lockWorkers(&queue.lock);
+	queue.inputFinished = 1;
+	broadcastSignal(&queue.blockRead);
+	unlockWorkers(&queue.lock);
+
+	for (int i = 0; i < startedThreads; i++)
+	{
+		joinWorkerThread(threads[i]);
+		addSearchCounters(searchTotals, &workers[i].scratch.searchTotals);
+		freeQueryScratch(&workers[i].scratch);
+	}
+
+	for (int i = 0; i < queue.blockCount; i++)
+	{
+		freeOutputBuffer(&queue.blocks[i].output);
+	}
+
+	freeWorkerSignal(&queue.blockAnswered);
+	freeWorkerSignal(&queue.blockRead);
+	freeWorkerLock(&queue.lock);
+
+	free(queue.blocks);
+	free(threads);
+	free(workers);
+
+	freeOutputBuffer(&updateOutput);
+	freeQueryScratch(&updateScratch);
+
+	return ((isValid == 1) && (rejectedLines == 0)) ? 0 : 1;
+}
+
+
+
+/*
+* Function:			answerBatchBlocks()
+* Description:		The work done by each batch worker thread: takes the next block that hasn't
+*					been claimed, answers every line in it, and repeats until the input is done.
+* Parameters:		void* worker		The BatchWorker for this thread.
+*/
+static void answerBatchBlocks(void* worker)
+{
+	BatchWorker* self = (BatchWorker*)worker;
+	BatchQueue* queue = self->queue;
+
+	while (1)
+	{
+		BatchBlock* block = NULL;
+		int rejectedLines = 0;
+
+		// Wait for a block to answer, or for the input to run out.
+		lockWorkers(&queue->lock);
+		while ((queue->blocksClaimed == queue->blocksRead) && (queue->inputFinished == 0))
+		{
+			waitForSignal(&queue->blockRead, &queue->lock);
+		}
+		if (queue->blocksClaimed == queue->blocksRead)
+		{
+			unlockWorkers(&queue->lock);
+			break;
+		}
+		block = &queue->blocks[queue->blocksClaimed % queue->blockCount];
+		queue->blocksClaimed++;
+		unlockWorkers(&queue->lock);
+
+		// The block is this thread's alone until it is marked as answered.
+		block->output.length = 0;
+
+		for (int i = 0; i < block->lineCount; i++)
+		{
+			if (block->isTooLong[i] == 1)
+			{
+				writeQueryError(&block->output, queue->options->outputFormat,
+					block->firstLineNumber + i, "line too long");
+				rejectedLines++;
+			}
+			else
+			{
+				rejectedLines += answerQueryLine(queue->options, &self->scratch, block->lines[i],
+					block->firstLineNumber + i, &block->output);
+			}
+		}
+
+		lockWorkers(&queue->lock);
+		block->rejectedLines = rejectedLines;
+		block->isAnswered = 1;
+		sendSignal(&queue->blockAnswered);
+		unlockWorkers(&queue->lock);
+	}
+}
+
+
+
+/*
+* Function:			readBatchBlock()
+* Description:		Reads up to kBatchBlockLines lines of the batch file into a block. An update
+*					line ends the block early, and is kept out of it for the main thread. A line
+*					too long to fit is kept in the block, marked, so its error is written in order.
+* Parameters:		FILE* input				The open batch file.
+*					BatchBlock* block		The block to fill.
+*					int* lineNumber			The number of lines read so far. Updated.
+*					char updateLine[]		Where to put an update line, or NULL if updates
+*											aren't being taken.
+* Return Values:	1 if the block was filled, 2 if it was ended by an update line, 0 if the
+*					batch file ran out first.
+*/
+static int readBatchBlock(FILE* input, BatchBlock* block, int* lineNumber, char updateLine[])
+{
+	block->firstLineNumber = *lineNumber + 1;
+	block->lineCount = 0;
+
+	while (block->lineCount < kBatchBlockLines)
+	{
+		char* line = block->lines[block->lineCount];
+		int lineRead = readBatchLine(input, line);
+
+		if (lineRead == 0)
+		{
+			return 0;
+		}
+
+		(*lineNumber)++;
+		block->isTooLong[block->lineCount] = (char)((lineRead == 2) ? 1 : 0);
+
+		if ((lineRead == 1) && (updateLine != NULL) && (isUpdateLine(line) == 1))
+		{
+			strcpy(updateLine, line);
+			return 2;
+		}
+
+		block->lineCount++;
+	}
+
+	return 1;
+}
+
+
+
+/*
+* Function:			readBatchLine()
+* Description:		Reads one line of the batch file. A line that doesn't fit in
+*					kTimetableLineMax characters (newline included, as the server counts it)
+*					is read to its end and thrown away, rather than being split into several
+*					lines that would each be taken as a query and throw the line numbers off.
+* Parameters:		FILE* input				The open batch file.
+*					char line[]				Where to put the line. Empty if it was too long.
+* Return Values:	1 if a line was read, 2 if the line was too long, 0 at the end of the file.
+*/
+static int readBatchLine(FILE* input, char line[])
+{
+	size_t lineLength = 0;
+	int nextCharacter = 0;
+
+	if (fgets(line, kTimetableLineMax, input) == NULL)
+	{
+		return 0;
+	}
+
+	// A line that filled the buffer without its newline either ends the file here, or is too long.
+	lineLength = strlen(line);
+	if ((lineLength < kTimetableLineMax - 1) || (line[lineLength - 1] == '\n'))
+	{
+		return 1;
+	}
+
+	nextCharacter = getc(input);
+	if (nextCharacter == EOF)
+	{
+		return 1;
+	}
+
+	while ((nextCharacter != '\n') && (nextCharacter != EOF))
+	{
+		nextCharacter = getc(input);
+	}
+
+	line[0] = '\0';
+
+	return 2;
+}
+
+
+
+/*
+* Function:			answerQueryLine()
+* Description:		Answers the query on one batch line, and writes its result line (or an
+*					error line) to the output. Blank lines and comments write nothing.
+* Parameters:		const ProgramOptions* options	The engine and output format.
+*					QueryScratch* scratch			Working memory for the search.
+*					char* line						The batch line. Changed in place.
+*					int lineNumber					The line's number in the batch file.
+*					OutputBuffer* output			Where to write the result.
+* Return Values:	1 if the line was rejected, 0 otherwise.
+*/
+int answerQueryLine(const ProgramOptions* options, QueryScratch* scratch, char* line,
+	int lineNumber, OutputBuffer* output)
+{
+	int originCity = 0;
+	int destinationCity = 0;
+	int startTime = 0;
+	const char* errorMessage = NULL;
+	int lineResult = 0;
+
+	SearchCounters queryCounters = { 0 };
+	const SearchCounters* reportedCounters = NULL;
+
+	if ((options->liveUpdates == 1) && (isUpdateLine(line) == 1))
+	{
+		return answerUpdateLine(options, scratch, line, lineNumber, output);
+	}
+
+	lineResult = parseQueryLine(line, options->profileQueries, &originCity, &destinationCity,
+		&startTime, &errorMessage);
+
+	// Blank line or comment.
+	if (lineResult == 0)
+	{
+		return 0;
+	}
+	else if (lineResult < 0)
+	{
+		writeQueryError(output, options->outputFormat, lineNumber, errorMessage);
+		return 1;
+	}
+
+	resetSearchCounters();
+
+	if (options->profileQueries == 1)
+	{
+		if (profileEarliestArrivals(scratch, startTime, originCity) == 0)
+		{
+			writeQueryError(output, options->outputFormat, lineNumber, "not enough memory");
+			return 1;
+		}
+	}
+	else if (options->pareto == 1)
+	{
+		paretoEarliestArrivals(scratch, startTime, originCity, destinationCity, options->maxLegs);
+	}
+	else if (options->arriveBy == 1)
+	{
+		/* The line's time is the deadline. The result is written as an ordinary query from the
+		latest start, on the day of that start, so its days count from the day the flyer leaves. */
+		if (findLatestStart(scratch, startTime, originCity, destinationCity, &startTime) == 1)
+		{
+			startTime -= dayOfTime(startTime) * kMinutesPerDay;
+		}
+	}
+	else
+	{
+		clearQueryResults(scratch);
+		findEarliestArrivals(options, scratch, startTime, originCity, destinationCity,
+			scratch->earliestArrivals);
+		createFastestFlightplan(originCity, destinationCity, scratch->earliestArrivals,
+			scratch->flightPlan);
+	}
+
+	// The counters are kept by this thread, so only its own queries are in them.
+	if (options->searchCounters != kNoCounters)
+	{
+		queryCounters = currentSearchCounters();
+		addSearchCounters(&scratch->searchTotals, &queryCounters);
+
+		if (options->searchCounters == kQueryCounters)
+		{
+			reportedCounters = &queryCounters;
+		}
+	}
+
+	if (options->profileQueries == 1)
+	{
+		writeProfileResult(output, options->outputFormat, lineNumber, originCity, destinationCity,
+			startTime, scratch, reportedCounters);
+	}
+	else if (options->pareto == 1)
+	{
+		writeParetoResult(output, options->outputFormat, lineNumber, originCity, destinationCity,
+			startTime, scratch, reportedCounters);
+	}
+	else
+	{
+		writeItinerary(output, options->outputFormat, lineNumber, originCity, destinationCity,
+			startTime, scratch->flightPlan, reportedCounters);
+	}
+
+	return 0;
+}
+
+
+
+/*
+* Function:			isUpdateLine()
+* Description:		Checks whether a batch line delays or cancels a flight, rather than asking a
+*					query.
+* Parameters:		const char* line		The batch line.
+* Return Values:	1 for an update line, 0 otherwise.
+*/
+static int isUpdateLine(const char* line)
+{
+	while ((*line == ' ') || (*line == '\t'))
+	{
+		line++;
+	}
+
+	return ((strncmp(line, "delay", 5) == 0) && (strchr(" \t,", line[5]) != NULL))
+		|| ((strncmp(line, "cancel", 6) == 0) && (strchr(" \t,", line[6]) != NULL));
+}
+
+
+
+/*
+* Function:			answerUpdateLine()
+* Description:		Delays or cancels the flight on one update line, repairs the cached trees,
+*					and writes a result line (or an error line) to the output. No other thread
+*					may be answering queries while it runs.
+* Parameters:		const ProgramOptions* options	The output format, and whether there's a cache.
+*					QueryScratch* scratch			Working memory for repairing the cached trees.
+*					char* line						The update line. Changed in place.
+*					int lineNumber					The line's number in the batch file.
+*					OutputBuffer* output			Where to write the result.
+* Return Values:	1 if the line was rejected, 0 otherwise.
+*/
+static int answerUpdateLine(const ProgramOptions* options, QueryScratch* scratch, char* line,
+	int lineNumber, OutputBuffer* output)
+{
+	const Timetable* network = flightTimetable();
+	char* fields[6] = { NULL };
+	int fieldCount = splitBatchFields(line, fields, 6);
+	int isCancel = (strcmp(fields[0], "cancel") == 0);
+	int originCity = 0;
+	int destinationCity = 0;
+	int timeInHHMM = 0;
+	int delayMinutes = 0;
+	int departureTime = 0;
+	int flightID = 0;
+	int repairedTrees = 0;
+	FlightUpdate update = { 0 };
+
+	if (fieldCount != ((isCancel == 1) ? 4 : 5))
+	{
+		writeQueryError(output, options->outputFormat, lineNumber, (isCancel == 1)
+			? "expected cancel, origin, destination and HHMM departure"
+			: "expected delay, origin, destination, HHMM departure and minutes");
+		return 1;
+	}
+
+	originCity = parseAirportField(fields[1]);
+	destinationCity = parseAirportField(fields[2]);
+
+	if ((originCity == 0) || (destinationCity == 0))
+	{
+		writeQueryError(output, options->outputFormat, lineNumber,
+			(originCity == 0) ? "unknown origin" : "unknown destination");
+		return 1;
+	}
+
+	if ((sscanf(fields[3], "%d", &timeInHHMM) != 1)
+		|| (checkRange(timeInHHMM / 100, 0, kHoursPerDay - 1) == 0)
+		|| (checkRange(timeInHHMM % 100, 0, kMinutesPerHour - 1) == 0))
+	{
+		writeQueryError(output, options->outputFormat, lineNumber, "invalid HHMM departure");
+		return 1;
+	}
+
+	if ((isCancel == 0) && ((sscanf(fields[4], "%d", &delayMinutes) != 1)
+		|| (checkRange(delayMinutes, 1, kMinutesPerDay - 1) == 0)))
+	{
+		writeQueryError(output, options->outputFormat, lineNumber,
+			"delay must be 1 to 1439 minutes");
+		return 1;
+	}
+
+	// The timetable's flights leave at UTC times within the day.
+	departureTime = timeAsMinutes(timeInHHMM) - timezoneOffset(originCity);
+	departureTime -= dayOfTime(departureTime) * kMinutesPerDay;
+	flightID = findScheduledFlight(originCity, destinationCity, departureTime);
+
+	if (flightID < 0)
+	{
+		writeQueryError(output, options->outputFormat, lineNumber, "no such flight");
+		return 1;
+	}
+
+	if (((isCancel == 1) && (cancelFlight(flightID, &update) == 0))
+		|| ((isCancel == 0) && (delayFlight(flightID, delayMinutes, &update) == 0)))
+	{
+		writeQueryError(output, options->outputFormat, lineNumber, "flight is cancelled");
+		return 1;
+	}
+
+	repairedTrees = repairCachedArrivals(scratch, &update);
+
+	if (options->outputFormat == kJSONOutput)
+	{
+		appendOutput(output, "{\"line\":%d,\"update\":\"%s\",\"from\":", lineNumber,
+			(isCancel == 1) ? "cancel" : "delay");
+		appendAirportJSON(output, originCity);
+		appendOutput(output, ",\"to\":");
+		appendAirportJSON(output, destinationCity);
+		appendOutput(output, ",\"departure\":\"%04d\"", timeInHHMM);
+		if (isCancel == 0)
+		{
+			appendOutput(output, ",\"delayMinutes\":%d", delayMinutes);
+		}
+		appendOutput(output, ",\"repairedTrees\":%d}\n", repairedTrees);
+	}
+	else
+	{
+		appendOutput(output, "%d\tupdate: %s %s>%s %04d", lineNumber,
+			(isCancel == 1) ? "cancel" : "delay", network->airports[originCity].name,
+			network->airports[destinationCity].name, timeInHHMM);
+		if (isCancel == 0)
+		{
+			appendOutput(output, " by %d minutes", delayMinutes);
+		}
+		appendOutput(output, ", %d cached tree%s repaired\n", repairedTrees,
+			(repairedTrees == 1) ? "" : "s");
+	}
+
+	return 0;
+}
+
+
+
+/*
+* Function:			parseQueryLine()
+* Description:		Reads the origin, destination and start time from one line of a batch file.
+* Parameters:		char* line					The line to read. Changed in place.
+*					int isTimeOptional			1 if the start time may be left off, for midnight.
+*					int* originCity				Set to the origin's cityID.
+*					int* destinationCity		Set to the destination's cityID.
+*					int* startTime				Set to the start time, in minutes since local
+*												midnight at the origin.
+*					const char** errorMessage	Set to a description of the problem, if the line
+*												isn't a valid query.
+* Return Values:	1 for a valid query, 0 for a blank line or comment, -1 for an invalid line.
+*/
+static int parseQueryLine(char* line, int isTimeOptional, int* originCity, int* destinationCity,
+	int* startTime, const char** errorMessage)
+{
+	char* fields[4] = { NULL };
+	int fieldCount = splitBatchFields(line, fields, 4);
+	int timeInHHMM = 0;
+
+	if ((fieldCount == 0) || (fields[0][0] == '#'))
+	{
+		return 0;
+	}
+
+	// A profile's window starts at midnight unless a time is given.
+	if ((fieldCount == 2) && (isTimeOptional == 1))
+	{
+		fields[2] = "0000";
+		fieldCount = 3;
+	}
+
+	if (fieldCount != 3)
+	{
+		*errorMessage = "expected origin, destination and HHMM start time";
+		return -1;
+	}
+
+	*originCity = parseAirportField(fields[0]);
+	*destinationCity = parseAirportField(fields[1]);
+
+	if (*originCity == 0)
+	{
+		*errorMessage = "unknown origin";
+		return -1;
+	}
+	if (*destinationCity == 0)
+	{
+		*errorMessage = "unknown destination";
+		return -1;
+	}
+	if (*originCity == *destinationCity)
+	{
+		*errorMessage = "origin and destination are the same";
+		return -1;
+	}
+
+	if ((sscanf(fields[2], "%d", &timeInHHMM) != 1)
+		|| (checkRange(timeInHHMM / 100, 0, kHoursPerDay - 1) == 0)
+		|| (checkRange(timeInHHMM % 100, 0, kMinutesPerHour - 1) == 0))
+	{
+		*errorMessage = "invalid HHMM start time";
+		return -1;
+	}
+
+	*startTime = timeAsMinutes(timeInHHMM);
+
+	return 1;
+}
+
+
+
+/*
+* Function:			splitBatchFields()
+* Description:		Splits a batch line into its fields. Fields are split on tabs or commas if
+*					the line has any, so names with spaces can be used; otherwise on spaces.
+* Parameters:		char* line			The line to split. Changed in place.
+*					char* fields[]		Set to the fields, trimmed of spaces.
+*					int maxFields		The most fields to split off.
+* Return Values:	The number of fields.
+*/
+static int splitBatchFields(char* line, char* fields[], int maxFields)
+{
+	const char* separators = (strpbrk(line, "\t,") != NULL) ? "\t,\r\n" : " \t\r\n";
+	int fieldCount = 0;
+	char* cursor = line;
+
+	// Split the line by hand; strtok() keeps its place in a static, so can't be used by workers.
+	while (fieldCount < maxFields)
+	{
+		char* field = NULL;
+
+		while ((*cursor != '\0') && (strchr(separators, *cursor) != NULL))
+		{
+			cursor++;
+		}
+		if (*cursor == '\0')
+		{
+			break;
+		}
+
+		field = cursor;
+		while ((*cursor != '\0') && (strchr(separators, *cursor) == NULL))
+		{
+			cursor++;
+		}
+		if (*cursor != '\0')
+		{
+			*cursor = '\0';
+			cursor++;
+		}
+
+		// Trim any spaces left around tab or comma separated fields.
+		while (*field == ' ')
+		{
+			field++;
+		}
+		for (size_t length = strlen(field); (length > 0) && (field[length - 1] == ' '); length--)
+		{
+			field[length - 1] = '\0';
+		}
+
+		if (*field != '\0')
+		{
+			fields[fieldCount] = field;
+			fieldCount++;
+		}
+	}
+
+	return fieldCount;
+}
+
+
+
+/*
+* Function:			parseAirportField()
+* Description:		Turns an airport number or name from a batch line into a cityID.
+* Parameters:		const char* field		The airport number or name.
+* Return Values:	The cityID, or 0 if there's no such airport.
+*/
+static int parseAirportField(const char* field)
+{
+	int cityID = findAirport(field);
+	int number = 0;
+	char extra = '\0';
+
+	// If it isn't a name, try it as a number.
+	if ((cityID == 0) && (sscanf(field, "%d%c", &number, &extra) == 1)
+		&& (checkRange(number, 1, flightTimetable()->airportCount) == 1))
+	{
+		cityID = number;
+	}
+
+	return cityID;
+}
+
+
+
+/*
+* Function:			writeJSONString()
+* Description:		Writes a string as a quoted, escaped JSON string.
+* Parameters:		OutputBuffer* output	Where to write.
+*					const char* text		The string to write.
+*/
+static void writeJSONString(OutputBuffer* output, const char* text)
+{
+	appendOutput(output, "\"");
+
+	for (; *text != '\0'; text++)
+	{
+		if ((*text == '"') || (*text == '\\'))
+		{
+			appendOutput(output, "\\%c", *text);
+		}
+		else if ((unsigned char)*text < 0x20)
+		{
+			appendOutput(output, "\\u%04x", (unsigned char)*text);
+		}
+		else
+		{
+			appendOutput(output, "%c", *text);
+		}
+	}
+
+	appendOutput(output, "\"");
+}
+
+
+
+/*
+* Function:			writeProfileResult()
+* Description:		Writes the result of one profile query as a JSON line or a TSV row: every
+*					departure in the window worth taking, with when it arrives. Times are given
+*					as local HHMM at each airport, with the number of days after the window's
+*					first day (0 for the same day). The count is negative for a time that falls
+*					on the day before, as an arrival west of the origin can; the TSV row writes
+*					it as a signed suffix, "+1" or "-1", left off on the first day.
+* Parameters:		OutputBuffer* output		Where to write.
+*					int format					kJSONOutput or kTSVOutput.
+*					int lineNumber				The query's line in the batch file.
+*					int originCity				The query's origin.
+*					int destinationCity			The query's destination.
+*					int windowStart				The start of the window, in minutes since local
+*												midnight.
+*					const QueryScratch* scratch	The scratch holding the profile.
+*					const SearchCounters* counters	The query's search counters, or NULL to
+*													leave them out.
+*/
+static void writeProfileResult(OutputBuffer* output, int format, int lineNumber, int originCity,
+	int destinationCity, int windowStart, const QueryScratch* scratch,
+	const SearchCounters* counters)
+{
+	const Timetable* network = flightTimetable();
+	int originOffset = timezoneOffset(originCity);
+	int destinationOffset = timezoneOffset(destinationCity);
+	int optionCount = 0;
+
+	for (int entry = scratch->profileHeads[destinationCity]; entry >= 0;
+		entry = scratch->profileEntries[entry].next)
+	{
+		optionCount++;
+	}
+
+	if (format == kJSONOutput)
+	{
+		appendOutput(output, "{\"line\":%d,\"origin\":", lineNumber);
+		appendAirportJSON(output, originCity);
+		appendOutput(output, ",\"destination\":");
+		appendAirportJSON(output, destinationCity);
+		appendOutput(output, ",\"windowStart\":\"%04d\",\"reachable\":%s,\"profile\":[",
+			timeAsHHMM(windowStart), (optionCount > 0) ? "true" : "false");
+	}
+	else
+	{
+		appendOutput(output, "%d\t%s\t%s\t%04d\t%d\t", lineNumber,
+			network->airports[originCity].name, network->airports[destinationCity].name,
+			timeAsHHMM(windowStart), optionCount);
+	}
+
+	for (int entry = scratch->profileHeads[destinationCity]; entry >= 0;
+		entry = scratch->profileEntries[entry].next)
+	{
+		const ProfileEntry* option = &scratch->profileEntries[entry];
+		int departureLocal = option->departureTime + originOffset;
+		int arrivalLocal = option->arrivalTime + destinationOffset;
+		int departureDay = dayOfTime(departureLocal);
+		int arrivalDay = dayOfTime(arrivalLocal);
+		const char* separator = (entry == scratch->profileHeads[destinationCity]) ? ""
+			: ((format == kJSONOutput) ? "," : ";");
+
+		if (format == kJSONOutput)
+		{
+			appendOutput(output, "%s{\"departure\":\"%04d\",\"departureDay\":%d,"
+				"\"arrival\":\"%04d\",\"arrivalDay\":%d,\"travelMinutes\":%d}", separator,
+				timeAsHHMM(departureLocal - departureDay * kMinutesPerDay), departureDay,
+				timeAsHHMM(arrivalLocal - arrivalDay * kMinutesPerDay), arrivalDay,
+				option->arrivalTime - option->departureTime);
+		}
+		else
+		{
+			// Each option as "HHMM>HHMM", a time on another day followed by "+N" or "-N".
+			appendOutput(output, "%s%04d", separator,
+				timeAsHHMM(departureLocal - departureDay * kMinutesPerDay));
+			if (departureDay != 0)
+			{
+				appendOutput(output, "%+d", departureDay);
+			}
+			appendOutput(output, ">%04d", timeAsHHMM(arrivalLocal - arrivalDay * kMinutesPerDay));
+			if (arrivalDay != 0)
+			{
+				appendOutput(output, "%+d", arrivalDay);
+			}
+		}
+	}
+
+	if (format == kJSONOutput)
+	{
+		appendOutput(output, "]");
+	}
+
+	if (counters != NULL)
+	{
+		appendOutput(output, (format == kJSONOutput) ? ",\"counters\":" : "");
+		writeSearchCounters(output, format, counters);
+	}
+
+	appendOutput(output, (format == kJSONOutput) ? "}\n" : "\n");
+}
+
+
+
+/*
+* Function:			writeParetoResult()
+* Description:		Writes the result of one Pareto query as a JSON line or a TSV row: every plan
+*					that arrives sooner by taking more flights, fewest flights first. Times are
+*					given as local HHMM at each airport, with the number of days after the start
+*					day (0 for the same day), negative for an arrival west of the origin that
+*					lands the day before. The TSV row writes it as the profile's does, "+1" or
+*					"-1", left off on the start day.
+* Parameters:		OutputBuffer* output		Where to write.
+*					int format					kJSONOutput or kTSVOutput.
+*					int lineNumber				The query's line in the batch file.
+*					int originCity				The query's origin.
+*					int destinationCity			The query's destination.
+*					int startTime				The start time, in minutes since local midnight.
+*					QueryScratch* scratch		The scratch holding the options. Its flightPlan is
+*												used for each option's plan in turn (JSON only).
+*					const SearchCounters* counters	The query's search counters, or NULL to
+*													leave them out.
+*/
+static void writeParetoResult(OutputBuffer* output, int format, int lineNumber, int originCity,
+	int destinationCity, int startTime, QueryScratch* scratch, const SearchCounters* counters)
+{
+	const Timetable* network = flightTimetable();
+	int startTimeUTC = startTime - timezoneOffset(originCity);
+	int destinationOffset = timezoneOffset(destinationCity);
+
+	if (format == kJSONOutput)
+	{
+		appendOutput(output, "{\"line\":%d,\"origin\":", lineNumber);
+		appendAirportJSON(output, originCity);
+		appendOutput(output, ",\"destination\":");
+		appendAirportJSON(output, destinationCity);
+		appendOutput(output, ",\"start\":\"%04d\",\"reachable\":%s,\"options\":[",
+			timeAsHHMM(startTime), (scratch->paretoOptionCount > 0) ? "true" : "false");
+	}
+	else
+	{
+		appendOutput(output, "%d\t%s\t%s\t%04d\t%d\t", lineNumber,
+			network->airports[originCity].name, network->airports[destinationCity].name,
+			timeAsHHMM(startTime), scratch->paretoOptionCount);
+	}
+
+	for (int i = 0; i < scratch->paretoOptionCount; i++)
+	{
+		const ParetoOption* option = &scratch->paretoOptions[i];
+		int arrivalLocal = option->arrivalTime + destinationOffset;
+		int arrivalDay = dayOfTime(arrivalLocal);
+		const char* separator = (i == 0) ? "" : ((format == kJSONOutput) ? "," : ";");
+
+		if (format == kJSONOutput)
+		{
+			int groundTime = startTimeUTC;
+
+			appendOutput(output, "%s{\"flights\":%d,\"arrival\":\"%04d\",\"arrivalDay\":%d,"
+				"\"travelMinutes\":%d,\"plan\":[", separator, option->flightCount,
+				timeAsHHMM(arrivalLocal - arrivalDay * kMinutesPerDay), arrivalDay,
+				option->arrivalTime - startTimeUTC);
+
+			createParetoFlightplan(scratch, originCity, destinationCity, option,
+				scratch->flightPlan);
+
+			for (int j = 0; scratch->flightPlan[j] != NULL; j++)
+			{
+				const Flight* flight = scratch->flightPlan[j];
+				int departureTime = nextConnectionUTC(flight, groundTime, (j == 0) ? 1 : 0);
+				int departureLocal = departureTime + timezoneOffset(flight->originCity);
+				int departureDay = dayOfTime(departureLocal);
+				int landingLocal = 0;
+				int landingDay = 0;
+
+				groundTime = departureTime + flight->flightDuration;
+				landingLocal = groundTime + timezoneOffset(flight->destinationCity);
+				landingDay = dayOfTime(landingLocal);
+
+				appendOutput(output, "%s{\"from\":", (j > 0) ? "," : "");
+				appendAirportJSON(output, flight->originCity);
+				appendOutput(output, ",\"to\":");
+				appendAirportJSON(output, flight->destinationCity);
+				appendOutput(output, ",\"departure\":\"%04d\",\"departureDay\":%d,"
+					"\"arrival\":\"%04d\",\"arrivalDay\":%d}",
+					timeAsHHMM(departureLocal - departureDay * kMinutesPerDay), departureDay,
+					timeAsHHMM(landingLocal - landingDay * kMinutesPerDay), landingDay);
+			}
+
+			appendOutput(output, "]}");
+		}
+		else
+		{
+			// Each option as "N@HHMM": N flights, arriving then, with "+N" or "-N" for another day.
+			appendOutput(output, "%s%d@%04d", separator, option->flightCount,
+				timeAsHHMM(arrivalLocal - arrivalDay * kMinutesPerDay));
+			if (arrivalDay != 0)
+			{
+				appendOutput(output, "%+d", arrivalDay);
+			}
+		}
+	}
+
+	if (format == kJSONOutput)
+	{
+		appendOutput(output, "]");
+	}
+
+	if (counters != NULL)
+	{
+		appendOutput(output, (format == kJSONOutput) ? ",\"counters\":" : "");
+		writeSearchCounters(output, format, counters);
+	}
+
+	appendOutput(output, (format == kJSONOutput) ? "}\n" : "\n");
+}
+
+
+
+/*
+* Function:			writeQueryError()
+* Description:		Writes the result line for a batch line that isn't a valid query.
+* Parameters:		OutputBuffer* output		Where to write.
+*					int format					kJSONOutput or kTSVOutput.
+*					int lineNumber				The line in the batch file.
+*					const char* errorMessage	What was wrong with it.
+*/
+void writeQueryError(OutputBuffer* output, int format, int lineNumber,
+	const char* errorMessage)
+{
+	if (format == kJSONOutput)
+	{
+		appendOutput(output, "{\"line\":%d,\"error\":", lineNumber);
+		writeJSONString(output, errorMessage);
+		appendOutput(output, "}\n");
+	}
+	else if (format == kBinaryOutput)
+	{
+		// The record's length, its line, -1 flights for an error, then the message.
+		appendBinaryField(output, 8 + (int)strlen(errorMessage));
+		appendBinaryField(output, lineNumber);
+		appendBinaryField(output, -1);
+		appendBytes(output, errorMessage, strlen(errorMessage));
+	}
+	else
+	{
+		appendOutput(output, "%d\terror: %s\n", lineNumber, errorMessage);
+	}
+}
+
+
+
+/*
+* Function:			appendOutput()
+* Description:		Writes printf-style formatted text to the end of an OutputBuffer, growing it
+*					if there isn't room.
+* Parameters:		OutputBuffer* buffer	The buffer to write to.
+*					const char* format		The printf() format.
+*					...						The values for the format.
+* Return Values:	1 if the text was written, 0 if there wasn't enough memory.
+*/
+int appendOutput(OutputBuffer* buffer, const char* format, ...)
+{
+	va_list arguments;
+	int needed = 0;
+
+	// Find out how long the text is first, so it's only formatted into the buffer once.
+	va_start(arguments, format);
+#ifdef _WIN32
+	needed = _vscprintf(format, arguments);
+#else
+	needed = vsnprintf(NULL, 0, format, arguments);
+#endif
+	va_end(arguments);
+
+	if (needed < 0)
+	{
+		return 0;
+	}
+
+	// Leave room for the null vsprintf() adds, even though the text doesn't keep it.
+	if (buffer->length + needed + 1 > buffer->capacity)
+	{
+		size_t newCapacity = (buffer->capacity == 0) ? 4096 : buffer->capacity * 2;
+		char* newText = NULL;
+
+		while (buffer->length + needed + 1 > newCapacity)
+		{
+			newCapacity *= 2;
+		}
+
+		newText = (char*)realloc(buffer->text, newCapacity);
+		if (newText == NULL)
+		{
+			return 0;
+		}
+
+		buffer->text = newText;
+		buffer->capacity = newCapacity;
+	}
+
+	va_start(arguments, format);
+	vsprintf(buffer->text + buffer->length, format, arguments);
+	va_end(arguments);
+
+	buffer->length += needed;
+
+	return 1;
+}
+
+
+
+/*
+* Function:			freeOutputBuffer()
+* Description:		Releases the memory held by an OutputBuffer, leaving it empty.
+* Parameters:		OutputBuffer* buffer	The buffer to release.
+*/
+void freeOutputBuffer(OutputBuffer* buffer)
+{
+	free(buffer->text);
+
+	buffer->text = NULL;
+	buffer->length = 0;
+	buffer->capacity = 0;
+}
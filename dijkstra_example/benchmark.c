@@ -0,0 +1,287 @@
+/*
+* Filename:				benchmark.c
+* Description:			Benchmarks for the Amazing Race flight planner. For each network size
+*						asked for, makes up a hub-and-spoke network (see generateTimetable()), times
+*						a set of random queries against it one at a time, and writes one line of
+*						results per size: the network's shape, the 50th and 99th percentile query
+*						times, queries per second and the process's peak memory use so far.
+*						Results are JSON lines, or TSV with --format tsv, so runs can be compared
+*						by a script.
+*
+*						Each query is timed the same way the menu answers it: a search, then the
+*						flight plan to the destination. The random queries come from the same
+*						seed as the network, so a run can be repeated exactly.
+*/
+
+#include "dijkstra_example.h"
+
+#ifdef _WIN32
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+
+#pragma warning(disable: 4996)
+
+
+
+static int benchmarkNetwork(const ProgramOptions* options, int airportCount);
+static int randomQueryValue(unsigned int* state, int limit);
+static long peakMemoryKB(void);
+static int compareSeconds(const void* first, const void* second);
+
+
+
+/*
+* Function:			runBenchmark()
+* Description:		Benchmarks every network size in the options' list, writing the results to
+*					stdout.
+* Parameters:		const ProgramOptions* options	The sizes, network shape, engine, number of
+*													queries and output format.
+* Return Values:	0 if every size was benchmarked, 1 if the list is invalid or a network
+*					couldn't be made (or is too big for the engine).
+*/
+int runBenchmark(const ProgramOptions* options)
+{
+	const char* size = options->benchmarkSizes;
+
+	// Results are written as each size finishes, so a long run can be watched.
+	if (options->outputFormat == kTSVOutput)
+	{
+		printf("engine\tairports\thubs\tlegs\tflights\tseed\tsetup_seconds\tqueries\t"
+			"p50_microseconds\tp99_microseconds\tqueries_per_second\tpeak_rss_kb\n");
+	}
+
+	// <Size loop>
+	// The sizes are a comma separated list of airport counts.
+	while (*size != '\0')
+	{
+		int airportCount = 0;
+		int length = 0;
+
+		if ((sscanf(size, "%d%n", &airportCount, &length) != 1) || (airportCount < 2))
+		{
+			fprintf(stderr, "Invalid benchmark size list \"%s\".\n", options->benchmarkSizes);
+			return 1;
+		}
+
+		if (benchmarkNetwork(options, airportCount) == 0)
+		{
+			return 1;
+		}
+
+		size += length;
+
+		if (*size == ',')
+		{
+			size++;
+		}
+	}
+
+	return 0;
+}
+
+
+
+/*
+* Function:			benchmarkNetwork()
+* Description:		Makes up one network, times the random queries against it, and writes a line
+*					of results.
+* Parameters:		const ProgramOptions* options	The network shape, engine and query count.
+*					int airportCount				The number of airports in the network.
+* Return Values:	1 if the network was benchmarked, 0 if there wasn't enough memory, or it is
+*					too big for the transfer pattern engine.
+*/
+static int benchmarkNetwork(const ProgramOptions* options, int airportCount)
+{
+	GeneratorSettings settings = options->generator;
+	const Timetable* network = flightTimetable();
+	QueryScratch scratch = { 0 };
+
+	double* querySeconds = NULL;
+	int queryCount = options->benchmarkQueries;
+	unsigned int state = settings.seed * 2654435761u + 12345u;
+
+	double setupSeconds = 0.0;
+	double totalSeconds = 0.0;
+
+	settings.airportCount = airportCount;
+	setupSeconds = wallClockSeconds();
+
+	// The engine's own tables are part of setting up a new network.
+	if (generateTimetable(&settings) < 0)
+	{
+		fprintf(stderr, "Not enough memory for a network of %d airports.\n", airportCount);
+		return 0;
+	}
+
+	if (((options->engine == kConnectionScanEngine) && (buildConnections() == 0))
+		|| ((options->engine == kAStarEngine) && (buildLandmarks(options->landmarkCount) == 0))
+		|| ((options->engine == kTransferEngine)
+		&& (buildTransferPatterns(options->transferHubCount, options->threadCount) == 0)))
+	{
+		fprintf(stderr, "Not enough memory for a network of %d airports.\n", airportCount);
+		return 0;
+	}
+
+	setupSeconds = wallClockSeconds() - setupSeconds;
+
+	// Start each size with an empty cache, so sizes can be compared.
+	freeArrivalCache();
+	if ((options->cacheSize > 0)
+		&& (initArrivalCache(options->cacheSize, options->liveUpdates) == 0))
+	{
+		fprintf(stderr, "Not enough memory to cache %d searches.\n", options->cacheSize);
+		return 0;
+	}
+
+	querySeconds = (double*)malloc((queryCount + 1) * sizeof(double));
+
+	if ((querySeconds == NULL) || (initQueryScratch(&scratch) == 0))
+	{
+		fprintf(stderr, "Not enough memory for a network of %d airports.\n", airportCount);
+		free(querySeconds);
+		return 0;
+	}
+
+	resetSearchCounters();
+
+	// <Query loop>
+	for (int i = 0; i < queryCount; i++)
+	{
+		int originCity = 1 + randomQueryValue(&state, network->airportCount);
+		int destinationCity = 1 + randomQueryValue(&state, network->airportCount - 1);
+		int startTime = randomQueryValue(&state, kMinutesPerDay);
+		double startSeconds = 0.0;
+
+		// Any airport but the origin.
+		if (destinationCity >= originCity)
+		{
+			destinationCity++;
+		}
+
+		startSeconds = wallClockSeconds();
+
+		clearQueryResults(&scratch);
+		findEarliestArrivals(options, &scratch, startTime, originCity, destinationCity,
+			scratch.earliestArrivals);
+		createFastestFlightplan(originCity, destinationCity, scratch.earliestArrivals,
+			scratch.flightPlan);
+
+		querySeconds[i] = wallClockSeconds() - startSeconds;
+		totalSeconds += querySeconds[i];
+	}
+
+	qsort(querySeconds, queryCount, sizeof(double), compareSeconds);
+
+	{
+		static const char* engineNames[] = { "dijkstra", "csa", "raptor", "astar", "transfer" };
+		double p50 = (queryCount > 0) ? querySeconds[(queryCount - 1) / 2] * 1e6 : 0.0;
+		double p99 = (queryCount > 0) ? querySeconds[(queryCount - 1) * 99 / 100] * 1e6 : 0.0;
+		double queriesPerSecond = (totalSeconds > 0.0) ? queryCount / totalSeconds : 0.0;
+
+		if (options->outputFormat == kTSVOutput)
+		{
+			printf("%s\t%d\t%d\t%d\t%d\t%u\t%.6f\t%d\t%.2f\t%.2f\t%.1f\t%ld\n",
+				engineNames[options->engine], network->airportCount, settings.hubCount,
+				network->legCount, network->flightCount, settings.seed, setupSeconds,
+				queryCount, p50, p99, queriesPerSecond, peakMemoryKB());
+		}
+		else
+		{
+			printf("{\"engine\":\"%s\",\"airports\":%d,\"hubs\":%d,\"legs\":%d,\"flights\":%d,"
+				"\"seed\":%u,\"setupSeconds\":%.6f,\"queries\":%d,\"p50Microseconds\":%.2f,"
+				"\"p99Microseconds\":%.2f,\"queriesPerSecond\":%.1f,\"peakRssKB\":%ld}\n",
+				engineNames[options->engine], network->airportCount, settings.hubCount,
+				network->legCount, network->flightCount, settings.seed, setupSeconds,
+				queryCount, p50, p99, queriesPerSecond, peakMemoryKB());
+		}
+		fflush(stdout);
+	}
+
+	// Counting slows the queries down, so compare counted runs only with each other.
+	if (options->searchCounters == kTotalCounters)
+	{
+		SearchCounters sizeCounters = currentSearchCounters();
+
+		printSearchCounters(&sizeCounters);
+	}
+
+	freeQueryScratch(&scratch);
+	free(querySeconds);
+
+	return 1;
+}
+
+
+
+/*
+* Function:			randomQueryValue()
+* Description:		Picks a random number for a benchmark query, from 0 up to (but not
+*					including) limit, with a linear congruential generator.
+* Parameters:		unsigned int* state		The generator's state. Updated.
+*					int limit				One more than the largest number wanted.
+* Return Values:	The random number.
+*/
+static int randomQueryValue(unsigned int* state, int limit)
+{
+	*state = *state * 1103515245u + 12345u;
+
+	// The low bits of a linear congruential generator repeat quickly, so use the high ones.
+	return (int)((*state >> 8) % (unsigned int)limit);
+}
+
+
+
+/*
+* Function:			peakMemoryKB()
+* Description:		Finds the most memory the process has had in use at once (its peak resident
+*					set size, or peak working set on Windows).
+* Return Values:	The peak, in kilobytes, or 0 if it can't be found.
+*/
+static long peakMemoryKB(void)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == 0)
+	{
+		return 0;
+	}
+
+	return (long)(counters.PeakWorkingSetSize / 1024);
+#else
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+
+	// Linux gives kilobytes; macOS gives bytes.
+#ifdef __APPLE__
+	return (long)(usage.ru_maxrss / 1024);
+#else
+	return (long)usage.ru_maxrss;
+#endif
+#endif
+}
+
+
+
+/*
+* Function:			compareSeconds()
+* Description:		qsort() comparison that orders query times from fastest to slowest.
+* Parameters:		const void* first		The first time, as a double.
+*					const void* second		The second time, as a double.
+* Return Values:	Negative, 0 or positive as first sorts before, with or after second.
+*/
+static int compareSeconds(const void* first, const void* second)
+{
+	double firstSeconds = *(const double*)first;
+	double secondSeconds = *(const double*)second;
+
+	return (firstSeconds > secondSeconds) - (firstSeconds < secondSeconds);
+}
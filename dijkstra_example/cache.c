@@ -0,0 +1,686 @@
+/*
+* Filename:				cache.c
+* Description:			The arrival cache for the Amazing Race flight planner. A search from an
+*						origin at a start time finds the earliest flight into every airport, but a
+*						query only reads the chain back from one destination. The cache keeps the
+*						whole earliestArrivals[] tree for the most recently used (origin, start time)
+*						pairs, so asking again, or asking for another destination from the same
+*						place and time, is just a walk of the cached tree.
+*
+*						The cache holds a fixed number of trees, all allocated up front. When it is
+*						full, the least recently used tree makes room for the new one. It is shared
+*						between batch worker threads, behind one lock.
+*						When a flight is delayed or cancelled, each cached tree is repaired in
+*						place (see updates.c), rather than thrown away.
+*
+*						Each tree also lists the airports reached from each airport, so storing,
+*						copying out and repairing a tree only go through the airports it reaches.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+// Where each cached tree is filed: by its key in a hash chain, and by its last use in a list.
+typedef struct
+{
+	int originAirport;			// The tree's origin, or 0 if this slot is unused.
+	int startTime;				// The tree's start time, in minutes since local midnight.
+	int hashNext;				// The next slot in the same hash chain, or -1.
+	int newer;					// The slot used next most recently, or -1 for the newest.
+	int older;					// The slot used next least recently, or -1 for the oldest.
+} CachedTree;
+
+/* The cache itself. Slot i's tree is cacheTrees[i * (airportCount + 1)] onward, and so are
+its lists of the airports reached from each airport, and, for live updates, its ground times
+(see ArrivalTree). A key's hash chain starts at cacheBuckets[hash & bucketMask]. Empty until
+initArrivalCache() is called. */
+static CachedTree* cacheSlots = NULL;
+static const Flight** cacheTrees = NULL;
+static int* cacheFirstChildren = NULL;
+static int* cacheNextSiblings = NULL;
+static int* cachePreviousSiblings = NULL;
+static int* cacheGroundTimes = NULL;
+static int* cacheBuckets = NULL;
+static int bucketMask = 0;
+static int cacheCapacity = 0;
+static int slotsUsed = 0;
+static int newestSlot = -1;
+static int oldestSlot = -1;
+static int treeSize = 0;
+
+static ArrivalCacheCounts cacheCounts = { 0 };
+static WorkerLock cacheLock;
+
+
+
+static int findCachedTree(int originAirport, int startTime);
+static unsigned int hashCacheKey(int originAirport, int startTime);
+static void unlinkCachedTree(int slot);
+static void linkNewestTree(int slot);
+static ArrivalTree slotTree(int slot);
+static void emptyCachedTree(int slot);
+static void timeCachedTree(int slot);
+
+
+
+/*
+* Function:			initArrivalCache()
+* Description:		Allocates room to cache a number of trees for the loaded timetable.
+* Parameters:		int capacity		The most trees to keep.
+*					int isRepairable	1 to keep what repairCachedArrivals() needs as well.
+* Return Values:	1 if the cache was allocated, 0 if there wasn't enough memory.
+*/
+int initArrivalCache(int capacity, int isRepairable)
+{
+	size_t entryCount = 0;
+	int bucketCount = 1;
+
+	treeSize = flightTimetable()->airportCount + 1;
+	entryCount = (size_t)capacity * treeSize;
+
+	// Keep the hash chains short by having at least twice as many buckets as trees.
+	while (bucketCount < 2 * capacity)
+	{
+		bucketCount *= 2;
+	}
+
+	cacheSlots = (CachedTree*)malloc(capacity * sizeof(CachedTree));
+	// Empty trees, so a tree is stored by setting only the airports it reaches.
+	cacheTrees = (const Flight**)calloc(entryCount, sizeof(const Flight*));
+	cacheFirstChildren = (int*)calloc(entryCount, sizeof(int));
+	cacheNextSiblings = (int*)calloc(entryCount, sizeof(int));
+	cacheBuckets = (int*)malloc(bucketCount * sizeof(int));
+
+	if (isRepairable == 1)
+	{
+		cachePreviousSiblings = (int*)calloc(entryCount, sizeof(int));
+		cacheGroundTimes = (int*)malloc(entryCount * sizeof(int));
+	}
+
+	if ((cacheSlots == NULL) || (cacheTrees == NULL) || (cacheFirstChildren == NULL)
+		|| (cacheNextSiblings == NULL) || (cacheBuckets == NULL) || ((isRepairable == 1)
+		&& ((cachePreviousSiblings == NULL) || (cacheGroundTimes == NULL))))
+	{
+		free(cacheSlots);
+		free((void*)cacheTrees);
+		free(cacheFirstChildren);
+		free(cacheNextSiblings);
+		free(cachePreviousSiblings);
+		free(cacheGroundTimes);
+		free(cacheBuckets);
+		cacheSlots = NULL;
+		cacheTrees = NULL;
+		cacheFirstChildren = NULL;
+		cacheNextSiblings = NULL;
+		cachePreviousSiblings = NULL;
+		cacheGroundTimes = NULL;
+		cacheBuckets = NULL;
+		return 0;
+	}
+
+	if (isRepairable == 1)
+	{
+		for (size_t i = 0; i < entryCount; i++)
+		{
+			cacheGroundTimes[i] = INT_MAX;
+		}
+	}
+
+	for (int i = 0; i < bucketCount; i++)
+	{
+		cacheBuckets[i] = -1;
+	}
+
+	bucketMask = bucketCount - 1;
+	cacheCapacity = capacity;
+	slotsUsed = 0;
+	newestSlot = -1;
+	oldestSlot = -1;
+
+	initWorkerLock(&cacheLock);
+
+	return 1;
+}
+
+
+
+/*
+* Function:			freeArrivalCache()
+* Description:		Releases the cache, if there is one.
+*/
+void freeArrivalCache(void)
+{
+	if (cacheSlots == NULL)
+	{
+		return;
+	}
+
+	free(cacheSlots);
+	free((void*)cacheTrees);
+	free(cacheFirstChildren);
+	free(cacheNextSiblings);
+	free(cachePreviousSiblings);
+	free(cacheGroundTimes);
+	free(cacheBuckets);
+	freeWorkerLock(&cacheLock);
+
+	cacheSlots = NULL;
+	cacheTrees = NULL;
+	cacheFirstChildren = NULL;
+	cacheNextSiblings = NULL;
+	cachePreviousSiblings = NULL;
+	cacheGroundTimes = NULL;
+	cacheBuckets = NULL;
+	cacheCapacity = 0;
+}
+
+
+
+/*
+* Function:			findCachedArrivals()
+* Description:		Copies the cached tree for an origin and start time into earliestArrivals[],
+*					if there is one, and marks it as the most recently used. Into a freshly
+*					cleared earliestArrivals, only the airports the tree reaches are copied, and
+*					listed for clearQueryResults().
+* Parameters:		QueryScratch* scratch		The scratch the query is using.
+*					int startTimeInMinutes		The start time, in the origin's local timezone.
+*					int originAirport			The origin.
+*					Flight earliestArrivals[]	Where to copy the tree.
+* Return Values:	1 if the tree was cached, 0 if it wasn't.
+*/
+int findCachedArrivals(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	const Flight* earliestArrivals[])
+{
+	int slot = 0;
+	ArrivalTree tree = { 0 };
+
+	lockWorkers(&cacheLock);
+
+	slot = findCachedTree(originAirport, startTimeInMinutes);
+
+	if (slot < 0)
+	{
+		cacheCounts.misses++;
+		unlockWorkers(&cacheLock);
+		return 0;
+	}
+
+	cacheCounts.hits++;
+
+	unlinkCachedTree(slot);
+	linkNewestTree(slot);
+
+	tree = slotTree(slot);
+
+	if (beginReachedList(scratch, earliestArrivals) == 1)
+	{
+		int reachedCount = 0;
+
+		for (int airport = nextTreeAirport(&tree, originAirport, originAirport); airport != 0;
+			airport = nextTreeAirport(&tree, airport, originAirport))
+		{
+			earliestArrivals[airport] = tree.arrivals[airport];
+			scratch->reachedAirports[reachedCount] = airport;
+			reachedCount++;
+		}
+		scratch->reachedCount = reachedCount;
+	}
+	else
+	{
+		memcpy((void*)earliestArrivals, (const void*)tree.arrivals,
+			treeSize * sizeof(const Flight*));
+	}
+
+	unlockWorkers(&cacheLock);
+
+	return 1;
+}
+
+
+
+/*
+* Function:			cacheArrivals()
+* Description:		Keeps a copy of a search's tree, making room by dropping the least recently
+*					used tree if the cache is full. When the search listed the airports it
+*					reached, only those are copied.
+* Parameters:		const QueryScratch* scratch		The scratch earliestArrivals[] belongs to, if any.
+*					int startTimeInMinutes			The start time, in the origin's local timezone.
+*					int originAirport				The origin.
+*					Flight earliestArrivals[]		The tree the search found.
+*/
+void cacheArrivals(const QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	const Flight* earliestArrivals[])
+{
+	int slot = 0;
+	ArrivalTree tree = { 0 };
+	unsigned int bucket = hashCacheKey(originAirport, startTimeInMinutes) & bucketMask;
+
+	lockWorkers(&cacheLock);
+
+	// Another thread may have searched for the same tree at the same time, and cached it first.
+	if (findCachedTree(originAirport, startTimeInMinutes) >= 0)
+	{
+		unlockWorkers(&cacheLock);
+		return;
+	}
+
+	// Use a fresh slot while there are any, then the least recently used one.
+	if (slotsUsed < cacheCapacity)
+	{
+		slot = slotsUsed;
+		slotsUsed++;
+	}
+	else
+	{
+		unsigned int oldBucket = 0;
+		int* link = NULL;
+
+		slot = oldestSlot;
+		unlinkCachedTree(slot);
+
+		// Take the old tree out of its hash chain.
+		oldBucket = hashCacheKey(cacheSlots[slot].originAirport, cacheSlots[slot].startTime)
+			& bucketMask;
+		link = &cacheBuckets[oldBucket];
+
+		while (*link != slot)
+		{
+			link = &cacheSlots[*link].hashNext;
+		}
+		*link = cacheSlots[slot].hashNext;
+
+		emptyCachedTree(slot);
+		cacheCounts.evictions++;
+	}
+
+	cacheSlots[slot].originAirport = originAirport;
+	cacheSlots[slot].startTime = startTimeInMinutes;
+	cacheSlots[slot].hashNext = cacheBuckets[bucket];
+	cacheBuckets[bucket] = slot;
+	linkNewestTree(slot);
+
+	tree = slotTree(slot);
+
+	// The slot is empty, so only the airports reached need setting.
+	if ((earliestArrivals == scratch->earliestArrivals) && (scratch->reachedCount >= 0))
+	{
+		for (int i = 0; i < scratch->reachedCount; i++)
+		{
+			setTreeArrival(&tree, scratch->reachedAirports[i],
+				earliestArrivals[scratch->reachedAirports[i]]);
+		}
+	}
+	else
+	{
+		for (int airport = 1; airport < treeSize; airport++)
+		{
+			if (earliestArrivals[airport] != NULL)
+			{
+				setTreeArrival(&tree, airport, earliestArrivals[airport]);
+			}
+		}
+	}
+
+	if (cacheGroundTimes != NULL)
+	{
+		timeCachedTree(slot);
+	}
+
+	unlockWorkers(&cacheLock);
+}
+
+
+
+/*
+* Function:			arrivalCacheCounts()
+* Description:		Gives the number of hits, misses and evictions since the cache was set up.
+* Return Values:	The counts.
+*/
+ArrivalCacheCounts arrivalCacheCounts(void)
+{
+	ArrivalCacheCounts counts = { 0 };
+
+	if (cacheSlots != NULL)
+	{
+		lockWorkers(&cacheLock);
+		counts = cacheCounts;
+		unlockWorkers(&cacheLock);
+	}
+
+	return counts;
+}
+
+
+
+/*
+* Function:			repairCachedArrivals()
+* Description:		Brings every cached tree up to date after a flight is delayed or cancelled
+*					(see repairArrivals()), instead of dropping them. Each tree the update
+*					can't affect takes constant time.
+* Parameters:		QueryScratch* scratch			Working memory for the repairs.
+*					const FlightUpdate* update		The change made to the timetable.
+* Return Values:	The number of trees that needed repairing.
+*/
+int repairCachedArrivals(QueryScratch* scratch, const FlightUpdate* update)
+{
+	int repairedTrees = 0;
+
+	if (cacheSlots == NULL)
+	{
+		return 0;
+	}
+
+	lockWorkers(&cacheLock);
+
+	for (int slot = 0; slot < slotsUsed; slot++)
+	{
+		ArrivalTree tree = slotTree(slot);
+
+		repairedTrees += repairArrivals(scratch, update, &tree);
+	}
+
+	unlockWorkers(&cacheLock);
+
+	return repairedTrees;
+}
+
+
+
+/*
+* Function:			findCachedTree()
+* Description:		Finds the slot holding the tree for an origin and start time. The cache lock
+*					must be held.
+* Parameters:		int originAirport		The origin.
+*					int startTime			The start time, in minutes since local midnight.
+* Return Values:	The slot, or -1 if the tree isn't cached.
+*/
+static int findCachedTree(int originAirport, int startTime)
+{
+	int slot = cacheBuckets[hashCacheKey(originAirport, startTime) & bucketMask];
+
+	while ((slot >= 0) && ((cacheSlots[slot].originAirport != originAirport)
+		|| (cacheSlots[slot].startTime != startTime)))
+	{
+		slot = cacheSlots[slot].hashNext;
+	}
+
+	return slot;
+}
+
+
+
+/*
+* Function:			hashCacheKey()
+* Description:		Mixes an origin and start time into a hash value.
+* Parameters:		int originAirport		The origin.
+*					int startTime			The start time, in minutes since local midnight.
+* Return Values:	The hash value.
+*/
+static unsigned int hashCacheKey(int originAirport, int startTime)
+{
+	unsigned int hash = (unsigned int)originAirport * kMinutesPerDay + (unsigned int)startTime;
+
+	// Spread nearby keys apart, so busy hubs at busy times don't share a few buckets.
+	hash ^= hash >> 16;
+	hash *= 0x45d9f3bu;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+
+
+/*
+* Function:			unlinkCachedTree()
+* Description:		Takes a slot out of the list ordered by last use. The cache lock must be held.
+* Parameters:		int slot		The slot to take out.
+*/
+static void unlinkCachedTree(int slot)
+{
+	if (cacheSlots[slot].newer >= 0)
+	{
+		cacheSlots[cacheSlots[slot].newer].older = cacheSlots[slot].older;
+	}
+	else
+	{
+		newestSlot = cacheSlots[slot].older;
+	}
+
+	if (cacheSlots[slot].older >= 0)
+	{
+		cacheSlots[cacheSlots[slot].older].newer = cacheSlots[slot].newer;
+	}
+	else
+	{
+		oldestSlot = cacheSlots[slot].newer;
+	}
+}
+
+
+
+/*
+* Function:			linkNewestTree()
+* Description:		Puts a slot at the most recently used end of the list. The cache lock must be
+*					held.
+* Parameters:		int slot		The slot to put there.
+*/
+static void linkNewestTree(int slot)
+{
+	cacheSlots[slot].newer = -1;
+	cacheSlots[slot].older = newestSlot;
+
+	if (newestSlot >= 0)
+	{
+		cacheSlots[newestSlot].newer = slot;
+	}
+	else
+	{
+		oldestSlot = slot;
+	}
+
+	newestSlot = slot;
+}
+
+
+
+/*
+* Function:			nextTreeAirport()
+* Description:		Steps through the airports below one airport of a tree, each airport before
+*					the ones reached from it.
+* Parameters:		const ArrivalTree* tree		The tree.
+*					int airport					The airport last visited, or subtreeRoot to start.
+*					int subtreeRoot				The airport whose subtree is being walked.
+* Return Values:	The next airport, or 0 once the subtree has been walked.
+*/
+int nextTreeAirport(const ArrivalTree* tree, int airport, int subtreeRoot)
+{
+	if (tree->firstChildren[airport] != 0)
+	{
+		return tree->firstChildren[airport];
+	}
+
+	// Back up until an airport on the way has a sibling still to visit.
+	while (airport != subtreeRoot)
+	{
+		if (tree->nextSiblings[airport] != 0)
+		{
+			return tree->nextSiblings[airport];
+		}
+
+		airport = tree->arrivals[airport]->originCity;
+	}
+
+	return 0;
+}
+
+
+
+/*
+* Function:			setTreeArrival()
+* Description:		Changes the flight a tree takes into an airport, moving the airport to the
+*					list of the airports reached from the flight's origin. Taking an airport out
+*					needs previousSiblings[].
+* Parameters:		ArrivalTree* tree			The tree.
+*					int airport					The airport.
+*					const Flight* flight		The flight into it, or NULL to take it out.
+*/
+void setTreeArrival(ArrivalTree* tree, int airport, const Flight* flight)
+{
+	int* firstChildren = tree->firstChildren;
+	int* nextSiblings = tree->nextSiblings;
+	int* previousSiblings = tree->previousSiblings;
+
+	if (tree->arrivals[airport] != NULL)
+	{
+		int parent = tree->arrivals[airport]->originCity;
+
+		if (previousSiblings[airport] != 0)
+		{
+			nextSiblings[previousSiblings[airport]] = nextSiblings[airport];
+		}
+		else
+		{
+			firstChildren[parent] = nextSiblings[airport];
+		}
+
+		if (nextSiblings[airport] != 0)
+		{
+			previousSiblings[nextSiblings[airport]] = previousSiblings[airport];
+		}
+
+		nextSiblings[airport] = 0;
+		previousSiblings[airport] = 0;
+	}
+
+	tree->arrivals[airport] = flight;
+
+	if (flight != NULL)
+	{
+		int parent = flight->originCity;
+
+		nextSiblings[airport] = firstChildren[parent];
+		if (previousSiblings != NULL)
+		{
+			if (firstChildren[parent] != 0)
+			{
+				previousSiblings[firstChildren[parent]] = airport;
+			}
+			previousSiblings[airport] = 0;
+		}
+		firstChildren[parent] = airport;
+	}
+}
+
+
+
+/*
+* Function:			slotTree()
+* Description:		Gives the tree held in a slot.
+* Parameters:		int slot		The slot.
+* Return Values:	The tree.
+*/
+static ArrivalTree slotTree(int slot)
+{
+	size_t first = (size_t)slot * treeSize;
+	ArrivalTree tree = { 0 };
+
+	tree.originAirport = cacheSlots[slot].originAirport;
+	tree.startTime = cacheSlots[slot].startTime;
+	tree.arrivals = &cacheTrees[first];
+	tree.firstChildren = &cacheFirstChildren[first];
+	tree.nextSiblings = &cacheNextSiblings[first];
+
+	if (cacheGroundTimes != NULL)
+	{
+		tree.groundTimes = &cacheGroundTimes[first];
+		tree.previousSiblings = &cachePreviousSiblings[first];
+	}
+
+	return tree;
+}
+
+
+
+/*
+* Function:			emptyCachedTree()
+* Description:		Clears a slot's tree, going through only the airports it reaches. Each
+*					airport is cleared after the ones reached from it, so the way back up is
+*					still there. The cache lock must be held.
+* Parameters:		int slot		The slot holding the tree.
+*/
+static void emptyCachedTree(int slot)
+{
+	ArrivalTree tree = slotTree(slot);
+	int originAirport = tree.originAirport;
+	int airport = originAirport;
+
+	// Start from the first airport with nothing reached from it.
+	while (tree.firstChildren[airport] != 0)
+	{
+		airport = tree.firstChildren[airport];
+	}
+
+	while (airport != originAirport)
+	{
+		int next = tree.nextSiblings[airport];
+
+		// Go on to the sibling's first leaf, or back up once the siblings are done.
+		if (next != 0)
+		{
+			while (tree.firstChildren[next] != 0)
+			{
+				next = tree.firstChildren[next];
+			}
+		}
+		else
+		{
+			next = tree.arrivals[airport]->originCity;
+		}
+
+		tree.arrivals[airport] = NULL;
+		tree.firstChildren[airport] = 0;
+		tree.nextSiblings[airport] = 0;
+		if (tree.groundTimes != NULL)
+		{
+			tree.groundTimes[airport] = INT_MAX;
+			tree.previousSiblings[airport] = 0;
+		}
+
+		airport = next;
+	}
+
+	tree.firstChildren[originAirport] = 0;
+	if (tree.groundTimes != NULL)
+	{
+		tree.groundTimes[originAirport] = INT_MAX;
+	}
+}
+
+
+
+/*
+* Function:			timeCachedTree()
+* Description:		Works out when a slot's tree reaches each airport, for repairs, by flying
+*					down the tree from the origin. The cache lock must be held.
+* Parameters:		int slot		The slot holding the tree.
+*/
+static void timeCachedTree(int slot)
+{
+	ArrivalTree tree = slotTree(slot);
+	int originAirport = tree.originAirport;
+
+	tree.groundTimes[originAirport] = tree.startTime - timezoneOffset(originAirport);
+
+	for (int airport = nextTreeAirport(&tree, originAirport, originAirport); airport != 0;
+		airport = nextTreeAirport(&tree, airport, originAirport))
+	{
+		const Flight* flight = tree.arrivals[airport];
+
+		tree.groundTimes[airport] = nextDepartureUTC(flight, tree.groundTimes[flight->originCity])
+			+ flight->flightDuration;
+	}
+}
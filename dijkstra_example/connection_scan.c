@@ -0,0 +1,244 @@
+/*
+* Filename:				connection_scan.c
+* Description:			The Connection Scan Algorithm (CSA) engine for the Amazing Race flight
+*						planner. Every flight in the timetable is flattened into one array of
+*						connections sorted by UTC departure time, and a query is answered by a
+*						single forward sweep over that array from the start time, keeping the
+*						earliest arrival at each airport. There is no heap and no per-airport
+*						bookkeeping beyond that, so the sweep reads memory strictly in order.
+*						It fills in the same earliestArrivals[] as mapEarliestArrivals(), so
+*						createFastestFlightplan() and printItinerary() work with either engine.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+/* Every flight in the loaded timetable as a connection, sorted by departure time in UTC.
+Built by buildConnections(); empty until then. */
+static Connection* connections = NULL;
+static int connectionCount = 0;
+
+
+
+static int compareConnections(const void* first, const void* second);
+
+
+
+/*
+* Function:			buildConnections()
+* Description:		Flattens the loaded timetable into the sorted connection array used by
+*					scanConnections(). Must be called again whenever the timetable changes.
+* Return Values:	1 if the array was built, 0 if there wasn't enough memory.
+*/
+int buildConnections(void)
+{
+	const Timetable* network = flightTimetable();
+	Connection* newConnections = (Connection*)malloc((network->flightCount + 1) * sizeof(Connection));
+
+	if (newConnections == NULL)
+	{
+		return 0;
+	}
+
+	for (int i = 0; i < network->flightCount; i++)
+	{
+		// The timetable already keeps each departure in UTC, within a single day.
+		newConnections[i].departureTime = network->departureMinutes[i];
+		newConnections[i].arrivalTime = network->arrivalMinutes[i];
+		newConnections[i].originCity = network->departures[i].originCity;
+		newConnections[i].destinationCity = network->departures[i].destinationCity;
+		newConnections[i].flight = i;
+	}
+
+	qsort(newConnections, network->flightCount, sizeof(Connection), compareConnections);
+
+	free(connections);
+	connections = newConnections;
+	connectionCount = network->flightCount;
+
+	return 1;
+}
+
+
+
+/*
+* Function:			freeConnections()
+* Description:		Releases the connection array.
+*/
+void freeConnections(void)
+{
+	free(connections);
+	connections = NULL;
+	connectionCount = 0;
+}
+
+
+
+/*
+* Function:			scanConnections()
+* Description:		Maps out the earliest possible arrival time at each airport from your original
+*					airport, at the current time, and returns a list of the flights needed to get
+*					to each one, by sweeping the connection array in departure order.
+*					Since the timetable repeats every day, the sweep wraps around to the start of
+*					the array for each new day. It stops once it has gone a full day past the
+*					latest arrival found so far: any flight after that has a copy one day
+*					earlier that could have been caught instead.
+* Parameters:		QueryScratch* scratch		Working memory for the search.
+*					int startTimeInMinutes		The user's starting time, in the local timezone.
+*					int originAirport			The user's starting airport.
+*					Flight earliestArrivals[]	An array to pass a list of flights to, representing
+*												the earliest flights available to each destination.
+*/
+void scanConnections(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	const Flight* earliestArrivals[])
+{
+	const Timetable* network = flightTimetable();
+
+	/* The earliest time each airport can be reached, in minutes since midnight UTC of the
+	first day. INT_MAX for airports that haven't been reached: the sweep puts back just the
+	airports it reached when it's done, listed in sweptAirports, so no search has to clear
+	every airport. */
+	int* earliestGroundTime = scratch->scanGroundTimes;
+	int* sweptAirports = scratch->markedAirports;
+	int sweptCount = 0;
+	int listReached = 0;
+
+	int startTimeUTC = startTimeInMinutes - timezoneOffset(originAirport);
+
+	// The latest time any airport has been reached so far. The sweep ends a day after this.
+	int latestGroundTime = startTimeUTC;
+
+	// The day being swept, and the connection the sweep starts from on that day.
+	int day = 0;
+	int first = 0;
+
+	if (connectionCount == 0)
+	{
+		return;
+	}
+
+	listReached = beginReachedList(scratch, earliestArrivals);
+
+	earliestGroundTime[originAirport] = startTimeUTC;
+	sweptAirports[sweptCount] = originAirport;
+	sweptCount++;
+
+	// Find the day of the start time (rounded down), and the first connection after it.
+	day = startTimeUTC / kMinutesPerDay;
+	if ((startTimeUTC % kMinutesPerDay) < 0)
+	{
+		day--;
+	}
+
+	{
+		int low = 0;
+		int high = connectionCount;
+		int timeOfDay = startTimeUTC - day * kMinutesPerDay;
+
+		while (low < high)
+		{
+			int middle = low + (high - low) / 2;
+
+			if (connections[middle].departureTime <= timeOfDay)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+
+		first = low;
+	}
+
+	// <Connection sweep>
+	// Sweep one day of connections at a time until nothing more can be improved.
+	while (day * kMinutesPerDay <= latestGroundTime + kMinutesPerDay)
+	{
+		int dayStart = day * kMinutesPerDay;
+
+		for (int i = first; i < connectionCount; i++)
+		{
+			const Connection* connection = &connections[i];
+			int departureTime = dayStart + connection->departureTime;
+			int arrivalTime = dayStart + connection->arrivalTime;
+			int arrivalAirport = connection->destinationCity;
+
+			if (departureTime > latestGroundTime + kMinutesPerDay)
+			{
+				break;
+			}
+
+			/* If the flyer is on the ground at the origin before the flight leaves, and the
+			flight lands before anything else gets to the destination, take it. Flights
+			back to the original airport are never useful. */
+			if ((earliestGroundTime[connection->originCity] < departureTime)
+				&& (arrivalTime < earliestGroundTime[arrivalAirport])
+				&& (arrivalAirport != originAirport))
+			{
+				// The first time the sweep reaches the airport, list it.
+				if (earliestGroundTime[arrivalAirport] == INT_MAX)
+				{
+					sweptAirports[sweptCount] = arrivalAirport;
+					sweptCount++;
+
+					if (listReached == 1)
+					{
+						scratch->reachedAirports[scratch->reachedCount] = arrivalAirport;
+						scratch->reachedCount++;
+					}
+				}
+
+				earliestGroundTime[arrivalAirport] = arrivalTime;
+				earliestArrivals[arrivalAirport] = &network->departures[connection->flight];
+
+				if (arrivalTime > latestGroundTime)
+				{
+					latestGroundTime = arrivalTime;
+				}
+			}
+		}
+
+		// On to the next day, from its first connection.
+		day++;
+		first = 0;
+	} // End of connection sweep.
+
+	for (int i = 0; i < sweptCount; i++)
+	{
+		earliestGroundTime[sweptAirports[i]] = INT_MAX;
+	}
+}
+
+
+
+/*
+* Function:			compareConnections()
+* Description:		qsort() comparison that orders connections by departure time, then by
+*					arrival time.
+* Parameters:		const void* first		The first Connection.
+*					const void* second		The second Connection.
+* Return Values:	Negative, 0 or positive as first sorts before, with or after second.
+*/
+static int compareConnections(const void* first, const void* second)
+{
+	const Connection* firstConnection = (const Connection*)first;
+	const Connection* secondConnection = (const Connection*)second;
+	int difference = firstConnection->departureTime - secondConnection->departureTime;
+
+	if (difference == 0)
+	{
+		difference = firstConnection->arrivalTime - secondConnection->arrivalTime;
+	}
+	if (difference == 0)
+	{
+		difference = firstConnection->flight - secondConnection->flight;
+	}
+
+	return difference;
+}
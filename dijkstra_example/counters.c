@@ -0,0 +1,104 @@
+/*
+* Filename:				counters.c
+* Description:			Search counters for the Amazing Race flight planner: how many airports the
+*						Dijkstra search settled, legs it checked, departure times it compared
+*						and so on, for finding out where a slow query spends its time.
+*
+*						The counting itself is done by the countSearch() macro in the search
+*						functions. It only counts in a build with SEARCH_COUNTERS defined; in any
+*						other build it compiles to nothing, so the searches are exactly as fast as
+*						they were, and every count here reads 0.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+#ifdef SEARCH_COUNTERS
+// This thread's counts since it last called resetSearchCounters().
+kThreadLocal SearchCounters threadSearchCounters = { 0 };
+#endif
+
+
+
+/*
+* Function:			resetSearchCounters()
+* Description:		Sets this thread's search counters back to 0, before a query is counted.
+*/
+void resetSearchCounters(void)
+{
+#ifdef SEARCH_COUNTERS
+	memset(&threadSearchCounters, 0, sizeof(SearchCounters));
+#endif
+}
+
+
+
+/*
+* Function:			currentSearchCounters()
+* Description:		Gives this thread's search counts since resetSearchCounters() was last called.
+* Return Values:	The counts, or all 0 in a build without SEARCH_COUNTERS.
+*/
+SearchCounters currentSearchCounters(void)
+{
+	SearchCounters counters = { 0 };
+
+#ifdef SEARCH_COUNTERS
+	counters = threadSearchCounters;
+#endif
+
+	return counters;
+}
+
+
+
+/*
+* Function:			addSearchCounters()
+* Description:		Adds one set of search counts to a running total.
+* Parameters:		SearchCounters* total				The total. Updated.
+*					const SearchCounters* counters		The counts to add to it.
+*/
+void addSearchCounters(SearchCounters* total, const SearchCounters* counters)
+{
+	total->airportsSettled += counters->airportsSettled;
+	total->legsRelaxed += counters->legsRelaxed;
+	total->soonestArrivalCalls += counters->soonestArrivalCalls;
+	total->flightsScanned += counters->flightsScanned;
+	total->dayWraps += counters->dayWraps;
+	total->improvements += counters->improvements;
+	total->planFlights += counters->planFlights;
+}
+
+
+
+/*
+* Function:			writeSearchCounters()
+* Description:		Writes a set of search counts as a JSON object, or as TSV columns. Each TSV
+*					column starts with a tab, so they can follow the other columns of a row; the
+*					header for them is kSearchCounterColumns.
+* Parameters:		OutputBuffer* output				Where to write.
+*					int format							kJSONOutput or kTSVOutput.
+*					const SearchCounters* counters		The counts to write.
+*/
+void writeSearchCounters(OutputBuffer* output, int format, const SearchCounters* counters)
+{
+	if (format == kJSONOutput)
+	{
+		appendOutput(output, "{\"airportsSettled\":%lld,\"legsRelaxed\":%lld,"
+			"\"soonestArrivalCalls\":%lld,\"flightsScanned\":%lld,\"dayWraps\":%lld,"
+			"\"improvements\":%lld,\"planFlights\":%lld}",
+			counters->airportsSettled, counters->legsRelaxed, counters->soonestArrivalCalls,
+			counters->flightsScanned, counters->dayWraps, counters->improvements,
+			counters->planFlights);
+	}
+	else
+	{
+		appendOutput(output, "\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld\t%lld",
+			counters->airportsSettled, counters->legsRelaxed, counters->soonestArrivalCalls,
+			counters->flightsScanned, counters->dayWraps, counters->improvements,
+			counters->planFlights);
+	}
+}
@@ -9,10 +9,20 @@
 *						the user, providing them with the total time taken to get to their destination,
 *						and the flights they will be taking, with times printed in the time zone
 *						for each location.
+*						The airports and flights are read from a timetable file when the program
+*						starts: the file named on the command line, or timetable.csv by default.
+*						Run with --help for the command line options.
 */
 
 #include "dijkstra_example.h"
 
+#include <time.h>
+
+// Vector comparisons for firstFlightAfter(), on processors and builds that have them.
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
 
 #pragma warning(disable: 4996)
 
@@ -20,7 +30,7 @@
 
 
 
-int main(void)
+int main(int argc, char* argv[])
 {
 	// Input variables. -1 is the failure/incorrect input state for each.
 	int originCity = -1;
@@ -29,10 +39,170 @@ int main(void)
 
 	int exitProgram = 0;
 
-	// Flight arrays
-	const Flight* earliestArrivals[kCityIndex] = { 0 };
-	const Flight* flightPlan[kCityIndex] = { 0 };
-	
+	ProgramOptions options = { 0 };
+	int lastCity = 0;
+
+	char originPrompt[kTimetableLineMax] = "";
+	char destinationPrompt[kTimetableLineMax] = "";
+	const char* timePrompt
+		= "Please enter the current time in your city of origin, in 24-hour format.";
+
+	/* Working memory for the search, including the flight arrays. Sized once the timetable
+	is loaded, with one entry per cityID (index 0 blank). A flight plan can't have more
+	flights than there are airports, so flightPlan always ends in at least one NULL. */
+	QueryScratch scratch = { 0 };
+
+
+	if (parseArguments(argc, argv, &options) == 0)
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	// Benchmarks make up their own networks, so there's no timetable to load.
+	if (options.benchmarkSizes != NULL)
+	{
+		int benchmarkResult = runBenchmark(&options);
+
+		printCacheCounts(&options);
+		freeArrivalCache();
+		freeConnections();
+		freeLandmarks();
+		freeTransferPatterns();
+		freeArrivalIndex();
+		freeTimetable();
+
+		return benchmarkResult;
+	}
+
+	if (loadTimetable(options.timetableFile, options.travelDate) < 0)
+	{
+		return 1;
+	}
+
+	if (buildAirportLabels() == 0)
+	{
+		fprintf(stderr, "Not enough memory for the airports' names.\n");
+		return 1;
+	}
+
+	/* The connection list, transfer patterns, profiles, arrival index and live updates all
+	take every flight to run every day. */
+	if ((flightTimetable()->serviceDayCount > 0)
+		&& ((options.engine == kConnectionScanEngine) || (options.engine == kTransferEngine)
+		|| (options.profileQueries == 1) || (options.precompute == 1) || (options.arriveBy == 1)
+		|| (options.liveUpdates == 1)))
+	{
+		fprintf(stderr, "%s has a calendar, so it can't be used with --engine csa or transfer, "
+			"--profile, --precompute, --arrive-by or --updates.\n", options.timetableFile);
+		return 1;
+	}
+
+	if ((options.engine == kConnectionScanEngine) && (buildConnections() == 0))
+	{
+		fprintf(stderr, "Not enough memory for the connection scan engine.\n");
+		return 1;
+	}
+
+	if ((options.engine == kAStarEngine) && (buildLandmarks(options.landmarkCount) == 0))
+	{
+		fprintf(stderr, "Not enough memory for the A* engine's landmarks.\n");
+		return 1;
+	}
+
+	if ((options.engine == kTransferEngine)
+		&& (buildTransferPatterns(options.transferHubCount, options.threadCount) == 0))
+	{
+		fprintf(stderr, "Not enough memory for the transfer pattern engine.\n");
+		return 1;
+	}
+
+	if ((options.arriveBy == 1) && (buildArrivalIndex() == 0))
+	{
+		fprintf(stderr, "Not enough memory for arrive-by searches.\n");
+		return 1;
+	}
+
+	if ((options.precompute == 1) && (profileTableFits() == 0))
+	{
+		fprintf(stderr, "%s has %d airports, too many to precompute every pair's profile; "
+			"leave out --precompute.\n", options.timetableFile, flightTimetable()->airportCount);
+		return 1;
+	}
+
+	if ((options.precompute == 1) && (buildProfileTable(options.threadCount) == 0))
+	{
+		fprintf(stderr, "Not enough memory to precompute every airport's profile.\n");
+		return 1;
+	}
+
+	if ((options.cacheSize > 0)
+		&& (initArrivalCache(options.cacheSize, options.liveUpdates) == 0))
+	{
+		fprintf(stderr, "Not enough memory to cache %d searches.\n", options.cacheSize);
+		return 1;
+	}
+
+	if ((options.liveUpdates == 1) && (initFlightUpdates() == 0))
+	{
+		fprintf(stderr, "Not enough memory for live updates.\n");
+		return 1;
+	}
+
+	// In batch mode, answer the queries from the batch file and skip the menu entirely.
+	if (options.batchFile != NULL)
+	{
+		int batchResult = runBatch(&options);
+
+		printCacheCounts(&options);
+		freeArrivalCache();
+		freeFlightUpdates();
+		freeProfileTable();
+		freeConnections();
+		freeLandmarks();
+		freeTransferPatterns();
+		freeArrivalIndex();
+		freeAirportLabels();
+		freeTimetable();
+
+		return batchResult;
+	}
+
+	// In server mode, answer queries from the socket until stopped.
+	if (options.serverSocket != NULL)
+	{
+		int serverResult = runServer(&options);
+
+		printCacheCounts(&options);
+		freeArrivalCache();
+		freeFlightUpdates();
+		freeProfileTable();
+		freeConnections();
+		freeLandmarks();
+		freeTransferPatterns();
+		freeArrivalIndex();
+		freeAirportLabels();
+		freeTimetable();
+
+		return serverResult;
+	}
+
+	lastCity = flightTimetable()->airportCount;
+
+	if (initQueryScratch(&scratch) == 0)
+	{
+		fprintf(stderr, "Not enough memory for %d airports.\n", lastCity);
+		return 1;
+	}
+
+	sprintf(originPrompt, "Please enter the number for your city of origin (1-%d).", lastCity);
+	sprintf(destinationPrompt, "Please enter the number for your destination (1-%d).", lastCity);
+
+	if (options.arriveBy == 1)
+	{
+		timePrompt = "Please enter the time you need to arrive by, in your destination's local "
+			"time,\nin 24-hour format.";
+	}
 
 	// Application loop
 	do
@@ -42,18 +212,13 @@ int main(void)
 		destinationCity = -1;
 		startTime = -1;
 
-		for (int i = 0; i < kCityIndex; i++)
-		{
-			earliestArrivals[i] = 0;
-			flightPlan[i] = 0;
-		}
+		clearQueryResults(&scratch);
 
 		// Ask for the first city value until a valid city is chosen or they select 0.
 		do
 		{
 			displayCityList(0);
-			originCity = getMenuChoice(kExitMenu, kLastCity, 
-				"Please enter the number for your city of origin (1-7).",
+			originCity = getMenuChoice(kExitMenu, lastCity, originPrompt,
 				"That is not a valid city number.");
 
 			
@@ -78,8 +243,7 @@ int main(void)
 
 
 			displayCityList(originCity);
-			destinationCity = getMenuChoice(kExitMenu, kLastCity,
-				"Please enter the number for your destination (1-7).",
+			destinationCity = getMenuChoice(kExitMenu, lastCity, destinationPrompt,
 				"That is not a valid city number.");
 
 
@@ -108,7 +272,7 @@ int main(void)
 			}
 
 			// Otherwise, get the user's input for time.
-			startTime = getHHMMTime();
+			startTime = getHHMMTime(timePrompt);
 
 			// If the user has entered valid time, convert it to minutes.
 			if (startTime >= 0)
@@ -121,10 +285,66 @@ int main(void)
 		{
 			printf("\n\n");
 
-			// Calculate and print flight plan.
-			mapEarliestArrivals(startTime, originCity, earliestArrivals);
-			createFastestFlightplan(originCity, destinationCity, earliestArrivals, flightPlan);
-			printItinerary(originCity, destinationCity, startTime, flightPlan);
+			resetSearchCounters();
+
+			// Calculate and print every way to leave over the next day, or just the one plan.
+			if (options.profileQueries == 1)
+			{
+				if (profileEarliestArrivals(&scratch, startTime, originCity) == 1)
+				{
+					printProfile(originCity, destinationCity, startTime, &scratch);
+				}
+			}
+			else if (options.pareto == 1)
+			{
+				paretoEarliestArrivals(&scratch, startTime, originCity, destinationCity,
+					options.maxLegs);
+				printParetoOptions(originCity, destinationCity, startTime, &scratch);
+			}
+			else if (options.arriveBy == 1)
+			{
+				// The time entered is the deadline, so find the latest start that makes it.
+				int latestStart = 0;
+
+				printf("Arriving in ");
+				printAirportName(destinationCity);
+				printf(" by ");
+				printClockTime(startTime, destinationCity);
+				printf(".\n\n");
+
+				if (findLatestStart(&scratch, startTime, originCity, destinationCity,
+					&latestStart) == 1)
+				{
+					printItinerary(originCity, destinationCity, latestStart, scratch.flightPlan);
+				}
+				else
+				{
+					printf("There are no flights that reach ");
+					printAirportName(destinationCity);
+					printf(" from ");
+					printAirportName(originCity);
+					printf(".\n");
+				}
+			}
+			else
+			{
+				findEarliestArrivals(&options, &scratch, startTime, originCity, destinationCity,
+					scratch.earliestArrivals);
+				createFastestFlightplan(originCity, destinationCity, scratch.earliestArrivals,
+					scratch.flightPlan);
+				printItinerary(originCity, destinationCity, startTime, scratch.flightPlan);
+			}
+
+			if (options.searchCounters != kNoCounters)
+			{
+				SearchCounters queryCounters = currentSearchCounters();
+
+				addSearchCounters(&scratch.searchTotals, &queryCounters);
+				if (options.searchCounters == kQueryCounters)
+				{
+					printSearchCounters(&queryCounters);
+				}
+			}
 
 			printf("\n");
 			waitForKey();
@@ -134,6 +354,23 @@ int main(void)
 		
 	} while (exitProgram != 1); // loop back to beginning, unless 0 was selected at some point.
 
+	if (options.searchCounters == kTotalCounters)
+	{
+		printSearchCounters(&scratch.searchTotals);
+	}
+
+	freeQueryScratch(&scratch);
+	printCacheCounts(&options);
+	freeArrivalCache();
+	freeFlightUpdates();
+	freeProfileTable();
+	freeConnections();
+	freeLandmarks();
+	freeTransferPatterns();
+	freeArrivalIndex();
+	freeAirportLabels();
+	freeTimetable();
+
 	return 0;
 }
 
@@ -183,27 +420,18 @@ int timeAsHHMM(int timeInMinutes)
 /*
 * Function:			timezoneOffset()
 * Description:		Takes a city ID and returns the difference between that city's
-*					timezone and UTC.
+*					timezone and UTC on the travel date.
 * Parameters:		int cityID		The number identifier of the city.
-* Return Values:	The time offset from UTC.
-*					(For this program, always a negative number)
+* Return Values:	The time offset from UTC, in minutes. 0 for an invalid cityID.
 */
 int timezoneOffset(int cityID)
 {
+	const Timetable* network = flightTimetable();
 	int offset = 0;
 
-
-	if ((cityID == kAustinID) || (cityID == kChicagoID))
+	if (checkRange(cityID, 1, network->airportCount))
 	{
-		offset = kCSToffset;
-	}
-	else if ((cityID == kDenverID) || (cityID == kSantaFeID))
-	{
-		offset = kMSToffset;
-	}
-	else if ((cityID == kTorontoID) || (cityID == kAtlantaID) || (cityID == kBuffaloID))
-	{
-		offset = kESToffset;
+		offset = network->airports[cityID].timezoneOffset;
 	}
 
 	return offset;
@@ -212,67 +440,118 @@ int timezoneOffset(int cityID)
 
 
 /*
-* Function:			timezoneDifference()
-* Description:		Takes two cities and returns the difference in their timezones.
-* Parameters:		int originCity		The number identifier of the origin city.
-*					int destinationCity	The number identifier of the destination city.
-* Return Values:	The difference, in hours, between timezones.
-*					Positive X means the destination is X hours behind.
-*					Negative X means the destination is X hours ahead.
+* Function:			timezoneOffsetAt()
+* Description:		Takes a city ID and a time, and returns the difference between that city's
+*					timezone and UTC at that time. It is the same as timezoneOffset() unless the
+*					timetable has a calendar, which can run past a change of clocks. A date's
+*					clocks are as departureShift() takes them: forward all day on the day they go
+*					forward, and back all day on the day they go back.
+* Parameters:		int cityID		The number identifier of the city.
+*					int timeUTC		The time, in minutes since midnight UTC of the first day.
+* Return Values:	The time offset from UTC, in minutes. 0 for an invalid cityID.
 */
-int timezoneDifference(int originCity, int destinationCity)
+int timezoneOffsetAt(int cityID, int timeUTC)
 {
-	int originOffset = timezoneOffset(originCity);
-	int destinationOffset = timezoneOffset(destinationCity);
+	const Timetable* network = flightTimetable();
+	const AirportInfo* airport = NULL;
+
+	if ((network->serviceDayCount == 0) || (checkRange(cityID, 1, network->airportCount) == 0)
+		|| (network->airports[cityID].daylightRule == kNoDaylightSaving))
+	{
+		return timezoneOffset(cityID);
+	}
 
-	return (originOffset - destinationOffset);
+	/* Take the date on the daylight saving clock, so the day the clocks go forward starts
+	on it. */
+	airport = &network->airports[cityID];
+	if (isDaylightTime(cityID, timeUTC + airport->standardOffset + kMinutesPerHour) == 1)
+	{
+		return airport->standardOffset + kMinutesPerHour;
+	}
+
+	return airport->standardOffset;
 }
-// End of time conversion functions
 
 
 
 /*
-* Function:			airportDirectory()
-* Description:		Takes a cityID and returns a pointer to the Airport constant
-*					for that city.
-* Parameters:		int cityID	The ID of the airport you wish to find the Airport struct for.
-* Return Values:	A const Airport pointer to the desired Airport struct.
+* Function:			isDaylightTime()
+* Description:		Checks whether a city's clocks are on daylight saving time at a local time.
+*					Without a calendar, that is whether they are on the travel date.
+* Parameters:		int cityID		The number identifier of the city.
+*					int localTime	The time in minutes since midnight, local time, of the first
+*									day. May be on a later (or earlier) day.
+* Return Values:	1 if the clocks are forward, 0 if they aren't or the cityID is invalid.
 */
-const Airport* airportDirectory(int cityID)
+int isDaylightTime(int cityID, int localTime)
 {
-	const Airport* airport = NULL;
+	const Timetable* network = flightTimetable();
+	const AirportInfo* airport = NULL;
+	int calendarDay = 0;
 
-	if (cityID == kTorontoID)
-	{
-		airport = &kTorontoAirport;
-	}
-	else if (cityID == kAtlantaID)
-	{
-		airport = &kAtlantaAirport;
-	}
-	else if (cityID == kAustinID)
-	{
-		airport = &kAustinAirport;
-	}
-	else if (cityID == kSantaFeID)
+	if (checkRange(cityID, 1, network->airportCount) == 0)
 	{
-		airport = &kSantaFeAirport;
+		return 0;
 	}
-	else if (cityID == kDenverID)
+
+	airport = &network->airports[cityID];
+	if (network->serviceDayCount == 0)
 	{
-		airport = &kDenverAirport;
+		return (airport->timezoneOffset != airport->standardOffset) ? 1 : 0;
 	}
-	else if (cityID == kChicagoID)
+
+	calendarDay = dayOfTime(localTime) + network->firstServiceDay;
+	if (calendarDay < 0)
 	{
-		airport = &kChicagoAirport;
+		calendarDay = 0;
 	}
-	else if (cityID == kBuffaloID)
+	else if (calendarDay >= network->serviceDayCount)
 	{
-		airport = &kBuffaloAirport;
+		calendarDay = network->serviceDayCount - 1;
 	}
 
-	return airport;
+	return (network->daylightDays[calendarDay] >> airport->daylightRule) & 1;
+}
+
+
+
+/*
+* Function:			dateAsDayNumber()
+* Description:		Takes a calendar date and returns how many days it is after 1 January 1970,
+*					so dates can be compared and counted between.
+* Parameters:		int year		The year, e.g. 2026.
+*					int month		The month, 1 to 12.
+*					int day			The day of the month, 1 to 31.
+* Return Values:	The day number. Negative for dates before 1970.
+*/
+int dateAsDayNumber(int year, int month, int day)
+{
+	// Count years from 1 March, so a leap day is always the last day of its year.
+	int marchYear = (month <= 2) ? year - 1 : year;
+	int era = ((marchYear >= 0) ? marchYear : marchYear - 399) / 400;
+	int yearOfEra = marchYear - era * 400;
+	int dayOfYear = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+	// The Gregorian calendar repeats every 400 years, which is 146097 days.
+	return era * 146097 + dayOfEra - 719468;
+}
+
+
+
+/*
+* Function:			todayAsDayNumber()
+* Description:		Returns today's date, on the computer's clock, as a day number.
+* Return Values:	The day number (see dateAsDayNumber()).
+*/
+int todayAsDayNumber(void)
+{
+	time_t now = time(NULL);
+	struct tm* today = localtime(&now);
+
+	return dateAsDayNumber(today->tm_year + 1900, today->tm_mon + 1, today->tm_mday);
 }
+// End of time conversion functions
 
 
 
@@ -285,9 +564,7 @@ const Airport* airportDirectory(int cityID)
 */
 void displayCityList(int skipNumber)
 {
-	char cityName[kCityNameMax] = "";
-
-	for (int i = 1; i <= kLastCity; i++)
+	for (int i = 1; i <= flightTimetable()->airportCount; i++)
 	{
 		if (i != skipNumber)
 		{
@@ -314,33 +591,11 @@ void displayCityList(int skipNumber)
 */
 void printAirportName(int airportNumber)
 {
-	if (airportNumber == kTorontoID)
-	{
-		printf("Toronto");
-	}
-	else if (airportNumber == kAtlantaID)
-	{
-		printf("Atlanta");
-	}
-	else if (airportNumber == kAustinID)
-	{
-		printf("Austin");
-	}
-	else if (airportNumber == kSantaFeID)
-	{
-		printf("Santa Fe");
-	}
-	else if (airportNumber == kDenverID)
-	{
-		printf("Denver");
-	}
-	else if (airportNumber == kChicagoID)
-	{
-		printf("Chicago");
-	}
-	else if (airportNumber == kBuffaloID)
+	const Timetable* network = flightTimetable();
+
+	if (checkRange(airportNumber, 1, network->airportCount))
 	{
-		printf("Buffalo");
+		printf("%s", network->airports[airportNumber].name);
 	}
 	else
 	{
@@ -368,68 +623,58 @@ void printTime(int timeInMinutes)
 /*
 * Function:			printClockTime()
 * Description:		Takes the time in minutes and prints it in the standard HH:MM format,
-*					using a 12 hour clock. Also prints a.m./f.m., timezone, and a notification that
-*					one day has passed to the next, if necessary.
-* Parameters:		int timeInMinutes	The time in minutes to be converted into HH:MM
-*					int cityID			The city ID number, to be used to calculate timezone.
+*					using a 12 hour clock. Also prints a.m./p.m., timezone, and which day it
+*					falls on, if not the first.
+* Parameters:		int timeInMinutes	The time in minutes since midnight, local time, of the
+*										first day. May be on a later (or earlier) day.
+*					int cityID			The city ID number, to be used to find the timezone.
 */
 void printClockTime(int timeInMinutes, int cityID)
 {
-	int hours = timeAsHHMM(timeInMinutes) / 100;
-	int minutes = timeAsHHMM(timeInMinutes) % 100;
+	// The day the time falls on, with the first day as day 0, and the time on that day.
+	int day = dayOfTime(timeInMinutes);
+	int hours = timeAsHHMM(timeInMinutes - day * kMinutesPerDay) / 100;
+	int minutes = timeAsHHMM(timeInMinutes - day * kMinutesPerDay) % 100;
 
-	char meridian[] = "a.m.";
-	char timezone[4] = "";
-	char nextDay[] = " the next day";
+	const char* meridian = "a.m.";
+	const char* timezone = "";
 
 	// Set timezone
-	if (timezoneOffset(cityID) == kCSToffset)
-	{
-		strcpy(timezone, "CST");
-	}
-	else if (timezoneOffset(cityID) == kMSToffset)
+	if (checkRange(cityID, 1, flightTimetable()->airportCount))
 	{
-		strcpy(timezone, "MST");
-	}
-	else if (timezoneOffset(cityID) == kESToffset)
-	{
-		strcpy(timezone, "EST");
-	}
-	
-	// If over 24 hours, reduce the time by 24 hours. Otherwise, remove note about " the next day"
-	if (hours > kHoursPerDay)
-	{
-		hours -= kHoursPerDay;
-	}
-	else
-	{
-		strcpy(nextDay, "");
+		timezone = (isDaylightTime(cityID, timeInMinutes) == 1)
+			? flightTimetable()->airports[cityID].daylightName
+			: flightTimetable()->airports[cityID].standardName;
 	}
 
-	// If over 12 hours, reduce by 12 and switch to p.m.
-	if (hours > (kHoursPerDay / 2))
+	// From noon on, reduce by 12 and switch to p.m.
+	if (hours >= (kHoursPerDay / 2))
 	{
 		hours -= kHoursPerDay / 2;
-		strcpy(meridian, "p.m.");
+		meridian = "p.m.";
 	}
 
-
-	// For 00/12 a.m.
-	if (hours == 00)
+	// For 12 a.m. and 12 p.m.
+	if (hours == 0)
 	{
 		hours = 12;
 	}
 
-	// For 12 p.m.
-	else if (hours == 12)
+	// Print the result.
+	printf("%d:%02d %s %s", hours, minutes, meridian, timezone);
+
+	if (day == 1)
 	{
-		strcpy(meridian, "p.m.");
+		printf(" the next day");
+	}
+	else if (day > 1)
+	{
+		printf(" %d days later", day);
+	}
+	else if (day < 0)
+	{
+		printf(" the day before");
 	}
-	
-
-
-	// Print the result.
-	printf("%d:%02d %s %s%s", hours, minutes, meridian, timezone, nextDay);
 }
 
 
@@ -438,17 +683,42 @@ void printClockTime(int timeInMinutes, int cityID)
 * Function:			printItinerary()
 * Description:		Given a flightplan, an itinerary is printed out, including all
 *					departure and arrival times (in local timezones) and total travel time.
+*					Times are followed in UTC, the same as the search, and only turned into
+*					each airport's local time to be printed. The itinerary is put together by
+*					writeItineraryText() and printed in one go.
 * Parameters:		int origin					The ID of the starting airport.
 *					int destination				The ID of the final destination.
 *					int startTime				The start time (in minutes since midnight 
 *												local time) of the journey.
 *					const Flight* flightPlan[]	The chain of flights to be printed.
 */
-void printItinerary(int origin, int destination, const int startTime, 
-	const Flight* flightPlan[kCityIndex])
+void printItinerary(int origin, int destination, const int startTime,
+	const Flight* flightPlan[])
+{
+	OutputBuffer itinerary = { 0 };
+
+	writeItineraryText(&itinerary, origin, destination, startTime, flightPlan);
+	fwrite(itinerary.text, 1, itinerary.length, stdout);
+
+	freeOutputBuffer(&itinerary);
+}
+
+
+
+/*
+* Function:			printProfile()
+* Description:		Prints every departure worth taking from the origin over the 24 hours from the
+*					start time, with when it gets to the destination, from a profile found by
+*					profileEarliestArrivals(). Times are in the local timezones.
+* Parameters:		int origin					The ID of the starting airport.
+*					int destination				The ID of the final destination.
+*					int startTime				The start of the profile's window (in minutes since
+*												midnight local time).
+*					const QueryScratch* scratch	The scratch holding the profile.
+*/
+void printProfile(int origin, int destination, const int startTime, const QueryScratch* scratch)
 {
-	int localStartTime = startTime;
-	int totalTravelTime = 0;
+	int entry = scratch->profileHeads[destination];
 
 	printf("Flying from ");
 	printAirportName(origin);
@@ -456,79 +726,149 @@ void printItinerary(int origin, int destination, const int startTime,
 	printAirportName(destination);
 	printf(".\n\n");
 
-	printf("Starting from ");
-	printAirportName(origin);
-	printf(" at ");
-	printClockTime(localStartTime, origin);
-	printf(".\n");
-
-
-	// For each flight in the flightPlan
-	for (int i = 0; i < kCityIndex; i++)
+	if (entry < 0)
 	{
-		// If there are no flights left in the flightPlan.
-		if (flightPlan[i] == NULL)
-		{
-			break;
-		}
+		printf("There are no flights that reach ");
+		printAirportName(destination);
+		printf(" from ");
+		printAirportName(origin);
+		printf(".\n");
+		return;
+	}
 
-		int flightOrigin = flightPlan[i]->originCity;
-		int flightDestination = flightPlan[i]->destinationCity;
-		int flightDuration = timeAsMinutes(flightPlan[i]->flightDuration);
+	printf("Leaving ");
+	printAirportName(origin);
+	printf(" in the 24 hours from ");
+	printClockTime(startTime, origin);
+	printf(", the best times to go are:\n");
 
-		int localDepartureTime = timeAsMinutes(flightPlan[i]->departureTime);
-		int destinationArrivalTime = localDepartureTime + flightDuration;
+	// Every later departure arrives later too, so each one is worth listing.
+	for (; entry >= 0; entry = scratch->profileEntries[entry].next)
+	{
+		const ProfileEntry* option = &scratch->profileEntries[entry];
+		// A journey can end more than a day after the window starts; printClockTime() says so.
+		printf("Leave at ");
+		printClockTime(option->departureTime + timezoneOffset(origin), origin);
+		printf(", arrive at ");
+		printClockTime(option->arrivalTime + timezoneOffset(destination), destination);
+		printf(" (");
+		printTime(option->arrivalTime - option->departureTime);
+		printf(").\n");
+	}
+}
 
-		// Account for the difference in timezones for the destination arrival time.
-		destinationArrivalTime -= timezoneDifference(flightOrigin, flightDestination) 
-			* kMinutesPerHour;
 
-		/* If departure time since midnight is less than current time since midnight,
-		you're leaving the next day. Increase localDepartureTime by one day.*/
-		if (localDepartureTime < localStartTime)
-		{
-			localDepartureTime += kMinutesPerDay;
-		}
 
+/*
+* Function:			printParetoOptions()
+* Description:		Prints every plan found by paretoEarliestArrivals(), from the fewest flights to
+*					the soonest arrival, each with its flights. Times are in the local timezones.
+* Parameters:		int origin					The ID of the starting airport.
+*					int destination				The ID of the final destination.
+*					int startTime				The user's starting time (in minutes since midnight
+*												local time).
+*					QueryScratch* scratch		The scratch holding the options. Its flightPlan is
+*												used for each option's plan in turn.
+*/
+void printParetoOptions(int origin, int destination, const int startTime, QueryScratch* scratch)
+{
+	int startTimeUTC = startTime - timezoneOffset(origin);
 
+	printf("Flying from ");
+	printAirportName(origin);
+	printf(" to ");
+	printAirportName(destination);
+	printf(", starting at ");
+	printClockTime(startTime, origin);
+	printf(".\n");
 
-		printf("Leaving ");
-		printAirportName(flightOrigin);
-		printf(" at ");
-		printClockTime(localDepartureTime, flightOrigin);
-		printf(" for ");
-		printAirportName(flightDestination);
+	if (scratch->paretoOptionCount == 0)
+	{
+		printf("There are no flights that reach ");
+		printAirportName(destination);
+		printf(" from ");
+		printAirportName(origin);
 		printf(".\n");
+		return;
+	}
 
+	// Each option takes more flights than the one before, and arrives sooner for it.
+	for (int i = 0; i < scratch->paretoOptionCount; i++)
+	{
+		const ParetoOption* option = &scratch->paretoOptions[i];
+		int groundTime = startTimeUTC;
 
+		printf("\nWith %d flight%s, arriving at ", option->flightCount,
+			(option->flightCount == 1) ? "" : "s");
+		printClockTime(option->arrivalTime + timezoneOffsetAt(destination, option->arrivalTime),
+			destination);
+		printf(" (");
+		printTime(option->arrivalTime - startTimeUTC);
+		printf("):\n");
 
-		printf("Arriving in ");
-		printAirportName(flightDestination);
-		printf(" at ");
-		printClockTime(destinationArrivalTime, flightDestination);
-		printf(".\n");
+		createParetoFlightplan(scratch, origin, destination, option, scratch->flightPlan);
 
+		// As in the search, each change of flights waits out the airport's connection time.
+		for (int j = 0; scratch->flightPlan[j] != NULL; j++)
+		{
+			const Flight* flight = scratch->flightPlan[j];
+			int departureTime = nextConnectionUTC(flight, groundTime, (j == 0) ? 1 : 0);
+
+			groundTime = departureTime + flight->flightDuration;
+
+			printf("  Leave ");
+			printAirportName(flight->originCity);
+			printf(" at ");
+			printClockTime(departureTime + timezoneOffsetAt(flight->originCity, departureTime),
+				flight->originCity);
+			printf(", arrive in ");
+			printAirportName(flight->destinationCity);
+			printf(" at ");
+			printClockTime(groundTime + timezoneOffsetAt(flight->destinationCity, groundTime),
+				flight->destinationCity);
+			printf(".\n");
+		}
+	}
+}
 
-		/* Increase travel time by the difference between localStartTime and localDepartureTime
-		(layover time waiting from when one flight touches down to the next one taking off) and
-		flight time. */
-		totalTravelTime += localDepartureTime - localStartTime;
-		totalTravelTime += flightDuration;
 
-		// Prepare for the next loop.
-		localStartTime = destinationArrivalTime;
 
-		/* Prevents some reduntant " the next day" messages. localStartTime shouldn't be greater 
-		than a day's worth of minutes for the beginning of the for, so reduce it by a day if it is. */
-		if (localStartTime > (kMinutesPerDay))
-		{
-			localStartTime -= kMinutesPerDay;
-		}
+/*
+* Function:			printCacheCounts()
+* Description:		Reports how well the arrival cache did, on stderr so it stays out of batch
+*					results. Prints nothing if the cache isn't in use.
+* Parameters:		const ProgramOptions* options	The options the program was run with.
+*/
+void printCacheCounts(const ProgramOptions* options)
+{
+	ArrivalCacheCounts counts = arrivalCacheCounts();
+	long long lookups = counts.hits + counts.misses;
+
+	if (options->cacheSize == 0)
+	{
+		return;
 	}
 
-	printf("\nTotal travel time: ");
-	printTime(totalTravelTime);
-	printf(".\n");
+	fprintf(stderr, "Arrival cache: %lld hits, %lld misses, %lld evictions (%.1f%% hit rate).\n",
+		counts.hits, counts.misses, counts.evictions,
+		(lookups > 0) ? 100.0 * counts.hits / lookups : 0.0);
+}
+
+
+
+/*
+* Function:			printSearchCounters()
+* Description:		Prints a set of search counts to stderr, on one line.
+* Parameters:		const SearchCounters* counters		The counts to print.
+*/
+void printSearchCounters(const SearchCounters* counters)
+{
+	fprintf(stderr, "Search counters: %lld airports settled, %lld legs relaxed, "
+		"%lld soonestArrival() calls, %lld flights scanned, %lld day wraps, "
+		"%lld improvements, %lld plan flights.\n",
+		counters->airportsSettled, counters->legsRelaxed, counters->soonestArrivalCalls,
+		counters->flightsScanned, counters->dayWraps, counters->improvements,
+		counters->planFlights);
 }
 
 
@@ -553,7 +893,7 @@ int getMenuChoice(int minValue, int maxValue, char prompt[], char invalidRespons
 	userChoice = getNum();
 
 	// If the user's entered number isn't within range, set choice to be -1.
-	if (!checkRange(userChoice, kExitMenu, kLastCity))
+	if (!checkRange(userChoice, minValue, maxValue))
 	{
 		userChoice = -1;
 
@@ -572,16 +912,17 @@ int getMenuChoice(int minValue, int maxValue, char prompt[], char invalidRespons
 /*
 * Function:			getHHMMTime()
 * Description:		Display a prompt and wait for user numerical input within a range.
+* Parameters:		const char prompt[]		What time to ask for.
 * Return Values:	The user's chosen number, if valid, or -1 if invalid input was received.
 */
-int getHHMMTime(void)
+int getHHMMTime(const char prompt[])
 {
 	int usersTime = 0;
 
 	int hours = 0;
 	int minutes = 0;
 
-	printf("Please enter the current time in your city of origin, in 24-hour format.\n");
+	printf("%s\n", prompt);
 	printf("Enter times in the form HHMM, with no colon between hours and minutes.\n");
 	printf("e.g. 140, 1820, 0020, 2359.\n");
 
@@ -637,230 +978,939 @@ void waitForKey(void)
 * Function:			soonestArrival()
 * Description:		Finds the flight that arrives soonest at a given destination from a given
 *					origin. 
+*					The first flight that hasn't left yet is found in the leg's sorted departure
+*					times by firstFlightAfter(). A later departure can still arrive sooner, so
+*					the timetable keeps, for every flight, the soonest-arriving flight from there
+*					to the end of the day; that and the first flight tomorrow are the only two
+*					flights worth comparing.
+*					That only holds when every flight runs every day. On a timetable with a
+*					calendar, soonestServiceArrival() checks each flight's days instead.
 * Parameters:		int startTime			The time, in minutes since midnight, that the flyer is
 *											at the origin airport. Given in UTC.
-*					int origin				The ID of the origin airport.
-*					int destination			The ID of the destination airport.
+*					int leg					The timetable leg (origin and destination pair) to
+*											search.
 *					Flight* soonestArrival	The flight that gets to the destination airport
-*											the fastest. NULL if no connection available.
-* Return Values:	Returns the time of arrival at the destination, given as the difference
-*					from startTime to time of arrival in minutes.
+*											the fastest.
+* Return Values:	Returns the time of arrival at the destination, in minutes since midnight
+*					UTC of the first day (the same clock as startTime).
 *					Also returns a pointer to the actual flight, via soonestArrival.
+*					If every flight on the leg has been cancelled, returns INT_MAX, with
+*					soonestArrival set to NULL.
 */
-int soonestArrival(const int startTime, int origin, int destination, const Flight** soonestArrival)
+int soonestArrival(const int startTime, int leg, const Flight** soonestArrival)
 {
-	// The local clock time, given in minutes since local midnight.
-	int localStartTime = startTime % (kMinutesPerDay) + timezoneOffset(origin) * kMinutesPerHour;
-
-	int arrivalTime = 0;
-	int bestArrivalTime = 0;
+	const Timetable* network = flightTimetable();
 
-	char loopedAround = 0;		// 1 if the flight scan has had to go past midnight to the next day.
+	// The flights on this leg are departureOffsets[leg] up to lastFlight, in order of departure.
+	int firstFlight = network->departureOffsets[leg];
+	int lastFlight = network->departureOffsets[leg + 1];
 
-	const Airport* originAirport = airportDirectory(origin);
-	const Flight* flightList = originAirport->flightList[destination];
+	/* The start time as days and minutes since midnight UTC. The day is rounded down, so
+	timeInDay is never negative, even for a start before the first midnight. */
+	int day = dayOfTime(startTime);
+	int timeInDay = startTime - day * kMinutesPerDay;
 
-	// If the originAirport has flights to the destination...
-	if (originAirport->flightConnections[destination] != 0)
-	{
-
-		// <Flight scan>
-		// Check each flight going out from this airport to the destination.
-		for (int i = 0; i < kMaxFlightsToDestination; i++)
-		{
-			// How long the layover is. Used to create a point of comparison, departureTimeUTC
-			int waitSinceArrival = timeAsMinutes(flightList[i].departureTime) - localStartTime;
+	int nextFlight = 0;
+	int bestToday = 0;
+	int bestTomorrow = 0;
+	int arrivalToday = 0;
+	int arrivalTomorrow = 0;
 
-			/* The departure time according to UTC, given as minutes since midnight UTC on the 
-			original departure. */
-			int departureTimeUTC = startTime + waitSinceArrival;
+	countSearch(soonestArrivalCalls, 1);
 
+	if (network->serviceDayCount > 0)
+	{
+		return soonestServiceArrival(startTime, leg, soonestArrival);
+	}
 
-			/* Since the flights are arranged chronologically, if they are departing after the 
-			current best arrival time, there is no way that any later flights could get to the 
-			destination any sooner.
-			Either way, break from the Flight Scan.*/
-			if ((departureTimeUTC > bestArrivalTime) && (bestArrivalTime != 0))
-			{
-				break;
-			}
-			/* If the end of the list has been reached (empty flight entries would have originCity 
-			of 0) loop around to the next day until it's 100% certain the best flight has been
-			found. */
-			else if ((flightList[i].originCity == 0) && (loopedAround !=1))
-			{
-				// Sets loopedAround flag to 1, so that time can be adjusted accordingly later.
-				loopedAround = 1;
-				/* localStartTime is set back 24 hours - to the same time the day before - and 
-				the cycle begins again, until the best time is found.*/
-				localStartTime -= kMinutesPerDay;
-
-				// Restarts flight scan.
-				i = -1;
-				continue;
-			}
-			/* If the end of the list has been reached and the day has already cycled once, there's
-			definitely no better flights to be found (since flights are the same every day, if you 
-			COULD catch it and it wasn't the best flight to take today, it's not better to take it 
-			tomorrow.) Break.*/
-			else if (flightList[i].originCity == 0)
-			{
-				/* Without this break, there gets to be some funky behaviour with flights that are
-				around midnight UST and departure times of 0 (i.e. no flight available.) */
-				break;
-			}
-			else
-			{
-				// If the flight leaves after the current time (i.e. haven't missed it)
-				if (timeAsMinutes(flightList[i].departureTime) > localStartTime)
-				{
-					// The arrival time is calculated.
-					arrivalTime = departureTimeUTC + timeAsMinutes(flightList[i].flightDuration);
+	// The first flight that leaves after timeInDay. One leaving at exactly timeInDay has been missed.
+	nextFlight = firstFlightAfter(network->departureMinutes, firstFlight, lastFlight, timeInDay);
 
-					/* If no bestArrivalTime has been found, or if the arrivalTime for this flight 
-					is better than the current best. */
-					if ((bestArrivalTime == 0) || (arrivalTime < bestArrivalTime))
-					{
-						// Set the new best time, and set soonestArrival to point at this flight.
-						bestArrivalTime = arrivalTime;
-						*soonestArrival = &flightList[i];
-					}
-				} // End of "if flight hasn't left yet"
+	/* Since flights are the same every day, the soonest arrival tomorrow is the soonest-arriving
+	flight of the whole day, taken one day later. A flight that could be caught today but isn't
+	the best today can't be any better tomorrow. */
+	bestTomorrow = network->soonestOnwardFlight[firstFlight];
 
-			} // End of checking flight i
+	// If even the day's best flight is cancelled, every flight on the leg is.
+	if (network->arrivalMinutes[bestTomorrow] == kCancelledArrival)
+	{
+		*soonestArrival = NULL;
+		return INT_MAX;
+	}
 
-		} // End of checking each flight from origin to destination
+	arrivalTomorrow = (day + 1) * kMinutesPerDay + network->arrivalMinutes[bestTomorrow];
 
-	} // End of "if this airport has flights to given destination."
+	// If there are flights left today, take the soonest-arriving one unless tomorrow's is sooner.
+	if (nextFlight < lastFlight)
+	{
+		bestToday = network->soonestOnwardFlight[nextFlight];
+		arrivalToday = day * kMinutesPerDay + network->arrivalMinutes[bestToday];
+	}
 
-	// If the originAirport has no flights to the destination, set soonestArrival to NULL.
-	else
+	if ((nextFlight < lastFlight) && (arrivalToday <= arrivalTomorrow))
 	{
-		soonestArrival = NULL;
+		*soonestArrival = &network->departures[bestToday];
+		return arrivalToday;
 	}
 
-	return bestArrivalTime;
+	countSearch(dayWraps, 1);
+
+	*soonestArrival = &network->departures[bestTomorrow];
+	return arrivalTomorrow;
 }
 
 
 
 /*
-* Function:			mapEarliestArrivals()
-* Description:		Maps out the earliest possible arrival time at each airport from your original 
-*					airport, at the current time, and returns a list of the flights needed to get 
-*					to each one.
-* Parameters:		int startTimeMinutes		The user's starting time, in the local timezone.
-*					int originAirport			The user's starting airport.
-*					Flight earliestArrivals[]	An array to pass a list of flights to, representing
-*												the earliest flights available to each destination.
+* Function:			soonestServiceArrival()
+* Description:		soonestArrival() for a timetable with a calendar, where a flight may not run
+*					every day. The flights on the leg are taken in the order they leave, day by
+*					day from the flyer's, skipping those that don't run that day, until one
+*					leaves after the soonest landing found so far (no flight leaving later can
+*					land any sooner). Days no flight on the leg runs are passed over whole. Unlike
+*					soonestArrival(), the wait isn't limited to a day: it can run to the end of
+*					the calendar.
+*					The calendar can run past a change of clocks at the origin, which moves a
+*					day's flights an hour from their times (see departureShift()). Where the
+*					origin changes its clocks, the flights are taken from an hour before the
+*					flyer gets there, and the scan runs on to an hour past the soonest landing.
+* Parameters:		int startTime			The time the flyer is at the origin, in minutes since
+*											midnight UTC of the first day.
+*					int leg					The timetable leg to search.
+*					Flight* soonestArrival	The flight that gets to the destination the fastest,
+*											or NULL if no flight on the leg runs in time.
+* Return Values:	The time of arrival at the destination, in minutes since midnight UTC of
+*					the first day, or INT_MAX if no flight on the leg runs in time.
 */
-void mapEarliestArrivals(const int startTimeInMinutes, int originAirport, 
-	const Flight* earliestArrivals[kCityIndex])
+int soonestServiceArrival(int startTime, int leg, const Flight** soonestArrival)
 {
-	/* The earliest possible time that each airport can be reached.
-	The earliestGroundTime is given in minutes since midnight of the
-	first day. All times (including original start time) are recorded
-	in UTC.
+	const Timetable* network = flightTimetable();
+	int firstFlight = network->departureOffsets[leg];
+	int lastFlight = network->departureOffsets[leg + 1];
+	int originAirport = network->departures[firstFlight].originCity;
+
+	// How far any day's flights can be from their times, and the earliest time worth taking.
+	int shiftLimit = (network->airports[originAirport].daylightRule == kNoDaylightSaving) ? 0
+		: kMinutesPerHour;
+	int day = dayOfTime(startTime - shiftLimit);
+	int nextFlight = firstFlightAfter(network->departureMinutes, firstFlight, lastFlight,
+		startTime - shiftLimit - day * kMinutesPerDay);
+
+	// The first day, counting from the travel date, past the end of the calendar.
+	int endDay = network->serviceDayCount - network->firstServiceDay;
+
+	int bestFlight = -1;
+	int bestDay = day;
+	int bestArrival = INT_MAX;
+
+	// <Day loop>
+	for (int flightDay = day; (flightDay < endDay)
+		&& (flightDay * kMinutesPerDay - shiftLimit < bestArrival); flightDay++)
+	{
+		if (isLegServiceDay(leg, flightDay) == 1)
+		{
+			for (int flight = (flightDay == day) ? nextFlight : firstFlight; flight < lastFlight;
+				flight++)
+			{
+				int shift = 0;
+				int arrival = 0;
+
+				countSearch(flightsScanned, 1);
+
+				if (flightDay * kMinutesPerDay + network->departureMinutes[flight] - shiftLimit
+					>= bestArrival)
+				{
+					break;
+				}
+
+				if (isServiceDay(flight, flightDay) == 0)
+				{
+					continue;
+				}
+
+				// One leaving at exactly startTime has been missed, as in soonestArrival().
+				shift = (shiftLimit == 0) ? 0 : departureShift(flight, flightDay);
+				arrival = flightDay * kMinutesPerDay + network->arrivalMinutes[flight] + shift;
+
+				if ((arrival < bestArrival)
+					&& (flightDay * kMinutesPerDay + network->departureMinutes[flight] + shift
+					> startTime))
+				{
+					bestFlight = flight;
+					bestDay = flightDay;
+					bestArrival = arrival;
+				}
+			}
+		}
+	} // End of day loop.
+
+	if (bestDay > dayOfTime(startTime))
+	{
+		countSearch(dayWraps, 1);
+	}
+
+	*soonestArrival = (bestFlight >= 0) ? &network->departures[bestFlight] : NULL;
+
+	return bestArrival;
+}
+
+
+
+/*
+* Function:			firstFlightAfter()
+* Description:		Finds the first flight in a run of sorted departure times that leaves after a
+*					given time. A binary search narrows the run down to kFlightScanWidth flights
+*					or fewer, which are then compared with the time all at once: 8 at a time with
+*					AVX2, or 4 at a time with SSE2, and one at a time otherwise. Most legs are
+*					short enough to skip the binary search altogether, and a straight scan has
+*					no branches to mispredict.
+* Parameters:		const int departureMinutes[]	The departure times, in ascending order.
+*					int firstFlight					The first flight in the run.
+*					int lastFlight					One past the last flight in the run.
+*					int time						The time to find the first flight after.
+* Return Values:	The first flight leaving after time, or lastFlight if none does.
+*/
+int firstFlightAfter(const int departureMinutes[], int firstFlight, int lastFlight, int time)
+{
+	int low = firstFlight;
+	int high = lastFlight;
+
+	// <Binary search>
+	while (high - low > kFlightScanWidth)
+	{
+		int middle = low + (high - low) / 2;
+
+		countSearch(flightsScanned, 1);
+
+		if (departureMinutes[middle] <= time)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	} // End of binary search loop.
+
+	// <Vector scan>
+	// The first lane that leaves after time is the answer, since the times are in order.
+#if defined(__AVX2__)
+	{
+		__m256i limit = _mm256_set1_epi32(time);
+
+		for (; low + 8 <= high; low += 8)
+		{
+			__m256i times = _mm256_loadu_si256((const __m256i*)&departureMinutes[low]);
+			int laterLanes = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(times, limit)));
+
+			countSearch(flightsScanned, 8);
+
+			if (laterLanes != 0)
+			{
+				return low + lowestSetBit(laterLanes);
+			}
+		}
+	}
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+	{
+		__m128i limit = _mm_set1_epi32(time);
+
+		for (; low + 4 <= high; low += 4)
+		{
+			__m128i times = _mm_loadu_si128((const __m128i*)&departureMinutes[low]);
+			int laterLanes = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(times, limit)));
+
+			countSearch(flightsScanned, 4);
+
+			if (laterLanes != 0)
+			{
+				return low + lowestSetBit(laterLanes);
+			}
+		}
+	}
+#endif
+	// The flights left over, and every flight on a build without either.
+	for (; low < high; low++)
+	{
+		countSearch(flightsScanned, 1);
+
+		if (departureMinutes[low] > time)
+		{
+			break;
+		}
+	} // End of vector scan.
+
+	return low;
+}
+
+
+
+/*
+* Function:			lowestSetBit()
+* Description:		Finds the lowest bit set in a vector comparison's lane mask.
+* Parameters:		int mask		The mask. Must not be 0.
+* Return Values:	The bit's position, from 0.
+*/
+int lowestSetBit(int mask)
+{
+#ifdef _MSC_VER
+	unsigned long position = 0;
+
+	_BitScanForward(&position, (unsigned long)mask);
+
+	return (int)position;
+#else
+	return __builtin_ctz((unsigned int)mask);
+#endif
+}
+
+
+
+/*
+* Function:			nextDepartureUTC()
+* Description:		Finds when a flight next leaves after a given time. Flights run every day
+*					unless the timetable has a calendar, and one leaving at exactly earliestTime
+*					has already been missed, the same as in soonestArrival(). On a calendar, each
+*					day's departure is on that day's clocks (see departureShift()).
+* Parameters:		const Flight* flight	The flight to take.
+*					int earliestTime		The time the flyer is at the flight's origin, in
+*											minutes since midnight UTC of the first day.
+* Return Values:	The departure time, in minutes since midnight UTC of the first day.
+*/
+int nextDepartureUTC(const Flight* flight, int earliestTime)
+{
+	const Timetable* network = flightTimetable();
+	int flightID = (int)(flight - network->departures);
+
+	/* Start from the day of earliestTime, or the day before on a calendar, where a change of
+	clocks can move the departure an hour either way. */
+	int day = dayOfTime(earliestTime - flight->departureTime)
+		- ((network->serviceDayCount > 0) ? 1 : 0);
+	int departureUTC = day * kMinutesPerDay + flight->departureTime + departureShift(flightID, day);
+
+	/* Then on a day at a time until it hasn't left yet, on a day it runs. The searches only
+	ever pick a flight for a day it runs. */
+	for (int wait = 0; (wait < network->serviceDayCount + 2)
+		&& ((departureUTC <= earliestTime) || (isServiceDay(flightID, day) == 0)); wait++)
+	{
+		day++;
+		departureUTC = day * kMinutesPerDay + flight->departureTime + departureShift(flightID, day);
+	}
+
+	return departureUTC;
+}
+
+
+
+/*
+* Function:			dayOfTime()
+* Description:		Gives the day a time falls on, counting from the first day as day 0.
+*					Rounds down, so times before the first midnight are on day -1.
+* Parameters:		int timeInMinutes		A time in minutes since midnight of the first day.
+* Return Values:	The day number.
+*/
+int dayOfTime(int timeInMinutes)
+{
+	int day = timeInMinutes / kMinutesPerDay;
+
+	if ((timeInMinutes % kMinutesPerDay) < 0)
+	{
+		day--;
+	}
+
+	return day;
+}
+
+
+
+/*
+* Function:			mapEarliestArrivals()
+* Description:		Maps out the earliest possible arrival time at each airport from your original 
+*					airport, at the current time, and returns a list of the flights needed to get 
+*					to each one.
+*					Airports are settled in order of their earliest ground time (a time-dependent
+*					Dijkstra search), so each airport's outgoing flights are only checked once.
+*					This works because waiting at an airport is always allowed: leaving an airport
+*					later can never get you anywhere sooner.
+*					Given a target airport, the search stops as soon as the target is settled,
+*					and never follows a flight that lands after the target's best time so far.
+*					Only the flights back from the target are then final.
+* Parameters:		QueryScratch* scratch		Working memory for the search.
+*					int startTimeMinutes		The user's starting time, in the local timezone.
+*					int originAirport			The user's starting airport.
+*					int targetAirport			The only airport whose flights are wanted, or 0 to
+*												map every airport.
+*					Flight earliestArrivals[]	An array to pass a list of flights to, representing
+*												the earliest flights available to each destination.
+*/
+void mapEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	int targetAirport, const Flight* earliestArrivals[])
+{
+	const Timetable* network = flightTimetable();
+
+	/* The earliest possible time that each airport can be reached.
+	The earliestGroundTime is given in minutes since midnight of the
+	first day. All times (including original start time) are recorded
+	in UTC.
 	[0] is always 0, so numbering for airports remains consistent.*/
-	int earliestGroundTime[kCityIndex] = { 0 };
+	int* earliestGroundTime = scratch->groundTimes;
+
+	// The airports that have been reached but not yet settled, earliest first.
+	AirportHeap* unsettledAirports = &scratch->heap;
 
-	/* 0 if the airport does not have an updated earliestGroundTime.
-	1 if the airport has an updated earliestGroundTime and needs to be rechecked.
-	[0] is always 0, so numbering for airports remains consistent. */
-	int earliestTimeUpdated[kCityIndex] = { 0 };
+	/* reachedStamp once the search has reached an airport, and settledStamp once the airport
+	has been taken from the heap and its earliestGroundTime is final. An airport with any
+	other stamp hasn't been reached yet, whatever earliestGroundTime says. */
+	unsigned int* airportStamps = scratch->airportStamps;
+	unsigned int reachedStamp = startSearchGeneration(scratch);
+	unsigned int settledStamp = reachedStamp + 1;
 
-	/* The sum of earliestTimeUpdated. If 0, the fastest path has been found.
-	If greater than 0, more passes are required.*/
-	int updatesNeeded = 0;
+	// Whether to list the airports reached in scratch->reachedAirports (see beginReachedList()).
+	int listReached = beginReachedList(scratch, earliestArrivals);
 
 	// Loop variables.
 	int departureAirport = 0;
 	int arrivalAirport = 0;
 
 	// The earliestGroundTime for the origin airport is startTimeMinutes, in UTC.
-	earliestGroundTime[originAirport] = startTimeInMinutes 
-		- timezoneOffset(originAirport) * kMinutesPerHour;
+	earliestGroundTime[originAirport] = startTimeInMinutes - timezoneOffset(originAirport);
+	airportStamps[originAirport] = reachedStamp;
 
-	earliestTimeUpdated[originAirport] = 1;
+	pushAirport(unsettledAirports, originAirport, earliestGroundTime);
 
-	do
+	// <Airport settle loop>
+	// Take the unsettled airport with the earliest ground time until none are left.
+	// (The heap is always left empty, ready for the next search.)
+	while (unsettledAirports->size > 0)
 	{
-		// <Airport check loop>
-		// Check each airport...
-		for  (departureAirport = 1; departureAirport < kCityIndex; departureAirport++)
+		departureAirport = popEarliestAirport(unsettledAirports, earliestGroundTime);
+
+		/* Nothing can reach this airport any sooner than it already has, since every other
+		unsettled airport is reached later still. */
+		airportStamps[departureAirport] = settledStamp;
+		countSearch(airportsSettled, 1);
+
+		// Once the target is settled, its flights are final and nothing else is needed.
+		if (departureAirport == targetAirport)
+		{
+			emptyAirportHeap(unsettledAirports);
+			break;
+		}
+
+		// <Destination from airport check loop>
+		// Check each leg flying out of this airport.
+		for (int leg = network->legOffsets[departureAirport];
+			leg < network->legOffsets[departureAirport + 1]; leg++)
 		{
+			arrivalAirport = network->legDestinations[leg];
 
-			// For each airport that has an updated earliestGroundTime...
-			if (earliestTimeUpdated[departureAirport] != 0)
+			/* Never check for flights towards the original airport, and never check airports
+			that are already settled, to save time.
+			Otherwise, check for flights to the arrivalAirport.*/
+			if ((arrivalAirport != originAirport)
+				&& (airportStamps[arrivalAirport] != settledStamp))
 			{
+				/* arrivalTime is determined by the soonestArrival function. It is given
+				in minutes since midnight on the day of departure from the originAirport.*/
+				int arrivalTime = 0;
 
-				// <Destination from airport check loop>
-				for (arrivalAirport = 1; arrivalAirport < kCityIndex; arrivalAirport ++)
-				{
+				const Flight* quickestFlightToGround = NULL;
+
+				countSearch(legsRelaxed, 1);
+
+				/* Set the best flight from the departureAirport to the arrivalAirport given
+				the earliest possible time you could arrive there. */
+				arrivalTime = soonestArrival(earliestGroundTime[departureAirport], leg,
+					&quickestFlightToGround);
 
-					/* Never check if an airport has a connection to itself, and never check for
-					flights towards the original airport, to save time.
-					Otherwise, check for flights to the arrivalAirport.*/
-					if ((departureAirport != arrivalAirport)
-						&& (arrivalAirport != originAirport))
+				/* A flight landing no sooner than the target has already been reached can't
+				be part of a faster way to the target. */
+				if ((targetAirport != 0) && (earliestArrivals[targetAirport] != NULL)
+					&& (arrivalTime >= earliestGroundTime[targetAirport]))
+				{
+					continue;
+				}
+
+				/* If the soonest arrival at the arrivalAirport is sooner than the
+				existing earliestGroundTime, or there is no existing flight to the
+				arrivalAirport, update the earliestGroundTime and queue (or move up) the
+				arrivalAirport in the heap.
+				If there is no quickestFlightToGround from the arrivalTime search, then
+				no update occurs, even if the other conditions are true.*/
+				if (
+					((arrivalTime < earliestGroundTime[arrivalAirport])
+					|| (earliestArrivals[arrivalAirport] == NULL))
+
+					&& (quickestFlightToGround != NULL)
+					)
+				{
+					// The first time this search reaches the airport, it can be set up.
+					if (airportStamps[arrivalAirport] != reachedStamp)
 					{
-						/* arrivalTime is determined by the soonestArrival function. It is given
-						in minutes since midnight on the day of departure from the originAirport.*/
-						int arrivalTime = 0;
-
-						const Flight* quickestFlightToGround = NULL;
-
-						/* Set the best flight from the departureAirport to the arrivalAirport given
-						the earliest possible time you could arrive there. If there is no flight to
-						that destination, quickestFlightToGround will be set to NULL by soonestArrival,
-						and the following if statement will be false.*/
-						arrivalTime = soonestArrival(earliestGroundTime[departureAirport],
-							departureAirport, arrivalAirport,
-							&quickestFlightToGround);
-
-						/* If the soonest arrival at the arrivalAirport is sooner than the
-						existing earliestGroundTime, or there is no existing flight to the
-						arrivalAirport, update the earliestGroundTime and set the update flag
-						to true.
-						If there is no quickestFlightToGround from the arrivalTime search, then
-						no update occurs, even if the other conditions are true.*/
-						if (
-							((arrivalTime < earliestGroundTime[arrivalAirport])
-							|| (earliestArrivals[arrivalAirport] == NULL))
-
-							&& (quickestFlightToGround != NULL)
-							)
-						{
-							// Update the earliestGroundTime for this airport, and set update flag on.
-							earliestGroundTime[arrivalAirport] = arrivalTime;
-							earliestTimeUpdated[arrivalAirport] = 1;
+						airportStamps[arrivalAirport] = reachedStamp;
 
-							/* The earliestArrivals for the given destination is now pointing at
-							the quickestFlightToGround from this loop. */
-							earliestArrivals[arrivalAirport] = quickestFlightToGround;
+						if (listReached == 1)
+						{
+							scratch->reachedAirports[scratch->reachedCount] = arrivalAirport;
+							scratch->reachedCount++;
 						}
 					}
 
-				} // End of destination check loop.
-			
-			/* Once all destinations from an airport are checked, that airport has been updated.
-			Set the earliestTimeUpdated flag for this airport to 0. */
-			earliestTimeUpdated[departureAirport] = 0;
+					earliestGroundTime[arrivalAirport] = arrivalTime;
+					pushAirport(unsettledAirports, arrivalAirport, earliestGroundTime);
+					countSearch(improvements, 1);
 
-			} // End of "if airport has been updated"
+					/* The earliestArrivals for the given destination is now pointing at
+					the quickestFlightToGround from this loop. */
+					earliestArrivals[arrivalAirport] = quickestFlightToGround;
+				}
+			}
 
-		} // End of airport check loop.
+		} // End of destination check loop.
 
+	} // End of airport settle loop.
 
-		// Check if another round of updates is needed.
-		updatesNeeded = 0;
-		for (int i = 0; i < kCityIndex; i++)
+	// Once every reachable airport has been settled, return.
+}
+
+
+
+/*
+* Function:			initQueryScratch()
+* Description:		Allocates the working memory one query needs, sized for the loaded timetable.
+*					A QueryScratch is reused for query after query, so answering a query doesn't
+*					allocate anything. Each thread answering queries needs its own.
+*					The per-airport arrays are carved out of a single arena, so a thread's
+*					scratch space is one allocation, laid out in one place.
+* Parameters:		QueryScratch* scratch		The scratch space to set up.
+* Return Values:	1 if it was allocated, 0 if there wasn't enough memory.
+*/
+int initQueryScratch(QueryScratch* scratch)
+{
+	int airportCount = flightTimetable()->airportCount;
+	size_t entries = (size_t)airportCount + 1;
+	QueryScratch emptyScratch = { 0 };
+
+	// Where each array starts in the arena, and the arena's size once they've all been placed.
+	size_t arenaSize = 0;
+	size_t earliestArrivalsAt = reserveArenaBytes(&arenaSize, entries * sizeof(const Flight*));
+	size_t flightPlanAt = reserveArenaBytes(&arenaSize, entries * sizeof(const Flight*));
+	size_t latestDeparturesAt = reserveArenaBytes(&arenaSize, entries * sizeof(const Flight*));
+	size_t groundTimesAt = reserveArenaBytes(&arenaSize, entries * sizeof(int));
+	size_t scanGroundTimesAt = reserveArenaBytes(&arenaSize, entries * sizeof(int));
+	size_t estimatedArrivalsAt = reserveArenaBytes(&arenaSize, entries * sizeof(int));
+	size_t airportFlagsAt = reserveArenaBytes(&arenaSize, entries * sizeof(char));
+	size_t airportStampsAt = reserveArenaBytes(&arenaSize, entries * sizeof(unsigned int));
+	size_t reachedAirportsAt = reserveArenaBytes(&arenaSize, entries * sizeof(int));
+	size_t markedAirportsAt = reserveArenaBytes(&arenaSize, entries * sizeof(int));
+	size_t nextMarkedAirportsAt = reserveArenaBytes(&arenaSize, entries * sizeof(int));
+	size_t lastRoundsAt = reserveArenaBytes(&arenaSize, entries * sizeof(int));
+	size_t improvedAirportsAt = reserveArenaBytes(&arenaSize, entries * sizeof(int));
+	size_t profileHeadsAt = reserveArenaBytes(&arenaSize, entries * sizeof(int));
+	size_t profileArrivalsAt = reserveArenaBytes(&arenaSize, entries * sizeof(int));
+	size_t paretoOptionsAt = reserveArenaBytes(&arenaSize, entries * sizeof(ParetoOption));
+
+	*scratch = emptyScratch;
+	scratch->airportCount = airportCount;
+
+	// Aligned to a cache line too, so no array shares a line with another thread's scratch.
+	scratch->arena = (char*)calloc(arenaSize + kArenaAlignment, 1);
+
+	if ((scratch->arena == NULL) || (initAirportHeap(&scratch->heap, airportCount) == 0))
+	{
+		freeQueryScratch(scratch);
+		return 0;
+	}
+
+	{
+		char* base = scratch->arena + (kArenaAlignment - (size_t)scratch->arena % kArenaAlignment);
+
+		scratch->earliestArrivals = (const Flight**)(base + earliestArrivalsAt);
+		scratch->flightPlan = (const Flight**)(base + flightPlanAt);
+		scratch->latestDepartures = (const Flight**)(base + latestDeparturesAt);
+		scratch->groundTimes = (int*)(base + groundTimesAt);
+		scratch->scanGroundTimes = (int*)(base + scanGroundTimesAt);
+		scratch->estimatedArrivals = (int*)(base + estimatedArrivalsAt);
+		scratch->airportFlags = base + airportFlagsAt;
+		scratch->airportStamps = (unsigned int*)(base + airportStampsAt);
+		scratch->reachedAirports = (int*)(base + reachedAirportsAt);
+		scratch->markedAirports = (int*)(base + markedAirportsAt);
+		scratch->nextMarkedAirports = (int*)(base + nextMarkedAirportsAt);
+		scratch->lastRounds = (int*)(base + lastRoundsAt);
+		scratch->improvedAirports = (int*)(base + improvedAirportsAt);
+		scratch->profileHeads = (int*)(base + profileHeadsAt);
+		scratch->profileArrivals = (int*)(base + profileArrivalsAt);
+		scratch->paretoOptions = (ParetoOption*)(base + paretoOptionsAt);
+	}
+
+	// No airport carries the first search's stamp yet, and there are no results to clear.
+	scratch->generation = 0;
+	scratch->reachedCount = 0;
+
+	/* The connection scan and profiles only put back the airports they set (see
+	scanConnections() and profileEarliestArrivals()), so these start out empty. */
+	for (int i = 0; i <= airportCount; i++)
+	{
+		scratch->scanGroundTimes[i] = INT_MAX;
+		scratch->profileHeads[i] = -1;
+		scratch->profileArrivals[i] = INT_MAX;
+	}
+
+	return 1;
+}
+
+
+
+/*
+* Function:			freeQueryScratch()
+* Description:		Releases the memory held by a QueryScratch.
+* Parameters:		QueryScratch* scratch		The scratch space to release.
+*/
+void freeQueryScratch(QueryScratch* scratch)
+{
+	QueryScratch emptyScratch = { 0 };
+
+	free(scratch->arena);
+	free(scratch->roundArrivals);
+	free(scratch->roundFlights);
+	free(scratch->roundLinks);
+	free(scratch->profileEntries);
+	freeAirportHeap(&scratch->heap);
+
+	*scratch = emptyScratch;
+}
+
+
+
+/*
+* Function:			clearQueryResults()
+* Description:		Empties the earliestArrivals[] and flightPlan[] of a QueryScratch, ready for
+*					a new query. Only the airports the last search reached are cleared, when
+*					it kept a list of them; a query that touches a few airports of a large
+*					network costs no more to clear than it did to answer.
+* Parameters:		QueryScratch* scratch		The scratch space to clear.
+*/
+void clearQueryResults(QueryScratch* scratch)
+{
+	if (scratch->reachedCount >= 0)
+	{
+		for (int i = 0; i < scratch->reachedCount; i++)
+		{
+			scratch->earliestArrivals[scratch->reachedAirports[i]] = NULL;
+		}
+	}
+	else
+	{
+		for (int i = 0; i <= scratch->airportCount; i++)
 		{
-			updatesNeeded += earliestTimeUpdated[i];
+			scratch->earliestArrivals[i] = NULL;
 		}
+	}
 
-	} while (updatesNeeded != 0);
-	// Once all airports have a soonest flight to arrival, return.
+	// Every flight plan ends in a NULL, so an empty one needs nothing more.
+	scratch->flightPlan[0] = NULL;
+	scratch->reachedCount = 0;
+}
+
+
+
+/*
+* Function:			beginReachedList()
+* Description:		Decides whether a search can list the airports it gives an entry in
+*					earliestArrivals[], in scratch->reachedAirports, so that clearQueryResults()
+*					can clear just those. Only the scratch's own earliestArrivals is listed, and
+*					only when it is freshly cleared; anything already in it would be missed, so
+*					otherwise clearQueryResults() is left to clear every airport.
+*					A search that lists an airport does so when it first fills in its entry.
+* Parameters:		QueryScratch* scratch		The scratch space the search will use.
+*					Flight earliestArrivals[]	The array the search will fill in.
+* Return Values:	1 if the search is to list the airports it reaches, 0 if not.
+*/
+int beginReachedList(QueryScratch* scratch, const Flight* earliestArrivals[])
+{
+	if (earliestArrivals != scratch->earliestArrivals)
+	{
+		return 0;
+	}
+
+	if (scratch->reachedCount != 0)
+	{
+		scratch->reachedCount = -1;
+		return 0;
+	}
+
+	return 1;
+}
+
+
+
+/*
+* Function:			reserveArenaBytes()
+* Description:		Sets aside room for an array in an arena that is still being laid out.
+* Parameters:		size_t* arenaSize		The bytes set aside so far. Grows by bytes, rounded
+*											up to a whole number of cache lines.
+*					size_t bytes			The size of the array.
+* Return Values:	Where the array starts, in bytes from the start of the arena.
+*/
+size_t reserveArenaBytes(size_t* arenaSize, size_t bytes)
+{
+	size_t offset = *arenaSize;
+
+	*arenaSize += (bytes + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+
+	return offset;
+}
+
+
+
+/*
+* Function:			startSearchGeneration()
+* Description:		Starts a new search's generation, which leaves every airport unreached
+*					without touching them. Once in two billion searches the stamps run out,
+*					and only then are they all cleared.
+* Parameters:		QueryScratch* scratch		The scratch space the search will use.
+* Return Values:	The stamp for the airports the search reaches. The one after it is for the
+*					airports it settles.
+*/
+unsigned int startSearchGeneration(QueryScratch* scratch)
+{
+	if (scratch->generation > UINT_MAX - 4)
+	{
+		memset(scratch->airportStamps, 0, (scratch->airportCount + 1) * sizeof(unsigned int));
+		scratch->generation = 0;
+	}
+
+	scratch->generation += 2;
+
+	return scratch->generation;
+}
+
+
+
+/*
+* Function:			initAirportHeap()
+* Description:		Allocates an empty AirportHeap, with room for every airport.
+* Parameters:		AirportHeap* heap		The heap to be set up.
+*					int airportCount		The highest cityID the heap will hold.
+* Return Values:	1 if the heap was allocated, 0 if there wasn't enough memory.
+*/
+int initAirportHeap(AirportHeap* heap, int airportCount)
+{
+	heap->size = 0;
+	heap->airports = (int*)malloc((airportCount + 1) * sizeof(int));
+	heap->position = (int*)malloc((airportCount + 1) * sizeof(int));
+
+	if ((heap->airports == NULL) || (heap->position == NULL))
+	{
+		return 0;
+	}
+
+	for (int i = 0; i <= airportCount; i++)
+	{
+		heap->airports[i] = 0;
+		heap->position[i] = -1;
+	}
+
+	return 1;
+}
+
+
+
+/*
+* Function:			freeAirportHeap()
+* Description:		Releases the memory held by an AirportHeap.
+* Parameters:		AirportHeap* heap		The heap to be released.
+*/
+void freeAirportHeap(AirportHeap* heap)
+{
+	free(heap->airports);
+	free(heap->position);
+
+	heap->airports = NULL;
+	heap->position = NULL;
+	heap->size = 0;
+}
+
+
+
+/*
+* Function:			pushAirport()
+* Description:		Adds an airport to the heap, or moves it up to its new place if it is
+*					already waiting and its ground time has improved.
+* Parameters:		AirportHeap* heap		The heap of unsettled airports.
+*					int cityID				The airport that was added or improved.
+*					int groundTimes[]		The earliestGroundTime for each airport, used as the
+*											heap's key.
+*/
+void pushAirport(AirportHeap* heap, int cityID, const int groundTimes[])
+{
+	int slot = heap->position[cityID];
+
+	// If the airport isn't waiting in the heap yet, add it to the bottom.
+	if (slot < 0)
+	{
+		slot = heap->size;
+		heap->size++;
+	}
+
+	/* Sift up: while the parent slot holds a later airport, move that airport down
+	into this slot. */
+	while (slot > 0)
+	{
+		int parentSlot = (slot - 1) / 2;
+		int parentAirport = heap->airports[parentSlot];
+
+		if (groundTimes[parentAirport] <= groundTimes[cityID])
+		{
+			break;
+		}
+
+		heap->airports[slot] = parentAirport;
+		heap->position[parentAirport] = slot;
+		slot = parentSlot;
+	}
+
+	heap->airports[slot] = cityID;
+	heap->position[cityID] = slot;
+}
+
+
+
+/*
+* Function:			popEarliestAirport()
+* Description:		Removes the airport with the earliest ground time from the heap.
+* Parameters:		AirportHeap* heap		The heap of unsettled airports. Must not be empty.
+*					int groundTimes[]		The earliestGroundTime for each airport, used as the
+*											heap's key.
+* Return Values:	The cityID of the airport with the earliest ground time.
+*/
+int popEarliestAirport(AirportHeap* heap, const int groundTimes[])
+{
+	int earliestAirport = heap->airports[0];
+	int lastAirport = 0;
+	int slot = 0;
+
+	heap->position[earliestAirport] = -1;
+	heap->size--;
+
+	// If the heap is now empty, there's nothing left to reorder.
+	if (heap->size == 0)
+	{
+		return earliestAirport;
+	}
+
+	/* Sift down: the last airport is placed at the top, and swapped with its earliest
+	child until neither child is earlier than it. */
+	lastAirport = heap->airports[heap->size];
+
+	while ((slot * 2 + 1) < heap->size)
+	{
+		int childSlot = slot * 2 + 1;
+
+		// Pick the earlier of the two children.
+		if (((childSlot + 1) < heap->size)
+			&& (groundTimes[heap->airports[childSlot + 1]] < groundTimes[heap->airports[childSlot]]))
+		{
+			childSlot++;
+		}
+
+		if (groundTimes[heap->airports[childSlot]] >= groundTimes[lastAirport])
+		{
+			break;
+		}
+
+		heap->airports[slot] = heap->airports[childSlot];
+		heap->position[heap->airports[slot]] = slot;
+		slot = childSlot;
+	}
+
+	heap->airports[slot] = lastAirport;
+	heap->position[lastAirport] = slot;
+
+	return earliestAirport;
+}
+
+
+
+/*
+* Function:			emptyAirportHeap()
+* Description:		Removes every airport from the heap, for a search that stops early.
+* Parameters:		AirportHeap* heap		The heap of unsettled airports.
+*/
+void emptyAirportHeap(AirportHeap* heap)
+{
+	while (heap->size > 0)
+	{
+		heap->size--;
+		heap->position[heap->airports[heap->size]] = -1;
+	}
+}
+
+
+
+/*
+* Function:			findEarliestArrivals()
+* Description:		Maps out the earliest possible arrival at each airport using the chosen
+*					search engine. Every engine fills in earliestArrivals[] the same way, and
+*					lists the airports it fills in (see beginReachedList()).
+*					With --cache, a search from the same origin and start time as a recent one
+*					is answered from the arrival cache instead. With --single-pair, the search
+*					only goes as far as the destination.
+* Parameters:		ProgramOptions* options		The engine to use, and its settings.
+*					QueryScratch* scratch		Working memory for the search.
+*					int startTimeMinutes		The user's starting time, in the local timezone.
+*					int originAirport			The user's starting airport.
+*					int destinationAirport		The user's destination. The flights back from here
+*												always form a valid flight plan.
+*					Flight earliestArrivals[]	An array to pass a list of flights to, representing
+*												the earliest flights available to each destination.
+*/
+void findEarliestArrivals(const ProgramOptions* options, QueryScratch* scratch,
+	const int startTimeInMinutes, int originAirport, int destinationAirport,
+	const Flight* earliestArrivals[])
+{
+	// A cached tree from the same origin and start time is as good as a new search.
+	if ((options->cacheSize > 0) && (findCachedArrivals(scratch, startTimeInMinutes,
+		originAirport, earliestArrivals) == 1))
+	{
+		return;
+	}
+
+	if (options->precompute == 1)
+	{
+		lookupEarliestArrivals(scratch, startTimeInMinutes, originAirport, destinationAirport,
+			earliestArrivals);
+	}
+	else if (options->engine == kConnectionScanEngine)
+	{
+		scanConnections(scratch, startTimeInMinutes, originAirport, earliestArrivals);
+	}
+	else if (options->engine == kAStarEngine)
+	{
+		astarEarliestArrivals(scratch, startTimeInMinutes, originAirport, destinationAirport,
+			earliestArrivals);
+	}
+	else if (options->engine == kTransferEngine)
+	{
+		transferEarliestArrivals(scratch, startTimeInMinutes, originAirport, destinationAirport,
+			earliestArrivals);
+	}
+	else if (options->engine == kRaptorEngine)
+	{
+		raptorEarliestArrivals(scratch, startTimeInMinutes, originAirport, destinationAirport,
+			options->maxLegs, earliestArrivals);
+	}
+	else
+	{
+		mapEarliestArrivals(scratch, startTimeInMinutes, originAirport,
+			(options->singlePair == 1) ? destinationAirport : 0, earliestArrivals);
+	}
+
+	if (options->cacheSize > 0)
+	{
+		cacheArrivals(scratch, startTimeInMinutes, originAirport, earliestArrivals);
+	}
 }
 
 
@@ -872,31 +1922,553 @@ void mapEarliestArrivals(const int startTimeInMinutes, int originAirport,
 * Parameters:		int originAirport			The starting airport.
 *					int destinationAirport		The final destination.
 *					Flight earliestArrivals[]	An array of the best possible arrival times.
-*					Flight fastestFlightPlan[]	The optimized flightplan to output.
+*					Flight fastestFlightPlan[]	The optimized flightplan to output. Ends in a NULL,
+*												and is left empty if the destination can't be
+*												reached.
 */
 void createFastestFlightplan(int originAirport, int destinationAirport,
-	const Flight* earliestArrivals[kCityIndex], const Flight* fastestFlightPlan[kLastCity])
+	const Flight* earliestArrivals[], const Flight* fastestFlightPlan[])
 {
-	const Flight* backwardsFlightPlan[kLastCity] = { NULL };
 	int currentAirport = destinationAirport;
-	int stepsTaken = -1;
-	int stepsReversed = 0;
+	int stepsTaken = 0;
 
-	// Starting from the final destination, work backwards to the origin.
+	// If the destination was never reached, there's no flight plan.
+	if (earliestArrivals[destinationAirport] == NULL)
+	{
+		fastestFlightPlan[0] = NULL;
+		return;
+	}
+
+	// Starting from the final destination, count the flights back to the origin.
 	do
 	{
 		stepsTaken++;
-		backwardsFlightPlan[stepsTaken] = earliestArrivals[currentAirport];
 		currentAirport = earliestArrivals[currentAirport]->originCity;
 	} while (currentAirport != originAirport);
 
-	/* Since the previous do loop creates the flight plan in reverse, we return it to
-	cronological order for output. As stepsReversed increments, it decrements the stepsTaken
-	in the backwardsFlightPlan.*/
-	for (stepsReversed = 0; stepsReversed <= stepsTaken; stepsReversed++)
+	/* Walk back from the destination again, this time filling in the flight plan from the
+	end, so that it comes out in chronological order for output. */
+	fastestFlightPlan[stepsTaken] = NULL;
+	currentAirport = destinationAirport;
+
+	for (int step = stepsTaken - 1; step >= 0; step--)
+	{
+		fastestFlightPlan[step] = earliestArrivals[currentAirport];
+		currentAirport = earliestArrivals[currentAirport]->originCity;
+	}
+
+	countSearch(planFlights, stepsTaken);
+}
+
+
+
+/*
+* Function:			parseArguments()
+* Description:		Reads the command line options into a ProgramOptions. Anything that isn't an
+*					option is taken as the timetable file.
+* Parameters:		int argc					The argument count from main().
+*					char* argv[]				The arguments from main().
+*					ProgramOptions* options		Filled in with the options, or their defaults.
+* Return Values:	1 if the command line is valid, 0 if it isn't (or --help was given).
+*/
+int parseArguments(int argc, char* argv[], ProgramOptions* options)
+{
+	int isValid = 1;
+
+	options->timetableFile = kDefaultTimetableFile;
+	options->engine = kDijkstraEngine;
+	options->maxLegs = 0;
+	options->batchFile = NULL;
+	options->serverSocket = NULL;
+	options->outputFormat = kJSONOutput;
+	options->threadCount = 0;
+	options->profileQueries = 0;
+	options->precompute = 0;
+	options->cacheSize = 0;
+	options->singlePair = 0;
+	options->landmarkCount = kDefaultLandmarkCount;
+	options->transferHubCount = 0;
+	options->arriveBy = 0;
+	options->pareto = 0;
+	options->liveUpdates = 0;
+	options->benchmarkSizes = NULL;
+	options->benchmarkQueries = 1000;
+	options->generator.airportCount = 0;
+	options->generator.hubCount = 0;
+	options->generator.legsPerAirport = 2;
+	options->generator.departuresPerLeg = 4;
+	options->generator.timezoneSpread = 8;
+	options->generator.seed = 1;
+	options->searchCounters = kNoCounters;
+	options->travelDate = todayAsDayNumber();
+
+	for (int i = 1; (i < argc) && (isValid == 1); i++)
+	{
+		if (strcmp(argv[i], "--engine") == 0)
+		{
+			i++;
+
+			if (i == argc)
+			{
+				isValid = 0;
+			}
+			else if (strcmp(argv[i], "dijkstra") == 0)
+			{
+				options->engine = kDijkstraEngine;
+			}
+			else if (strcmp(argv[i], "csa") == 0)
+			{
+				options->engine = kConnectionScanEngine;
+			}
+			else if (strcmp(argv[i], "raptor") == 0)
+			{
+				options->engine = kRaptorEngine;
+			}
+			else if (strcmp(argv[i], "astar") == 0)
+			{
+				options->engine = kAStarEngine;
+			}
+			else if (strcmp(argv[i], "transfer") == 0)
+			{
+				options->engine = kTransferEngine;
+			}
+			else
+			{
+				fprintf(stderr, "Unknown engine \"%s\".\n", argv[i]);
+				isValid = 0;
+			}
+		}
+		else if (strcmp(argv[i], "--max-legs") == 0)
+		{
+			i++;
+
+			if ((i == argc) || (sscanf(argv[i], "%d", &options->maxLegs) != 1)
+				|| (options->maxLegs < 1))
+			{
+				fprintf(stderr, "--max-legs needs a number of flights, 1 or more.\n");
+				isValid = 0;
+			}
+		}
+		else if (strcmp(argv[i], "--date") == 0)
+		{
+			int year = 0;
+			int month = 0;
+			int day = 0;
+
+			i++;
+
+			if ((i == argc) || (sscanf(argv[i], "%d-%d-%d", &year, &month, &day) != 3)
+				|| (checkRange(year, 1970, 2199) == 0) || (checkRange(month, 1, 12) == 0)
+				|| (checkRange(day, 1, 31) == 0))
+			{
+				fprintf(stderr, "--date needs a date, as YYYY-MM-DD.\n");
+				isValid = 0;
+			}
+			else
+			{
+				options->travelDate = dateAsDayNumber(year, month, day);
+			}
+		}
+		else if (strcmp(argv[i], "--batch") == 0)
+		{
+			i++;
+
+			if (i == argc)
+			{
+				fprintf(stderr, "--batch needs a file of queries, or - for stdin.\n");
+				isValid = 0;
+			}
+			else
+			{
+				options->batchFile = argv[i];
+			}
+		}
+		else if (strcmp(argv[i], "--serve") == 0)
+		{
+			i++;
+
+			if (i == argc)
+			{
+				fprintf(stderr, "--serve needs a path for the socket.\n");
+				isValid = 0;
+			}
+			else
+			{
+				options->serverSocket = argv[i];
+			}
+		}
+		else if (strcmp(argv[i], "--format") == 0)
+		{
+			i++;
+
+			if ((i < argc) && (strcmp(argv[i], "json") == 0))
+			{
+				options->outputFormat = kJSONOutput;
+			}
+			else if ((i < argc) && (strcmp(argv[i], "tsv") == 0))
+			{
+				options->outputFormat = kTSVOutput;
+			}
+			else if ((i < argc) && (strcmp(argv[i], "binary") == 0))
+			{
+				options->outputFormat = kBinaryOutput;
+			}
+			else
+			{
+				fprintf(stderr, "--format needs json, tsv or binary.\n");
+				isValid = 0;
+			}
+		}
+		else if (strcmp(argv[i], "--profile") == 0)
+		{
+			options->profileQueries = 1;
+		}
+		else if (strcmp(argv[i], "--precompute") == 0)
+		{
+			options->precompute = 1;
+		}
+		else if (strcmp(argv[i], "--arrive-by") == 0)
+		{
+			options->arriveBy = 1;
+		}
+		else if (strcmp(argv[i], "--pareto") == 0)
+		{
+			options->pareto = 1;
+		}
+		else if (strcmp(argv[i], "--updates") == 0)
+		{
+			options->liveUpdates = 1;
+		}
+		else if (strcmp(argv[i], "--landmarks") == 0)
+		{
+			i++;
+
+			if ((i == argc) || (sscanf(argv[i], "%d", &options->landmarkCount) != 1)
+				|| (checkRange(options->landmarkCount, 1, 64) == 0))
+			{
+				fprintf(stderr, "--landmarks needs a number of landmarks, from 1 to 64.\n");
+				isValid = 0;
+			}
+		}
+		else if (strcmp(argv[i], "--transfer-hubs") == 0)
+		{
+			i++;
+
+			if ((i == argc) || (sscanf(argv[i], "%d", &options->transferHubCount) != 1)
+				|| (options->transferHubCount < 1))
+			{
+				fprintf(stderr, "--transfer-hubs needs a number of hubs, at least 1.\n");
+				isValid = 0;
+			}
+		}
+		else if (strcmp(argv[i], "--single-pair") == 0)
+		{
+			options->singlePair = 1;
+		}
+		else if (strcmp(argv[i], "--cache") == 0)
+		{
+			i++;
+
+			if ((i == argc) || (sscanf(argv[i], "%d", &options->cacheSize) != 1)
+				|| (options->cacheSize < 0))
+			{
+				fprintf(stderr, "--cache needs a number of searches to keep, or 0 for none.\n");
+				isValid = 0;
+			}
+		}
+		else if (strcmp(argv[i], "--benchmark") == 0)
+		{
+			i++;
+
+			if (i == argc)
+			{
+				fprintf(stderr, "--benchmark needs a list of airport counts, e.g. 10,1000,100000.\n");
+				isValid = 0;
+			}
+			else
+			{
+				options->benchmarkSizes = argv[i];
+			}
+		}
+		else if ((strcmp(argv[i], "--queries") == 0) || (strcmp(argv[i], "--hubs") == 0)
+			|| (strcmp(argv[i], "--legs") == 0) || (strcmp(argv[i], "--departures") == 0)
+			|| (strcmp(argv[i], "--timezones") == 0))
+		{
+			// The benchmark settings are all counts: 0 or more, or 1 or more.
+			int* setting = &options->benchmarkQueries;
+			int minimum = 1;
+			int maximum = INT_MAX;
+
+			if (strcmp(argv[i], "--hubs") == 0)
+			{
+				setting = &options->generator.hubCount;
+				minimum = 0;
+			}
+			else if (strcmp(argv[i], "--legs") == 0)
+			{
+				setting = &options->generator.legsPerAirport;
+			}
+			else if (strcmp(argv[i], "--departures") == 0)
+			{
+				setting = &options->generator.departuresPerLeg;
+			}
+			else if (strcmp(argv[i], "--timezones") == 0)
+			{
+				setting = &options->generator.timezoneSpread;
+				minimum = 0;
+				maximum = 24;
+			}
+
+			i++;
+
+			if ((i == argc) || (sscanf(argv[i], "%d", setting) != 1)
+				|| (checkRange(*setting, minimum, maximum) == 0))
+			{
+				fprintf(stderr, "%s needs a number from %d up%s.\n", argv[i - 1], minimum,
+					(maximum == 24) ? " to 24" : "");
+				isValid = 0;
+			}
+		}
+		else if (strcmp(argv[i], "--seed") == 0)
+		{
+			i++;
+
+			if ((i == argc) || (sscanf(argv[i], "%u", &options->generator.seed) != 1))
+			{
+				fprintf(stderr, "--seed needs a number.\n");
+				isValid = 0;
+			}
+		}
+		else if (strcmp(argv[i], "--threads") == 0)
+		{
+			i++;
+
+			if ((i == argc) || (sscanf(argv[i], "%d", &options->threadCount) != 1)
+				|| (options->threadCount < 0))
+			{
+				fprintf(stderr, "--threads needs a number of threads, or 0 for one per core.\n");
+				isValid = 0;
+			}
+		}
+		else if (strcmp(argv[i], "--counters") == 0)
+		{
+			i++;
+
+			if ((i < argc) && (strcmp(argv[i], "query") == 0))
+			{
+				options->searchCounters = kQueryCounters;
+			}
+			else if ((i < argc) && (strcmp(argv[i], "total") == 0))
+			{
+				options->searchCounters = kTotalCounters;
+			}
+			else
+			{
+				fprintf(stderr, "--counters needs query or total.\n");
+				isValid = 0;
+			}
+		}
+		else if ((argv[i][0] == '-') && (argv[i][1] != '\0'))
+		{
+			isValid = 0;
+		}
+		else
+		{
+			options->timetableFile = argv[i];
+		}
+	}
+
+	// Only the round-based searches can count flights.
+	if ((isValid == 1) && (options->maxLegs > 0) && (options->engine != kRaptorEngine)
+		&& (options->pareto == 0))
+	{
+		fprintf(stderr, "--max-legs only works with --engine raptor or --pareto.\n");
+		isValid = 0;
+	}
+
+	// Profiles are always found the same way, so an engine's leg limit can't apply to them.
+	if ((isValid == 1) && (options->maxLegs > 0)
+		&& ((options->profileQueries == 1) || (options->precompute == 1)))
+	{
+		fprintf(stderr, "--max-legs can't be used with --profile or --precompute.\n");
+		isValid = 0;
+	}
+
+	// Benchmarks time single queries, one at a time.
+	if ((isValid == 1) && (options->benchmarkSizes != NULL)
+		&& ((options->batchFile != NULL) || (options->profileQueries == 1)
+		|| (options->precompute == 1)))
+	{
+		fprintf(stderr, "--benchmark can't be used with --batch, --profile or --precompute.\n");
+		isValid = 0;
+	}
+
+	/* Only a whole tree of earliest arrivals can be shared between destinations. A leg limit
+	or the precomputed table only give the flights to the one destination asked for. */
+	if ((isValid == 1) && (options->cacheSize > 0)
+		&& ((options->maxLegs > 0) || (options->precompute == 1)))
+	{
+		fprintf(stderr, "--cache can't be used with --max-legs or --precompute.\n");
+		isValid = 0;
+	}
+
+	// Arrive-by queries have a search of their own, for one start time at a time.
+	if ((isValid == 1) && (options->arriveBy == 1)
+		&& ((options->engine != kDijkstraEngine) || (options->singlePair == 1)
+		|| (options->profileQueries == 1) || (options->precompute == 1)
+		|| (options->cacheSize > 0) || (options->benchmarkSizes != NULL)))
+	{
+		fprintf(stderr, "--arrive-by can't be used with --engine, --single-pair, --profile, "
+			"--precompute, --cache or --benchmark.\n");
+		isValid = 0;
+	}
+
+	/* Pareto queries have a search of their own too, and list several plans where the others
+	give one. */
+	if ((isValid == 1) && (options->pareto == 1)
+		&& ((options->engine != kDijkstraEngine) || (options->singlePair == 1)
+		|| (options->profileQueries == 1) || (options->precompute == 1)
+		|| (options->cacheSize > 0) || (options->benchmarkSizes != NULL)
+		|| (options->arriveBy == 1)))
+	{
+		fprintf(stderr, "--pareto can't be used with --engine, --single-pair, --profile, "
+			"--precompute, --cache, --benchmark or --arrive-by.\n");
+		isValid = 0;
+	}
+
+	/* A* stops at the destination too, and transfer patterns only fly the destination's
+	patterns, so their trees can't be shared either. */
+	if ((isValid == 1) && ((options->engine == kAStarEngine) || (options->engine == kTransferEngine))
+		&& (options->cacheSize > 0))
+	{
+		fprintf(stderr, "--cache can't be used with --engine astar or transfer.\n");
+		isValid = 0;
+	}
+
+	/* Stopping at the destination leaves the rest of the tree unfinished, so it can't be
+	cached for other destinations. */
+	if ((isValid == 1) && (options->singlePair == 1)
+		&& ((options->engine != kDijkstraEngine) || (options->profileQueries == 1)
+		|| (options->precompute == 1) || (options->cacheSize > 0)))
+	{
+		fprintf(stderr, "--single-pair only works with --engine dijkstra, and can't be used with "
+			"--profile, --precompute or --cache.\n");
+		isValid = 0;
+	}
+
+	// A server takes its queries from the socket, and runs until it is stopped.
+	if ((isValid == 1) && (options->serverSocket != NULL)
+		&& ((options->batchFile != NULL) || (options->benchmarkSizes != NULL)))
+	{
+		fprintf(stderr, "--serve can't be used with --batch or --benchmark.\n");
+		isValid = 0;
+	}
+
+	/* Updates change the timetable between batch queries. The connection list, transfer
+	patterns, arrival index and profile table are all built from it at startup, and would go
+	stale. */
+	if ((isValid == 1) && (options->liveUpdates == 1)
+		&& ((options->batchFile == NULL) || (options->engine == kConnectionScanEngine)
+		|| (options->engine == kTransferEngine) || (options->arriveBy == 1)
+		|| (options->profileQueries == 1) || (options->precompute == 1)))
+	{
+		fprintf(stderr, "--updates needs --batch, and can't be used with --engine csa or transfer, "
+			"--arrive-by, --profile or --precompute.\n");
+		isValid = 0;
+	}
+
+#ifndef SEARCH_COUNTERS
+	// Counting is compiled out of a normal build, so there would be nothing to report.
+	if ((isValid == 1) && (options->searchCounters != kNoCounters))
 	{
-		fastestFlightPlan[stepsReversed] = backwardsFlightPlan[stepsTaken - stepsReversed];
+		fprintf(stderr, "--counters needs a build with SEARCH_COUNTERS defined.\n");
+		isValid = 0;
 	}
+#endif
+
+	// Binary records only hold single plans, and benchmarks write their own text.
+	if ((isValid == 1) && (options->outputFormat == kBinaryOutput)
+		&& ((options->profileQueries == 1) || (options->pareto == 1)
+		|| (options->liveUpdates == 1) || (options->searchCounters == kQueryCounters)
+		|| (options->benchmarkSizes != NULL)))
+	{
+		fprintf(stderr, "--format binary can't be used with --profile, --pareto, --updates, "
+			"--counters query or --benchmark.\n");
+		isValid = 0;
+	}
+
+	// A benchmark only reports on each size as a whole.
+	if ((isValid == 1) && (options->benchmarkSizes != NULL)
+		&& (options->searchCounters == kQueryCounters))
+	{
+		fprintf(stderr, "--benchmark can only be used with --counters total.\n");
+		isValid = 0;
+	}
+
+	return isValid;
+}
+
+
+
+/*
+* Function:			printUsage()
+* Description:		Prints the command line options.
+* Parameters:		const char* programName		The name the program was run as.
+*/
+void printUsage(const char* programName)
+{
+	fprintf(stderr, "Usage: %s [options] [timetable.csv]\n", programName);
+	fprintf(stderr, "  --engine <name>    The search engine to use:\n");
+	fprintf(stderr, "                       dijkstra  Time-dependent Dijkstra (default).\n");
+	fprintf(stderr, "                       csa       Connection scan.\n");
+	fprintf(stderr, "                       raptor    Round-based, one round per flight taken.\n");
+	fprintf(stderr, "                       astar     Dijkstra aimed at the destination (A*).\n");
+	fprintf(stderr, "                       transfer  Transfer patterns between hubs, found for\n");
+	fprintf(stderr, "                                 every origin at startup (on --threads\n");
+	fprintf(stderr, "                                 threads).\n");
+	fprintf(stderr, "  --landmarks <n>    Landmarks for astar's lower bounds (default 8).\n");
+	fprintf(stderr, "  --transfer-hubs <n>\n");
+	fprintf(stderr, "                     Hubs for transfer: the n airports with the most flights out\n");
+	fprintf(stderr, "                     (default those with twice the average).\n");
+	fprintf(stderr, "  --max-legs <n>     Use at most n flights (raptor and --pareto only).\n");
+	fprintf(stderr, "  --arrive-by        Take each time as when to be at the destination, and find\n");
+	fprintf(stderr, "                     the latest start from the origin that gets there by then.\n");
+	fprintf(stderr, "  --pareto           List every plan that arrives sooner by taking more flights,\n");
+	fprintf(stderr, "                     keeping to each airport's minimum connection time.\n");
+	fprintf(stderr, "  --profile          List every departure worth taking over the next 24 hours,\n");
+	fprintf(stderr, "                     instead of the one plan from the start time.\n");
+	fprintf(stderr, "  --precompute       Find every airport's profile at startup, and answer each\n");
+	fprintf(stderr, "                     query from that table instead of searching. For up to\n");
+	fprintf(stderr, "                     about 5,000 airports.\n");
+	fprintf(stderr, "  --single-pair      Stop each search once the destination is reached, instead\n");
+	fprintf(stderr, "                     of mapping every airport (dijkstra only).\n");
+	fprintf(stderr, "  --cache <n>        Keep the results of the last n searches, for other queries\n");
+	fprintf(stderr, "                     from the same origin and start time.\n");
+	fprintf(stderr, "  --date <date>      Travel on this date, as YYYY-MM-DD (default today). Sets\n");
+	fprintf(stderr, "                     which airports are on daylight saving time.\n");
+	fprintf(stderr, "  --batch <file>     Answer the queries in file (- for stdin) without the menu.\n");
+	fprintf(stderr, "                     Each line is: origin destination HHMM\n");
+	fprintf(stderr, "  --serve <path>     Answer queries like --batch's on a Unix socket at path until\n");
+	fprintf(stderr, "                     stopped, one result line per query line (Linux only).\n");
+	fprintf(stderr, "  --updates          Also take batch lines that change a flight, for the queries\n");
+	fprintf(stderr, "                     after them: delay origin destination HHMM minutes, or\n");
+	fprintf(stderr, "                     cancel origin destination HHMM.\n");
+	fprintf(stderr, "  --format <name>    Batch and benchmark output: json (JSON lines, default) or tsv.\n");
+	fprintf(stderr, "                     Batch and server results may also be binary records.\n");
+	fprintf(stderr, "  --benchmark <list> Time random queries on made-up hub-and-spoke networks with\n");
+	fprintf(stderr, "                     each number of airports in the list, e.g. 10,1000,100000.\n");
+	fprintf(stderr, "                     Writes one result per size, in the --format given.\n");
+	fprintf(stderr, "  --queries <n>      Queries to time for each size (default 1000).\n");
+	fprintf(stderr, "  --hubs <n>         Hubs in each network (default 0, one per 25 airports).\n");
+	fprintf(stderr, "  --legs <n>         Hubs each other airport flies to (default 2).\n");
+	fprintf(stderr, "  --departures <n>   Flights a day on each leg (default 4).\n");
+	fprintf(stderr, "  --timezones <n>    Hours the airports' timezones span (default 8, at most 24).\n");
+	fprintf(stderr, "  --seed <n>         Seed for the networks and queries (default 1).\n");
+	fprintf(stderr, "  --threads <n>      Threads for batch and server queries (default 0, one per core).\n");
+	fprintf(stderr, "  --counters <when>  Report how much work the Dijkstra search did (builds with\n");
+	fprintf(stderr, "                     SEARCH_COUNTERS defined only):\n");
+	fprintf(stderr, "                       query     With each query's result.\n");
+	fprintf(stderr, "                       total     Added up over every query, at the end.\n");
 }
 
 
@@ -2,10 +2,10 @@
 * Filename:				dijkstra_example.h
 * Programmer name:		Colin McMillan
 * First useful version:	2014 November
-* Description:			The header file for use with dijkstra_example.c. Contains all the constants, 
+* Description:			The header file for use with dijkstra_example.c. Contains all the constants,
 *						typedefines/structs, and prototypes for use with the Amazing Race flight
-*						planner program. Specifically, it has the listing of the seven airports 
-*						available for use, along with all outgoing flights from those airports.
+*						planner program. The airports and flights themselves are no longer listed
+*						here; they are loaded from a timetable file at runtime (see timetable.c).
 */
 
 
@@ -14,51 +14,102 @@
 
 // Standard headers
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+
+// getch() comes from conio.h on Windows. Elsewhere, wait for the Enter key instead.
+#ifdef _WIN32
 #include <conio.h>
+#else
+#define getch getchar
+#endif
+
+// Threads come from the Windows API on Windows, and from pthreads elsewhere.
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 
 
 
 // Constants
 
 // - Array size constants
-/* Used to define the size of arrays where the index number corresponds to a particular city.
-Is equal to the number of cities + 1, with the 0 index generally being blank.*/
-#define kCityIndex 8
-#define kLastCity 7
-
-// The maximum number of flights a given airport can have to a given destination
-#define kMaxFlightsToDestination 17	
-#define kCityNameMax 12
-
-// - Index constants. Used when defining the airport constants.
-#define kToronto 1
-#define kAtlanta 2
-#define kAustin 3
-#define kSantaFe 4
-#define kDenver 5
-#define kChicago 6
-#define kBuffalo 7
-
-// - Menu/City identifier constants
-const int kExitMenu = 0;
-const int kTorontoID = kToronto;
-const int kAtlantaID = kAtlanta;
-const int kAustinID = kAustin;
-const int kSantaFeID = kSantaFe;
-const int kDenverID = kDenver;
-const int kChicagoID = kChicago;
-const int kBuffaloID = kBuffalo;
-
-// - Timezone offset constants (in reference to UTC)
-const int kMSToffset = -7;		// The timezone offset for Denver and Santa Fe.
-const int kCSToffset = -6;		// The timezone offset for Austin and Chicago.
-const int kESToffset = -5;		// The timezone offset for Toronto, Atlanta, and Buffalo.
+// The longest airport name (including the terminating null) a timetable can use.
+#define kAirportNameMax 32
+// The longest timezone name (including the terminating null), e.g. "EST" or "UTC+5:30".
+#define kTimezoneNameMax 12
+// The longest line the timetable loader will read.
+#define kTimetableLineMax 256
+// The search arrays start on a cache line boundary, so a leg's run of times shares as few lines
+// as possible.
+#define kCacheLineSize 64
+
+// The timetable loaded when no file is given on the command line.
+#define kDefaultTimetableFile "timetable.csv"
+
+// - Menu identifier constants
+static const int kExitMenu = 0;
+
+// - Search engine identifiers, chosen with the --engine command line option.
+#define kDijkstraEngine 0			// mapEarliestArrivals()
+#define kConnectionScanEngine 1		// scanConnections()
+#define kRaptorEngine 2				// raptorEarliestArrivals()
+#define kAStarEngine 3				// astarEarliestArrivals()
+#define kTransferEngine 4			// transferEarliestArrivals()
+
+// - Search tuning constants
+// Runs of departures this short are scanned by firstFlightAfter(), not bisected.
+#define kFlightScanWidth 32
+// Each array in a QueryScratch's arena starts on a cache line of its own.
+#define kArenaAlignment 64
+
+// The landmarks the A* engine takes its lower bounds from, unless --landmarks says otherwise.
+#define kDefaultLandmarkCount 8
+// Airports with this many times the average flights out are the transfer pattern engine's hubs.
+#define kTransferHubFactor 2.0
+// The most pairs of airports the precomputed profile table will take (see profileTableFits()).
+#define kProfileTablePairLimit 25000000.0
+
+// - Batch execution constants
+#define kBatchBlockLines 256		// Queries handed to a batch worker at a time.
+#define kBatchBlocksPerThread 4		// Blocks in flight per worker, so none of them wait.
+
+// - Batch output formats, chosen with the --format command line option.
+#define kJSONOutput 0		// One JSON object per line.
+#define kTSVOutput 1		// Tab separated values, with a header row.
+#define kBinaryOutput 2		// Little-endian 32-bit fields, one record per result (serializer.c).
+
+/* The most bytes an itinerary's output takes for each flight, and once more for the rest of it,
+besides its airports' names (see writeItinerary()). */
+#define kItineraryFixedBytes 256
+
+// - Search counter reports, chosen with the --counters command line option.
+#define kNoCounters 0		// Don't report the search counters.
+#define kQueryCounters 1	// Report each query's counters with its result.
+#define kTotalCounters 2	// Report the counters added up over every query, to stderr.
+// The TSV header for the columns writeSearchCounters() writes.
+#define kSearchCounterColumns "\tairports_settled\tlegs_relaxed\tsoonest_arrival_calls" \
+	"\tflights_scanned\tday_wraps\timprovements\tplan_flights"
+
+// - Daylight saving time rules, given for each airport in the timetable file.
+#define kNoDaylightSaving 0		// "none": the airport stays on standard time all year.
+#define kUSDaylightSaving 1		// "us": second Sunday in March to first Sunday in November.
+#define kEUDaylightSaving 2		// "eu": last Sunday in March to last Sunday in October.
 
 // - Time conversion constants
-const int kMinutesPerHour = 60;
-const int kHoursPerDay = 24;
-const int kMinutesPerDay = 60 * 24;
+static const int kMinutesPerHour = 60;
+static const int kHoursPerDay = 24;
+static const int kMinutesPerDay = 60 * 24;
+// The longest calendar a timetable can have, and the one used if it gives operating days but no
+// calendar (from the travel date on).
+#define kServiceDaysMax 731
+#define kServiceDaysDefault 366
+// The arrivalMinutes[] of a cancelled flight (see cancelFlight()): later than any real landing.
+static const int kCancelledArrival = INT_MAX / 2;
 
 
 
@@ -69,21 +120,308 @@ typedef struct
 {
 	int originCity;			// The cityID for the city the flight starts from.
 	int destinationCity;	// The cityID for the city the flight ends at.
-	int departureTime;		// The time the flight leaves, in originCity local time (HHMM format).
-	int flightDuration;		// The duration of the flight, in HHMM format.
+	int departureTime;		// When the flight leaves, in minutes after midnight UTC.
+	int flightDuration;		// How long the flight takes, in minutes.
+	int serviceID;			// Which row of the timetable's serviceDays[] says what days it runs.
 } Flight;
 
 typedef struct
 {
-	/* An array of ints. 0 at a given index indicates that the city has no connection
-	to the city having the cityID == index. Non-zero indicates that at least one
-	connecting flight exists. */
-	char flightConnections[kCityIndex];
-	/* A multidimensional array of flights. The first index indicates which airport
-	it flies to, and the second index points to individual flights.
-	*/
-	Flight flightList[kCityIndex][kMaxFlightsToDestination];
-} Airport;
+	char name[kAirportNameMax];				// The airport's name, as printed to the user.
+
+	/* The airport's timezone on the travel date, which every search and printout uses. With a
+	calendar, other dates can be on other clocks (see timezoneOffsetAt()). */
+	char timezoneName[kTimezoneNameMax];	// The timezone's name, e.g. "EST" or "EDT".
+	int timezoneOffset;						// The offset from UTC, in minutes.
+
+	// The timezone's rules, for working out the two fields above for a date.
+	char standardName[kTimezoneNameMax];	// The name on standard time, e.g. "EST".
+	char daylightName[kTimezoneNameMax];	// The name on daylight saving time, e.g. "EDT".
+	int standardOffset;						// The standard offset from UTC, in minutes.
+	int daylightRule;						// When clocks go forward, e.g. kUSDaylightSaving.
+
+	int minimumConnection;					// Minutes needed to change flights here (--pareto).
+} AirportInfo;
+
+/* The loaded flight network, stored in compressed sparse row form. Airports are numbered
+from 1 to airportCount, with the 0 index being blank.
+A "leg" is every flight from one airport to one other airport. The legs leaving airport a
+are legOffsets[a] up to (but not including) legOffsets[a + 1], and the flights on leg l are
+departures[departureOffsets[l]] up to departures[departureOffsets[l + 1]], sorted by
+departure time in UTC.
+A flight's index in departures[] is its flight ID. The search data is kept apart from the
+Flight structs, in parallel arrays indexed by flight ID (structure of arrays), so a search
+reads one leg's times as a short contiguous run and only touches departures[] for the flight
+it picks. */
+typedef struct
+{
+	int airportCount;			// The number of airports. The highest cityID.
+	int legCount;				// The number of origin/destination pairs with flights.
+	int flightCount;			// The number of flights.
+
+	AirportInfo* airports;		// [airportCount + 1] The name and timezone of each airport.
+	int* legOffsets;			// [airportCount + 2] The first leg leaving each airport.
+	int* legDestinations;		// [legCount] The cityID each leg flies to.
+	int* departureOffsets;		// [legCount + 1] The first flight on each leg.
+	Flight* departures;			// [flightCount] Every flight, grouped by leg.
+
+	/* Search data for each flight in departures[], precomputed so that soonestArrival()
+	does no HHMM or timezone arithmetic. Times are in minutes after midnight UTC. Each array
+	starts on a kCacheLineSize boundary. */
+	int* departureMinutes;		// [flightCount] When the flight leaves, 0 up to kMinutesPerDay.
+	int* arrivalMinutes;		// [flightCount] When the flight lands. May be past midnight.
+	/* [flightCount] The flight ID, from this flight to the last flight on the same leg, that
+	lands soonest. The earliest-leaving flight wins a tie. */
+	int* soonestOnwardFlight;
+
+	/* The days each flight runs, for a timetable with a calendar (see isServiceDay()). Without
+	one, serviceDayCount is 0 and every flight runs every day. Calendar day d is a UTC day, as
+	the travel date's clocks put the flight on it, and a flight leaves on it if bit d % 32 of
+	word d / 32 of its row of serviceDays[] is set. Rows are shared by flights that run on the
+	same days. */
+	int serviceDayCount;		// The days in the calendar. 0 for a timetable without one.
+	int serviceWords;			// The words in each row of days.
+	int firstServiceDay;		// The calendar day of the searches' day 0 (the travel date).
+	unsigned int* serviceDays;	// [rows * serviceWords] Each distinct set of days flights run.
+	int* flightServices;		// [flightCount] Each flight's serviceID, next to its times.
+	unsigned int* legServiceDays;	// [legCount * serviceWords] The days any flight on a leg runs.
+	/* [serviceDayCount] For each calendar day, bit r is set if daylight saving rule r has the
+	clocks forward on that day's date. Every time above is on the clocks of the travel date, so
+	on a date its origin's clocks are set differently, a flight leaves an hour off its time
+	(see departureShift()). */
+	unsigned char* daylightDays;
+
+	/* An open-addressing hash table of cityIDs, for looking airports up by name. 0 marks an
+	empty slot. Its size is a power of two, and it is kept at most half full. */
+	int* airportNameTable;
+	int airportNameTableSize;
+} Timetable;
+
+/* One flight, as seen by the connection scan engine. Times are minutes since midnight UTC,
+with departureTime always within the first day. */
+typedef struct
+{
+	int departureTime;		// When the flight leaves, 0 up to kMinutesPerDay.
+	int arrivalTime;		// When the flight lands. May be past midnight.
+	int originCity;			// The cityID the flight leaves from.
+	int destinationCity;	// The cityID the flight lands at.
+	int flight;				// The flight's index in the timetable's departures[].
+} Connection;
+
+// The shape of a made-up hub-and-spoke network, for benchmarks (see generateTimetable()).
+typedef struct
+{
+	int airportCount;			// The number of airports, hubs included.
+	int hubCount;				// The number of hubs. 0 for one per 25 airports.
+	int legsPerAirport;			// How many hubs each other airport has flights to and from.
+	int departuresPerLeg;		// How many flights a day fly each leg.
+	int timezoneSpread;			// How many hours apart the airports' timezones range over.
+	unsigned int seed;			// The same seed always gives the same network.
+} GeneratorSettings;
+
+/* One delay or cancellation, as applied to the timetable (see delayFlight() and cancelFlight()).
+A delayed flight is moved to its new place among the leg's flights, and the flights between its
+old and new places each move one place the other way. */
+typedef struct
+{
+	int leg;					// The leg the flight is on.
+	int oldFlight;				// The flight's ID before the change.
+	int newFlight;				// The flight's ID after it. The same, for a cancellation.
+	int isCancelled;			// 1 if the flight was cancelled, 0 if it was delayed.
+} FlightUpdate;
+
+// The settings given on the command line.
+typedef struct
+{
+	const char* timetableFile;	// The timetable to load.
+	int engine;					// Which search engine answers queries, e.g. kDijkstraEngine.
+	int maxLegs;				// The most flights a plan may use (RAPTOR, Pareto). 0 for no limit.
+	const char* batchFile;		// Queries to answer without the menu ("-" for stdin), or NULL.
+	const char* serverSocket;	// Unix socket to answer queries on until stopped, or NULL.
+	int outputFormat;			// How batch results are written, e.g. kJSONOutput.
+	int threadCount;			// How many threads answer batch queries. 0 for one per core.
+	int profileQueries;			// 1 to list every departure over a day, instead of one start time.
+	int precompute;				// 1 to answer queries from a table built when the program starts.
+	int cacheSize;				// How many searches' results to keep for reuse. 0 for none.
+	int singlePair;				// 1 to stop each search at the destination (Dijkstra only).
+	int landmarkCount;			// How many landmarks the A* engine's lower bounds come from.
+	int transferHubCount;		// How many hubs the transfer pattern engine uses. 0 to choose.
+	int arriveBy;				// 1 if query times are deadlines at the destination.
+	int pareto;					// 1 to list every plan trading more flights for sooner arrival.
+	int liveUpdates;			// 1 to take delay and cancel lines in the batch, between queries.
+	const char* benchmarkSizes;	// Airport counts to benchmark, e.g. "10,1000", or NULL.
+	int benchmarkQueries;		// How many random queries to time for each size.
+	GeneratorSettings generator;	// The networks to benchmark.
+	int searchCounters;			// How to report the search counters, e.g. kQueryCounters.
+	int travelDate;				// The day the timezones are taken from (see dateAsDayNumber()).
+} ProgramOptions;
+
+// Portable wrappers around the platform's threads (see threads.c).
+#ifdef _WIN32
+typedef HANDLE WorkerThread;
+typedef CRITICAL_SECTION WorkerLock;
+typedef CONDITION_VARIABLE WorkerSignal;
+#else
+typedef pthread_t WorkerThread;
+typedef pthread_mutex_t WorkerLock;
+typedef pthread_cond_t WorkerSignal;
+#endif
+
+// How well the arrival cache (see cache.c) is doing.
+typedef struct
+{
+	long long hits;				// Searches answered from the cache.
+	long long misses;			// Searches that had to be run.
+	long long evictions;		// Results dropped to make room for newer ones.
+} ArrivalCacheCounts;
+
+/* A cached earliest-arrival tree, as repairArrivals() works on it. Each array has an entry
+per cityID. The airports reached from each airport are listed through firstChildren[],
+nextSiblings[] and previousSiblings[], so a tree can be walked, or part of it taken out,
+without going through every airport. Ground times and previous siblings are only kept for
+live updates; without them, both are NULL. */
+typedef struct
+{
+	int originAirport;				// The tree's origin.
+	int startTime;					// The tree's start time, in minutes since local midnight.
+	const Flight** arrivals;		// The flight into each airport, or NULL if it isn't reached.
+	int* groundTimes;				// When each airport is reached, in UTC minutes, or INT_MAX.
+	int* firstChildren;				// The first airport reached from each airport, or 0.
+	int* nextSiblings;				// The next airport reached from the same one, or 0.
+	int* previousSiblings;			// The airport before it in the same list, or 0.
+} ArrivalTree;
+
+/* How much work the Dijkstra search did (see counters.c). Only counted in a build with
+SEARCH_COUNTERS defined; otherwise every count stays 0. */
+typedef struct
+{
+	long long airportsSettled;		// Airports taken from the heap and expanded.
+	long long legsRelaxed;			// Legs out of a settled airport checked for a sooner arrival.
+	long long soonestArrivalCalls;	// Calls to soonestArrival().
+	long long flightsScanned;		// Departure times compared in firstFlightAfter()'s searches.
+	long long dayWraps;				// Soonest arrivals that meant waiting for the next day.
+	long long improvements;			// Sooner arrivals found, each moving an airport up the heap.
+	long long planFlights;			// Flights walked back by createFastestFlightplan().
+} SearchCounters;
+
+// A block of text that grows as it is written to. Reused, so it only grows when it must.
+typedef struct
+{
+	char* text;				// The text written so far. Not null-terminated.
+	size_t length;			// The number of characters written.
+	size_t capacity;		// The allocated size of text.
+} OutputBuffer;
+
+typedef struct
+{
+	int size;				// The number of airports currently waiting in the heap.
+	/* A binary min-heap of cityIDs, ordered by their earliestGroundTime. [0] is the
+	airport with the earliest time. */
+	int* airports;
+	/* The heap slot holding each cityID, or -1 if that airport is not in the heap.
+	Lets an airport's position be found directly when its time improves. */
+	int* position;
+} AirportHeap;
+
+/* One option in a profile: leave the origin at departureTime and be at the destination by
+arrivalTime, both in minutes since midnight UTC of the first day. An airport's entries are
+chained through next, from the earliest departure to the latest; each one leaves later and
+arrives later than the one before it, so none is ever a worse choice than another. */
+typedef struct
+{
+	int departureTime;				// When the first flight leaves the origin.
+	int arrivalTime;				// The earliest arrival at the destination leaving then.
+	const Flight* firstFlight;		// The flight out of the origin to take.
+	int next;						// The index of the airport's next entry, or -1 after the last.
+	int airport;					// The destination the entry is for.
+} ProfileEntry;
+
+/* One option from a Pareto query: reach the destination with flightCount flights by
+arrivalTime, in minutes since midnight UTC of the first day. */
+typedef struct
+{
+	int flightCount;				// The number of flights the plan uses.
+	int arrivalTime;				// The earliest arrival at the destination with that many.
+} ParetoOption;
+
+/* The working memory for answering one query at a time, sized for the loaded timetable.
+Every array has one entry per cityID, with index 0 blank. Searches only use what they need,
+and leave the rest alone. Reused from query to query, so queries don't allocate.
+The per-airport arrays are all carved out of one block, the arena, allocated once. */
+typedef struct
+{
+	int airportCount;					// The number of airports the arrays are sized for.
+	char* arena;						// The block the per-airport arrays are carved from.
+
+	/* The search that last reached each airport: stamped generation when reached, and
+	generation + 1 once settled. An airport's groundTimes, estimatedArrivals and lastRounds
+	only mean something if it carries one of the current search's stamps, so a new search
+	starts a new generation instead of clearing them. A repair (updates) stamps the airports
+	it takes out of a tree. */
+	unsigned int* airportStamps;
+	unsigned int generation;			// The current search's reached stamp. Never 0.
+
+	/* The airports given an entry in earliestArrivals since it was last cleared, so that
+	clearQueryResults() only needs to clear those. reachedCount is -1 when the entries
+	could be anywhere, which means clearing them all. */
+	int* reachedAirports;
+	int reachedCount;
+
+	const Flight** earliestArrivals;	// The search result: the best flight into each airport.
+	const Flight** flightPlan;			// The flight plan to the destination, ending in NULL.
+	const Flight** latestDepartures;	// The best flight out of each airport (arrive-by).
+
+	int* groundTimes;					// The earliest time each airport can be reached.
+	int* scanGroundTimes;				// The same for the connection scan. INT_MAX between sweeps.
+	char* airportFlags;					// Settled (arrive-by).
+	AirportHeap heap;					// The unsettled airports (Dijkstra).
+	int* estimatedArrivals;				// Ground time plus time left to the destination (A*).
+
+	int* markedAirports;				// The airports to scan this round (RAPTOR).
+	int* nextMarkedAirports;			// The airports to scan next round (RAPTOR).
+	int* lastRounds;					// The last round to improve each airport (RAPTOR).
+	int* improvedAirports;				// Every airport a round has improved (RAPTOR).
+	int improvedCount;					// The number of improvedAirports.
+
+	/* Each round's arrival at each airport, the flight taken there, and the round before it
+	that last improved the airport, or -1 (RAPTOR). Only an airport's entries for the rounds
+	that improved it are filled in. */
+	int* roundArrivals;
+	int* roundFlights;
+	int* roundLinks;
+	int roundsAllocated;				// The number of rounds the three arrays above can hold.
+
+	/* Each airport's first ProfileEntry, or -1, and the best arrival from any later departure
+	(profiles). Only the airports in the last profile's entries are ever set, so the next
+	profile puts back just those. */
+	int* profileHeads;
+	int* profileArrivals;
+	ProfileEntry* profileEntries;		// Every airport's profile entries (profiles).
+	int profileEntryCount;				// The number of profileEntries in use.
+	int profileEntriesAllocated;		// The number of profileEntries there's room for.
+
+	ParetoOption* paretoOptions;		// The destination's options, fewest flights first (Pareto).
+	int paretoOptionCount;				// The number of paretoOptions found.
+
+	SearchCounters searchTotals;		// The search counters added up over every query.
+} QueryScratch;
+
+
+
+/* Search counters are kept per thread, so the searches on different threads never share a
+cache line. Counting compiles to nothing unless SEARCH_COUNTERS is defined (e.g. with
+-DSEARCH_COUNTERS, or /D SEARCH_COUNTERS in Visual Studio). */
+#ifdef SEARCH_COUNTERS
+#ifdef _WIN32
+#define kThreadLocal __declspec(thread)
+#else
+#define kThreadLocal __thread
+#endif
+extern kThreadLocal SearchCounters threadSearchCounters;
+#define countSearch(counter, amount) (threadSearchCounters.counter += (amount))
+#else
+#define countSearch(counter, amount) ((void)0)
+#endif
 
 
 
@@ -92,369 +430,185 @@ typedef struct
 int timeAsMinutes(int timeInHHMM);
 int timeAsHHMM(int timeInMinutes);
 int timezoneOffset(int cityID);
-int timezoneDifference(int originCity, int destinationCity);
-const Airport* airportDirectory(int cityID);
+int timezoneOffsetAt(int cityID, int timeUTC);
+int isDaylightTime(int cityID, int localTime);
+int dateAsDayNumber(int year, int month, int day);
+int todayAsDayNumber(void);
 void displayCityList(int skipNumber);
 void printAirportName(int airportNumber);
 void printTime(int timeInMinutes);
 void printClockTime(int timeInMinutes, int cityID);
-void printItinerary(int origin, int destination, const int startTime, 
-	const Flight* flightPlan[kCityIndex]);
+void printItinerary(int origin, int destination, const int startTime,
+	const Flight* flightPlan[]);
+void printProfile(int origin, int destination, const int startTime, const QueryScratch* scratch);
+void printParetoOptions(int origin, int destination, const int startTime, QueryScratch* scratch);
+void printCacheCounts(const ProgramOptions* options);
+void printSearchCounters(const SearchCounters* counters);
 
 int getMenuChoice(int minValue, int maxValue, char prompt[], char invalidResponse[]);
-int getHHMMTime(void);
+int getHHMMTime(const char prompt[]);
 void waitForKey(void);
 
-int soonestArrival(const int startTime, int origin, int destination, const Flight** soonestArrival);
-void mapEarliestArrivals(const int startTimeInMinutes, int originAirport, 
-	const Flight* earliestArrivals[kCityIndex]);
+int soonestArrival(const int startTime, int leg, const Flight** soonestArrival);
+int soonestServiceArrival(int startTime, int leg, const Flight** soonestArrival);
+int firstFlightAfter(const int departureMinutes[], int firstFlight, int lastFlight, int time);
+int lowestSetBit(int mask);
+int nextDepartureUTC(const Flight* flight, int earliestTime);
+int dayOfTime(int timeInMinutes);
+void mapEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	int targetAirport, const Flight* earliestArrivals[]);
 void createFastestFlightplan(int originAirport, int destinationAirport,
-	const Flight* earliestArrivals[kCityIndex], const Flight* fastestFlightPlan[kLastCity]);
-
+	const Flight* earliestArrivals[], const Flight* fastestFlightPlan[]);
+int initQueryScratch(QueryScratch* scratch);
+void freeQueryScratch(QueryScratch* scratch);
+void clearQueryResults(QueryScratch* scratch);
+int beginReachedList(QueryScratch* scratch, const Flight* earliestArrivals[]);
+size_t reserveArenaBytes(size_t* arenaSize, size_t bytes);
+unsigned int startSearchGeneration(QueryScratch* scratch);
+int initAirportHeap(AirportHeap* heap, int airportCount);
+void freeAirportHeap(AirportHeap* heap);
+void pushAirport(AirportHeap* heap, int cityID, const int groundTimes[]);
+int popEarliestAirport(AirportHeap* heap, const int groundTimes[]);
+void emptyAirportHeap(AirportHeap* heap);
+
+void findEarliestArrivals(const ProgramOptions* options, QueryScratch* scratch,
+	const int startTimeInMinutes, int originAirport, int destinationAirport,
+	const Flight* earliestArrivals[]);
+
+int parseArguments(int argc, char* argv[], ProgramOptions* options);
+void printUsage(const char* programName);
 int checkRange(int checkInt, int minValue, int maxValue);
 int getNum(void);
 
-
-
-
-// Airport listings
-const Airport kTorontoAirport =
-{
-	// Connections checklist: Atlanta (2), Denver (5), and Chicago (6).
-	{ 0, 0, kAtlanta, 0, 0, kDenver, kChicago, 0 },
-
-	// Flight list
-	{
-		// Empty space for 0 index
-		{ 0 },
-		// To Toronto
-		{ 0 },
-		// To Atlanta
-		{
-			{ kToronto, kAtlanta, 625, 220 },
-			{ kToronto, kAtlanta, 910, 450 },
-			{ kToronto, kAtlanta, 1230, 415 },
-			{ kToronto, kAtlanta, 1610, 610 },
-			{ kToronto, kAtlanta, 2000, 215 },
-		},
-		// To Austin
-		{ 0 },
-		// To Santa Fe
-		{ 0 },
-		// To Denver
-		{
-			{ kToronto, kDenver, 730, 335 },
-			{ kToronto, kDenver, 1500, 600 },
-		},
-		// To Chicago
-		{
-			{ kToronto, kChicago, 640, 120 },
-
-			{ kToronto, kChicago, 740, 135 },
-			{ kToronto, kChicago, 840, 135 },
-			{ kToronto, kChicago, 940, 135 },
-			{ kToronto, kChicago, 1040, 135 },
-			{ kToronto, kChicago, 1140, 135 },
-			{ kToronto, kChicago, 1240, 135 },
-			{ kToronto, kChicago, 1340, 135 },
-			{ kToronto, kChicago, 1440, 135 },
-
-			{ kToronto, kChicago, 1530, 145 },
-			{ kToronto, kChicago, 1630, 145 },
-			{ kToronto, kChicago, 1730, 145 },
-			{ kToronto, kChicago, 1830, 145 },
-			{ kToronto, kChicago, 1930, 145 },
-
-			{ kToronto, kChicago, 2100, 130 },
-			{ kToronto, kChicago, 2200, 115 },
-		},
-		// To Buffalo
-		{ 0 }
-	}
-};
-
-
-const Airport kAtlantaAirport =
-{
-	// Connections checklist: Toronto(1), Austin(3), Denver(5), Chicago(6).
-	{ 0, kToronto, 0, kAustin, 0, kDenver, kChicago, 0 },
-
-	// Flight list
-	{
-		// Empty space for 0 index
-		{ 0 },
-		// To Toronto
-		{
-			{ kAtlanta, kToronto, 710, 210 },
-			{ kAtlanta, kToronto, 1030, 410 },
-			{ kAtlanta, kToronto, 1500, 350 },
-			{ kAtlanta, kToronto, 1710, 610 },
-			{ kAtlanta, kToronto, 2100, 220 },
-		},
-		// To Atlanta
-		{ 0 },
-		// To Austin
-		{
-			{ kAtlanta, kAustin, 900, 210 },
-			{ kAtlanta, kAustin, 1530, 250 },
-			{ kAtlanta, kAustin, 2000, 230 },
-		},
-		// To Santa Fe
-		{ 0 },
-		// To Denver
-		{
-			{ kAtlanta, kDenver, 600, 300 },
-			{ kAtlanta, kDenver, 1320, 500 },
-			{ kAtlanta, kDenver, 1710, 250 },
-		},
-		// To Chicago
-		{
-			{ kAtlanta, kChicago, 650, 210 },
-
-			{ kAtlanta, kChicago, 750, 300 },
-			{ kAtlanta, kChicago, 850, 300 },
-			{ kAtlanta, kChicago, 950, 300 },
-			{ kAtlanta, kChicago, 1050, 300 },
-			{ kAtlanta, kChicago, 1150, 300 },
-			{ kAtlanta, kChicago, 1250, 300 },
-			{ kAtlanta, kChicago, 1350, 300 },
-			{ kAtlanta, kChicago, 1450, 300 },
-
-			{ kAtlanta, kChicago, 1550, 230 },
-			{ kAtlanta, kChicago, 1650, 230 },
-			{ kAtlanta, kChicago, 1750, 230 },
-			{ kAtlanta, kChicago, 1850, 230 },
-			{ kAtlanta, kChicago, 1950, 230 },
-
-			{ kAtlanta, kChicago, 2030, 210 },
-		},
-		// To Buffalo
-		{ 0 }
-	}
-};
-
-
-const Airport kAustinAirport =
-{
-
-	// Connections checklist: Atlanta (2), SantaFe(4), and Denver(5).
-	{ 0, 0, kAtlanta, 0, kSantaFe, kDenver, 0, 0 },
-
-	// Flight list
-	{
-		// Empty space for 0 index
-		{ 0 },
-		// To Toronto
-		{ 0 },
-		// To Atlanta
-		{
-			{ kAustin, kAtlanta, 910, 220 },
-			{ kAustin, kAtlanta, 1500, 220 },
-			{ kAustin, kAtlanta, 2130, 230 },
-		},
-		// To Austin
-		{ 0 },
-		// To Santa Fe
-		{
-			{ kAustin, kSantaFe, 1700, 55 },
-		},
-		// To Denver
-		{
-			{ kAustin, kDenver, 1030, 220 },
-			{ kAustin, kDenver, 1820, 220 },
-		},
-		// To Chicago
-		{ 0 },
-		// To Buffalo
-		{ 0 }
-	}
-};
-
-
-const Airport kSantaFeAirport =
-{
-
-	// Connections checklist: Austin (3).
-	{ 0, 0, 0, kAustin, 0, 0, 0, 0 },
-
-	// Flight list
-	{
-		// Empty space for 0 index
-		{ 0 },
-		// To Toronto
-		{ 0 },
-		// To Atlanta
-		{ 0 },
-		// To Austin
-		{
-			{ kSantaFe, kAustin, 1500, 45 },
-		},
-		// To Santa Fe
-		{ 0 },
-		// To Denver
-		{ 0 },
-		// To Chicago
-		{ 0 },
-		// To Buffalo
-		{ 0 }
-	}
-};
-
-
-const Airport kDenverAirport =
-{
-
-	// Connections checklist: Toronto (1), Atlanta (2), Austin (3), and Chicago(6).
-	{ 0, kToronto, kAtlanta, kAustin, 0, 0, kChicago, 0 },
-
-	// Flight list
-	{
-		// Empty space for 0 index
-		{ 0 },
-		// To Toronto
-		{
-			{ kDenver, kToronto, 630, 410 },
-			{ kDenver, kToronto, 1030, 520 },
-			{ kDenver, kToronto, 1400, 500 },
-		},
-		// To Atlanta
-		{
-			{ kDenver, kAtlanta, 600, 310 },
-			{ kDenver, kAtlanta, 1300, 320 },
-			{ kDenver, kAtlanta, 1500, 350 },
-		},
-		// To Austin
-		{
-			{ kDenver, kAustin, 1200, 200 },
-			{ kDenver, kAustin, 1500, 220 },
-		},
-		// To Santa Fe
-		{ 0 },
-		// To Denver
-		{ 0 },
-		// To Chicago
-		{
-			{ kDenver, kChicago, 700, 220 },
-
-			{ kDenver, kChicago, 800, 250 },
-			{ kDenver, kChicago, 1000, 250 },
-			{ kDenver, kChicago, 1200, 250 },
-			{ kDenver, kChicago, 1400, 250 },
-			{ kDenver, kChicago, 1600, 250 },
-
-			{ kDenver, kChicago, 1830, 240 },
-		},
-		// To Buffalo
-		{ 0 }
-	}
-};
-
-
-const Airport kChicagoAirport =
-{
-
-	// Connections checklist: Toronto (1), Atlanta (2), Denver(5), and Buffalo(7).
-	{ 0, kToronto, kAtlanta, 0, 0, kDenver, 0, kBuffalo },
-
-	// Flight list
-	{
-		// Empty space for 0 index
-		{ 0 },
-		// To Toronto
-		{
-			{ kChicago, kToronto, 740, 110 },
-
-			{ kChicago, kToronto, 910, 230 },
-			{ kChicago, kToronto, 1010, 230 },
-			{ kChicago, kToronto, 1110, 230 },
-			{ kChicago, kToronto, 1210, 230 },
-			{ kChicago, kToronto, 1310, 230 },
-			{ kChicago, kToronto, 1410, 230 },
-			{ kChicago, kToronto, 1510, 230 },
-			{ kChicago, kToronto, 1610, 230 },
-			{ kChicago, kToronto, 1710, 230 },
-
-			{ kChicago, kToronto, 1910, 200 },
-			{ kChicago, kToronto, 2110, 210 },
-		},
-		// To Atlanta
-		{
-			{ kChicago, kAtlanta, 650, 210 },
-
-			{ kChicago, kAtlanta, 800, 240 },
-			{ kChicago, kAtlanta, 900, 240 },
-			{ kChicago, kAtlanta, 1000, 240 },
-			{ kChicago, kAtlanta, 1100, 240 },
-			{ kChicago, kAtlanta, 1200, 240 },
-			{ kChicago, kAtlanta, 1300, 240 },
-			{ kChicago, kAtlanta, 1400, 240 },
-			{ kChicago, kAtlanta, 1500, 240 },
-			{ kChicago, kAtlanta, 1600, 240 },
-			{ kChicago, kAtlanta, 1700, 240 },
-			{ kChicago, kAtlanta, 1800, 240 },
-			{ kChicago, kAtlanta, 1900, 240 },
-			{ kChicago, kAtlanta, 2000, 240 },
-
-			{ kChicago, kAtlanta, 2150, 300 },
-		},
-		// To Austin
-		{ 0 },
-		// To Santa Fe
-		{ 0 },
-		// To Denver
-		{
-			{ kChicago, kDenver, 900, 210 },
-
-			{ kChicago, kDenver, 1130, 220 },
-			{ kChicago, kDenver, 1330, 220 },
-			{ kChicago, kDenver, 1530, 220 },
-			{ kChicago, kDenver, 1730, 220 },
-
-			{ kChicago, kDenver, 2100, 250 },
-		},
-		// To Chicago
-		{ 0 },
-		// To Buffalo
-		{
-			{ kChicago, kBuffalo, 1100, 200 },
-			{ kChicago, kBuffalo, 1310, 150 },
-			{ kChicago, kBuffalo, 1500, 230 },
-			{ kChicago, kBuffalo, 1800, 210 },
-		}
-	}
-};
-
-
-const Airport kBuffaloAirport =
-{
-
-	// Connections checklist: Chicago(6).
-	{ 0, 0, 0, 0, 0, 0, kChicago, 0 },
-
-	// Flight list
-	{
-		// Empty space for 0 index
-		{ 0 },
-		// To Toronto
-		{ 0 },
-		// To Atlanta
-		{ 0 },
-		// To Austin
-		{ 0 },
-		// To Santa Fe
-		{ 0 },
-		// To Denver
-		{ 0 },
-		// To Chicago
-		{
-			{ kBuffalo, kChicago, 940, 140 },
-			{ kBuffalo, kChicago, 1110, 150 },
-			{ kBuffalo, kChicago, 1740, 240 },
-			{ kBuffalo, kChicago, 2010, 220 },
-		},
-		// To Buffalo
-		{ 0 }
-	}
-};
-
-#endif
\ No newline at end of file
+// - Timetable loading (timetable.c)
+int loadTimetable(const char* fileName, int travelDate);
+void freeTimetable(void);
+const Timetable* flightTimetable(void);
+int findAirport(const char* airportName);
+int generateTimetable(GeneratorSettings* settings);
+int findScheduledFlight(int originAirport, int destinationAirport, int departureTime);
+int delayFlight(int flightID, int delayMinutes, FlightUpdate* update);
+int cancelFlight(int flightID, FlightUpdate* update);
+int isServiceDay(int flightID, int day);
+int isLegServiceDay(int leg, int day);
+int departureShift(int flightID, int day);
+
+// - Live updates (updates.c)
+int initFlightUpdates(void);
+void freeFlightUpdates(void);
+const Flight* movedFlight(const FlightUpdate* update, const Flight* flight);
+int repairArrivals(QueryScratch* scratch, const FlightUpdate* update, ArrivalTree* tree);
+
+// - Connection scan engine (connection_scan.c)
+int buildConnections(void);
+void freeConnections(void);
+void scanConnections(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	const Flight* earliestArrivals[]);
+
+// - Round-based engine (raptor.c)
+void raptorEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	int destinationAirport, int maxLegs, const Flight* earliestArrivals[]);
+int raptorRounds(QueryScratch* scratch, int startTimeUTC, int originAirport, int targetAirport,
+	int maxLegs, int useConnectionTimes);
+int lastImprovingRound(const QueryScratch* scratch, int airport, int round);
+
+// - Pareto queries (pareto.c)
+void paretoEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	int destinationAirport, int maxLegs);
+void createParetoFlightplan(const QueryScratch* scratch, int originAirport,
+	int destinationAirport, const ParetoOption* option, const Flight* flightPlan[]);
+int nextConnectionUTC(const Flight* flight, int groundTime, int isFirstFlight);
+
+// - Goal-directed engine (astar.c)
+int buildLandmarks(int count);
+void freeLandmarks(void);
+void astarEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	int destinationAirport, const Flight* earliestArrivals[]);
+
+// - Transfer pattern engine (transfer_patterns.c)
+int buildTransferPatterns(int hubCount, int threadCount);
+void freeTransferPatterns(void);
+void transferEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes,
+	int originAirport, int destinationAirport, const Flight* earliestArrivals[]);
+
+// - Arrive-by queries (arrive_by.c)
+int buildArrivalIndex(void);
+void freeArrivalIndex(void);
+int findLatestStart(QueryScratch* scratch, const int deadlineInMinutes, int originAirport,
+	int destinationAirport, int* latestStartInMinutes);
+
+// - Profile queries (profile.c)
+int profileEarliestArrivals(QueryScratch* scratch, const int windowStartInMinutes,
+	int originAirport);
+
+// - Precomputed profile table (precompute.c)
+int profileTableFits(void);
+int buildProfileTable(int threadCount);
+void freeProfileTable(void);
+void lookupEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes,
+	int originAirport, int destinationAirport, const Flight* earliestArrivals[]);
+
+// - Arrival cache (cache.c)
+int initArrivalCache(int capacity, int isRepairable);
+void freeArrivalCache(void);
+int findCachedArrivals(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	const Flight* earliestArrivals[]);
+void cacheArrivals(const QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	const Flight* earliestArrivals[]);
+ArrivalCacheCounts arrivalCacheCounts(void);
+int repairCachedArrivals(QueryScratch* scratch, const FlightUpdate* update);
+int nextTreeAirport(const ArrivalTree* tree, int airport, int subtreeRoot);
+void setTreeArrival(ArrivalTree* tree, int airport, const Flight* flight);
+
+// - Search counters (counters.c)
+void resetSearchCounters(void);
+SearchCounters currentSearchCounters(void);
+void addSearchCounters(SearchCounters* total, const SearchCounters* counters);
+void writeSearchCounters(OutputBuffer* output, int format, const SearchCounters* counters);
+
+// - Benchmarks (benchmark.c)
+int runBenchmark(const ProgramOptions* options);
+
+// - Batch queries (batch.c)
+int runBatch(const ProgramOptions* options);
+int answerQueryLine(const ProgramOptions* options, QueryScratch* scratch, char* line,
+	int lineNumber, OutputBuffer* output);
+void writeQueryError(OutputBuffer* output, int format, int lineNumber,
+	const char* errorMessage);
+int appendOutput(OutputBuffer* buffer, const char* format, ...);
+void freeOutputBuffer(OutputBuffer* buffer);
+
+// - Itinerary output (serializer.c)
+int buildAirportLabels(void);
+void freeAirportLabels(void);
+void writeItinerary(OutputBuffer* output, int format, int lineNumber, int originCity,
+	int destinationCity, int startTime, const Flight* flightPlan[],
+	const SearchCounters* counters);
+void writeItineraryText(OutputBuffer* output, int originCity, int destinationCity,
+	const int startTime, const Flight* flightPlan[]);
+void appendAirportJSON(OutputBuffer* output, int cityID);
+void appendBinaryField(OutputBuffer* output, int value);
+int appendBytes(OutputBuffer* buffer, const char* bytes, size_t count);
+
+// - Server mode (server.c)
+int runServer(const ProgramOptions* options);
+
+// - Threads (threads.c)
+int startWorkerThread(WorkerThread* thread, void (*work)(void*), void* argument);
+void joinWorkerThread(WorkerThread thread);
+void initWorkerLock(WorkerLock* lock);
+void freeWorkerLock(WorkerLock* lock);
+void lockWorkers(WorkerLock* lock);
+void unlockWorkers(WorkerLock* lock);
+void initWorkerSignal(WorkerSignal* signal);
+void freeWorkerSignal(WorkerSignal* signal);
+void waitForSignal(WorkerSignal* signal, WorkerLock* lock);
+void sendSignal(WorkerSignal* signal);
+void broadcastSignal(WorkerSignal* signal);
+int processorCount(void);
+int workerThreadCount(int threadCount, int jobCount);
+int runForEachOrigin(int originCount, void* workers, int workerCount, size_t workerSize,
+	int (*work)(void*, int), int* threadsUsed);
+double wallClockSeconds(void);
+
+#endif
@@ -0,0 +1,134 @@
+/*
+* Filename:				pareto.c
+* Description:			Pareto queries for the Amazing Race flight planner. Instead of the one
+*						plan that arrives soonest, these give every plan worth choosing between
+*						when fewer flights matter as well as arriving early: each one uses more
+*						flights than the one before, but arrives sooner for it. A plan that needs
+*						more flights to arrive no sooner is never listed.
+*
+*						The search is the round-based one (raptorRounds()). Round k holds the
+*						earliest arrival at each airport with at most k flights, and only keeps an
+*						arrival that beats every earlier round, so each airport's rounds are its
+*						Pareto bag over (arrival time, flights): no entry is dominated by another.
+*						The destination's bag is the answer. Arrivals no sooner than the
+*						destination's best so far are dropped (target pruning), since they can't
+*						add to its bag.
+*
+*						Unlike the other engines, a Pareto search keeps to each airport's minimum
+*						connection time: a flyer who lands there can't take off again until that
+*						many minutes later. Plans are printed with nextConnectionUTC(), which does
+*						the same.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+/*
+* Function:			paretoEarliestArrivals()
+* Description:		Finds every plan to the destination that no other plan beats on both
+*					arrival time and number of flights, into scratch->paretoOptions, fewest
+*					flights first.
+* Parameters:		QueryScratch* scratch		Working memory for the search.
+*					int startTimeInMinutes		The user's starting time, in the local timezone.
+*					int originAirport			The user's starting airport.
+*					int destinationAirport		The airport to find plans to.
+*					int maxLegs					The most flights a plan may use. 0 for no limit.
+*/
+void paretoEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	int destinationAirport, int maxLegs)
+{
+	int airportCount = flightTimetable()->airportCount;
+	int round = raptorRounds(scratch, startTimeInMinutes - timezoneOffset(originAirport),
+		originAirport, destinationAirport, maxLegs, 1);
+	ParetoOption* options = scratch->paretoOptions;
+	int optionCount = 0;
+
+	/* A round only improves the destination when it beats every earlier round, so each round
+	that improved it adds one option. Those rounds are linked from the last back to the first.
+	A plan never visits an airport twice (the second visit could only be later), so there are
+	never more options than there are airports. */
+	for (int r = lastImprovingRound(scratch, destinationAirport, round - 1);
+		(r >= 1) && (optionCount < airportCount);
+		r = scratch->roundLinks[(size_t)r * (airportCount + 1) + destinationAirport])
+	{
+		options[optionCount].flightCount = r;
+		options[optionCount].arrivalTime =
+			scratch->roundArrivals[(size_t)r * (airportCount + 1) + destinationAirport];
+		optionCount++;
+	}
+
+	// Found most flights first, so turn them around.
+	for (int i = 0; i < optionCount / 2; i++)
+	{
+		ParetoOption swap = options[i];
+		options[i] = options[optionCount - 1 - i];
+		options[optionCount - 1 - i] = swap;
+	}
+
+	scratch->paretoOptionCount = optionCount;
+}
+
+
+
+/*
+* Function:			createParetoFlightplan()
+* Description:		Forms the flight plan for one of the Pareto options, by walking back from
+*					the destination one round at a time.
+* Parameters:		const QueryScratch* scratch		The scratch the search was run in.
+*					int originAirport				The starting airport.
+*					int destinationAirport			The final destination.
+*					const ParetoOption* option		The option to make the plan for.
+*					Flight flightPlan[]				The plan, in order. Ends in a NULL.
+*/
+void createParetoFlightplan(const QueryScratch* scratch, int originAirport,
+	int destinationAirport, const ParetoOption* option, const Flight* flightPlan[])
+{
+	const Timetable* network = flightTimetable();
+	const int* roundFlights = scratch->roundFlights;
+	int airportCount = network->airportCount;
+	int currentAirport = destinationAirport;
+	int step = option->flightCount;
+	int r = option->flightCount;
+
+	flightPlan[step] = NULL;
+
+	// <Round walk>
+	// Each flight back comes from one round earlier than the last, so each uses one fewer flight.
+	while (currentAirport != originAirport)
+	{
+		r = lastImprovingRound(scratch, currentAirport, r);
+
+		step--;
+		flightPlan[step] = &network->departures[roundFlights[(size_t)r * (airportCount + 1) + currentAirport]];
+		currentAirport = flightPlan[step]->originCity;
+		r--;
+	} // End of round walk loop.
+
+	countSearch(planFlights, option->flightCount);
+}
+
+
+
+/*
+* Function:			nextConnectionUTC()
+* Description:		Finds when a flight in a Pareto plan leaves, keeping to the minimum
+*					connection time at its airport (unless it's the first flight of the plan).
+* Parameters:		const Flight* flight	The flight to take.
+*					int groundTime			When the flyer started or landed at the flight's
+*											origin, in minutes since midnight UTC.
+*					int isFirstFlight		1 for the plan's first flight, 0 otherwise.
+* Return Values:	The departure time, in minutes since midnight UTC of the first day.
+*/
+int nextConnectionUTC(const Flight* flight, int groundTime, int isFirstFlight)
+{
+	if (isFirstFlight == 0)
+	{
+		groundTime += flightTimetable()->airports[flight->originCity].minimumConnection;
+	}
+
+	return nextDepartureUTC(flight, groundTime);
+}
@@ -0,0 +1,386 @@
+/*
+* Filename:				precompute.c
+* Description:			The precomputed profile table for the Amazing Race flight planner. Since the
+*						flights are the same every day, a whole day's profile from each origin (see
+*						profile.c) answers every query from it, at any start time. With --precompute
+*						every origin's profile is found once when the program starts, spread over
+*						worker threads, and packed into one table. A query is then a binary search
+*						of the table for each flight of the plan, with no search of the network.
+*
+*						The table holds, for each origin and destination pair, the departures worth
+*						taking over the origin's local day, and the first flight to take for each.
+*						Whatever airport that first flight lands at, the table's entry for there to
+*						the destination gives the next flight, with the same arrival.
+*
+*						The table has an entry range for every pair of airports, so it grows with
+*						the square of the airports. profileTableFits() says whether the loaded
+*						network is small enough to build it.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+/* The table itself. The entries for origin o and destination d are pairOffsets[p] up to
+pairOffsets[p + 1], where p = o * (tableAirportCount + 1) + d, sorted by departure. Pair
+indices and offsets are size_t, since both pass INT_MAX long before the airports do. Times are
+minutes since midnight UTC of the first day, with departures in the origin's local first day.
+Empty until buildProfileTable() is called. */
+static int tableAirportCount = 0;
+static size_t* pairOffsets = NULL;
+static int* tableDepartures = NULL;
+static const Flight** tableFlights = NULL;
+
+// One origin's profile, as found by a worker, waiting to be packed into the table.
+typedef struct
+{
+	int* destinationCounts;			// [airportCount + 1] The entries for each destination.
+	int* departures;				// The entries' departures, grouped by destination.
+	const Flight** flights;			// The entries' first flights.
+} OriginProfile;
+
+// What each thread building the table is given: where to keep profiles, and its own working memory.
+typedef struct
+{
+	OriginProfile* origins;			// [airportCount + 1] Each origin's profile, shared.
+	QueryScratch scratch;
+} ProfileBuilder;
+
+
+
+static int buildOriginProfile(void* builder, int origin);
+static int keepOriginProfile(const QueryScratch* scratch, OriginProfile* profile);
+static void freeOriginProfile(OriginProfile* profile);
+
+
+
+/*
+* Function:			profileTableFits()
+* Description:		Says whether the loaded timetable is small enough for the profile table,
+*					rather than running out of memory partway or taking hours to build. Its pairs
+*					of airports must be no more than kProfileTablePairLimit: 5,000 airports
+*					(2.5e7 pairs) need 200 MB for the pair offsets alone, before any entries.
+* Return Values:	1 if buildProfileTable() can be called, 0 if the timetable is too big.
+*/
+int profileTableFits(void)
+{
+	double airportCount = (double)flightTimetable()->airportCount;
+
+	return (((airportCount + 1.0) * (airportCount + 1.0)) <= kProfileTablePairLimit) ? 1 : 0;
+}
+
+
+
+/*
+* Function:			buildProfileTable()
+* Description:		Finds every origin's profile and packs them into the table used by
+*					lookupEarliestArrivals(), reporting how long it took and how big the table is.
+*					Must be called again whenever the timetable changes.
+* Parameters:		int threadCount		The number of threads to build with. 0 for one per core.
+* Return Values:	1 if the table was built, 0 if there wasn't enough memory.
+*/
+int buildProfileTable(int threadCount)
+{
+	const Timetable* network = flightTimetable();
+	int airportCount = network->airportCount;
+	size_t pairCount = (size_t)(airportCount + 1) * (airportCount + 1);
+
+	double startSeconds = wallClockSeconds();
+	OriginProfile* origins = NULL;
+	ProfileBuilder* builders = NULL;
+	int threadsUsed = 0;
+	int isOutOfMemory = 0;
+	size_t entryCount = 0;
+
+	size_t* newOffsets = NULL;
+	int* newDepartures = NULL;
+	const Flight** newFlights = NULL;
+
+	threadCount = workerThreadCount(threadCount, airportCount);
+	origins = (OriginProfile*)calloc(airportCount + 1, sizeof(OriginProfile));
+	builders = (ProfileBuilder*)calloc(threadCount, sizeof(ProfileBuilder));
+
+	if ((origins == NULL) || (builders == NULL))
+	{
+		free(origins);
+		free(builders);
+		return 0;
+	}
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		builders[i].origins = origins;
+
+		if (initQueryScratch(&builders[i].scratch) == 0)
+		{
+			isOutOfMemory = 1;
+			break;
+		}
+	}
+
+	if ((isOutOfMemory == 0) && (runForEachOrigin(airportCount, builders, threadCount,
+		sizeof(ProfileBuilder), buildOriginProfile, &threadsUsed) == 0))
+	{
+		isOutOfMemory = 1;
+	}
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		freeQueryScratch(&builders[i].scratch);
+	}
+	free(builders);
+
+	// <Table packing>
+	// Lay every origin's profile end to end, and point each pair at its entries.
+	if (isOutOfMemory == 0)
+	{
+		newOffsets = (size_t*)malloc((pairCount + 1) * sizeof(size_t));
+
+		if (newOffsets != NULL)
+		{
+			for (int origin = 0; origin <= airportCount; origin++)
+			{
+				for (int destination = 0; destination <= airportCount; destination++)
+				{
+					newOffsets[(size_t)origin * (airportCount + 1) + destination] = entryCount;
+
+					if ((origin > 0) && (origins[origin].destinationCounts != NULL))
+					{
+						entryCount += origins[origin].destinationCounts[destination];
+					}
+				}
+			}
+			newOffsets[pairCount] = entryCount;
+
+			newDepartures = (int*)malloc((entryCount + 1) * sizeof(int));
+			newFlights = (const Flight**)malloc((entryCount + 1) * sizeof(const Flight*));
+		}
+
+		if ((newOffsets == NULL) || (newDepartures == NULL) || (newFlights == NULL))
+		{
+			isOutOfMemory = 1;
+		}
+		else
+		{
+			for (int origin = 1; origin <= airportCount; origin++)
+			{
+				const OriginProfile* profile = &origins[origin];
+				size_t first = newOffsets[(size_t)origin * (airportCount + 1)];
+				size_t count = newOffsets[(size_t)(origin + 1) * (airportCount + 1)] - first;
+
+				memcpy(&newDepartures[first], profile->departures, count * sizeof(int));
+				memcpy((void*)&newFlights[first], (const void*)profile->flights,
+					count * sizeof(const Flight*));
+			}
+		}
+	} // End of table packing.
+
+	for (int origin = 0; origin <= airportCount; origin++)
+	{
+		freeOriginProfile(&origins[origin]);
+	}
+	free(origins);
+
+	if (isOutOfMemory == 1)
+	{
+		free(newOffsets);
+		free(newDepartures);
+		free((void*)newFlights);
+		return 0;
+	}
+
+	freeProfileTable();
+	tableAirportCount = airportCount;
+	pairOffsets = newOffsets;
+	tableDepartures = newDepartures;
+	tableFlights = newFlights;
+
+	fprintf(stderr, "Precomputed %.0f profile entries for %d airports on %d thread%s in %.3f seconds"
+		" (%.1f MB).\n", (double)entryCount, airportCount, threadsUsed,
+		(threadsUsed > 1) ? "s" : "",
+		wallClockSeconds() - startSeconds,
+		((pairCount + 1) * sizeof(size_t) + entryCount * (sizeof(int) + sizeof(const Flight*)))
+		/ (1024.0 * 1024.0));
+
+	return 1;
+}
+
+
+
+/*
+* Function:			freeProfileTable()
+* Description:		Releases the profile table.
+*/
+void freeProfileTable(void)
+{
+	free(pairOffsets);
+	free(tableDepartures);
+	free((void*)tableFlights);
+
+	pairOffsets = NULL;
+	tableDepartures = NULL;
+	tableFlights = NULL;
+	tableAirportCount = 0;
+}
+
+
+
+/*
+* Function:			lookupEarliestArrivals()
+* Description:		Finds the flights to take to the destination from the profile table, instead
+*					of searching the network. At each airport on the way, a binary search of the
+*					table finds the first departure worth taking, and its first flight is taken.
+*					Only the destination's chain of flights is filled in earliestArrivals[], which
+*					is all createFastestFlightplan() needs, and listed (see beginReachedList()).
+* Parameters:		QueryScratch* scratch		The scratch the query is using.
+*					int startTimeMinutes		The user's starting time, in the local timezone.
+*					int originAirport			The user's starting airport.
+*					int destinationAirport		The airport to find the flights to.
+*					Flight earliestArrivals[]	An array to pass the flights to, as for
+*												mapEarliestArrivals().
+*/
+void lookupEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes,
+	int originAirport, int destinationAirport, const Flight* earliestArrivals[])
+{
+	int groundTime = startTimeInMinutes - timezoneOffset(originAirport);
+	int currentAirport = originAirport;
+	int listReached = beginReachedList(scratch, earliestArrivals);
+
+	// Every flight lands somewhere new, so a plan can't take more flights than there are airports.
+	for (int step = 0; (step < tableAirportCount) && (currentAirport != destinationAirport); step++)
+	{
+		size_t pair = (size_t)currentAirport * (tableAirportCount + 1) + destinationAirport;
+		size_t first = pairOffsets[pair];
+		size_t last = pairOffsets[pair + 1];
+
+		// The table's day at this airport starts at local midnight.
+		int dayStart = -timezoneOffset(currentAirport);
+		int day = dayOfTime(groundTime - dayStart);
+		int timeInDay = groundTime - day * kMinutesPerDay;
+
+		const Flight* flight = NULL;
+
+		if (first == last)
+		{
+			return;
+		}
+
+		// Binary search for the first departure after the flyer is on the ground.
+		size_t low = first;
+		size_t high = last;
+
+		while (low < high)
+		{
+			size_t middle = low + (high - low) / 2;
+
+			if (tableDepartures[middle] <= timeInDay)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+
+		// Past the last departure of the day, the first one tomorrow is the one to take.
+		if (low == last)
+		{
+			low = first;
+		}
+
+		flight = tableFlights[low];
+
+		if ((listReached == 1) && (earliestArrivals[flight->destinationCity] == NULL))
+		{
+			scratch->reachedAirports[scratch->reachedCount] = flight->destinationCity;
+			scratch->reachedCount++;
+		}
+		earliestArrivals[flight->destinationCity] = flight;
+
+		groundTime = nextDepartureUTC(flight, groundTime) + flight->flightDuration;
+		currentAirport = flight->destinationCity;
+	}
+}
+
+
+
+/*
+* Function:			buildOriginProfile()
+* Description:		The work done for each origin by the threads building the table: finds its
+*					day's profile and keeps it. Called by runForEachOrigin().
+* Parameters:		void* builder		The ProfileBuilder for this thread.
+*					int origin			The origin to find the profile from.
+* Return Values:	1 if the profile was kept, 0 if there wasn't enough memory.
+*/
+static int buildOriginProfile(void* builder, int origin)
+{
+	ProfileBuilder* self = (ProfileBuilder*)builder;
+
+	// Each origin's day starts at its local midnight.
+	return ((profileEarliestArrivals(&self->scratch, 0, origin) == 1)
+		&& (keepOriginProfile(&self->scratch, &self->origins[origin]) == 1)) ? 1 : 0;
+}
+
+
+
+/*
+* Function:			keepOriginProfile()
+* Description:		Copies the profile in a scratch out into an OriginProfile, grouped by
+*					destination, before the scratch is reused for the next origin.
+* Parameters:		const QueryScratch* scratch		The scratch holding the profile.
+*					OriginProfile* profile			Where to copy it.
+* Return Values:	1 if it was copied, 0 if there wasn't enough memory.
+*/
+static int keepOriginProfile(const QueryScratch* scratch, OriginProfile* profile)
+{
+	int airportCount = scratch->airportCount;
+	int entryCount = scratch->profileEntryCount;
+	int next = 0;
+
+	profile->destinationCounts = (int*)calloc(airportCount + 1, sizeof(int));
+	profile->departures = (int*)malloc((entryCount + 1) * sizeof(int));
+	profile->flights = (const Flight**)malloc((entryCount + 1) * sizeof(const Flight*));
+
+	if ((profile->destinationCounts == NULL) || (profile->departures == NULL)
+		|| (profile->flights == NULL))
+	{
+		freeOriginProfile(profile);
+		return 0;
+	}
+
+	for (int destination = 1; destination <= airportCount; destination++)
+	{
+		for (int entry = scratch->profileHeads[destination]; entry >= 0;
+			entry = scratch->profileEntries[entry].next)
+		{
+			profile->departures[next] = scratch->profileEntries[entry].departureTime;
+			profile->flights[next] = scratch->profileEntries[entry].firstFlight;
+			profile->destinationCounts[destination]++;
+			next++;
+		}
+	}
+
+	return 1;
+}
+
+
+
+/*
+* Function:			freeOriginProfile()
+* Description:		Releases the memory held by an OriginProfile.
+* Parameters:		OriginProfile* profile		The profile to release.
+*/
+static void freeOriginProfile(OriginProfile* profile)
+{
+	free(profile->destinationCounts);
+	free(profile->departures);
+	free((void*)profile->flights);
+
+	profile->destinationCounts = NULL;
+	profile->departures = NULL;
+	profile->flights = NULL;
+}
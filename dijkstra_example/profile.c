@@ -0,0 +1,283 @@
+/*
+* Filename:				profile.c
+* Description:			Profile queries for the Amazing Race flight planner: "when should I leave?"
+*						rather than "I'm leaving at HHMM". From one origin, finds every departure
+*						over a day that is worth taking to each airport, with the earliest arrival
+*						for each one.
+*
+*						Only the times a flight actually leaves the origin can start a useful
+*						journey, so one search is run per departure, from the latest to the
+*						earliest (a self-pruning profile search). Every airport remembers the best
+*						arrival found by the later departures, and a search stops at any airport it
+*						can't beat: leaving earlier to get somewhere no sooner is never worth it,
+*						and whatever the later departure could reach onward from there, it already
+*						has. Each search only explores what is new, so the whole day costs far less
+*						than a search for every minute.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+static int latestDepartureBefore(int originAirport, int timeUTC);
+static int addProfileEntry(QueryScratch* scratch, int airport, int departureTime, int arrivalTime,
+	const Flight* firstFlight);
+
+
+
+/*
+* Function:			profileEarliestArrivals()
+* Description:		Finds, for every airport, each departure from the origin in a 24 hour window
+*					that gets there sooner than any later departure, and when it arrives.
+*					The results are left in the scratch: the entries for an airport start at
+*					profileEntries[profileHeads[airport]] and follow each entry's next, from the
+*					earliest departure to the latest. An airport with no entries can't be reached.
+*					Each entry also gives the flight out of the origin to take; from wherever that
+*					lands, the same arrival is the earliest possible (see buildProfileTable()).
+*					The window runs from windowStartInMinutes up to (but not including) the same
+*					time the next day. A journey may arrive after the window ends.
+* Parameters:		QueryScratch* scratch			Working memory for the search, and the results.
+*					int windowStartInMinutes		The start of the window, in the origin's local
+*													timezone.
+*					int originAirport				The airport every journey starts from.
+* Return Values:	1 if the profile was found, 0 if there wasn't enough memory for it.
+*/
+int profileEarliestArrivals(QueryScratch* scratch, const int windowStartInMinutes,
+	int originAirport)
+{
+	const Timetable* network = flightTimetable();
+
+	const Flight** earliestArrivals = scratch->earliestArrivals;
+	int* earliestGroundTime = scratch->groundTimes;
+	AirportHeap* unsettledAirports = &scratch->heap;
+
+	/* Whether each airport has been reached or settled by the current departure's search
+	(see mapEarliestArrivals()). Each departure starts a new generation. */
+	unsigned int* airportStamps = scratch->airportStamps;
+	unsigned int reachedStamp = 0;
+	unsigned int settledStamp = 0;
+	int listReached = 0;
+
+	int windowStartUTC = windowStartInMinutes - timezoneOffset(originAirport);
+	int departureTime = windowStartUTC + kMinutesPerDay;
+
+	/* Put back just the airports the last profile gave entries to; no other airport's head
+	or arrival has been set. */
+	for (int entry = 0; entry < scratch->profileEntryCount; entry++)
+	{
+		scratch->profileHeads[scratch->profileEntries[entry].airport] = -1;
+		scratch->profileArrivals[scratch->profileEntries[entry].airport] = INT_MAX;
+	}
+	scratch->profileEntryCount = 0;
+
+	// Start from an empty earliestArrivals, so the airports the searches reach can be listed.
+	clearQueryResults(scratch);
+	listReached = beginReachedList(scratch, earliestArrivals);
+
+	// <Departure loop>
+	// One search per departure from the origin, from the latest in the window to the earliest.
+	while (1)
+	{
+		departureTime = latestDepartureBefore(originAirport, departureTime);
+
+		if (departureTime < windowStartUTC)
+		{
+			break;
+		}
+
+		reachedStamp = startSearchGeneration(scratch);
+		settledStamp = reachedStamp + 1;
+
+		/* Be at the origin just before the flight leaves, so it (and any other flight leaving
+		at the same time) can be caught. */
+		earliestGroundTime[originAirport] = departureTime - 1;
+		airportStamps[originAirport] = reachedStamp;
+		pushAirport(unsettledAirports, originAirport, earliestGroundTime);
+
+		// <Airport settle loop>
+		while (unsettledAirports->size > 0)
+		{
+			int departureAirport = popEarliestAirport(unsettledAirports, earliestGroundTime);
+
+			airportStamps[departureAirport] = settledStamp;
+			countSearch(airportsSettled, 1);
+
+			/* An airport reached no sooner than a later departure reaches it is pruned: the
+			later departure has already explored everything onward from there. */
+			if (departureAirport != originAirport)
+			{
+				const Flight* firstFlight = earliestArrivals[departureAirport];
+
+				if (earliestGroundTime[departureAirport] >= scratch->profileArrivals[departureAirport])
+				{
+					continue;
+				}
+
+				// Follow this search's flights back to the one that left the origin.
+				while (firstFlight->originCity != originAirport)
+				{
+					firstFlight = earliestArrivals[firstFlight->originCity];
+				}
+
+				if (addProfileEntry(scratch, departureAirport, departureTime,
+					earliestGroundTime[departureAirport], firstFlight) == 0)
+				{
+					// Leave the heap empty for the next search.
+					while (unsettledAirports->size > 0)
+					{
+						popEarliestAirport(unsettledAirports, earliestGroundTime);
+					}
+					return 0;
+				}
+
+				// Only once it has an entry, so the next profile knows to put it back.
+				scratch->profileArrivals[departureAirport] = earliestGroundTime[departureAirport];
+			}
+
+			for (int leg = network->legOffsets[departureAirport];
+				leg < network->legOffsets[departureAirport + 1]; leg++)
+			{
+				int arrivalAirport = network->legDestinations[leg];
+				const Flight* quickestFlightToGround = NULL;
+				int arrivalTime = 0;
+
+				if ((arrivalAirport == originAirport)
+					|| (airportStamps[arrivalAirport] == settledStamp))
+				{
+					continue;
+				}
+
+				countSearch(legsRelaxed, 1);
+				arrivalTime = soonestArrival(earliestGroundTime[departureAirport], leg,
+					&quickestFlightToGround);
+
+				/* Don't queue an airport this search can't improve on; it would only be
+				pruned when it was settled. */
+				if (((airportStamps[arrivalAirport] != reachedStamp)
+					|| (arrivalTime < earliestGroundTime[arrivalAirport]))
+					&& (arrivalTime < scratch->profileArrivals[arrivalAirport]))
+				{
+					airportStamps[arrivalAirport] = reachedStamp;
+
+					if ((listReached == 1) && (earliestArrivals[arrivalAirport] == NULL))
+					{
+						scratch->reachedAirports[scratch->reachedCount] = arrivalAirport;
+						scratch->reachedCount++;
+					}
+
+					earliestGroundTime[arrivalAirport] = arrivalTime;
+					earliestArrivals[arrivalAirport] = quickestFlightToGround;
+					pushAirport(unsettledAirports, arrivalAirport, earliestGroundTime);
+					countSearch(improvements, 1);
+				}
+			}
+		} // End of airport settle loop.
+	} // End of departure loop.
+
+	return 1;
+}
+
+
+
+/*
+* Function:			latestDepartureBefore()
+* Description:		Finds the latest time any flight leaves an airport before a given time.
+*					Flights run every day, so there is always one unless the airport has none.
+* Parameters:		int originAirport		The airport the flights leave.
+*					int timeUTC				The time to search back from, in minutes since
+*											midnight UTC of the first day.
+* Return Values:	The departure time, in minutes since midnight UTC of the first day, or
+*					INT_MIN if no flights leave the airport.
+*/
+static int latestDepartureBefore(int originAirport, int timeUTC)
+{
+	const Timetable* network = flightTimetable();
+
+	// The time as a day, and minutes since that day's midnight UTC.
+	int day = dayOfTime(timeUTC);
+	int timeInDay = timeUTC - day * kMinutesPerDay;
+
+	int latestDeparture = INT_MIN;
+
+	for (int leg = network->legOffsets[originAirport];
+		leg < network->legOffsets[originAirport + 1]; leg++)
+	{
+		int firstFlight = network->departureOffsets[leg];
+		int lastFlight = network->departureOffsets[leg + 1];
+		int departure = 0;
+
+		// The first flight leaving at or after timeInDay.
+		int low = firstFlightAfter(network->departureMinutes, firstFlight, lastFlight,
+			timeInDay - 1);
+
+		// The flight before that one, or failing that, the last flight of the day before.
+		if (low > firstFlight)
+		{
+			departure = day * kMinutesPerDay + network->departureMinutes[low - 1];
+		}
+		else
+		{
+			departure = (day - 1) * kMinutesPerDay + network->departureMinutes[lastFlight - 1];
+		}
+
+		if (departure > latestDeparture)
+		{
+			latestDeparture = departure;
+		}
+	}
+
+	return latestDeparture;
+}
+
+
+
+/*
+* Function:			addProfileEntry()
+* Description:		Adds an entry to the front of an airport's profile, making room for it if the
+*					scratch doesn't have any left. Entries are added from the latest departure to
+*					the earliest, so the front of the list is always the earliest departure.
+* Parameters:		QueryScratch* scratch		The scratch holding the profile.
+*					int airport					The airport the entry is for.
+*					int departureTime			When the journey leaves the origin.
+*					int arrivalTime				When it gets to the airport.
+*					const Flight* firstFlight	The flight to take out of the origin.
+* Return Values:	1 if the entry was added, 0 if there wasn't enough memory.
+*/
+static int addProfileEntry(QueryScratch* scratch, int airport, int departureTime, int arrivalTime,
+	const Flight* firstFlight)
+{
+	ProfileEntry* entry = NULL;
+
+	// The scratch keeps its entries between queries, so this rarely has to allocate.
+	if (scratch->profileEntryCount == scratch->profileEntriesAllocated)
+	{
+		int newCount = (scratch->profileEntriesAllocated == 0)
+			? 4 * (scratch->airportCount + 1) : scratch->profileEntriesAllocated * 2;
+		ProfileEntry* newEntries = (ProfileEntry*)realloc(scratch->profileEntries,
+			(size_t)newCount * sizeof(ProfileEntry));
+
+		if (newEntries == NULL)
+		{
+			fprintf(stderr, "Not enough memory for %d profile entries.\n", newCount);
+			return 0;
+		}
+
+		scratch->profileEntries = newEntries;
+		scratch->profileEntriesAllocated = newCount;
+	}
+
+	entry = &scratch->profileEntries[scratch->profileEntryCount];
+	entry->departureTime = departureTime;
+	entry->arrivalTime = arrivalTime;
+	entry->firstFlight = firstFlight;
+	entry->next = scratch->profileHeads[airport];
+	entry->airport = airport;
+
+	scratch->profileHeads[airport] = scratch->profileEntryCount;
+	scratch->profileEntryCount++;
+
+	return 1;
+}
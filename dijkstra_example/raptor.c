@@ -0,0 +1,368 @@
+/*
+* Filename:				raptor.c
+* Description:			The round-based (RAPTOR) engine for the Amazing Race flight planner.
+*						Round k finds the earliest arrival at each airport using at most k flights.
+*						Only the airports whose arrival improved in the previous round are
+*						scanned, so each round is cheap, and a leg limit stops the search after
+*						that many rounds. This answers "fastest with at most k flights", which
+*						neither of the other engines can.
+*						Within a round the marked airports are independent of each other: they
+*						only read the previous round's arrivals.
+*						The rounds themselves are run by raptorRounds(), which the Pareto search
+*						(pareto.c) shares.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+static int growRounds(QueryScratch* scratch, int round);
+
+
+
+/*
+* Function:			raptorEarliestArrivals()
+* Description:		Maps out the earliest possible arrival time at each airport from your original
+*					airport, at the current time, using at most maxLegs flights, and returns a
+*					list of the flights needed to get to each one.
+*					Every round's arrivals and flights are kept, so that the flight plan to the
+*					destination can be rebuilt round by round within the leg limit. Without a
+*					limit the flights in earliestArrivals[] form the same kind of tree as
+*					mapEarliestArrivals() gives. With a limit, a faster path to an airport on the
+*					way may need more flights than the destination can afford, so only the
+*					chain of flights back from destinationAirport is guaranteed to be a valid plan.
+* Parameters:		QueryScratch* scratch		Working memory for the search. Its round arrays are
+*												grown as needed, and kept for the next query.
+*					int startTimeMinutes		The user's starting time, in the local timezone.
+*					int originAirport			The user's starting airport.
+*					int destinationAirport		The airport the flight plan will be made for.
+*					int maxLegs					The most flights the plan may use. 0 for no limit.
+*					Flight earliestArrivals[]	An array to pass a list of flights to, representing
+*												the earliest flights available to each destination.
+*/
+void raptorEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes, int originAirport,
+	int destinationAirport, int maxLegs, const Flight* earliestArrivals[])
+{
+	const Timetable* network = flightTimetable();
+	int airportCount = network->airportCount;
+	int* roundFlights = NULL;
+	int listReached = beginReachedList(scratch, earliestArrivals);
+	int round = raptorRounds(scratch, startTimeInMinutes - timezoneOffset(originAirport),
+		originAirport, 0, maxLegs, 0);
+
+	roundFlights = scratch->roundFlights;
+
+	/* Each airport's flight is the one from the last round that improved it. Without a leg
+	limit these always chain back to the origin. */
+	for (int i = 0; i < scratch->improvedCount; i++)
+	{
+		int airport = scratch->improvedAirports[i];
+
+		if (listReached == 1)
+		{
+			scratch->reachedAirports[scratch->reachedCount] = airport;
+			scratch->reachedCount++;
+		}
+
+		earliestArrivals[airport] = &network->departures[
+			roundFlights[(size_t)scratch->lastRounds[airport] * (airportCount + 1) + airport]];
+	}
+
+	/* With a leg limit, rebuild the destination's chain round by round, so each step back
+	uses one fewer flight. */
+	if ((maxLegs > 0) && (earliestArrivals[destinationAirport] != NULL))
+	{
+		int currentAirport = destinationAirport;
+		int r = round - 1;
+
+		while (currentAirport != originAirport)
+		{
+			r = lastImprovingRound(scratch, currentAirport, r);
+			earliestArrivals[currentAirport] =
+				&network->departures[roundFlights[(size_t)r * (airportCount + 1) + currentAirport]];
+			currentAirport = earliestArrivals[currentAirport]->originCity;
+			r--;
+		}
+	}
+}
+
+
+
+/*
+* Function:			raptorRounds()
+* Description:		Runs the rounds: round k finds the earliest arrival at each airport using at
+*					most k flights, in scratch->roundArrivals and scratch->roundFlights.
+*					Only the entries of the airports a round improves are written: each airport
+*					keeps the last round that improved it in scratch->lastRounds, and a link
+*					back to the round before that in scratch->roundLinks (see
+*					lastImprovingRound()). The airports improved at all are listed in
+*					scratch->improvedAirports. Nothing has to be cleared for every airport.
+*					With a target, any arrival no sooner than the target's best so far is
+*					dropped, as it can't lead anywhere useful. With connection times, each
+*					airport after the origin holds the flyer for its minimumConnection before
+*					the next flight.
+* Parameters:		QueryScratch* scratch		Working memory for the search. Its round arrays are
+*												grown as needed, and kept for the next query.
+*					int startTimeUTC			The start time, in minutes since midnight UTC.
+*					int originAirport			The user's starting airport.
+*					int targetAirport			The only airport that matters, or 0 for all.
+*					int maxLegs					The most flights to use. 0 for no limit.
+*					int useConnectionTimes		1 to keep to each airport's minimum connection.
+* Return Values:	The number of rounds filled in, round 0 (the origin alone) included.
+*/
+int raptorRounds(QueryScratch* scratch, int startTimeUTC, int originAirport, int targetAirport,
+	int maxLegs, int useConnectionTimes)
+{
+	const Timetable* network = flightTimetable();
+	int airportCount = network->airportCount;
+
+	/* Each round's arrival time, flight and link back for each airport, one row of
+	airportCount + 1 per round. An airport's entries are only written in the rounds that
+	improve it. */
+	int* roundArrivals = NULL;
+	int* roundFlights = NULL;
+	int* roundLinks = NULL;
+
+	/* The best arrival at each airport over all rounds so far, and the last round that
+	improved it. Only meaningful for the airports stamped as reached by this search; the rest
+	haven't been reached. */
+	int* bestArrival = scratch->groundTimes;
+	int* lastRounds = scratch->lastRounds;
+	unsigned int* airportStamps = scratch->airportStamps;
+	unsigned int reachedStamp = startSearchGeneration(scratch);
+
+	/* The airports to scan in this round, and the ones marked for the next. An airport is
+	only listed once per round: the first time the round improves it. */
+	int* markedAirports = scratch->markedAirports;
+	int* nextMarkedAirports = scratch->nextMarkedAirports;
+	int markedCount = 0;
+
+	int round = 0;
+
+	bestArrival[originAirport] = startTimeUTC;
+	lastRounds[originAirport] = 0;
+	airportStamps[originAirport] = reachedStamp;
+	markedAirports[0] = originAirport;
+	markedCount = 1;
+	scratch->improvedCount = 0;
+
+	// <Round loop>
+	// Round 0 is just the origin. Each round after that adds one more flight.
+	while (1)
+	{
+		int* previousArrivals = NULL;
+		int* currentArrivals = NULL;
+		int* currentFlights = NULL;
+		int* currentLinks = NULL;
+		int nextMarkedCount = 0;
+
+		// Make room for this round.
+		if (growRounds(scratch, round) == 0)
+		{
+			fprintf(stderr, "Not enough memory to search %d airports.\n", airportCount);
+			break;
+		}
+
+		roundArrivals = scratch->roundArrivals;
+		roundFlights = scratch->roundFlights;
+		roundLinks = scratch->roundLinks;
+
+		currentArrivals = &roundArrivals[(size_t)round * (airportCount + 1)];
+		currentFlights = &roundFlights[(size_t)round * (airportCount + 1)];
+		currentLinks = &roundLinks[(size_t)round * (airportCount + 1)];
+
+		// Round 0 only holds the origin.
+		if (round == 0)
+		{
+			currentArrivals[originAirport] = startTimeUTC;
+			currentFlights[originAirport] = -1;
+			currentLinks[originAirport] = -1;
+
+			round++;
+			continue;
+		}
+
+		// Stop once nothing improved in the last round, or the leg limit has been reached.
+		if ((markedCount == 0) || ((maxLegs > 0) && (round > maxLegs)))
+		{
+			break;
+		}
+
+		/* Every marked airport was improved in the last round, so its entry there is the
+		time to leave it from. */
+		previousArrivals = &roundArrivals[(size_t)(round - 1) * (airportCount + 1)];
+
+		// <Marked airport scan>
+		for (int marked = 0; marked < markedCount; marked++)
+		{
+			int departureAirport = markedAirports[marked];
+
+			for (int leg = network->legOffsets[departureAirport];
+				leg < network->legOffsets[departureAirport + 1]; leg++)
+			{
+				int arrivalAirport = network->legDestinations[leg];
+				const Flight* quickestFlightToGround = NULL;
+				int readyTime = previousArrivals[departureAirport];
+				int arrivalTime = 0;
+				int bestSoFar = INT_MAX;
+				int targetBest = INT_MAX;
+
+				// Flights back to the original airport are never useful.
+				if (arrivalAirport == originAirport)
+				{
+					continue;
+				}
+
+				// Changing flights takes time, but starting out from the origin doesn't.
+				if ((useConnectionTimes == 1) && (departureAirport != originAirport))
+				{
+					readyTime += network->airports[departureAirport].minimumConnection;
+				}
+
+				/* Leave from where the last round got to. Reading only the last round keeps
+				this round to exactly one more flight. */
+				arrivalTime = soonestArrival(readyTime, leg, &quickestFlightToGround);
+
+				if (airportStamps[arrivalAirport] == reachedStamp)
+				{
+					bestSoFar = bestArrival[arrivalAirport];
+				}
+
+				if ((targetAirport != 0) && (airportStamps[targetAirport] == reachedStamp))
+				{
+					targetBest = bestArrival[targetAirport];
+				}
+
+				/* Only keep arrivals that beat every earlier round as well; anything else
+				uses more flights to get there no sooner. With a target, they must beat the
+				target's best too. */
+				if ((arrivalTime < bestSoFar) && (arrivalTime < targetBest))
+				{
+					// The first time any round improves the airport, it can be set up.
+					if (airportStamps[arrivalAirport] != reachedStamp)
+					{
+						airportStamps[arrivalAirport] = reachedStamp;
+						lastRounds[arrivalAirport] = -1;
+						scratch->improvedAirports[scratch->improvedCount] = arrivalAirport;
+						scratch->improvedCount++;
+					}
+
+					// The first time this round improves it, link it back and mark it.
+					if (lastRounds[arrivalAirport] != round)
+					{
+						currentLinks[arrivalAirport] = lastRounds[arrivalAirport];
+						lastRounds[arrivalAirport] = round;
+						nextMarkedAirports[nextMarkedCount] = arrivalAirport;
+						nextMarkedCount++;
+					}
+
+					currentArrivals[arrivalAirport] = arrivalTime;
+					currentFlights[arrivalAirport] = (int)(quickestFlightToGround - network->departures);
+					bestArrival[arrivalAirport] = arrivalTime;
+				}
+			}
+		} // End of marked airport scan.
+
+		// The airports improved this round are the ones to scan next round.
+		{
+			int* swap = markedAirports;
+			markedAirports = nextMarkedAirports;
+			nextMarkedAirports = swap;
+		}
+		markedCount = nextMarkedCount;
+
+		round++;
+	} // End of round loop.
+
+	return round;
+}
+
+
+
+/*
+* Function:			lastImprovingRound()
+* Description:		Finds the last round, no later than a given one, that improved an airport in
+*					the last raptorRounds(), by following the airport's links back from the last
+*					round that improved it at all.
+* Parameters:		const QueryScratch* scratch		The scratch the rounds were run in.
+*					int airport						The airport.
+*					int round						The latest round to consider.
+* Return Values:	The round, or -1 if none that early reached the airport.
+*/
+int lastImprovingRound(const QueryScratch* scratch, int airport, int round)
+{
+	int r = 0;
+
+	if (scratch->airportStamps[airport] != scratch->generation)
+	{
+		return -1;
+	}
+
+	r = scratch->lastRounds[airport];
+
+	while (r > round)
+	{
+		r = scratch->roundLinks[(size_t)r * (scratch->airportCount + 1) + airport];
+	}
+
+	return r;
+}
+
+
+
+/*
+* Function:			growRounds()
+* Description:		Makes sure the scratch has room for a round. The scratch keeps its rounds
+*					between queries, so this only allocates when a query needs more rounds than
+*					any before it.
+* Parameters:		QueryScratch* scratch		Working memory for the search.
+*					int round					The round that needs room.
+* Return Values:	1 if there is room, 0 if there wasn't enough memory.
+*/
+static int growRounds(QueryScratch* scratch, int round)
+{
+	int airportCount = flightTimetable()->airportCount;
+	int newRounds = (scratch->roundsAllocated == 0) ? 8 : scratch->roundsAllocated * 2;
+	int* grownArrivals = NULL;
+	int* grownFlights = NULL;
+	int* grownLinks = NULL;
+
+	if (round < scratch->roundsAllocated)
+	{
+		return 1;
+	}
+
+	grownArrivals = (int*)realloc(scratch->roundArrivals,
+		(size_t)newRounds * (airportCount + 1) * sizeof(int));
+
+	if (grownArrivals == NULL)
+	{
+		return 0;
+	}
+
+	scratch->roundArrivals = grownArrivals;
+	grownFlights = (int*)realloc(scratch->roundFlights,
+		(size_t)newRounds * (airportCount + 1) * sizeof(int));
+
+	if (grownFlights == NULL)
+	{
+		return 0;
+	}
+
+	scratch->roundFlights = grownFlights;
+	grownLinks = (int*)realloc(scratch->roundLinks,
+		(size_t)newRounds * (airportCount + 1) * sizeof(int));
+
+	if (grownLinks == NULL)
+	{
+		return 0;
+	}
+
+	scratch->roundLinks = grownLinks;
+	scratch->roundsAllocated = newRounds;
+
+	return 1;
+}
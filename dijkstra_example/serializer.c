@@ -0,0 +1,876 @@
+/*
+* Filename:				serializer.c
+* Description:			Writes itineraries for the Amazing Race flight planner into an
+*						OutputBuffer: as the menu's sentences, as a JSON line, as a TSV row, or as
+*						a compact binary record. Batch and server results are written here, and
+*						so is the menu's printItinerary().
+*
+*						Nothing is formatted with printf(). Each airport's name, its name as a
+*						quoted JSON string and its timezone's name are worked out once, when the
+*						timetable is loaded, and copied straight into the output; numbers and
+*						times are turned into digits by hand. An itinerary's longest possible
+*						length is reserved up front, so the buffer is checked for room once per
+*						itinerary rather than once per piece of it.
+*
+*						A binary record is a run of 32-bit little-endian integers:
+*						  length		The bytes in the record after this field.
+*						  line			The query's line in the batch.
+*						  flights		The number of flights, 0 if the destination can't be
+*										reached, or -1 for an error.
+*						An error record ends with its message, as bytes with no null. Any other
+*						record goes on with the origin and destination cityIDs and the start time,
+*						then, if there are flights, the arrival and the travel time, and for each
+*						flight its index in the timetable's departures[], its origin and
+*						destination, and when it leaves and lands. Times are in minutes since
+*						local midnight on the start day, at the airport they happen at.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+// An airport's strings, ready to be copied into output.
+typedef struct
+{
+	const char* name;				// The name, as printed to the user.
+	const char* jsonName;			// The name as a quoted, escaped JSON string.
+	const char* standardName;		// The timezone's name on standard time.
+	const char* daylightName;		// The timezone's name on daylight saving time.
+	int nameLength;
+	int jsonNameLength;
+	int standardNameLength;
+	int daylightNameLength;
+} AirportLabel;
+
+/* Each airport's strings, by cityID. [0] is for a cityID out of range, which is printed as
+"Invalid" with no timezone. Built by buildAirportLabels(); empty until then. */
+static AirportLabel* airportLabels = NULL;
+static char* labelText = NULL;		// Where the labels' strings are kept.
+static int longestLabel = 0;		// The longest of any of the strings above.
+
+
+
+static const AirportLabel* labelOf(int cityID);
+static char* reserveOutput(OutputBuffer* buffer, size_t count);
+static char* putText(char* to, const char* text, int length);
+static char* putNumber(char* to, int value);
+static char* putHHMM(char* to, int timeInMinutes);
+static char* putBinary(char* to, int value);
+static char* putClockTime(char* to, int timeInMinutes, int cityID);
+static char* putDuration(char* to, int timeInMinutes);
+static char* putJSONString(char* to, const char* text);
+static int jsonStringLength(const char* text);
+
+
+
+/*
+* Function:			buildAirportLabels()
+* Description:		Works out every airport's strings for the loaded timetable, so itineraries
+*					can be written without formatting any names. Must be called again whenever
+*					the timetable changes.
+* Return Values:	1 if the labels were built, 0 if there wasn't enough memory.
+*/
+int buildAirportLabels(void)
+{
+	const Timetable* network = flightTimetable();
+	size_t textSize = 0;
+	char* next = NULL;
+
+	freeAirportLabels();
+
+	airportLabels = (AirportLabel*)calloc(network->airportCount + 1, sizeof(AirportLabel));
+	if (airportLabels == NULL)
+	{
+		return 0;
+	}
+
+	// <Label size loop>
+	// Every string is kept with a null after it too, for anything that wants one.
+	textSize = (size_t)jsonStringLength("Invalid") + 1 + strlen("Invalid") + 1 + 2;
+
+	for (int i = 1; i <= network->airportCount; i++)
+	{
+		const AirportInfo* airport = &network->airports[i];
+
+		textSize += strlen(airport->name) + 1 + (size_t)jsonStringLength(airport->name) + 1
+			+ strlen(airport->standardName) + 1 + strlen(airport->daylightName) + 1;
+	} // End of label size loop.
+
+	labelText = (char*)malloc(textSize);
+	if (labelText == NULL)
+	{
+		freeAirportLabels();
+		return 0;
+	}
+
+	next = labelText;
+	longestLabel = 0;
+
+	// <Label loop>
+	for (int i = 0; i <= network->airportCount; i++)
+	{
+		AirportLabel* label = &airportLabels[i];
+		const char* name = (i == 0) ? "Invalid" : network->airports[i].name;
+		const char* standardName = (i == 0) ? "" : network->airports[i].standardName;
+		const char* daylightName = (i == 0) ? "" : network->airports[i].daylightName;
+
+		label->name = next;
+		label->nameLength = (int)strlen(name);
+		next = putText(next, name, label->nameLength);
+		*next++ = '\0';
+
+		label->jsonName = next;
+		label->jsonNameLength = jsonStringLength(name);
+		next = putJSONString(next, name);
+		*next++ = '\0';
+
+		label->standardName = next;
+		label->standardNameLength = (int)strlen(standardName);
+		next = putText(next, standardName, label->standardNameLength);
+		*next++ = '\0';
+
+		label->daylightName = next;
+		label->daylightNameLength = (int)strlen(daylightName);
+		next = putText(next, daylightName, label->daylightNameLength);
+		*next++ = '\0';
+
+		if (label->jsonNameLength > longestLabel)
+		{
+			longestLabel = label->jsonNameLength;
+		}
+		if (label->standardNameLength > longestLabel)
+		{
+			longestLabel = label->standardNameLength;
+		}
+		if (label->daylightNameLength > longestLabel)
+		{
+			longestLabel = label->daylightNameLength;
+		}
+	} // End of label loop.
+
+	return 1;
+}
+
+
+
+/*
+* Function:			freeAirportLabels()
+* Description:		Releases the airports' strings.
+*/
+void freeAirportLabels(void)
+{
+	free(airportLabels);
+	free(labelText);
+
+	airportLabels = NULL;
+	labelText = NULL;
+	longestLabel = 0;
+}
+
+
+
+/*
+* Function:			writeItinerary()
+* Description:		Writes the result of one query as a JSON line, a TSV row or a binary record.
+*					JSON and TSV times are given as local HHMM at each airport, with the number
+*					of days after the start day (0 for the same day).
+* Parameters:		OutputBuffer* output		Where to write.
+*					int format					kJSONOutput, kTSVOutput or kBinaryOutput.
+*					int lineNumber				The query's line in the batch file.
+*					int originCity				The query's origin.
+*					int destinationCity			The query's destination.
+*					int startTime				The start time, in minutes since local midnight.
+*					const Flight* flightPlan[]	The plan from createFastestFlightplan().
+*					const SearchCounters* counters	The query's search counters, or NULL to
+*													leave them out. Never given for binary.
+*/
+void writeItinerary(OutputBuffer* output, int format, int lineNumber, int originCity,
+	int destinationCity, int startTime, const Flight* flightPlan[],
+	const SearchCounters* counters)
+{
+	const Timetable* network = flightTimetable();
+	const AirportLabel* origin = labelOf(originCity);
+	const AirportLabel* destination = labelOf(destinationCity);
+
+	int startTimeUTC = startTime - timezoneOffset(originCity);
+	int groundTime = startTimeUTC;
+	int flightCount = 0;
+
+	int arrivalLocal = 0;
+	int arrivalDay = 0;
+
+	char* recordStart = NULL;
+	char* to = NULL;
+
+	while (flightPlan[flightCount] != NULL)
+	{
+		flightCount++;
+	}
+
+	if (flightCount > 0)
+	{
+		for (int i = 0; i < flightCount; i++)
+		{
+			groundTime = nextDepartureUTC(flightPlan[i], groundTime)
+				+ flightPlan[i]->flightDuration;
+		}
+
+		arrivalLocal = groundTime + timezoneOffsetAt(destinationCity, groundTime);
+		arrivalDay = dayOfTime(arrivalLocal);
+	}
+
+	to = reserveOutput(output,
+		(size_t)(flightCount + 1) * (kItineraryFixedBytes + 4 * longestLabel));
+	if (to == NULL)
+	{
+		return;
+	}
+	recordStart = to;
+
+	if (format == kJSONOutput)
+	{
+		to = putText(to, "{\"line\":", 8);
+		to = putNumber(to, lineNumber);
+		to = putText(to, ",\"origin\":", 10);
+		to = putText(to, origin->jsonName, origin->jsonNameLength);
+		to = putText(to, ",\"destination\":", 15);
+		to = putText(to, destination->jsonName, destination->jsonNameLength);
+		to = putText(to, ",\"start\":\"", 10);
+		to = putHHMM(to, startTime);
+		*to++ = '"';
+
+		if (flightCount == 0)
+		{
+			to = putText(to, ",\"reachable\":false", 18);
+		}
+		else
+		{
+			to = putText(to, ",\"reachable\":true,\"arrival\":\"", 29);
+			to = putHHMM(to, arrivalLocal - arrivalDay * kMinutesPerDay);
+			to = putText(to, "\",\"arrivalDay\":", 15);
+			to = putNumber(to, arrivalDay);
+			to = putText(to, ",\"travelMinutes\":", 17);
+			to = putNumber(to, groundTime - startTimeUTC);
+			to = putText(to, ",\"flights\":[", 12);
+
+			groundTime = startTimeUTC;
+
+			for (int i = 0; i < flightCount; i++)
+			{
+				const Flight* flight = flightPlan[i];
+				const AirportLabel* from = labelOf(flight->originCity);
+				const AirportLabel* towards = labelOf(flight->destinationCity);
+				int departureTime = nextDepartureUTC(flight, groundTime);
+				int departureLocal = departureTime
+					+ timezoneOffsetAt(flight->originCity, departureTime);
+				int departureDay = dayOfTime(departureLocal);
+				int landingLocal = 0;
+				int landingDay = 0;
+
+				groundTime = departureTime + flight->flightDuration;
+				landingLocal = groundTime
+					+ timezoneOffsetAt(flight->destinationCity, groundTime);
+				landingDay = dayOfTime(landingLocal);
+
+				if (i > 0)
+				{
+					*to++ = ',';
+				}
+				to = putText(to, "{\"from\":", 8);
+				to = putText(to, from->jsonName, from->jsonNameLength);
+				to = putText(to, ",\"to\":", 6);
+				to = putText(to, towards->jsonName, towards->jsonNameLength);
+				to = putText(to, ",\"departure\":\"", 14);
+				to = putHHMM(to, departureLocal - departureDay * kMinutesPerDay);
+				to = putText(to, "\",\"departureDay\":", 17);
+				to = putNumber(to, departureDay);
+				to = putText(to, ",\"arrival\":\"", 12);
+				to = putHHMM(to, landingLocal - landingDay * kMinutesPerDay);
+				to = putText(to, "\",\"arrivalDay\":", 15);
+				to = putNumber(to, landingDay);
+				*to++ = '}';
+			}
+
+			*to++ = ']';
+		}
+
+		output->length = (size_t)(to - output->text);
+
+		if (counters != NULL)
+		{
+			appendBytes(output, ",\"counters\":", 12);
+			writeSearchCounters(output, format, counters);
+		}
+
+		appendBytes(output, "}\n", 2);
+	}
+	else if (format == kTSVOutput)
+	{
+		to = putNumber(to, lineNumber);
+		*to++ = '\t';
+		to = putText(to, origin->name, origin->nameLength);
+		*to++ = '\t';
+		to = putText(to, destination->name, destination->nameLength);
+		*to++ = '\t';
+		to = putHHMM(to, startTime);
+		*to++ = '\t';
+
+		if (flightCount == 0)
+		{
+			to = putText(to, "\t\t\t0\t", 5);
+		}
+		else
+		{
+			to = putHHMM(to, arrivalLocal - arrivalDay * kMinutesPerDay);
+			*to++ = '\t';
+			to = putNumber(to, arrivalDay);
+			*to++ = '\t';
+			to = putNumber(to, groundTime - startTimeUTC);
+			*to++ = '\t';
+			to = putNumber(to, flightCount);
+			*to++ = '\t';
+
+			// The plan as "Origin HHMM>Destination HHMM" per flight, separated by semicolons.
+			groundTime = startTimeUTC;
+
+			for (int i = 0; i < flightCount; i++)
+			{
+				const Flight* flight = flightPlan[i];
+				const AirportLabel* from = labelOf(flight->originCity);
+				const AirportLabel* towards = labelOf(flight->destinationCity);
+				int departureTime = nextDepartureUTC(flight, groundTime);
+				int departureLocal = departureTime
+					+ timezoneOffsetAt(flight->originCity, departureTime);
+				int landingLocal = 0;
+
+				groundTime = departureTime + flight->flightDuration;
+				landingLocal = groundTime
+					+ timezoneOffsetAt(flight->destinationCity, groundTime);
+
+				if (i > 0)
+				{
+					*to++ = ';';
+				}
+				to = putText(to, from->name, from->nameLength);
+				*to++ = ' ';
+				to = putHHMM(to, departureLocal - dayOfTime(departureLocal) * kMinutesPerDay);
+				*to++ = '>';
+				to = putText(to, towards->name, towards->nameLength);
+				*to++ = ' ';
+				to = putHHMM(to, landingLocal - dayOfTime(landingLocal) * kMinutesPerDay);
+			}
+		}
+
+		output->length = (size_t)(to - output->text);
+
+		if (counters != NULL)
+		{
+			writeSearchCounters(output, format, counters);
+		}
+
+		appendBytes(output, "\n", 1);
+	}
+	else
+	{
+		// The length goes in once the rest of the record is written.
+		to = putBinary(to, 0);
+		to = putBinary(to, lineNumber);
+		to = putBinary(to, flightCount);
+		to = putBinary(to, originCity);
+		to = putBinary(to, destinationCity);
+		to = putBinary(to, startTime);
+
+		if (flightCount > 0)
+		{
+			to = putBinary(to, arrivalLocal);
+			to = putBinary(to, groundTime - startTimeUTC);
+
+			groundTime = startTimeUTC;
+
+			for (int i = 0; i < flightCount; i++)
+			{
+				const Flight* flight = flightPlan[i];
+				int departureTime = nextDepartureUTC(flight, groundTime);
+
+				groundTime = departureTime + flight->flightDuration;
+
+				to = putBinary(to, (int)(flight - network->departures));
+				to = putBinary(to, flight->originCity);
+				to = putBinary(to, flight->destinationCity);
+				to = putBinary(to,
+					departureTime + timezoneOffsetAt(flight->originCity, departureTime));
+				to = putBinary(to,
+					groundTime + timezoneOffsetAt(flight->destinationCity, groundTime));
+			}
+		}
+
+		putBinary(recordStart, (int)(to - recordStart) - 4);
+		output->length = (size_t)(to - output->text);
+	}
+}
+
+
+
+/*
+* Function:			writeItineraryText()
+* Description:		Writes a flight plan as the menu words it: every departure and arrival time
+*					(in local timezones) and the total travel time.
+* Parameters:		OutputBuffer* output		Where to write.
+*					int originCity				The ID of the starting airport.
+*					int destinationCity			The ID of the final destination.
+*					int startTime				The start time (in minutes since midnight local
+*												time) of the journey.
+*					const Flight* flightPlan[]	The chain of flights, ending in a NULL.
+*/
+void writeItineraryText(OutputBuffer* output, int originCity, int destinationCity,
+	const int startTime, const Flight* flightPlan[])
+{
+	const AirportLabel* origin = labelOf(originCity);
+	const AirportLabel* destination = labelOf(destinationCity);
+
+	int startTimeUTC = startTime - timezoneOffset(originCity);
+	int groundTime = startTimeUTC;
+	int flightCount = 0;
+	char* to = NULL;
+
+	while (flightPlan[flightCount] != NULL)
+	{
+		flightCount++;
+	}
+
+	to = reserveOutput(output,
+		(size_t)(flightCount + 1) * (kItineraryFixedBytes + 4 * longestLabel));
+	if (to == NULL)
+	{
+		return;
+	}
+
+	to = putText(to, "Flying from ", 12);
+	to = putText(to, origin->name, origin->nameLength);
+	to = putText(to, " to ", 4);
+	to = putText(to, destination->name, destination->nameLength);
+	to = putText(to, ".\n\nStarting from ", 17);
+	to = putText(to, origin->name, origin->nameLength);
+	to = putText(to, " at ", 4);
+	to = putClockTime(to, startTime, originCity);
+	to = putText(to, ".\n", 2);
+
+	// If the flightPlan is empty, there's no way to get there at all.
+	if (flightCount == 0)
+	{
+		to = putText(to, "There are no flights that reach ", 32);
+		to = putText(to, destination->name, destination->nameLength);
+		to = putText(to, " from ", 6);
+		to = putText(to, origin->name, origin->nameLength);
+		to = putText(to, ".\n", 2);
+		output->length = (size_t)(to - output->text);
+		return;
+	}
+
+	for (int i = 0; i < flightCount; i++)
+	{
+		int flightOrigin = flightPlan[i]->originCity;
+		int flightDestination = flightPlan[i]->destinationCity;
+		const AirportLabel* from = labelOf(flightOrigin);
+		const AirportLabel* towards = labelOf(flightDestination);
+
+		// As in the search, a flight leaving at exactly the ground time has been missed.
+		int departureTime = nextDepartureUTC(flightPlan[i], groundTime);
+
+		groundTime = departureTime + flightPlan[i]->flightDuration;
+
+		to = putText(to, "Leaving ", 8);
+		to = putText(to, from->name, from->nameLength);
+		to = putText(to, " at ", 4);
+		to = putClockTime(to, departureTime + timezoneOffsetAt(flightOrigin, departureTime),
+			flightOrigin);
+		to = putText(to, " for ", 5);
+		to = putText(to, towards->name, towards->nameLength);
+		to = putText(to, ".\nArriving in ", 14);
+		to = putText(to, towards->name, towards->nameLength);
+		to = putText(to, " at ", 4);
+		to = putClockTime(to, groundTime + timezoneOffsetAt(flightDestination, groundTime),
+			flightDestination);
+		to = putText(to, ".\n", 2);
+	}
+
+	// Layovers and flights alike, from the start to the final landing.
+	to = putText(to, "\nTotal travel time: ", 20);
+	to = putDuration(to, groundTime - startTimeUTC);
+	to = putText(to, ".\n", 2);
+
+	output->length = (size_t)(to - output->text);
+}
+
+
+
+/*
+* Function:			appendAirportJSON()
+* Description:		Writes an airport's name as a quoted, escaped JSON string.
+* Parameters:		OutputBuffer* output	Where to write.
+*					int cityID				The airport.
+*/
+void appendAirportJSON(OutputBuffer* output, int cityID)
+{
+	const AirportLabel* label = labelOf(cityID);
+
+	appendBytes(output, label->jsonName, label->jsonNameLength);
+}
+
+
+
+/*
+* Function:			appendBinaryField()
+* Description:		Writes one field of a binary record: a 32-bit little-endian integer.
+* Parameters:		OutputBuffer* output	Where to write.
+*					int value				The field.
+*/
+void appendBinaryField(OutputBuffer* output, int value)
+{
+	char field[4];
+
+	putBinary(field, value);
+	appendBytes(output, field, 4);
+}
+
+
+
+/*
+* Function:			appendBytes()
+* Description:		Adds raw bytes to the end of an OutputBuffer, growing it if there isn't
+*					room. Unlike appendOutput(), the bytes may hold anything, nulls included.
+* Parameters:		OutputBuffer* buffer	The buffer to add to.
+*					const char* bytes		The bytes to add.
+*					size_t count			How many bytes there are.
+* Return Values:	1 if the bytes were added, 0 if there wasn't enough memory.
+*/
+int appendBytes(OutputBuffer* buffer, const char* bytes, size_t count)
+{
+	char* to = reserveOutput(buffer, count);
+
+	if (to == NULL)
+	{
+		return 0;
+	}
+
+	memcpy(to, bytes, count);
+	buffer->length += count;
+
+	return 1;
+}
+
+
+
+/*
+* Function:			labelOf()
+* Description:		Finds an airport's strings.
+* Parameters:		int cityID		The airport.
+* Return Values:	Its label, or the "Invalid" label for a cityID out of range.
+*/
+static const AirportLabel* labelOf(int cityID)
+{
+	if (checkRange(cityID, 1, flightTimetable()->airportCount))
+	{
+		return &airportLabels[cityID];
+	}
+
+	return &airportLabels[0];
+}
+
+
+
+/*
+* Function:			reserveOutput()
+* Description:		Makes room for count more bytes at the end of an OutputBuffer, growing it if
+*					it must. The buffer's length isn't changed; the caller sets it once the bytes
+*					are written.
+* Parameters:		OutputBuffer* buffer	The buffer to make room in.
+*					size_t count			The most bytes that will be written.
+* Return Values:	Where to write the bytes, or NULL if there wasn't enough memory.
+*/
+static char* reserveOutput(OutputBuffer* buffer, size_t count)
+{
+	if (buffer->length + count > buffer->capacity)
+	{
+		size_t newCapacity = (buffer->capacity == 0) ? 4096 : buffer->capacity * 2;
+		char* newText = NULL;
+
+		while (buffer->length + count > newCapacity)
+		{
+			newCapacity *= 2;
+		}
+
+		newText = (char*)realloc(buffer->text, newCapacity);
+		if (newText == NULL)
+		{
+			return NULL;
+		}
+
+		buffer->text = newText;
+		buffer->capacity = newCapacity;
+	}
+
+	return buffer->text + buffer->length;
+}
+
+
+
+/*
+* Function:			putText()
+* Description:		Copies a string of known length.
+* Parameters:		char* to				Where to write.
+*					const char* text		The string.
+*					int length				How many characters to copy.
+* Return Values:	Where the next character goes.
+*/
+static char* putText(char* to, const char* text, int length)
+{
+	memcpy(to, text, (size_t)length);
+
+	return to + length;
+}
+
+
+
+/*
+* Function:			putNumber()
+* Description:		Writes an integer in decimal, as printf("%d") would.
+* Parameters:		char* to		Where to write.
+*					int value		The integer.
+* Return Values:	Where the next character goes.
+*/
+static char* putNumber(char* to, int value)
+{
+	// Worked out from the last digit back, so the digits are collected in reverse.
+	char digits[10];
+	int digitCount = 0;
+	unsigned int magnitude = (value < 0) ? 0u - (unsigned int)value : (unsigned int)value;
+
+	if (value < 0)
+	{
+		*to++ = '-';
+	}
+
+	do
+	{
+		digits[digitCount] = (char)('0' + magnitude % 10);
+		digitCount++;
+		magnitude /= 10;
+	} while (magnitude > 0);
+
+	while (digitCount > 0)
+	{
+		digitCount--;
+		*to++ = digits[digitCount];
+	}
+
+	return to;
+}
+
+
+
+/*
+* Function:			putHHMM()
+* Description:		Writes a time of day as four digits, as printf("%04d", timeAsHHMM()) would.
+* Parameters:		char* to				Where to write.
+*					int timeInMinutes		The time, 0 up to kMinutesPerDay.
+* Return Values:	Where the next character goes.
+*/
+static char* putHHMM(char* to, int timeInMinutes)
+{
+	int hours = timeInMinutes / kMinutesPerHour;
+	int minutes = timeInMinutes % kMinutesPerHour;
+
+	to[0] = (char)('0' + hours / 10);
+	to[1] = (char)('0' + hours % 10);
+	to[2] = (char)('0' + minutes / 10);
+	to[3] = (char)('0' + minutes % 10);
+
+	return to + 4;
+}
+
+
+
+/*
+* Function:			putBinary()
+* Description:		Writes a 32-bit integer, least significant byte first, whatever order the
+*					computer keeps it in.
+* Parameters:		char* to		Where to write.
+*					int value		The integer.
+* Return Values:	Where the next byte goes.
+*/
+static char* putBinary(char* to, int value)
+{
+	unsigned int bits = (unsigned int)value;
+
+	to[0] = (char)(bits & 0xff);
+	to[1] = (char)((bits >> 8) & 0xff);
+	to[2] = (char)((bits >> 16) & 0xff);
+	to[3] = (char)((bits >> 24) & 0xff);
+
+	return to + 4;
+}
+
+
+
+/*
+* Function:			putClockTime()
+* Description:		Writes a time as printClockTime() prints it: on a 12 hour clock, with
+*					a.m./p.m., the timezone, and which day it falls on, if not the first.
+* Parameters:		char* to				Where to write.
+*					int timeInMinutes		The time in minutes since midnight, local time, of
+*											the first day. May be on a later (or earlier) day.
+*					int cityID				The city, for the timezone's name.
+* Return Values:	Where the next character goes.
+*/
+static char* putClockTime(char* to, int timeInMinutes, int cityID)
+{
+	const AirportLabel* label = labelOf(cityID);
+	int day = dayOfTime(timeInMinutes);
+	int timeOfDay = timeInMinutes - day * kMinutesPerDay;
+	int hours = timeOfDay / kMinutesPerHour;
+	int minutes = timeOfDay % kMinutesPerHour;
+	int isAfternoon = (hours >= (kHoursPerDay / 2)) ? 1 : 0;
+
+	if (isAfternoon == 1)
+	{
+		hours -= kHoursPerDay / 2;
+	}
+
+	// For 12 a.m. and 12 p.m.
+	if (hours == 0)
+	{
+		hours = 12;
+	}
+
+	to = putNumber(to, hours);
+	*to++ = ':';
+	*to++ = (char)('0' + minutes / 10);
+	*to++ = (char)('0' + minutes % 10);
+	to = putText(to, (isAfternoon == 1) ? " p.m. " : " a.m. ", 6);
+	if (isDaylightTime(cityID, timeInMinutes) == 1)
+	{
+		to = putText(to, label->daylightName, label->daylightNameLength);
+	}
+	else
+	{
+		to = putText(to, label->standardName, label->standardNameLength);
+	}
+
+	if (day == 1)
+	{
+		to = putText(to, " the next day", 13);
+	}
+	else if (day > 1)
+	{
+		*to++ = ' ';
+		to = putNumber(to, day);
+		to = putText(to, " days later", 11);
+	}
+	else if (day < 0)
+	{
+		to = putText(to, " the day before", 15);
+	}
+
+	return to;
+}
+
+
+
+/*
+* Function:			putDuration()
+* Description:		Writes a length of time in H:MM format, as printTime() prints it.
+* Parameters:		char* to				Where to write.
+*					int timeInMinutes		The length of time, in minutes.
+* Return Values:	Where the next character goes.
+*/
+static char* putDuration(char* to, int timeInMinutes)
+{
+	int minutes = timeAsHHMM(timeInMinutes) % 100;
+
+	to = putNumber(to, timeAsHHMM(timeInMinutes) / 100);
+	*to++ = ':';
+	*to++ = (char)('0' + minutes / 10);
+	*to++ = (char)('0' + minutes % 10);
+
+	return to;
+}
+
+
+
+/*
+* Function:			putJSONString()
+* Description:		Writes a string as a quoted, escaped JSON string, as batch.c's
+*					writeJSONString() does.
+* Parameters:		char* to				Where to write. Must have room for
+*											jsonStringLength(text) characters.
+*					const char* text		The string.
+* Return Values:	Where the next character goes.
+*/
+static char* putJSONString(char* to, const char* text)
+{
+	static const char hexDigits[] = "0123456789abcdef";
+
+	*to++ = '"';
+
+	for (; *text != '\0'; text++)
+	{
+		unsigned char character = (unsigned char)*text;
+
+		if ((character == '"') || (character == '\\'))
+		{
+			*to++ = '\\';
+			*to++ = (char)character;
+		}
+		else if (character < 0x20)
+		{
+			to = putText(to, "\\u00", 4);
+			*to++ = hexDigits[character >> 4];
+			*to++ = hexDigits[character & 0xf];
+		}
+		else
+		{
+			*to++ = (char)character;
+		}
+	}
+
+	*to++ = '"';
+
+	return to;
+}
+
+
+
+/*
+* Function:			jsonStringLength()
+* Description:		Works out how long a string is once written by putJSONString().
+* Parameters:		const char* text		The string.
+* Return Values:	The length, quotes included.
+*/
+static int jsonStringLength(const char* text)
+{
+	int length = 2;
+
+	for (; *text != '\0'; text++)
+	{
+		unsigned char character = (unsigned char)*text;
+
+		if ((character == '"') || (character == '\\'))
+		{
+			length += 2;
+		}
+		else if (character < 0x20)
+		{
+			length += 6;
+		}
+		else
+		{
+			length++;
+		}
+	}
+
+	return length;
+}
@@ -0,0 +1,830 @@
+/*
+* Filename:				server.c
+* Description:			Server mode for the Amazing Race flight planner (--serve). The timetable
+*						is loaded once, and queries are then taken over a local Unix domain socket
+*						for as long as the program runs, so a caller on the same host pays neither
+*						process startup nor the timetable load for each query.
+*
+*						The protocol is the batch file's, over a stream: the client writes query
+*						lines, and gets back one result line per query, in the order asked, in
+*						the --format given. Line numbers in the results count from 1 on each
+*						connection. A client may write many lines without waiting for their
+*						answers, and may shut down its side of the socket once it has written
+*						the last one; the rest of the answers still come back before the server
+*						closes the connection.
+*
+*						The main thread runs an epoll loop: it accepts connections, reads what
+*						they send and writes back what has been answered, never blocking on any
+*						one client. A connection with whole lines waiting goes on a ready queue,
+*						and the worker threads (--threads) take connections from it and answer
+*						their lines with answerQueryLine(), as batch mode does. Only one worker
+*						has a connection at a time, so its answers stay in order. A client that
+*						doesn't read its answers stops being read from until it catches up.
+*
+*						SIGINT or SIGTERM stops the server cleanly. epoll is Linux only, so
+*						elsewhere --serve just reports that it isn't supported.
+*/
+
+// memrchr() and accept4() are GNU extensions.
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "dijkstra_example.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+
+#pragma warning(disable: 4996)
+
+
+
+#ifdef __linux__
+
+// - Server constants
+#define kServerEvents 256				// epoll events taken at a time.
+#define kServerReadSize 65536			// Bytes read from a client at a time.
+#define kServerLineMax 65536			// Most unanswered bytes a client may send without a newline.
+#define kServerOutputMax (1 << 20)		// Unsent answers at which a client stops being read.
+
+// One client connection. Only the main thread creates, watches and frees connections.
+typedef struct ServerConnection
+{
+	int socket;						// The client's socket.
+	OutputBuffer input;				// Bytes read from the client and not yet answered.
+	OutputBuffer output;			// Answers not yet sent to the client.
+	size_t outputSent;				// How much of output has been sent.
+	int lineNumber;					// Lines answered so far. Only touched by the worker.
+	unsigned int watchedEvents;		// The epoll events the socket is watched for. 0 if it has
+									// been taken out of the epoll set.
+
+	int isQueued;					// 1 while on the ready queue, or being answered.
+	int isFlushQueued;				// 1 while on the flush list.
+	int isInputClosed;				// 1 once the client has sent everything it will.
+	int isBroken;					// 1 if the connection failed, and is to be dropped.
+
+	struct ServerConnection* nextReady;		// The next connection on the ready queue.
+	struct ServerConnection* nextFlush;		// The next connection on the flush list.
+	struct ServerConnection* previous;		// The connections list, for freeing them all.
+	struct ServerConnection* next;
+} ServerConnection;
+
+/* What the main thread and the workers share. The lock is held while changing the queues, or
+any connection's input, output or flags. */
+typedef struct
+{
+	const ProgramOptions* options;
+
+	int listenSocket;
+	int epollHandle;
+	int wakeEvent;					// An eventfd the workers write to once output is ready.
+	int signalEvent;				// A signalfd for SIGINT and SIGTERM.
+	ServerConnection* connections;	// Every open connection. Main thread only.
+	int isListenPaused;				// 1 while out of handles for new connections.
+
+	ServerConnection* readyHead;	// Connections with whole lines waiting, oldest first.
+	ServerConnection* readyTail;
+	ServerConnection* flushHead;	// Connections a worker has added output to.
+	int isStopping;					// 1 once the workers should finish.
+
+	WorkerLock lock;
+	WorkerSignal connectionReady;	// Sent when a connection goes on the ready queue.
+} QueryServer;
+
+// What each worker thread is given: the shared server, and its own working memory.
+typedef struct
+{
+	QueryServer* server;
+	QueryScratch scratch;
+	OutputBuffer lines;				// The lines taken from a connection.
+	OutputBuffer output;			// Their answers, before they are handed back.
+} ServerWorker;
+
+
+
+static int openListenSocket(const char* socketPath);
+static int watchServerHandle(QueryServer* server, int handle, void* tag);
+static void acceptConnections(QueryServer* server);
+static void readConnection(QueryServer* server, ServerConnection* connection);
+static void flushConnection(QueryServer* server, ServerConnection* connection);
+static void updateConnection(QueryServer* server, ServerConnection* connection);
+static void closeConnection(QueryServer* server, ServerConnection* connection);
+static void queueConnection(QueryServer* server, ServerConnection* connection);
+static void answerConnections(void* worker);
+
+#endif
+
+
+
+/*
+* Function:			runServer()
+* Description:		Answers queries over a Unix domain socket until SIGINT or SIGTERM.
+* Parameters:		const ProgramOptions* options	The socket path, engine, output format and
+*													thread count.
+* Return Values:	0 if the server ran and stopped cleanly, 1 if it couldn't be started.
+*/
+int runServer(const ProgramOptions* options)
+{
+#ifdef __linux__
+	QueryServer server;
+	int threadCount = (options->threadCount > 0) ? options->threadCount : processorCount();
+	ServerWorker* workers = (ServerWorker*)calloc(threadCount, sizeof(ServerWorker));
+	WorkerThread* threads = (WorkerThread*)calloc(threadCount, sizeof(WorkerThread));
+	struct epoll_event* events = (struct epoll_event*)calloc(kServerEvents,
+		sizeof(struct epoll_event));
+	SearchCounters searchTotals = { 0 };
+	sigset_t stopSignals;
+
+	int startedThreads = 0;
+	int isValid = 1;
+
+	memset(&server, 0, sizeof(server));
+	server.options = options;
+	server.listenSocket = -1;
+	server.epollHandle = -1;
+	server.wakeEvent = -1;
+	server.signalEvent = -1;
+
+	if ((workers == NULL) || (threads == NULL) || (events == NULL))
+	{
+		fprintf(stderr, "Not enough memory for %d server thread%s.\n", threadCount,
+			(threadCount > 1) ? "s" : "");
+		free(workers);
+		free(threads);
+		free(events);
+		return 1;
+	}
+
+	/* The stop signals are read from a signalfd, so they mustn't be delivered the usual way.
+	Blocking them before any worker starts blocks them in every worker too. */
+	sigemptyset(&stopSignals);
+	sigaddset(&stopSignals, SIGINT);
+	sigaddset(&stopSignals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stopSignals, NULL);
+
+	server.listenSocket = openListenSocket(options->serverSocket);
+	server.epollHandle = epoll_create1(EPOLL_CLOEXEC);
+	server.wakeEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	server.signalEvent = signalfd(-1, &stopSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	if ((server.listenSocket < 0) || (server.epollHandle < 0) || (server.wakeEvent < 0)
+		|| (server.signalEvent < 0)
+		|| (watchServerHandle(&server, server.listenSocket, &server.listenSocket) == 0)
+		|| (watchServerHandle(&server, server.wakeEvent, &server.wakeEvent) == 0)
+		|| (watchServerHandle(&server, server.signalEvent, &server.signalEvent) == 0))
+	{
+		if (server.listenSocket >= 0)
+		{
+			fprintf(stderr, "Unable to start the server's event loop.\n");
+		}
+		isValid = 0;
+	}
+
+	initWorkerLock(&server.lock);
+	initWorkerSignal(&server.connectionReady);
+
+	for (int i = 0; (i < threadCount) && (isValid == 1); i++)
+	{
+		workers[i].server = &server;
+
+		if (initQueryScratch(&workers[i].scratch) == 0)
+		{
+			fprintf(stderr, "Not enough memory for %d airports.\n", flightTimetable()->airportCount);
+			isValid = 0;
+			break;
+		}
+		if (startWorkerThread(&threads[i], answerConnections, &workers[i]) == 0)
+		{
+			fprintf(stderr, "Unable to start server thread %d.\n", i + 1);
+			freeQueryScratch(&workers[i].scratch);
+			isValid = 0;
+			break;
+		}
+
+		startedThreads++;
+	}
+
+	if (isValid == 1)
+	{
+		fprintf(stderr, "Answering queries on %s with %d thread%s.\n", options->serverSocket,
+			threadCount, (threadCount > 1) ? "s" : "");
+	}
+
+	// <Event loop>
+	// Runs until a stop signal arrives.
+	while ((isValid == 1) && (server.isStopping == 0))
+	{
+		int eventCount = epoll_wait(server.epollHandle, events, kServerEvents, -1);
+
+		if ((eventCount < 0) && (errno != EINTR))
+		{
+			fprintf(stderr, "The server's event loop failed.\n");
+			break;
+		}
+
+		for (int i = 0; i < eventCount; i++)
+		{
+			void* tag = events[i].data.ptr;
+
+			if (tag == &server.listenSocket)
+			{
+				acceptConnections(&server);
+			}
+			else if (tag == &server.signalEvent)
+			{
+				lockWorkers(&server.lock);
+				server.isStopping = 1;
+				unlockWorkers(&server.lock);
+			}
+			else if (tag == &server.wakeEvent)
+			{
+				ServerConnection* connection = NULL;
+				unsigned long long wakeCount = 0;
+
+				// Reading the counter resets it. Nothing else is needed from it.
+				if (read(server.wakeEvent, &wakeCount, sizeof(wakeCount)) < 0)
+				{
+					continue;
+				}
+
+				// Take the whole flush list, then send what each connection now has.
+				lockWorkers(&server.lock);
+				connection = server.flushHead;
+				server.flushHead = NULL;
+				for (ServerConnection* c = connection; c != NULL; c = c->nextFlush)
+				{
+					c->isFlushQueued = 0;
+				}
+				unlockWorkers(&server.lock);
+
+				while (connection != NULL)
+				{
+					ServerConnection* nextConnection = connection->nextFlush;
+
+					flushConnection(&server, connection);
+					connection = nextConnection;
+				}
+			}
+			else
+			{
+				ServerConnection* connection = (ServerConnection*)tag;
+
+				if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0)
+				{
+					readConnection(&server, connection);
+				}
+				if ((events[i].events & EPOLLOUT) != 0)
+				{
+					flushConnection(&server, connection);
+				}
+				else
+				{
+					updateConnection(&server, connection);
+				}
+			}
+		}
+	} // End of event loop.
+
+	// Let every worker know there's nothing more coming, and wait for them to stop.
+	lockWorkers(&server.lock);
+	server.isStopping = 1;
+	broadcastSignal(&server.connectionReady);
+	unlockWorkers(&server.lock);
+
+	for (int i = 0; i < startedThreads; i++)
+	{
+		joinWorkerThread(threads[i]);
+		addSearchCounters(&searchTotals, &workers[i].scratch.searchTotals);
+		freeQueryScratch(&workers[i].scratch);
+		freeOutputBuffer(&workers[i].lines);
+		freeOutputBuffer(&workers[i].output);
+	}
+
+	while (server.connections != NULL)
+	{
+		closeConnection(&server, server.connections);
+	}
+
+	if (server.listenSocket >= 0)
+	{
+		close(server.listenSocket);
+		unlink(options->serverSocket);
+	}
+	if (server.epollHandle >= 0)
+	{
+		close(server.epollHandle);
+	}
+	if (server.wakeEvent >= 0)
+	{
+		close(server.wakeEvent);
+	}
+	if (server.signalEvent >= 0)
+	{
+		close(server.signalEvent);
+	}
+
+	freeWorkerSignal(&server.connectionReady);
+	freeWorkerLock(&server.lock);
+
+	free(events);
+	free(threads);
+	free(workers);
+
+	if ((isValid == 1) && (options->searchCounters == kTotalCounters))
+	{
+		printSearchCounters(&searchTotals);
+	}
+
+	return (isValid == 1) ? 0 : 1;
+#else
+	fprintf(stderr, "--serve needs epoll, so it only works on Linux.\n");
+	return 1;
+#endif
+}
+
+
+
+#ifdef __linux__
+
+/*
+* Function:			openListenSocket()
+* Description:		Creates the server's Unix domain socket and starts listening on it. A socket
+*					left behind by a server that didn't stop cleanly is replaced.
+* Parameters:		const char* socketPath		Where to create the socket.
+* Return Values:	The listening socket, or -1 if it couldn't be opened.
+*/
+static int openListenSocket(const char* socketPath)
+{
+	struct sockaddr_un address;
+	struct stat existing;
+	int listenSocket = -1;
+
+	if (strlen(socketPath) >= sizeof(address.sun_path))
+	{
+		fprintf(stderr, "The socket path \"%s\" is too long.\n", socketPath);
+		return -1;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, socketPath);
+
+	// Only ever remove a socket, never a file that happens to have the same name.
+	if ((stat(socketPath, &existing) == 0) && (S_ISSOCK(existing.st_mode)))
+	{
+		unlink(socketPath);
+	}
+
+	listenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+	if ((listenSocket < 0)
+		|| (bind(listenSocket, (struct sockaddr*)&address, sizeof(address)) != 0)
+		|| (listen(listenSocket, SOMAXCONN) != 0))
+	{
+		fprintf(stderr, "Unable to listen on the socket \"%s\".\n", socketPath);
+		if (listenSocket >= 0)
+		{
+			close(listenSocket);
+		}
+		return -1;
+	}
+
+	return listenSocket;
+}
+
+
+
+/*
+* Function:			watchServerHandle()
+* Description:		Adds one of the server's own handles (not a connection) to the epoll set.
+* Parameters:		QueryServer* server		The server.
+*					int handle				The handle to watch for input.
+*					void* tag				What its events are reported with.
+* Return Values:	1 if it is being watched, 0 if it couldn't be.
+*/
+static int watchServerHandle(QueryServer* server, int handle, void* tag)
+{
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = tag;
+
+	return (epoll_ctl(server->epollHandle, EPOLL_CTL_ADD, handle, &event) == 0);
+}
+
+
+
+/*
+* Function:			acceptConnections()
+* Description:		Accepts every connection waiting on the listening socket, and starts
+*					watching each for input. Main thread only.
+* Parameters:		QueryServer* server		The server.
+*/
+static void acceptConnections(QueryServer* server)
+{
+	while (1)
+	{
+		int clientSocket = accept4(server->listenSocket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		ServerConnection* connection = NULL;
+		struct epoll_event event;
+
+		if (clientSocket < 0)
+		{
+			/* Out of handles: the connection stays waiting until one is closed, so stop
+			watching for new ones until then rather than spinning on them. */
+			if (((errno == EMFILE) || (errno == ENFILE))
+				&& (epoll_ctl(server->epollHandle, EPOLL_CTL_DEL, server->listenSocket, NULL) == 0))
+			{
+				server->isListenPaused = 1;
+			}
+			break;
+		}
+
+		connection = (ServerConnection*)calloc(1, sizeof(ServerConnection));
+
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.ptr = connection;
+
+		if ((connection == NULL)
+			|| (epoll_ctl(server->epollHandle, EPOLL_CTL_ADD, clientSocket, &event) != 0))
+		{
+			close(clientSocket);
+			free(connection);
+			continue;
+		}
+
+		connection->socket = clientSocket;
+		connection->watchedEvents = EPOLLIN;
+		connection->next = server->connections;
+		if (server->connections != NULL)
+		{
+			server->connections->previous = connection;
+		}
+		server->connections = connection;
+	}
+}
+
+
+
+/*
+* Function:			readConnection()
+* Description:		Reads whatever a client has sent, and queues the connection for a worker
+*					if it now has whole lines waiting. Main thread only.
+* Parameters:		QueryServer* server				The server.
+*					ServerConnection* connection	The connection to read from.
+*/
+static void readConnection(QueryServer* server, ServerConnection* connection)
+{
+	char bytes[kServerReadSize];
+	ssize_t count = recv(connection->socket, bytes, sizeof(bytes), 0);
+
+	if ((count < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+	{
+		return;
+	}
+
+	lockWorkers(&server->lock);
+
+	if (count > 0)
+	{
+		if (appendBytes(&connection->input, bytes, (size_t)count) == 0)
+		{
+			connection->isBroken = 1;
+		}
+		else if (memchr(bytes, '\n', (size_t)count) != NULL)
+		{
+			queueConnection(server, connection);
+		}
+		else if (connection->input.length > kServerLineMax)
+		{
+			// No query is anywhere near this long.
+			connection->isBroken = 1;
+		}
+	}
+	else if (count == 0)
+	{
+		connection->isInputClosed = 1;
+
+		// A last line without a newline is still a query.
+		if ((connection->input.length > 0)
+			&& (connection->input.text[connection->input.length - 1] != '\n'))
+		{
+			appendBytes(&connection->input, "\n", 1);
+			queueConnection(server, connection);
+		}
+	}
+	else
+	{
+		connection->isBroken = 1;
+	}
+
+	unlockWorkers(&server->lock);
+}
+
+
+
+/*
+* Function:			flushConnection()
+* Description:		Sends a client as much of its waiting output as its socket will take, then
+*					brings its epoll events up to date. Main thread only.
+* Parameters:		QueryServer* server				The server.
+*					ServerConnection* connection	The connection to send to.
+*/
+static void flushConnection(QueryServer* server, ServerConnection* connection)
+{
+	lockWorkers(&server->lock);
+
+	while ((connection->isBroken == 0) && (connection->outputSent < connection->output.length))
+	{
+		ssize_t count = send(connection->socket, connection->output.text + connection->outputSent,
+			connection->output.length - connection->outputSent, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+		if (count < 0)
+		{
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+			{
+				connection->isBroken = 1;
+			}
+			if (errno != EINTR)
+			{
+				break;
+			}
+		}
+		else
+		{
+			connection->outputSent += (size_t)count;
+		}
+	}
+
+	// Everything has gone, so the buffer can start again from the beginning.
+	if (connection->outputSent == connection->output.length)
+	{
+		connection->output.length = 0;
+		connection->outputSent = 0;
+	}
+
+	unlockWorkers(&server->lock);
+
+	updateConnection(server, connection);
+}
+
+
+
+/*
+* Function:			updateConnection()
+* Description:		Watches a connection for whichever events it now needs: input while its
+*					client is sending and keeping up with the answers, and output while answers
+*					are waiting. Closes it once it is finished with. Main thread only.
+* Parameters:		QueryServer* server				The server.
+*					ServerConnection* connection	The connection to update.
+*/
+static void updateConnection(QueryServer* server, ServerConnection* connection)
+{
+	unsigned int wantedEvents = 0;
+	int isFinished = 0;
+
+	lockWorkers(&server->lock);
+
+	// A connection a worker still has, or that is on the flush list, can't be freed yet.
+	if ((connection->isQueued == 0) && (connection->isFlushQueued == 0))
+	{
+		isFinished = (connection->isBroken == 1)
+			|| ((connection->isInputClosed == 1) && (connection->output.length == 0));
+	}
+
+	if (connection->isBroken == 0)
+	{
+		size_t unsent = connection->output.length - connection->outputSent;
+
+		if ((connection->isInputClosed == 0) && (unsent < kServerOutputMax))
+		{
+			wantedEvents |= EPOLLIN;
+		}
+		if (unsent > 0)
+		{
+			wantedEvents |= EPOLLOUT;
+		}
+	}
+
+	unlockWorkers(&server->lock);
+
+	/* A socket watched for nothing is taken out of the epoll set altogether, since a hung up
+	socket would otherwise keep reporting it. The worker's wakeup brings it back if needed. */
+	if (isFinished == 1)
+	{
+		closeConnection(server, connection);
+	}
+	else if (wantedEvents != connection->watchedEvents)
+	{
+		struct epoll_event event;
+		int operation = (wantedEvents == 0) ? EPOLL_CTL_DEL
+			: ((connection->watchedEvents == 0) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD);
+
+		memset(&event, 0, sizeof(event));
+		event.events = wantedEvents;
+		event.data.ptr = connection;
+
+		epoll_ctl(server->epollHandle, operation, connection->socket, &event);
+		connection->watchedEvents = wantedEvents;
+	}
+}
+
+
+
+/*
+* Function:			closeConnection()
+* Description:		Closes a connection and frees it. No worker may have it. Main thread only.
+* Parameters:		QueryServer* server				The server.
+*					ServerConnection* connection	The connection to close.
+*/
+static void closeConnection(QueryServer* server, ServerConnection* connection)
+{
+	if (connection->previous != NULL)
+	{
+		connection->previous->next = connection->next;
+	}
+	else
+	{
+		server->connections = connection->next;
+	}
+	if (connection->next != NULL)
+	{
+		connection->next->previous = connection->previous;
+	}
+
+	// Closing the socket takes it out of the epoll set too.
+	close(connection->socket);
+	freeOutputBuffer(&connection->input);
+	freeOutputBuffer(&connection->output);
+	free(connection);
+
+	// A handle is free again, so waiting connections can be taken.
+	if ((server->isListenPaused == 1)
+		&& (watchServerHandle(server, server->listenSocket, &server->listenSocket) == 1))
+	{
+		server->isListenPaused = 0;
+	}
+}
+
+
+
+/*
+* Function:			queueConnection()
+* Description:		Puts a connection with whole lines waiting on the ready queue, unless it is
+*					already there or being answered. The caller holds the server's lock.
+* Parameters:		QueryServer* server				The server.
+*					ServerConnection* connection	The connection to queue.
+*/
+static void queueConnection(QueryServer* server, ServerConnection* connection)
+{
+	if (connection->isQueued == 1)
+	{
+		return;
+	}
+
+	connection->isQueued = 1;
+	connection->nextReady = NULL;
+
+	if (server->readyTail != NULL)
+	{
+		server->readyTail->nextReady = connection;
+	}
+	else
+	{
+		server->readyHead = connection;
+	}
+	server->readyTail = connection;
+
+	sendSignal(&server->connectionReady);
+}
+
+
+
+/*
+* Function:			answerConnections()
+* Description:		The work done by each server worker thread: takes the next ready
+*					connection, answers every whole line it has sent, hands the answers back to
+*					the main thread, and repeats until the server stops.
+* Parameters:		void* worker		The ServerWorker for this thread.
+*/
+static void answerConnections(void* worker)
+{
+	ServerWorker* self = (ServerWorker*)worker;
+	QueryServer* server = self->server;
+	char line[kTimetableLineMax] = "";
+	const unsigned long long wakeCount = 1;
+
+	while (1)
+	{
+		ServerConnection* connection = NULL;
+		char* lastNewline = NULL;
+		size_t lineStart = 0;
+		size_t takenLength = 0;
+
+		// Wait for a connection to answer, or for the server to stop.
+		lockWorkers(&server->lock);
+		while ((server->readyHead == NULL) && (server->isStopping == 0))
+		{
+			waitForSignal(&server->connectionReady, &server->lock);
+		}
+		if (server->isStopping == 1)
+		{
+			unlockWorkers(&server->lock);
+			break;
+		}
+		connection = server->readyHead;
+		server->readyHead = connection->nextReady;
+		if (server->readyHead == NULL)
+		{
+			server->readyTail = NULL;
+		}
+
+		// Take every whole line, leaving any part line for the next read to finish.
+		self->lines.length = 0;
+		lastNewline = (char*)memrchr(connection->input.text, '\n', connection->input.length);
+		if (lastNewline != NULL)
+		{
+			takenLength = (size_t)(lastNewline - connection->input.text) + 1;
+			if (appendBytes(&self->lines, connection->input.text, takenLength) == 1)
+			{
+				memmove(connection->input.text, connection->input.text + takenLength,
+					connection->input.length - takenLength);
+				connection->input.length -= takenLength;
+			}
+			else
+			{
+				connection->isBroken = 1;
+			}
+		}
+		unlockWorkers(&server->lock);
+
+		// The connection's lines are this thread's alone now; answer them without the lock.
+		self->output.length = 0;
+
+		while (lineStart < self->lines.length)
+		{
+			char* lineEnd = (char*)memchr(self->lines.text + lineStart, '\n',
+				self->lines.length - lineStart);
+			size_t lineLength = (size_t)(lineEnd - (self->lines.text + lineStart)) + 1;
+
+			connection->lineNumber++;
+
+			if (lineLength >= kTimetableLineMax)
+			{
+				writeQueryError(&self->output, server->options->outputFormat,
+					connection->lineNumber, "line too long");
+			}
+			else
+			{
+				memcpy(line, self->lines.text + lineStart, lineLength);
+				line[lineLength] = '\0';
+				answerQueryLine(server->options, &self->scratch, line, connection->lineNumber,
+					&self->output);
+			}
+
+			lineStart += lineLength;
+		}
+
+		// Hand the answers back, and put the connection back in the queue if more has come in.
+		lockWorkers(&server->lock);
+		if (appendBytes(&connection->output, self->output.text, self->output.length) == 0)
+		{
+			connection->isBroken = 1;
+		}
+		connection->isQueued = 0;
+		if ((connection->isBroken == 0)
+			&& (memchr(connection->input.text, '\n', connection->input.length) != NULL))
+		{
+			queueConnection(server, connection);
+		}
+		if (connection->isFlushQueued == 0)
+		{
+			connection->isFlushQueued = 1;
+			connection->nextFlush = server->flushHead;
+			server->flushHead = connection;
+		}
+		unlockWorkers(&server->lock);
+
+		// The write only fails if the counter is full, when a wakeup is waiting already.
+		if (write(server->wakeEvent, &wakeCount, sizeof(wakeCount)) < 0)
+		{
+			continue;
+		}
+	}
+}
+
+
+
+#endif
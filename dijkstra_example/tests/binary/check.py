@@ -0,0 +1,120 @@
+"""
+Decodes the program's binary records for batch.txt, and checks each one against the TSV row
+the program writes for the same query. Run by run_tests.py as:
+
+	python check.py <dijkstra_example program>
+
+The record layout is the one described at the top of serializer.c. Every field of a record must
+be accounted for by its length, and the records must cover the output exactly.
+"""
+
+import struct
+import subprocess
+import sys
+
+ARGUMENTS = ["--batch", "batch.txt", "--date", "2026-03-02", "timetable.csv"]
+MINUTES_PER_DAY = 1440
+
+
+def airport_names():
+	"""Returns the timetable's airport names by cityID, numbered in the order they first appear,
+	and its number of flights."""
+	names = [None]
+	flight_count = 0
+
+	with open("timetable.csv") as timetable:
+		for line in timetable:
+			fields = [field.strip() for field in line.strip().split(",")]
+			if (fields[0] == "") or fields[0].startswith("#") or (fields[0] == "calendar"):
+				continue
+
+			airports = fields[1:2] if fields[0] == "airport" else fields[0:2]
+			for name in airports:
+				if name not in names:
+					names.append(name)
+			if fields[0] != "airport":
+				flight_count += 1
+
+	return names, flight_count
+
+
+def hhmm(minutes):
+	"""Formats minutes since the start day's midnight as the TSV's HHMM time of day."""
+	minutes %= MINUTES_PER_DAY
+	return "%02d%02d" % (minutes // 60, minutes % 60)
+
+
+def decode_records(output):
+	"""Splits binary output into records, each a list of its 32-bit fields and its raw bytes."""
+	records = []
+	offset = 0
+
+	while offset < len(output):
+		if offset + 4 > len(output):
+			raise ValueError("a length field is cut off at byte %d" % offset)
+		(length,) = struct.unpack_from("<i", output, offset)
+		body = output[offset + 4:offset + 4 + length]
+		if (length < 8) or (len(body) != length):
+			raise ValueError("the record at byte %d has a bad length, %d" % (offset, length))
+		records.append(body)
+		offset += 4 + length
+
+	return records
+
+
+def expected_row(body, names, flight_count):
+	"""Turns one record back into the TSV row it stands for."""
+	line, flights = struct.unpack_from("<ii", body, 0)
+
+	if flights == -1:
+		return "%d\terror: %s" % (line, body[8:].decode())
+
+	fields = list(struct.unpack("<%di" % (len(body) // 4), body)) if len(body) % 4 == 0 else None
+	if (fields is None) or (len(fields) != 5 + ((2 + 5 * flights) if flights > 0 else 0)):
+		raise ValueError("line %d's record has %d bytes for %d flights" % (line, len(body), flights))
+
+	origin, destination, start = fields[2:5]
+	row = [str(line), names[origin], names[destination], hhmm(start)]
+
+	if flights == 0:
+		return "\t".join(row + ["", "", "", "0", ""])
+
+	arrival, travel = fields[5:7]
+	plan = []
+	for i in range(flights):
+		flight_index, source, target, departure, landing = fields[7 + 5 * i:12 + 5 * i]
+		if not (0 <= flight_index < flight_count):
+			raise ValueError("line %d's flight %d is out of range" % (line, flight_index))
+		plan.append("%s %s>%s %s" % (names[source], hhmm(departure), names[target], hhmm(landing)))
+
+	return "\t".join(row + [hhmm(arrival), str(arrival // MINUTES_PER_DAY), str(travel),
+		str(flights), ";".join(plan)])
+
+
+def main():
+	program = sys.argv[1]
+	names, flight_count = airport_names()
+	binary = subprocess.run([program, "--format", "binary"] + ARGUMENTS,
+		stdout=subprocess.PIPE, stderr=subprocess.DEVNULL).stdout
+	tsv = subprocess.run([program, "--format", "tsv"] + ARGUMENTS,
+		stdout=subprocess.PIPE, stderr=subprocess.DEVNULL).stdout.decode().splitlines()[1:]
+
+	try:
+		rows = [expected_row(body, names, flight_count) for body in decode_records(binary)]
+	except ValueError as error:
+		print("FAIL binary: check.py: %s" % error)
+		return 1
+
+	if rows != tsv:
+		print("FAIL binary: check.py: the records don't match the TSV rows")
+		for decoded, written in zip(rows, tsv):
+			if decoded != written:
+				print("  decoded: %s\n  tsv:     %s" % (decoded, written))
+		return 1
+
+	print("PASS binary: check.py: %d records match the TSV rows" % len(rows))
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
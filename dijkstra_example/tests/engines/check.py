@@ -0,0 +1,157 @@
+"""
+Checks the answers that can't be pinned to expected.txt against the ones that are. Run by
+run_tests.py as:
+
+	python check.py <dijkstra_example program>
+
+--precompute and --engine transfer must arrive exactly when the search engines do. Their plans
+may differ when two plans land at the same time, since they keep the one that leaves last. The
+transfer engine is run with its own choice of hubs, with two and with every airport a hub.
+
+Every --arrive-by answer must be the latest start that works: an ordinary query from that start
+makes the deadline, and one from a minute later doesn't.
+
+Every --pareto option of n flights must land when RAPTOR does with --max-legs n, and RAPTOR
+with one flight fewer must land later or not at all.
+"""
+
+import re
+import subprocess
+import sys
+
+ARGUMENTS = ["--format", "tsv", "--date", "2026-03-29"]
+MINUTES_PER_DAY = 1440
+
+
+def run(program, options, batch):
+	"""Runs the program on a batch given as text, and returns its TSV rows, header dropped, as
+	lists of fields."""
+	output = subprocess.run([program, "--batch", "-"] + ARGUMENTS + options + ["timetable.csv"],
+		input=batch.encode(), stdout=subprocess.PIPE, stderr=subprocess.DEVNULL).stdout
+	return [row.split("\t") for row in output.decode().splitlines()[1:]]
+
+
+def minutes(hhmm):
+	"""Turns an HHMM time into minutes after midnight."""
+	return int(hhmm[:2]) * 60 + int(hhmm[2:])
+
+
+def hhmm(minutes_after_midnight):
+	"""Turns minutes after midnight into an HHMM time, wrapping to the day."""
+	minutes_after_midnight %= MINUTES_PER_DAY
+	return "%02d%02d" % (minutes_after_midnight // 60, minutes_after_midnight % 60)
+
+
+def check_arrivals(program, options, batch, expected):
+	"""Returns a list of problems with the answers given with options, which must arrive when
+	expected.txt does."""
+	problems = []
+	name = " ".join(options)
+
+	for row, want in zip(run(program, options, batch), expected):
+		if row[:7] != want[:7]:
+			problems.append("%s line %s: %s, not %s" % (name, row[0], row[3:7], want[3:7]))
+		elif (row[8] != "") and (len(row[8].split(";")) != int(row[7])):
+			problems.append("%s line %s: its plan isn't %s flights" % (name, row[0], row[7]))
+
+	return problems
+
+
+def check_arrive_by(program, batch):
+	"""Returns a list of problems with --arrive-by's answers."""
+	problems = []
+	queries = [line.split() for line in batch.splitlines() if not line.startswith("#")]
+	answers = run(program, ["--arrive-by"], batch)
+
+	# Ask the ordinary queries from each answer's start, and from a minute after it.
+	forward_batch = ""
+	for query, answer in zip(queries, answers):
+		start = minutes(answer[3]) if answer[3] != "" else 0
+		forward_batch += "%s %s %s\n" % (query[0], query[1], hhmm(start))
+		forward_batch += "%s %s %s\n" % (query[0], query[1], hhmm(start + 1))
+	forward = run(program, [], forward_batch)
+
+	for i, (query, answer) in enumerate(zip(queries, answers)):
+		at_start, after_start = forward[2 * i], forward[2 * i + 1]
+		if answer[8] == "":
+			problems.append("--arrive-by line %s: no plan" % answer[0])
+			continue
+
+		# The deadline falls within a day after the arrival, or leaving a day later would do.
+		travel = int(answer[6])
+		deadline = travel + (minutes(query[2]) - minutes(answer[4])) % MINUTES_PER_DAY
+
+		if (at_start[6] == "") or (int(at_start[6]) > deadline):
+			problems.append("--arrive-by line %s: leaving at %s doesn't make %s"
+				% (answer[0], answer[3], query[2]))
+		if (after_start[6] != "") and (1 + int(after_start[6]) <= deadline):
+			problems.append("--arrive-by line %s: leaving a minute after %s still makes %s"
+				% (answer[0], answer[3], query[2]))
+
+	return problems
+
+
+def check_pareto(program, batch):
+	"""Returns a list of problems with --pareto's answers."""
+	problems = []
+	answers = run(program, ["--pareto"], batch)
+	most_flights = max(int(option.split("@")[0])
+		for answer in answers for option in answer[5].split(";") if option != "")
+
+	# RAPTOR's earliest arrival with each limit on flights, as its time, day and travel minutes.
+	raptor = {}
+	for legs in range(1, most_flights + 1):
+		raptor[legs] = [(row[4], int(row[5]), int(row[6])) if row[6] != "" else None
+			for row in run(program, ["--engine", "raptor", "--max-legs", str(legs)], batch)]
+
+	for i, answer in enumerate(answers):
+		for option in answer[5].split(";"):
+			match = re.fullmatch(r"(\d+)@(\d{4})([+-]\d+)?", option)
+			if match is None:
+				problems.append("--pareto line %s: can't read %s" % (answer[0], option))
+				continue
+
+			flights = int(match.group(1))
+			day = int(match.group(3)) if match.group(3) is not None else 0
+			limited = raptor[flights][i]
+			fewer = raptor[flights - 1][i] if flights > 1 else None
+
+			if (limited is None) or (limited[:2] != (match.group(2), day)):
+				problems.append("--pareto line %s: %s, but RAPTOR with %d flights lands at %s"
+					% (answer[0], option, flights, limited))
+			elif (fewer is not None) and (fewer[2] <= limited[2]):
+				problems.append("--pareto line %s: %s, but RAPTOR lands as soon with %d flights"
+					% (answer[0], option, flights - 1))
+
+	return problems
+
+
+def main():
+	program = sys.argv[1]
+
+	with open("batch.txt") as batch_file:
+		batch = batch_file.read()
+	with open("expected.txt") as expected_file:
+		expected = [row.split("\t") for row in expected_file.read().splitlines()[1:]]
+
+	for name, problems in (("--precompute", check_arrivals(program, ["--precompute"], batch,
+			expected)),
+		("--engine transfer", check_arrivals(program, ["--engine", "transfer"], batch, expected)),
+		("--transfer-hubs 2", check_arrivals(program, ["--engine", "transfer", "--transfer-hubs",
+			"2"], batch, expected)),
+		("--transfer-hubs 9", check_arrivals(program, ["--engine", "transfer", "--transfer-hubs",
+			"9"], batch, expected)),
+		("--arrive-by", check_arrive_by(program, batch)),
+		("--pareto", check_pareto(program, batch))):
+		if len(problems) > 0:
+			print("FAIL engines: check.py: %s" % name)
+			for problem in problems:
+				print("  %s" % problem)
+			return 1
+		print("PASS engines: check.py: %s" % name)
+
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,78 @@
+"""
+Runs the flight planner against the fixtures in this directory, and checks its output.
+
+Usage: python run_tests.py <path to the built dijkstra_example program>
+
+Each directory here holding a runs.txt is a test case. Every line of runs.txt that isn't blank
+or a # comment is one run: the name of the file its output must match, then the arguments to
+run the program with, from inside the case's directory. Text output is compared line by line,
+so line endings don't matter; a file ending in .bin must match byte for byte. A case may also
+have a check.py, which is run with the program's path once its runs have passed, for checks a
+fixed expected file can't make.
+
+Exits with 0 if every run passed, 1 otherwise.
+"""
+
+import os
+import subprocess
+import sys
+
+
+def run_case(program, case_directory):
+	"""Runs one case's runs.txt. Returns the number of runs that failed."""
+	failures = 0
+
+	with open(os.path.join(case_directory, "runs.txt")) as runs:
+		for line in runs:
+			fields = line.split()
+			if (len(fields) == 0) or fields[0].startswith("#"):
+				continue
+
+			expected_file = fields[0]
+			arguments = fields[1:]
+			result = subprocess.run([program] + arguments, cwd=case_directory,
+				stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+
+			with open(os.path.join(case_directory, expected_file), "rb") as expected:
+				expected_output = expected.read()
+
+			if expected_file.endswith(".bin"):
+				passed = (result.stdout == expected_output)
+			else:
+				passed = (result.stdout.decode().splitlines()
+					== expected_output.decode().splitlines())
+
+			name = os.path.basename(case_directory)
+			print("%s %s: %s" % ("PASS" if passed else "FAIL", name, " ".join(arguments)))
+			if not passed:
+				failures += 1
+				sys.stdout.write(result.stderr.decode())
+
+	checker = os.path.join(case_directory, "check.py")
+	if (failures == 0) and os.path.exists(checker):
+		if subprocess.run([sys.executable, checker, program], cwd=case_directory).returncode != 0:
+			failures += 1
+
+	return failures
+
+
+def main():
+	if len(sys.argv) != 2:
+		sys.stderr.write("Usage: python run_tests.py <dijkstra_example program>\n")
+		return 1
+
+	program = os.path.abspath(sys.argv[1])
+	tests_directory = os.path.dirname(os.path.abspath(__file__))
+	failures = 0
+
+	for name in sorted(os.listdir(tests_directory)):
+		case_directory = os.path.join(tests_directory, name)
+		if os.path.exists(os.path.join(case_directory, "runs.txt")):
+			failures += run_case(program, case_directory)
+
+	print("%d failed." % failures if failures > 0 else "All passed.")
+	return 1 if failures > 0 else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
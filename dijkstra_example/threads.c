@@ -0,0 +1,471 @@
+/*
+* Filename:				threads.c
+* Description:			Thin wrappers around the platform's threads, locks and condition
+*						variables for the Amazing Race flight planner, so the batch workers can be
+*						written once. Uses the Windows API on Windows and pthreads everywhere else.
+*
+*						runForEachOrigin() is built on them, for the tables found one origin at a
+*						time when the program starts (the profile table and transfer patterns).
+*/
+
+#include "dijkstra_example.h"
+
+#ifndef _WIN32
+#include <time.h>
+#include <unistd.h>
+#endif
+
+
+#pragma warning(disable: 4996)
+
+
+
+// What a new thread should run. Handed to the thread, which frees it once it has started.
+typedef struct
+{
+	void (*work)(void*);
+	void* argument;
+} ThreadStart;
+
+
+// The origins shared between the threads of one runForEachOrigin() call.
+typedef struct
+{
+	int (*work)(void*, int);
+	int originCount;
+	int nextOrigin;					// The next origin that no thread has taken.
+	int isFailed;					// 1 once any call to work() has failed.
+	WorkerLock lock;				// Held while changing nextOrigin or isFailed.
+} OriginRun;
+
+// What each thread of a runForEachOrigin() call is given: the shared origins, and its worker.
+typedef struct
+{
+	OriginRun* run;
+	void* worker;
+} OriginRunner;
+
+
+
+static void takeOrigins(void* runner);
+
+#ifdef _WIN32
+static DWORD WINAPI runThreadStart(LPVOID parameter);
+#else
+static void* runThreadStart(void* parameter);
+#endif
+
+
+
+/*
+* Function:			startWorkerThread()
+* Description:		Starts a new thread running work(argument).
+* Parameters:		WorkerThread* thread		Set to the new thread.
+*					void (*work)(void*)			The function the thread runs.
+*					void* argument				What to pass to work().
+* Return Values:	1 if the thread was started, 0 if it couldn't be.
+*/
+int startWorkerThread(WorkerThread* thread, void (*work)(void*), void* argument)
+{
+	ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+	int started = 0;
+
+	if (start == NULL)
+	{
+		return 0;
+	}
+
+	start->work = work;
+	start->argument = argument;
+
+#ifdef _WIN32
+	*thread = CreateThread(NULL, 0, runThreadStart, start, 0, NULL);
+	started = (*thread != NULL);
+#else
+	started = (pthread_create(thread, NULL, runThreadStart, start) == 0);
+#endif
+
+	if (started == 0)
+	{
+		free(start);
+	}
+
+	return started;
+}
+
+
+
+/*
+* Function:			joinWorkerThread()
+* Description:		Waits for a thread to finish, and releases it.
+* Parameters:		WorkerThread thread		The thread to wait for.
+*/
+void joinWorkerThread(WorkerThread thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, NULL);
+#endif
+}
+
+
+
+/*
+* Function:			initWorkerLock()
+* Description:		Sets up a lock, so only one thread at a time holds it.
+* Parameters:		WorkerLock* lock		The lock to set up.
+*/
+void initWorkerLock(WorkerLock* lock)
+{
+#ifdef _WIN32
+	InitializeCriticalSection(lock);
+#else
+	pthread_mutex_init(lock, NULL);
+#endif
+}
+
+
+
+/*
+* Function:			freeWorkerLock()
+* Description:		Releases a lock. No thread may be holding it.
+* Parameters:		WorkerLock* lock		The lock to release.
+*/
+void freeWorkerLock(WorkerLock* lock)
+{
+#ifdef _WIN32
+	DeleteCriticalSection(lock);
+#else
+	pthread_mutex_destroy(lock);
+#endif
+}
+
+
+
+/*
+* Function:			lockWorkers()
+* Description:		Takes a lock, waiting until no other thread holds it.
+* Parameters:		WorkerLock* lock		The lock to take.
+*/
+void lockWorkers(WorkerLock* lock)
+{
+#ifdef _WIN32
+	EnterCriticalSection(lock);
+#else
+	pthread_mutex_lock(lock);
+#endif
+}
+
+
+
+/*
+* Function:			unlockWorkers()
+* Description:		Gives up a lock taken by lockWorkers().
+* Parameters:		WorkerLock* lock		The lock to give up.
+*/
+void unlockWorkers(WorkerLock* lock)
+{
+#ifdef _WIN32
+	LeaveCriticalSection(lock);
+#else
+	pthread_mutex_unlock(lock);
+#endif
+}
+
+
+
+/*
+* Function:			initWorkerSignal()
+* Description:		Sets up a signal that threads can wait on until another thread sends it.
+* Parameters:		WorkerSignal* signal	The signal to set up.
+*/
+void initWorkerSignal(WorkerSignal* signal)
+{
+#ifdef _WIN32
+	InitializeConditionVariable(signal);
+#else
+	pthread_cond_init(signal, NULL);
+#endif
+}
+
+
+
+/*
+* Function:			freeWorkerSignal()
+* Description:		Releases a signal. No thread may be waiting on it.
+* Parameters:		WorkerSignal* signal	The signal to release.
+*/
+void freeWorkerSignal(WorkerSignal* signal)
+{
+#ifdef _WIN32
+	// Windows condition variables don't hold anything that needs releasing.
+	(void)signal;
+#else
+	pthread_cond_destroy(signal);
+#endif
+}
+
+
+
+/*
+* Function:			waitForSignal()
+* Description:		Gives up a held lock and waits for the signal, then takes the lock back.
+*					May return without the signal having been sent, so always wait in a loop
+*					that checks what was being waited for.
+* Parameters:		WorkerSignal* signal	The signal to wait for.
+*					WorkerLock* lock		The lock held by this thread.
+*/
+void waitForSignal(WorkerSignal* signal, WorkerLock* lock)
+{
+#ifdef _WIN32
+	SleepConditionVariableCS(signal, lock, INFINITE);
+#else
+	pthread_cond_wait(signal, lock);
+#endif
+}
+
+
+
+/*
+* Function:			sendSignal()
+* Description:		Wakes one thread waiting on the signal, if any are.
+* Parameters:		WorkerSignal* signal	The signal to send.
+*/
+void sendSignal(WorkerSignal* signal)
+{
+#ifdef _WIN32
+	WakeConditionVariable(signal);
+#else
+	pthread_cond_signal(signal);
+#endif
+}
+
+
+
+/*
+* Function:			broadcastSignal()
+* Description:		Wakes every thread waiting on the signal.
+* Parameters:		WorkerSignal* signal	The signal to send.
+*/
+void broadcastSignal(WorkerSignal* signal)
+{
+#ifdef _WIN32
+	WakeAllConditionVariable(signal);
+#else
+	pthread_cond_broadcast(signal);
+#endif
+}
+
+
+
+/*
+* Function:			processorCount()
+* Description:		Counts the processors (cores) available to run threads on.
+* Return Values:	The number of processors, at least 1.
+*/
+int processorCount(void)
+{
+	int count = 1;
+
+#ifdef _WIN32
+	SYSTEM_INFO systemInfo;
+
+	GetSystemInfo(&systemInfo);
+	count = (int)systemInfo.dwNumberOfProcessors;
+#else
+	count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	return (count > 0) ? count : 1;
+}
+
+
+
+/*
+* Function:			workerThreadCount()
+* Description:		Works out how many threads to share some jobs between: the number asked
+*					for, or one per core if that's 0, but never more than there are jobs.
+* Parameters:		int threadCount		The threads asked for, or 0 for one per core.
+*					int jobCount		The number of jobs to share out.
+* Return Values:	The number of threads to use, at least 1.
+*/
+int workerThreadCount(int threadCount, int jobCount)
+{
+	if (threadCount <= 0)
+	{
+		threadCount = processorCount();
+	}
+	if (threadCount > jobCount)
+	{
+		threadCount = (jobCount > 0) ? jobCount : 1;
+	}
+
+	return threadCount;
+}
+
+
+
+/*
+* Function:			runForEachOrigin()
+* Description:		Calls work(worker, origin) for every origin from 1 to originCount, on one
+*					thread per worker. Each thread takes the next origin no thread has taken,
+*					until there are none left or a call has failed. The first worker runs on this
+*					thread, once the others are started; if a thread can't be started, the ones
+*					that are running share out its origins anyway.
+* Parameters:		int originCount				The number of origins.
+*					void* workers				The workers, one per thread, workerSize bytes
+*												apart. Each is only used by its own thread.
+*					int workerCount				The number of workers.
+*					size_t workerSize			The size of each worker.
+*					int (*work)(void*, int)		The work for one origin. Returns 1 if it was
+*												done, 0 if it failed (ran out of memory).
+*					int* threadsUsed			Set to the number of threads that ran.
+* Return Values:	1 if work() was done for every origin, 0 if any call failed or there wasn't
+*					enough memory to start.
+*/
+int runForEachOrigin(int originCount, void* workers, int workerCount, size_t workerSize,
+	int (*work)(void*, int), int* threadsUsed)
+{
+	OriginRun run;
+	OriginRunner* runners = (OriginRunner*)calloc(workerCount, sizeof(OriginRunner));
+	WorkerThread* threads = (WorkerThread*)calloc(workerCount, sizeof(WorkerThread));
+	int startedThreads = 0;
+
+	*threadsUsed = 0;
+
+	if ((runners == NULL) || (threads == NULL))
+	{
+		free(runners);
+		free(threads);
+		return 0;
+	}
+
+	run.work = work;
+	run.originCount = originCount;
+	run.nextOrigin = 1;
+	run.isFailed = 0;
+	initWorkerLock(&run.lock);
+
+	for (int i = 0; i < workerCount; i++)
+	{
+		runners[i].run = &run;
+		runners[i].worker = (char*)workers + i * workerSize;
+	}
+
+	for (int i = 1; i < workerCount; i++)
+	{
+		if (startWorkerThread(&threads[i], takeOrigins, &runners[i]) == 0)
+		{
+			break;
+		}
+		startedThreads++;
+	}
+
+	takeOrigins(&runners[0]);
+
+	for (int i = 1; i <= startedThreads; i++)
+	{
+		joinWorkerThread(threads[i]);
+	}
+
+	freeWorkerLock(&run.lock);
+	free(runners);
+	free(threads);
+
+	*threadsUsed = startedThreads + 1;
+
+	return (run.isFailed == 0) ? 1 : 0;
+}
+
+
+
+/*
+* Function:			wallClockSeconds()
+* Description:		Reads a clock that runs at real time, for timing work spread over several
+*					threads (clock() adds up every thread's processor time instead).
+* Return Values:	The time in seconds since some fixed point. Only differences are meaningful.
+*/
+double wallClockSeconds(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+#endif
+}
+
+
+
+/*
+* Function:			takeOrigins()
+* Description:		The work done by each thread of runForEachOrigin(): takes the next origin no
+*					thread has taken, does its work, and repeats until none are left.
+* Parameters:		void* runner		The OriginRunner for this thread.
+*/
+static void takeOrigins(void* runner)
+{
+	OriginRunner* self = (OriginRunner*)runner;
+	OriginRun* run = self->run;
+
+	while (1)
+	{
+		int origin = 0;
+
+		lockWorkers(&run->lock);
+		if ((run->isFailed == 0) && (run->nextOrigin <= run->originCount))
+		{
+			origin = run->nextOrigin;
+			run->nextOrigin++;
+		}
+		unlockWorkers(&run->lock);
+
+		if (origin == 0)
+		{
+			break;
+		}
+
+		if (run->work(self->worker, origin) == 0)
+		{
+			lockWorkers(&run->lock);
+			run->isFailed = 1;
+			unlockWorkers(&run->lock);
+		}
+	}
+}
+
+
+
+/*
+* Function:			runThreadStart()
+* Description:		The function each new thread actually starts in. Calls the work it was given.
+* Parameters:		The ThreadStart for this thread.
+*/
+#ifdef _WIN32
+static DWORD WINAPI runThreadStart(LPVOID parameter)
+#else
+static void* runThreadStart(void* parameter)
+#endif
+{
+	ThreadStart start = *(ThreadStart*)parameter;
+
+	free(parameter);
+	start.work(start.argument);
+
+#ifdef _WIN32
+	return 0;
+#else
+	return NULL;
+#endif
+}
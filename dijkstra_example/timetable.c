@@ -0,0 +1,1836 @@
+/*
+* Filename:				timetable.c
+* Description:			Loads the flight network for the Amazing Race flight planner from a
+*						timetable file, and stores it in compressed sparse row (CSR) arrays so the
+*						flight search can walk each airport's legs and each leg's departures as
+*						contiguous runs of memory.
+*
+*						The timetable file is a CSV with one record per line. Blank lines and lines
+*						starting with # are ignored.
+*						  airport,<name>,<UTC offset>[,<timezone name>[,<DST rule>[,<DST name>
+*						    [,<minimum connection>]]]]
+*						  <origin>,<destination>,<departure HHMM>,<duration HHMM>
+*						    [,<weekdays>[,<first date>[,<last date>]]]
+*						  calendar,<first date>,<last date>
+*						The UTC offset is the airport's standard time, in hours or hours:minutes
+*						(e.g. -5 or 5:30). The DST rule says when its clocks go forward an hour:
+*						none (the default), us or eu. The minimum connection is how many minutes
+*						a flyer needs between flights there (default 0); only --pareto uses it.
+*						Fields may be left empty to keep their defaults. Departure times are in
+*						the origin's local time. Airports are numbered in the order they first
+*						appear, so declaring them up front fixes their numbers. An airport that is
+*						only ever named in a flight record is assumed to be on UTC.
+*
+*						Flights run every day, unless the timetable has a calendar: a calendar
+*						record, or any flight record giving the days it runs. The weekdays are
+*						the digits of the days the flight runs, 1 for Monday to 7 for Sunday
+*						(e.g. 12345 or 1.3.5..), and the dates (YYYY-MM-DD, in the origin's local
+*						time) limit it to a season. Left out, a flight runs every day of the
+*						calendar. Without a calendar record, the calendar is the year from the
+*						travel date. Each set of days is kept once, as a bitset over the calendar,
+*						so a timetable with a calendar costs a bit per day per distinct schedule
+*						rather than a copy of the flight for every day it runs.
+*
+*						Every time is turned into UTC as the timetable is loaded, using each
+*						airport's offset on the travel date, so the searches never deal with
+*						timezones or HHMM times. Local times are only worked out for printing.
+*
+*						Once loaded, flights can still be delayed or cancelled (delayFlight() and
+*						cancelFlight()), a leg at a time, without rebuilding anything else. The
+*						flights run every day, so a change applies to every day's flight.
+*/
+
+// posix_memalign() is POSIX, and isn't declared by a strict C compile without this.
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "dijkstra_example.h"
+
+#include <ctype.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#pragma warning(disable: 4996)
+
+
+
+// The timetable every search runs against. Empty until loadTimetable() succeeds.
+static Timetable loadedTimetable = { 0 };
+
+/* The days a flight record says the flight runs, as read: which weekdays (bit 0 for Monday up
+to bit 6 for Sunday), from and to which of the origin's local dates (as day numbers). */
+typedef struct
+{
+	int weekdays;
+	int firstDate;
+	int lastDate;
+} ServiceRule;
+
+
+
+static int isTimetableHHMM(int timeInHHMM);
+static int parseUTCOffset(const char* field, int* offsetMinutes);
+static int parseDaylightRule(const char* field);
+static void nameUTCOffset(char timezoneName[], int offsetMinutes);
+static char* trimField(char* field);
+static int splitFields(char* line, char* fields[], int maxFields);
+static unsigned int hashAirportName(const char* airportName);
+static int lookupAirport(const Timetable* network, const char* airportName);
+static int addAirport(Timetable* network, int* airportCapacity, const char* airportName,
+	int offset, const char* timezoneName);
+static void applyTravelDate(Timetable* network, int travelDate);
+static int isDaylightSaving(int daylightRule, int travelDate);
+static int sundayOnOrBefore(int dayNumber);
+static int parseDateField(const char* field, int* dayNumber);
+static int parseWeekdaysField(const char* field, int* weekdays);
+static int buildServiceDays(Timetable* network, Flight* flights, const ServiceRule* rules,
+	int flightCount, int firstDate, int lastDate, int travelDate);
+static unsigned int hashServiceRow(const unsigned int* row, int wordCount);
+static int testServiceBit(const Timetable* network, const unsigned int* days, int calendarDay);
+static void normalizeFlightTimes(const Timetable* network, Flight* flights, int flightCount);
+static int compareFlights(const void* first, const void* second);
+static int legOfFlight(const Timetable* network, int flightID);
+static void findSoonestOnwardFlights(Timetable* network, int leg);
+static int buildFlightGraph(Timetable* network, Flight* flights, int flightCount);
+static int* allocateSearchArray(int count);
+static void freeSearchArray(int* searchArray);
+static void releaseTimetable(Timetable* network);
+static unsigned int nextRandom(unsigned int* state);
+static int randomBelow(unsigned int* state, int limit);
+
+
+
+/*
+* Function:			loadTimetable()
+* Description:		Reads a timetable file and replaces the loaded flight network with it.
+* Parameters:		const char* fileName	The path of the timetable CSV.
+*					int travelDate			The day whose timezones (standard or daylight
+*											saving time) apply, as from dateAsDayNumber().
+* Return Values:	The number of flights loaded, or -1 if the file couldn't be read or has
+*					an invalid record. On failure, the previous timetable is kept.
+*/
+int loadTimetable(const char* fileName, int travelDate)
+{
+	Timetable network = { 0 };
+	int airportCapacity = 0;
+
+	// Flights are gathered in file order, then sorted into legs once the whole file is read.
+	Flight* flights = NULL;
+	ServiceRule* rules = NULL;
+	int flightCount = 0;
+	int flightCapacity = 0;
+
+	// The calendar, if there is one, as day numbers. firstDate > lastDate until it is known.
+	int hasCalendar = 0;
+	int hasServiceDays = 0;
+	int firstDate = 0;
+	int lastDate = -1;
+
+	char line[kTimetableLineMax] = "";
+	char* fields[7] = { NULL };
+	int lineNumber = 0;
+	int isValid = 1;
+
+	FILE* timetableFile = fopen(fileName, "r");
+
+	if (timetableFile == NULL)
+	{
+		fprintf(stderr, "Unable to open the timetable file \"%s\".\n", fileName);
+		return -1;
+	}
+
+	while ((isValid == 1) && (fgets(line, kTimetableLineMax, timetableFile) != NULL))
+	{
+		int fieldCount = 0;
+
+		lineNumber++;
+
+		fieldCount = splitFields(line, fields, 7);
+
+		// Skip blank lines and comments.
+		if (((fieldCount == 1) && (fields[0][0] == '\0')) || (fields[0][0] == '#'))
+		{
+			continue;
+		}
+
+		/* Airport record:
+		airport,<name>,<offset>[,<timezone name>[,<DST rule>[,<DST name>[,<connection>]]]] */
+		if (strcmp(fields[0], "airport") == 0)
+		{
+			int offset = 0;
+			int daylightRule = (fieldCount >= 5) ? parseDaylightRule(fields[4]) : kNoDaylightSaving;
+			int minimumConnection = 0;
+			int cityID = 0;
+
+			if ((fieldCount < 3) || (fieldCount > 7) || (parseUTCOffset(fields[2], &offset) == 0)
+				|| (daylightRule < 0) || ((fieldCount == 7) && (fields[6][0] != '\0')
+				&& ((sscanf(fields[6], "%d", &minimumConnection) != 1)
+				|| (checkRange(minimumConnection, 0, kMinutesPerDay - 1) == 0))))
+			{
+				fprintf(stderr, "%s line %d: expected airport,<name>,<UTC offset>[,<timezone>"
+					"[,none|us|eu[,<DST timezone>[,<minimum connection minutes>]]]].\n",
+					fileName, lineNumber);
+				isValid = 0;
+			}
+			else if (lookupAirport(&network, fields[1]) != 0)
+			{
+				fprintf(stderr, "%s line %d: %s is declared more than once.\n",
+					fileName, lineNumber, fields[1]);
+				isValid = 0;
+			}
+			else
+			{
+				cityID = addAirport(&network, &airportCapacity, fields[1], offset,
+					(fieldCount >= 4) ? fields[3] : NULL);
+
+				if (cityID == 0)
+				{
+					fprintf(stderr, "%s line %d: invalid airport name.\n", fileName, lineNumber);
+					isValid = 0;
+				}
+				else
+				{
+					network.airports[cityID].minimumConnection = minimumConnection;
+				}
+			}
+
+			// Daylight saving time is an hour ahead of standard time.
+			if ((isValid == 1) && (daylightRule != kNoDaylightSaving))
+			{
+				AirportInfo* airport = &network.airports[cityID];
+
+				airport->daylightRule = daylightRule;
+
+				if ((fieldCount >= 6) && (fields[5][0] != '\0'))
+				{
+					strncpy(airport->daylightName, fields[5], kTimezoneNameMax - 1);
+					airport->daylightName[kTimezoneNameMax - 1] = '\0';
+				}
+				else
+				{
+					nameUTCOffset(airport->daylightName, offset + kMinutesPerHour);
+				}
+			}
+		}
+
+		// Calendar record: calendar,<first date>,<last date>
+		else if (strcmp(fields[0], "calendar") == 0)
+		{
+			if ((fieldCount != 3) || (parseDateField(fields[1], &firstDate) == 0)
+				|| (parseDateField(fields[2], &lastDate) == 0)
+				|| (checkRange(lastDate - firstDate + 1, 1, kServiceDaysMax) == 0))
+			{
+				fprintf(stderr, "%s line %d: expected calendar,<first date>,<last date>, as "
+					"YYYY-MM-DD, at most %d days apart.\n", fileName, lineNumber, kServiceDaysMax);
+				isValid = 0;
+			}
+			else if (hasCalendar == 1)
+			{
+				fprintf(stderr, "%s line %d: the calendar is given more than once.\n",
+					fileName, lineNumber);
+				isValid = 0;
+			}
+
+			hasCalendar = 1;
+		}
+
+		/* Flight record:
+		<origin>,<destination>,<departure>,<duration>[,<weekdays>[,<first date>[,<last date>]]] */
+		else if ((fieldCount >= 4) && (fieldCount <= 7))
+		{
+			Flight flight = { 0 };
+			ServiceRule rule = { 0x7F, INT_MIN, INT_MAX };
+
+			flight.originCity = lookupAirport(&network, fields[0]);
+			if (flight.originCity == 0)
+			{
+				flight.originCity = addAirport(&network, &airportCapacity, fields[0], 0, NULL);
+			}
+
+			flight.destinationCity = lookupAirport(&network, fields[1]);
+			if (flight.destinationCity == 0)
+			{
+				flight.destinationCity = addAirport(&network, &airportCapacity, fields[1], 0, NULL);
+			}
+
+			if ((flight.originCity == 0) || (flight.destinationCity == 0))
+			{
+				fprintf(stderr, "%s line %d: invalid airport name.\n", fileName, lineNumber);
+				isValid = 0;
+			}
+			else if (flight.originCity == flight.destinationCity)
+			{
+				fprintf(stderr, "%s line %d: a flight can't land where it took off.\n",
+					fileName, lineNumber);
+				isValid = 0;
+			}
+			else if ((sscanf(fields[2], "%d", &flight.departureTime) != 1)
+				|| (isTimetableHHMM(flight.departureTime) == 0)
+				|| (sscanf(fields[3], "%d", &flight.flightDuration) != 1)
+				|| (isTimetableHHMM(flight.flightDuration) == 0)
+				|| (flight.flightDuration == 0))
+			{
+				fprintf(stderr, "%s line %d: times must be given as HHMM.\n", fileName, lineNumber);
+				isValid = 0;
+			}
+			else if (((fieldCount >= 5) && (fields[4][0] != '\0')
+				&& (parseWeekdaysField(fields[4], &rule.weekdays) == 0))
+				|| ((fieldCount >= 6) && (fields[5][0] != '\0')
+				&& (parseDateField(fields[5], &rule.firstDate) == 0))
+				|| ((fieldCount >= 7) && (fields[6][0] != '\0')
+				&& (parseDateField(fields[6], &rule.lastDate) == 0)))
+			{
+				fprintf(stderr, "%s line %d: weekdays must be digits from 1 (Monday) to 7 (Sunday), "
+					"and dates YYYY-MM-DD.\n", fileName, lineNumber);
+				isValid = 0;
+			}
+			else if (rule.firstDate > rule.lastDate)
+			{
+				fprintf(stderr, "%s line %d: the flight's last date is before its first.\n",
+					fileName, lineNumber);
+				isValid = 0;
+			}
+			else
+			{
+				// Grow the flight list as needed.
+				if (flightCount == flightCapacity)
+				{
+					Flight* grownFlights = NULL;
+					ServiceRule* grownRules = NULL;
+
+					flightCapacity = (flightCapacity == 0) ? 256 : flightCapacity * 2;
+					grownFlights = (Flight*)realloc(flights, flightCapacity * sizeof(Flight));
+					if (grownFlights != NULL)
+					{
+						flights = grownFlights;
+					}
+					grownRules = (ServiceRule*)realloc(rules, flightCapacity * sizeof(ServiceRule));
+					if (grownRules != NULL)
+					{
+						rules = grownRules;
+					}
+
+					if ((grownFlights == NULL) || (grownRules == NULL))
+					{
+						fprintf(stderr, "Out of memory loading %s.\n", fileName);
+						isValid = 0;
+						continue;
+					}
+				}
+
+				// Any days given at all mean the timetable needs a calendar.
+				if (fieldCount > 4)
+				{
+					hasServiceDays = 1;
+				}
+
+				flight.serviceID = flightCount;
+				flights[flightCount] = flight;
+				rules[flightCount] = rule;
+				flightCount++;
+			}
+		}
+		else
+		{
+			fprintf(stderr, "%s line %d: expected <origin>,<destination>,<departure>,<duration>"
+				"[,<weekdays>[,<first date>[,<last date>]]].\n", fileName, lineNumber);
+			isValid = 0;
+		}
+	}
+
+	fclose(timetableFile);
+
+	if ((isValid == 1) && (network.airportCount == 0))
+	{
+		fprintf(stderr, "%s has no airports.\n", fileName);
+		isValid = 0;
+	}
+
+	// Operating days without a calendar record run for a year from the travel date.
+	if ((hasCalendar == 0) && (hasServiceDays == 1))
+	{
+		firstDate = travelDate;
+		lastDate = travelDate + kServiceDaysDefault - 1;
+	}
+
+	/* Now every airport is known, put the whole timetable on UTC for the travel date. The
+	operating days are turned into UTC days first, while the departures are still local. */
+	if (isValid == 1)
+	{
+		applyTravelDate(&network, travelDate);
+
+		if ((firstDate <= lastDate) && (buildServiceDays(&network, flights, rules, flightCount,
+			firstDate, lastDate, travelDate) == 0))
+		{
+			fprintf(stderr, "Out of memory loading %s.\n", fileName);
+			isValid = 0;
+		}
+
+		normalizeFlightTimes(&network, flights, flightCount);
+	}
+
+	if ((isValid == 1) && (buildFlightGraph(&network, flights, flightCount) == 0))
+	{
+		fprintf(stderr, "Out of memory loading %s.\n", fileName);
+		isValid = 0;
+	}
+
+	free(flights);
+	free(rules);
+
+	if (isValid == 0)
+	{
+		releaseTimetable(&network);
+		return -1;
+	}
+
+	// Swap in the new network.
+	releaseTimetable(&loadedTimetable);
+	loadedTimetable = network;
+
+	return loadedTimetable.flightCount;
+}
+
+
+
+/*
+* Function:			generateTimetable()
+* Description:		Makes up a hub-and-spoke flight network and replaces the loaded timetable
+*					with it, for benchmarks. Airports 1 up to hubCount are hubs, each flying to a
+*					few other hubs; every other airport flies to and from legsPerAirport hubs.
+*					Each leg gets departuresPerLeg flights a day at random times, all taking the
+*					same time. Airports are named "A1", "A2" and so on.
+*					The network only depends on the settings, so the same seed gives the same
+*					network on every platform.
+* Parameters:		GeneratorSettings* settings		The shape of the network. Its hubCount and
+*													legsPerAirport are set to the numbers used.
+* Return Values:	The number of flights made, or -1 if there wasn't enough memory. On failure,
+*					the previous timetable is kept.
+*/
+int generateTimetable(GeneratorSettings* settings)
+{
+	Timetable network = { 0 };
+	int airportCapacity = 0;
+	unsigned int state = settings->seed * 2654435761u + 1;
+
+	int airportCount = (settings->airportCount > 1) ? settings->airportCount : 2;
+	int hubCount = (settings->hubCount > 0) ? settings->hubCount : airportCount / 25;
+	int legsPerAirport = settings->legsPerAirport;
+	int hubLegs = 0;
+
+	Flight* flights = NULL;
+	int flightCount = 0;
+	int isValid = 1;
+
+	// The random number generator gets stuck on 0.
+	if (state == 0)
+	{
+		state = 1;
+	}
+
+	if (hubCount < 1)
+	{
+		hubCount = 1;
+	}
+	if (hubCount > airportCount)
+	{
+		hubCount = airportCount;
+	}
+	if (legsPerAirport > hubCount)
+	{
+		legsPerAirport = hubCount;
+	}
+
+	settings->hubCount = hubCount;
+	settings->legsPerAirport = legsPerAirport;
+
+	// Hubs fly to twice as many other hubs as a spoke flies to hubs.
+	hubLegs = (2 * legsPerAirport < hubCount - 1) ? 2 * legsPerAirport : hubCount - 1;
+
+	// Every leg is flown both ways.
+	flights = (Flight*)malloc(((size_t)hubCount * hubLegs + (size_t)(airportCount - hubCount)
+		* legsPerAirport) * 2 * settings->departuresPerLeg * sizeof(Flight) + sizeof(Flight));
+
+	if (flights == NULL)
+	{
+		return -1;
+	}
+
+	// <Airport generation>
+	for (int i = 1; (i <= airportCount) && (isValid == 1); i++)
+	{
+		char airportName[kAirportNameMax] = "";
+		int offset = (settings->timezoneSpread > 0)
+			? randomBelow(&state, settings->timezoneSpread + 1) - settings->timezoneSpread / 2 : 0;
+
+		sprintf(airportName, "A%d", i);
+
+		if (addAirport(&network, &airportCapacity, airportName, offset * kMinutesPerHour, NULL) == 0)
+		{
+			isValid = 0;
+		}
+	}
+
+	// <Leg generation>
+	// Each airport's legs, as a random pick of hubs, flown both ways.
+	for (int origin = 1; (origin <= airportCount) && (isValid == 1); origin++)
+	{
+		int legCount = (origin <= hubCount) ? hubLegs : legsPerAirport;
+
+		for (int leg = 0; leg < legCount; leg++)
+		{
+			int destination = 1 + randomBelow(&state, hubCount);
+
+			// Hubs don't fly to themselves; pick the next hub along instead.
+			if (destination == origin)
+			{
+				destination = (destination % hubCount) + 1;
+			}
+
+			// Longer flights between hubs, shorter ones out to the spokes.
+			int duration = (origin <= hubCount) ? 90 + randomBelow(&state, 300)
+				: 40 + randomBelow(&state, 150);
+
+			for (int i = 0; i < settings->departuresPerLeg; i++)
+			{
+				int outbound = randomBelow(&state, kMinutesPerDay);
+				int inbound = randomBelow(&state, kMinutesPerDay);
+
+				flights[flightCount].originCity = origin;
+				flights[flightCount].destinationCity = destination;
+				flights[flightCount].departureTime = timeAsHHMM(outbound);
+				flights[flightCount].flightDuration = timeAsHHMM(duration);
+				flights[flightCount].serviceID = 0;
+				flightCount++;
+
+				flights[flightCount].originCity = destination;
+				flights[flightCount].destinationCity = origin;
+				flights[flightCount].departureTime = timeAsHHMM(inbound);
+				flights[flightCount].flightDuration = timeAsHHMM(duration);
+				flights[flightCount].serviceID = 0;
+				flightCount++;
+			}
+		}
+	}
+
+	// Made-up networks have no daylight saving time, so any travel date gives the same times.
+	if (isValid == 1)
+	{
+		normalizeFlightTimes(&network, flights, flightCount);
+	}
+
+	if ((isValid == 1) && (buildFlightGraph(&network, flights, flightCount) == 0))
+	{
+		isValid = 0;
+	}
+
+	free(flights);
+
+	if (isValid == 0)
+	{
+		releaseTimetable(&network);
+		return -1;
+	}
+
+	// Swap in the new network.
+	releaseTimetable(&loadedTimetable);
+	loadedTimetable = network;
+
+	return loadedTimetable.flightCount;
+}
+
+
+
+/*
+* Function:			freeTimetable()
+* Description:		Releases the loaded timetable.
+*/
+void freeTimetable(void)
+{
+	releaseTimetable(&loadedTimetable);
+}
+
+
+
+/*
+* Function:			flightTimetable()
+* Description:		Gives read access to the loaded flight network.
+* Return Values:	A const pointer to the loaded Timetable.
+*/
+const Timetable* flightTimetable(void)
+{
+	return &loadedTimetable;
+}
+
+
+
+/*
+* Function:			findAirport()
+* Description:		Looks up an airport in the loaded timetable by name.
+* Parameters:		const char* airportName		The name to look for. Case sensitive.
+* Return Values:	The airport's cityID, or 0 if there is no airport by that name.
+*/
+int findAirport(const char* airportName)
+{
+	return lookupAirport(&loadedTimetable, airportName);
+}
+
+
+
+/*
+* Function:			findScheduledFlight()
+* Description:		Finds a flight in the loaded timetable by its route and departure time.
+* Parameters:		int originAirport			The flight's origin.
+*					int destinationAirport		The flight's destination.
+*					int departureTime			When it leaves, in minutes since midnight UTC.
+* Return Values:	The flight ID, or -1 if there's no such flight.
+*/
+int findScheduledFlight(int originAirport, int destinationAirport, int departureTime)
+{
+	const Timetable* network = &loadedTimetable;
+
+	for (int leg = network->legOffsets[originAirport]; leg < network->legOffsets[originAirport + 1];
+		leg++)
+	{
+		if (network->legDestinations[leg] != destinationAirport)
+		{
+			continue;
+		}
+
+		for (int flight = network->departureOffsets[leg];
+			flight < network->departureOffsets[leg + 1]; flight++)
+		{
+			if (network->departureMinutes[flight] == departureTime)
+			{
+				return flight;
+			}
+		}
+	}
+
+	return -1;
+}
+
+
+
+/*
+* Function:			delayFlight()
+* Description:		Delays a flight in the loaded timetable, keeping its flying time. It moves to
+*					its new place among the leg's flights, so the flights on the leg are still
+*					in order of departure, and the leg's soonest onward flights are found again.
+* Parameters:		int flightID				The flight to delay.
+*					int delayMinutes			How late it now leaves, from 1 to a day less a
+*												minute. A flight pushed past midnight leaves
+*												that much after midnight every day.
+*					FlightUpdate* update		Set to the change made.
+* Return Values:	1 if the flight was delayed, 0 if it has been cancelled.
+*/
+int delayFlight(int flightID, int delayMinutes, FlightUpdate* update)
+{
+	Timetable* network = &loadedTimetable;
+	int leg = legOfFlight(network, flightID);
+	int firstFlight = network->departureOffsets[leg];
+	int lastFlight = network->departureOffsets[leg + 1];
+	Flight delayedFlight = network->departures[flightID];
+	int place = flightID;
+
+	if (network->arrivalMinutes[flightID] == kCancelledArrival)
+	{
+		return 0;
+	}
+
+	delayedFlight.departureTime = (delayedFlight.departureTime + delayMinutes) % kMinutesPerDay;
+
+	// <Reorder loop>
+	// Move the flights that now leave before it back a place, or those that leave after it on.
+	while ((place + 1 < lastFlight)
+		&& (compareFlights(&network->departures[place + 1], &delayedFlight) < 0))
+	{
+		network->departures[place] = network->departures[place + 1];
+		network->departureMinutes[place] = network->departureMinutes[place + 1];
+		network->arrivalMinutes[place] = network->arrivalMinutes[place + 1];
+		place++;
+	}
+	while ((place > firstFlight)
+		&& (compareFlights(&network->departures[place - 1], &delayedFlight) > 0))
+	{
+		network->departures[place] = network->departures[place - 1];
+		network->departureMinutes[place] = network->departureMinutes[place - 1];
+		network->arrivalMinutes[place] = network->arrivalMinutes[place - 1];
+		place--;
+	} // End of reorder loop.
+
+	network->departures[place] = delayedFlight;
+	network->departureMinutes[place] = delayedFlight.departureTime;
+	network->arrivalMinutes[place] = delayedFlight.departureTime + delayedFlight.flightDuration;
+
+	findSoonestOnwardFlights(network, leg);
+
+	update->leg = leg;
+	update->oldFlight = flightID;
+	update->newFlight = place;
+	update->isCancelled = 0;
+
+	return 1;
+}
+
+
+
+/*
+* Function:			cancelFlight()
+* Description:		Cancels a flight in the loaded timetable. It keeps its place on the leg, but
+*					its arrival is set to kCancelledArrival, so no search ever takes it.
+* Parameters:		int flightID				The flight to cancel.
+*					FlightUpdate* update		Set to the change made.
+* Return Values:	1 if the flight was cancelled, 0 if it already had been.
+*/
+int cancelFlight(int flightID, FlightUpdate* update)
+{
+	Timetable* network = &loadedTimetable;
+	int leg = legOfFlight(network, flightID);
+
+	if (network->arrivalMinutes[flightID] == kCancelledArrival)
+	{
+		return 0;
+	}
+
+	network->arrivalMinutes[flightID] = kCancelledArrival;
+	findSoonestOnwardFlights(network, leg);
+
+	update->leg = leg;
+	update->oldFlight = flightID;
+	update->newFlight = flightID;
+	update->isCancelled = 1;
+
+	return 1;
+}
+
+
+
+/*
+* Function:			isServiceDay()
+* Description:		Checks whether a flight leaves on a day, going by the timetable's calendar.
+*					On a timetable without one, every flight leaves every day.
+* Parameters:		int flightID		The flight.
+*					int day				The day it would leave, in UTC, counting from the travel
+*										date as day 0 (as from dayOfTime()).
+* Return Values:	1 if the flight leaves that day, 0 if it doesn't.
+*/
+int isServiceDay(int flightID, int day)
+{
+	const Timetable* network = &loadedTimetable;
+
+	if (network->serviceDayCount == 0)
+	{
+		return 1;
+	}
+
+	return testServiceBit(network, &network->serviceDays[(size_t)network->flightServices[flightID]
+		* network->serviceWords], day + network->firstServiceDay);
+}
+
+
+
+/*
+* Function:			isLegServiceDay()
+* Description:		Checks whether any flight on a leg leaves on a day, going by the timetable's
+*					calendar, so a search can pass over the days a leg has no flights at all.
+* Parameters:		int leg				The leg.
+*					int day				The day, in UTC, counting from the travel date as day 0.
+* Return Values:	1 if some flight on the leg leaves that day, 0 if none does.
+*/
+int isLegServiceDay(int leg, int day)
+{
+	const Timetable* network = &loadedTimetable;
+
+	if (network->serviceDayCount == 0)
+	{
+		return 1;
+	}
+
+	return testServiceBit(network, &network->legServiceDays[(size_t)leg * network->serviceWords],
+		day + network->firstServiceDay);
+}
+
+
+
+/*
+* Function:			departureShift()
+* Description:		Finds how far a flight's departure on a day is from its time in the timetable.
+*					The times are UTC on the travel date's clocks, so a flight leaving on a date
+*					its origin has the clocks set differently leaves an hour earlier or later. A
+*					date's clocks are as on isDaylightSaving(): the day they go forward counts
+*					as daylight saving time. Only a timetable with a calendar has any other day.
+* Parameters:		int flightID		The flight.
+*					int day				The day it would leave on the travel date's clocks, in
+*										UTC, counting from the travel date as day 0.
+* Return Values:	The minutes to add to the flight's departure and arrival on that day.
+*/
+int departureShift(int flightID, int day)
+{
+	const Timetable* network = &loadedTimetable;
+	const AirportInfo* origin = NULL;
+	int calendarDay = 0;
+	int offset = 0;
+
+	if (network->serviceDayCount == 0)
+	{
+		return 0;
+	}
+
+	origin = &network->airports[network->departures[flightID].originCity];
+	if (origin->daylightRule == kNoDaylightSaving)
+	{
+		return 0;
+	}
+
+	// The flight's local date, which can be a day either side of its UTC one.
+	calendarDay = day + dayOfTime(network->departureMinutes[flightID] + origin->timezoneOffset)
+		+ network->firstServiceDay;
+	if (calendarDay < 0)
+	{
+		calendarDay = 0;
+	}
+	else if (calendarDay >= network->serviceDayCount)
+	{
+		calendarDay = network->serviceDayCount - 1;
+	}
+
+	offset = origin->standardOffset;
+	if (((network->daylightDays[calendarDay] >> origin->daylightRule) & 1) != 0)
+	{
+		offset += kMinutesPerHour;
+	}
+
+	return origin->timezoneOffset - offset;
+}
+
+
+
+/*
+* Function:			isTimetableHHMM()
+* Description:		Checks that an HHMM value from the timetable is a real time of day.
+* Parameters:		int timeInHHMM		The time to check.
+* Return Values:	1 if the time is valid, 0 if it isn't.
+*/
+static int isTimetableHHMM(int timeInHHMM)
+{
+	return ((checkRange(timeInHHMM / 100, 0, kHoursPerDay - 1) == 1)
+		&& (checkRange(timeInHHMM % 100, 0, kMinutesPerHour - 1) == 1)
+		&& (timeInHHMM >= 0));
+}
+
+
+
+/*
+* Function:			parseUTCOffset()
+* Description:		Reads a timezone's offset from UTC, given in hours (e.g. -5) or hours and
+*					minutes (e.g. 5:30 or -3:30).
+* Parameters:		const char* field		The offset, as written in the timetable.
+*					int* offsetMinutes		Set to the offset, in minutes.
+* Return Values:	1 if the offset is valid (from -12:00 to +14:00), 0 if it isn't.
+*/
+static int parseUTCOffset(const char* field, int* offsetMinutes)
+{
+	int hours = 0;
+	int minutes = 0;
+	int length = 0;
+	int isNegative = (field[0] == '-');
+
+	if (sscanf(field, "%d%n", &hours, &length) != 1)
+	{
+		return 0;
+	}
+
+	if (field[length] == ':')
+	{
+		const char* minuteField = &field[length + 1];
+
+		// Exactly two digits of minutes, and nothing after them.
+		if ((isdigit((unsigned char)minuteField[0]) == 0)
+			|| (isdigit((unsigned char)minuteField[1]) == 0) || (minuteField[2] != '\0'))
+		{
+			return 0;
+		}
+
+		minutes = (minuteField[0] - '0') * 10 + (minuteField[1] - '0');
+
+		if (checkRange(minutes, 0, kMinutesPerHour - 1) == 0)
+		{
+			return 0;
+		}
+	}
+	else if (field[length] != '\0')
+	{
+		return 0;
+	}
+
+	// The minutes go the same way as the hours, so -3:30 is three and a half hours behind.
+	*offsetMinutes = hours * kMinutesPerHour + (isNegative ? -minutes : minutes);
+
+	return checkRange(*offsetMinutes, -12 * kMinutesPerHour, 14 * kMinutesPerHour);
+}
+
+
+
+/*
+* Function:			parseDaylightRule()
+* Description:		Reads the name of a daylight saving time rule.
+* Parameters:		const char* field		The rule, as written in the timetable.
+* Return Values:	The rule, e.g. kUSDaylightSaving, or -1 if it isn't one.
+*/
+static int parseDaylightRule(const char* field)
+{
+	if ((strcmp(field, "none") == 0) || (field[0] == '\0'))
+	{
+		return kNoDaylightSaving;
+	}
+	else if (strcmp(field, "us") == 0)
+	{
+		return kUSDaylightSaving;
+	}
+	else if (strcmp(field, "eu") == 0)
+	{
+		return kEUDaylightSaving;
+	}
+
+	return -1;
+}
+
+
+
+/*
+* Function:			parseDateField()
+* Description:		Reads a date from the timetable, given as YYYY-MM-DD.
+* Parameters:		const char* field		The date, as written in the timetable.
+*					int* dayNumber			Set to the date, as from dateAsDayNumber().
+* Return Values:	1 if the date is valid, 0 if it isn't.
+*/
+static int parseDateField(const char* field, int* dayNumber)
+{
+	int year = 0;
+	int month = 0;
+	int day = 0;
+	int length = 0;
+
+	if ((sscanf(field, "%d-%d-%d%n", &year, &month, &day, &length) != 3)
+		|| (field[length] != '\0') || (checkRange(year, 1970, 2199) == 0)
+		|| (checkRange(month, 1, 12) == 0) || (checkRange(day, 1, 31) == 0))
+	{
+		return 0;
+	}
+
+	*dayNumber = dateAsDayNumber(year, month, day);
+
+	// A day past the end of the month would be counted into the next one.
+	return (*dayNumber < dateAsDayNumber((month == 12) ? year + 1 : year,
+		(month == 12) ? 1 : month + 1, 1)) ? 1 : 0;
+}
+
+
+
+/*
+* Function:			parseWeekdaysField()
+* Description:		Reads the weekdays a flight runs on: the digits of the days, from 1 for
+*					Monday to 7 for Sunday, in any order. Dots, dashes and spaces may stand in
+*					for the days it doesn't run, e.g. 1.3.5.. or 12345--.
+* Parameters:		const char* field		The weekdays, as written in the timetable.
+*					int* weekdays			Set to the days, with bit 0 for Monday up to bit 6
+*											for Sunday.
+* Return Values:	1 if the weekdays are valid, 0 if they aren't.
+*/
+static int parseWeekdaysField(const char* field, int* weekdays)
+{
+	*weekdays = 0;
+
+	for (int i = 0; field[i] != '\0'; i++)
+	{
+		if ((field[i] >= '1') && (field[i] <= '7'))
+		{
+			*weekdays |= 1 << (field[i] - '1');
+		}
+		else if ((field[i] != '.') && (field[i] != '-') && (field[i] != ' '))
+		{
+			return 0;
+		}
+	}
+
+	return (*weekdays != 0) ? 1 : 0;
+}
+
+
+
+/*
+* Function:			nameUTCOffset()
+* Description:		Names a timezone after its offset from UTC, e.g. "UTC", "UTC-4" or
+*					"UTC+5:30", for an airport whose timezone isn't given a name.
+* Parameters:		char timezoneName[]		Set to the name. At least kTimezoneNameMax long.
+*					int offsetMinutes		The offset from UTC, in minutes.
+*/
+static void nameUTCOffset(char timezoneName[], int offsetMinutes)
+{
+	int hours = abs(offsetMinutes) / kMinutesPerHour;
+	int minutes = abs(offsetMinutes) % kMinutesPerHour;
+
+	if (offsetMinutes == 0)
+	{
+		strcpy(timezoneName, "UTC");
+	}
+	else if (minutes == 0)
+	{
+		sprintf(timezoneName, "UTC%c%d", (offsetMinutes < 0) ? '-' : '+', hours);
+	}
+	else
+	{
+		sprintf(timezoneName, "UTC%c%d:%02d", (offsetMinutes < 0) ? '-' : '+', hours, minutes);
+	}
+}
+
+
+
+/*
+* Function:			trimField()
+* Description:		Removes leading and trailing whitespace (including line endings) from a
+*					string, in place.
+* Parameters:		char* field		The string to trim.
+* Return Values:	A pointer to the first non-space character of field.
+*/
+static char* trimField(char* field)
+{
+	size_t length = 0;
+
+	while ((*field == ' ') || (*field == '\t'))
+	{
+		field++;
+	}
+
+	length = strlen(field);
+	while ((length > 0) && ((field[length - 1] == ' ') || (field[length - 1] == '\t')
+		|| (field[length - 1] == '\r') || (field[length - 1] == '\n')))
+	{
+		length--;
+	}
+	field[length] = '\0';
+
+	return field;
+}
+
+
+
+/*
+* Function:			splitFields()
+* Description:		Splits a CSV line into trimmed fields, in place.
+* Parameters:		char* line			The line to split.
+*					char* fields[]		Set to point at the start of each field.
+*					int maxFields		The size of fields[]. Extra fields are counted but
+*										not stored.
+* Return Values:	The number of fields on the line.
+*/
+static int splitFields(char* line, char* fields[], int maxFields)
+{
+	int fieldCount = 0;
+	char* fieldStart = line;
+	char* comma = NULL;
+
+	do
+	{
+		comma = strchr(fieldStart, ',');
+
+		if (comma != NULL)
+		{
+			*comma = '\0';
+		}
+
+		if (fieldCount < maxFields)
+		{
+			fields[fieldCount] = trimField(fieldStart);
+		}
+		fieldCount++;
+
+		fieldStart = comma + 1;
+	} while (comma != NULL);
+
+	return fieldCount;
+}
+
+
+
+/*
+* Function:			hashAirportName()
+* Description:		Hashes an airport name for the name lookup table (FNV-1a).
+* Parameters:		const char* airportName		The name to hash.
+* Return Values:	The hash of the name.
+*/
+static unsigned int hashAirportName(const char* airportName)
+{
+	unsigned int hash = 2166136261u;
+
+	while (*airportName != '\0')
+	{
+		hash ^= (unsigned char)*airportName;
+		hash *= 16777619u;
+		airportName++;
+	}
+
+	return hash;
+}
+
+
+
+/*
+* Function:			lookupAirport()
+* Description:		Looks up an airport by name in a timetable's name table.
+* Parameters:		const Timetable* network	The timetable to search.
+*					const char* airportName		The name to look for. Case sensitive.
+* Return Values:	The airport's cityID, or 0 if there is no airport by that name.
+*/
+static int lookupAirport(const Timetable* network, const char* airportName)
+{
+	int cityID = 0;
+
+	if (network->airportNameTableSize > 0)
+	{
+		unsigned int mask = network->airportNameTableSize - 1;
+		unsigned int slot = hashAirportName(airportName) & mask;
+
+		// Probe forward until the name or an empty slot is found.
+		while (network->airportNameTable[slot] != 0)
+		{
+			if (strcmp(network->airports[network->airportNameTable[slot]].name, airportName) == 0)
+			{
+				cityID = network->airportNameTable[slot];
+				break;
+			}
+
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	return cityID;
+}
+
+
+
+/*
+* Function:			addAirport()
+* Description:		Adds a new airport to a timetable being loaded, and to the name lookup table.
+* Parameters:		Timetable* network			The timetable being loaded.
+*					int* airportCapacity		The allocated size of network->airports, grown
+*												as needed.
+*					const char* airportName		The new airport's name.
+*					int offset					The airport's UTC offset, in minutes.
+*					const char* timezoneName	The name of the timezone, or NULL to name it
+*												after the offset (e.g. "UTC-4").
+*												The airport stays on this timezone all year
+*												unless its daylightRule is set afterwards.
+* Return Values:	The new airport's cityID, or 0 if the name is empty, too long, or there
+*					wasn't enough memory.
+*/
+static int addAirport(Timetable* network, int* airportCapacity, const char* airportName,
+	int offset, const char* timezoneName)
+{
+	int cityID = network->airportCount + 1;
+	AirportInfo* airport = NULL;
+	unsigned int slot = 0;
+
+	if ((airportName[0] == '\0') || (strlen(airportName) >= kAirportNameMax))
+	{
+		return 0;
+	}
+
+	// Grow the airport list as needed. Index 0 is left blank.
+	if ((cityID + 1) > *airportCapacity)
+	{
+		int newCapacity = (*airportCapacity == 0) ? 64 : *airportCapacity * 2;
+		AirportInfo* grownAirports = (AirportInfo*)realloc(network->airports,
+			newCapacity * sizeof(AirportInfo));
+
+		if (grownAirports == NULL)
+		{
+			return 0;
+		}
+
+		if (*airportCapacity == 0)
+		{
+			memset(&grownAirports[0], 0, sizeof(AirportInfo));
+		}
+
+		network->airports = grownAirports;
+		*airportCapacity = newCapacity;
+	}
+
+	// Keep the name table at most half full, so probes stay short.
+	if ((cityID * 2) > network->airportNameTableSize)
+	{
+		int newSize = (network->airportNameTableSize == 0) ? 128 : network->airportNameTableSize * 2;
+		int* newTable = (int*)calloc(newSize, sizeof(int));
+
+		if (newTable == NULL)
+		{
+			return 0;
+		}
+
+		// Re-insert every existing airport.
+		for (int i = 1; i < cityID; i++)
+		{
+			slot = hashAirportName(network->airports[i].name) & (newSize - 1);
+			while (newTable[slot] != 0)
+			{
+				slot = (slot + 1) & (newSize - 1);
+			}
+			newTable[slot] = i;
+		}
+
+		free(network->airportNameTable);
+		network->airportNameTable = newTable;
+		network->airportNameTableSize = newSize;
+	}
+
+	airport = &network->airports[cityID];
+	strcpy(airport->name, airportName);
+	airport->standardOffset = offset;
+	airport->timezoneOffset = offset;
+	airport->daylightRule = kNoDaylightSaving;
+	airport->minimumConnection = 0;
+
+	if ((timezoneName != NULL) && (timezoneName[0] != '\0'))
+	{
+		strncpy(airport->standardName, timezoneName, kTimezoneNameMax - 1);
+		airport->standardName[kTimezoneNameMax - 1] = '\0';
+	}
+	else
+	{
+		nameUTCOffset(airport->standardName, offset);
+	}
+
+	strcpy(airport->timezoneName, airport->standardName);
+	strcpy(airport->daylightName, airport->standardName);
+
+	slot = hashAirportName(airportName) & (network->airportNameTableSize - 1);
+	while (network->airportNameTable[slot] != 0)
+	{
+		slot = (slot + 1) & (network->airportNameTableSize - 1);
+	}
+	network->airportNameTable[slot] = cityID;
+
+	network->airportCount = cityID;
+
+	return cityID;
+}
+
+
+
+/*
+* Function:			applyTravelDate()
+* Description:		Sets every airport's timezone to the one it is on for the travel date:
+*					standard time, or an hour ahead on daylight saving time.
+* Parameters:		Timetable* network		The timetable being loaded.
+*					int travelDate			The day, as from dateAsDayNumber().
+*/
+static void applyTravelDate(Timetable* network, int travelDate)
+{
+	for (int i = 1; i <= network->airportCount; i++)
+	{
+		AirportInfo* airport = &network->airports[i];
+
+		if (isDaylightSaving(airport->daylightRule, travelDate) == 1)
+		{
+			airport->timezoneOffset = airport->standardOffset + kMinutesPerHour;
+			strcpy(airport->timezoneName, airport->daylightName);
+		}
+		else
+		{
+			airport->timezoneOffset = airport->standardOffset;
+			strcpy(airport->timezoneName, airport->standardName);
+		}
+	}
+}
+
+
+
+/*
+* Function:			isDaylightSaving()
+* Description:		Checks whether a daylight saving time rule has the clocks forward on a
+*					date. Clocks change early on a Sunday morning, so the day they go forward
+*					counts as daylight saving time, and the day they go back doesn't.
+* Parameters:		int daylightRule		The rule, e.g. kUSDaylightSaving.
+*					int travelDate			The day, as from dateAsDayNumber().
+* Return Values:	1 if the clocks are forward that day, 0 if they aren't.
+*/
+static int isDaylightSaving(int daylightRule, int travelDate)
+{
+	// Find the date's year, starting from a guess that is never too late.
+	int year = 1970 + travelDate / 366 - 1;
+	int startDay = 0;
+	int endDay = 0;
+
+	if (daylightRule == kNoDaylightSaving)
+	{
+		return 0;
+	}
+
+	while (dateAsDayNumber(year + 1, 1, 1) <= travelDate)
+	{
+		year++;
+	}
+
+	if (daylightRule == kUSDaylightSaving)
+	{
+		// The second Sunday in March, to the first Sunday in November.
+		startDay = sundayOnOrBefore(dateAsDayNumber(year, 3, 14));
+		endDay = sundayOnOrBefore(dateAsDayNumber(year, 11, 7));
+	}
+	else
+	{
+		// The last Sunday in March, to the last Sunday in October.
+		startDay = sundayOnOrBefore(dateAsDayNumber(year, 3, 31));
+		endDay = sundayOnOrBefore(dateAsDayNumber(year, 10, 31));
+	}
+
+	return ((travelDate >= startDay) && (travelDate < endDay)) ? 1 : 0;
+}
+
+
+
+/*
+* Function:			sundayOnOrBefore()
+* Description:		Finds the last Sunday on or before a day.
+* Parameters:		int dayNumber		The day, as from dateAsDayNumber().
+* Return Values:	The Sunday, as a day number.
+*/
+static int sundayOnOrBefore(int dayNumber)
+{
+	// Day 0, 1 January 1970, was a Thursday: 4 days after a Sunday.
+	int daysSinceSunday = ((dayNumber + 4) % 7 + 7) % 7;
+
+	return dayNumber - daysSinceSunday;
+}
+
+
+
+/*
+* Function:			buildServiceDays()
+* Description:		Turns each flight's operating days into a row of bits over the timetable's
+*					calendar, and gives the flight that row as its serviceID. A flight's days
+*					are its origin's local dates, so they're moved onto UTC days along with its
+*					departure: a flight leaving before its origin's midnight UTC, say, leaves on
+*					the UTC day before. The calendar has a spare day at each end for that.
+*					Like the departures, the days are moved on the travel date's clocks. Which
+*					dates have the clocks forward is kept in daylightDays[], for the searches to
+*					move each day's departures to its own clocks (see departureShift()).
+*					Flights with the same days share a row, found through a hash table of the
+*					rows made so far, and the rows are trimmed to fit once they're all made.
+* Parameters:		Timetable* network			The timetable being loaded, with each airport's
+*												timezone for the travel date.
+*					Flight* flights				The flights, with local departure times and a
+*												serviceID indexing rules[]. Changed in place.
+*					const ServiceRule* rules	The days each flight record gave.
+*					int flightCount				The number of flights.
+*					int firstDate				The calendar's first date, as a day number.
+*					int lastDate				The calendar's last date.
+*					int travelDate				The travel date, the searches' day 0.
+* Return Values:	1 if the rows were made, 0 if there wasn't enough memory.
+*/
+static int buildServiceDays(Timetable* network, Flight* flights, const ServiceRule* rules,
+	int flightCount, int firstDate, int lastDate, int travelDate)
+{
+	// Calendar day 0 is the spare day before firstDate.
+	int calendarStart = firstDate - 1;
+	int rowCount = 0;
+	unsigned int* rowTable = NULL;
+	unsigned int rowTableSize = 1;
+	unsigned int* trimmedDays = NULL;
+
+	// Keep the row table at most half full, as for airport names. Each slot is a row plus 1.
+	while (rowTableSize < 2 * (unsigned int)(flightCount + 1))
+	{
+		rowTableSize *= 2;
+	}
+
+	network->serviceDayCount = lastDate - firstDate + 3;
+	network->serviceWords = (network->serviceDayCount + 31) / 32;
+	network->firstServiceDay = travelDate - calendarStart;
+	network->serviceDays = (unsigned int*)calloc((size_t)(flightCount + 1) * network->serviceWords,
+		sizeof(unsigned int));
+	network->daylightDays = (unsigned char*)calloc(network->serviceDayCount, sizeof(unsigned char));
+	rowTable = (unsigned int*)calloc(rowTableSize, sizeof(unsigned int));
+
+	if ((network->serviceDays == NULL) || (network->daylightDays == NULL) || (rowTable == NULL))
+	{
+		free(rowTable);
+		return 0;
+	}
+
+	for (int calendarDay = 0; calendarDay < network->serviceDayCount; calendarDay++)
+	{
+		for (int rule = kUSDaylightSaving; rule <= kEUDaylightSaving; rule++)
+		{
+			if (isDaylightSaving(rule, calendarStart + calendarDay) == 1)
+			{
+				network->daylightDays[calendarDay] |= (unsigned char)(1 << rule);
+			}
+		}
+	}
+
+	for (int i = 0; i < flightCount; i++)
+	{
+		const ServiceRule* rule = &rules[flights[i].serviceID];
+		unsigned int* row = &network->serviceDays[(size_t)rowCount * network->serviceWords];
+		int localDeparture = timeAsMinutes(flights[i].departureTime);
+		int dayShift = dayOfTime(localDeparture
+			- network->airports[flights[i].originCity].timezoneOffset);
+		int firstDay = (rule->firstDate > firstDate) ? rule->firstDate : firstDate;
+		int lastDay = (rule->lastDate < lastDate) ? rule->lastDate : lastDate;
+		unsigned int slot = 0;
+
+		for (int date = firstDay; date <= lastDay; date++)
+		{
+			// Day 0, 1 January 1970, was a Thursday: 3 days after a Monday.
+			int weekday = ((date + 3) % 7 + 7) % 7;
+
+			if ((rule->weekdays & (1 << weekday)) != 0)
+			{
+				int calendarDay = date + dayShift - calendarStart;
+
+				row[calendarDay / 32] |= 1u << (calendarDay % 32);
+			}
+		}
+
+		// Share an earlier row if one has the same days, or keep this one as a new row.
+		slot = hashServiceRow(row, network->serviceWords) & (rowTableSize - 1);
+		while (rowTable[slot] != 0)
+		{
+			const unsigned int* sharedRow = &network->serviceDays[(size_t)(rowTable[slot] - 1)
+				* network->serviceWords];
+
+			if (memcmp(row, sharedRow, network->serviceWords * sizeof(unsigned int)) == 0)
+			{
+				break;
+			}
+
+			slot = (slot + 1) & (rowTableSize - 1);
+		}
+
+		if (rowTable[slot] != 0)
+		{
+			memset(row, 0, network->serviceWords * sizeof(unsigned int));
+			flights[i].serviceID = (int)rowTable[slot] - 1;
+		}
+		else
+		{
+			rowTable[slot] = (unsigned int)rowCount + 1;
+			flights[i].serviceID = rowCount;
+			rowCount++;
+		}
+	}
+
+	free(rowTable);
+
+	// Most flights share their days with others, so give back the rows that weren't needed.
+	trimmedDays = (unsigned int*)realloc(network->serviceDays,
+		(size_t)((rowCount > 0) ? rowCount : 1) * network->serviceWords * sizeof(unsigned int));
+	if (trimmedDays != NULL)
+	{
+		network->serviceDays = trimmedDays;
+	}
+
+	return 1;
+}
+
+
+
+/*
+* Function:			hashServiceRow()
+* Description:		Hashes a row of operating days for buildServiceDays(). Each word is mixed
+*					down into the low bits, since the table only looks at those, and seasons
+*					that differ only late in a word would otherwise share a slot.
+* Parameters:		const unsigned int* row		The row.
+*					int wordCount				The words in the row.
+* Return Values:	The hash of the row.
+*/
+static unsigned int hashServiceRow(const unsigned int* row, int wordCount)
+{
+	unsigned int hash = 2166136261u;
+
+	for (int word = 0; word < wordCount; word++)
+	{
+		hash ^= row[word];
+		hash *= 0x45d9f3bu;
+		hash ^= hash >> 16;
+	}
+
+	return hash;
+}
+
+
+
+/*
+* Function:			testServiceBit()
+* Description:		Checks one day in a row of operating days.
+* Parameters:		const Timetable* network	The timetable.
+*					const unsigned int* days	The row.
+*					int calendarDay				The day, counting from the calendar's first day.
+*												May be outside the calendar.
+* Return Values:	1 if the day's bit is set, 0 if it isn't or the day is outside the calendar.
+*/
+static int testServiceBit(const Timetable* network, const unsigned int* days, int calendarDay)
+{
+	if ((calendarDay < 0) || (calendarDay >= network->serviceDayCount))
+	{
+		return 0;
+	}
+
+	return (days[calendarDay / 32] >> (calendarDay % 32)) & 1;
+}
+
+
+
+/*
+* Function:			normalizeFlightTimes()
+* Description:		Turns flights read as local HHMM times into the form the timetable keeps:
+*					departures in minutes since midnight UTC (within a single day), and
+*					durations in minutes. Done once, as the timetable is loaded.
+* Parameters:		const Timetable* network	The timetable being loaded, with each airport's
+*												timezone for the travel date.
+*					Flight* flights				The flights. Changed in place.
+*					int flightCount				The number of flights.
+*/
+static void normalizeFlightTimes(const Timetable* network, Flight* flights, int flightCount)
+{
+	for (int i = 0; i < flightCount; i++)
+	{
+		int departure = timeAsMinutes(flights[i].departureTime)
+			- network->airports[flights[i].originCity].timezoneOffset;
+
+		flights[i].departureTime = (departure % kMinutesPerDay + kMinutesPerDay) % kMinutesPerDay;
+		flights[i].flightDuration = timeAsMinutes(flights[i].flightDuration);
+	}
+}
+
+
+
+/*
+* Function:			compareFlights()
+* Description:		qsort() comparison that orders flights by origin, then destination, then
+*					departure time (in UTC, once the times have been normalized).
+* Parameters:		const void* first		The first Flight.
+*					const void* second		The second Flight.
+* Return Values:	Negative, 0 or positive as first sorts before, with or after second.
+*/
+static int compareFlights(const void* first, const void* second)
+{
+	const Flight* firstFlight = (const Flight*)first;
+	const Flight* secondFlight = (const Flight*)second;
+	int difference = firstFlight->originCity - secondFlight->originCity;
+
+	if (difference == 0)
+	{
+		difference = firstFlight->destinationCity - secondFlight->destinationCity;
+	}
+	if (difference == 0)
+	{
+		difference = firstFlight->departureTime - secondFlight->departureTime;
+	}
+	if (difference == 0)
+	{
+		difference = firstFlight->flightDuration - secondFlight->flightDuration;
+	}
+
+	return difference;
+}
+
+
+
+/*
+* Function:			legOfFlight()
+* Description:		Finds the leg a flight is on, with a binary search of the legs' first flights.
+* Parameters:		const Timetable* network	The timetable.
+*					int flightID				The flight.
+* Return Values:	The leg.
+*/
+static int legOfFlight(const Timetable* network, int flightID)
+{
+	int low = 0;
+	int high = network->legCount;
+
+	// Find the last leg whose first flight is no later than flightID.
+	while (high - low > 1)
+	{
+		int middle = low + (high - low) / 2;
+
+		if (network->departureOffsets[middle] <= flightID)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+
+
+/*
+* Function:			findSoonestOnwardFlights()
+* Description:		Fills in soonestOnwardFlight[] for one leg, as buildFlightGraph() does for
+*					every leg, after its flights have changed.
+* Parameters:		Timetable* network		The timetable.
+*					int leg					The leg whose flights changed.
+*/
+static void findSoonestOnwardFlights(Timetable* network, int leg)
+{
+	int firstFlight = network->departureOffsets[leg];
+	int lastFlight = network->departureOffsets[leg + 1];
+
+	network->soonestOnwardFlight[lastFlight - 1] = lastFlight - 1;
+
+	for (int i = lastFlight - 2; i >= firstFlight; i--)
+	{
+		if (network->arrivalMinutes[i] <= network->arrivalMinutes[network->soonestOnwardFlight[i + 1]])
+		{
+			network->soonestOnwardFlight[i] = i;
+		}
+		else
+		{
+			network->soonestOnwardFlight[i] = network->soonestOnwardFlight[i + 1];
+		}
+	}
+}
+
+
+
+/*
+* Function:			buildFlightGraph()
+* Description:		Sorts the loaded flights into legs and fills in the CSR arrays of a
+*					timetable.
+* Parameters:		Timetable* network		The timetable being loaded. Its airports must
+*											already be filled in.
+*					Flight* flights			Every flight, with its times normalized to UTC
+*											minutes (see normalizeFlightTimes()). Sorted in
+*											place.
+*					int flightCount			The number of flights.
+* Return Values:	1 if the arrays were built, 0 if there wasn't enough memory.
+*/
+static int buildFlightGraph(Timetable* network, Flight* flights, int flightCount)
+{
+	int legCount = 0;
+	int leg = -1;
+
+	qsort(flights, flightCount, sizeof(Flight), compareFlights);
+
+	// Count the legs: one for each distinct origin/destination pair.
+	for (int i = 0; i < flightCount; i++)
+	{
+		if ((i == 0) || (flights[i].originCity != flights[i - 1].originCity)
+			|| (flights[i].destinationCity != flights[i - 1].destinationCity))
+		{
+			legCount++;
+		}
+	}
+
+	network->flightCount = flightCount;
+	network->legCount = legCount;
+	network->legOffsets = (int*)calloc(network->airportCount + 2, sizeof(int));
+	network->legDestinations = (int*)malloc((legCount + 1) * sizeof(int));
+	network->departureOffsets = (int*)malloc((legCount + 1) * sizeof(int));
+	network->departures = (Flight*)malloc((flightCount + 1) * sizeof(Flight));
+	network->departureMinutes = allocateSearchArray(flightCount + 1);
+	network->arrivalMinutes = allocateSearchArray(flightCount + 1);
+	network->soonestOnwardFlight = allocateSearchArray(flightCount + 1);
+
+	if ((network->legOffsets == NULL) || (network->legDestinations == NULL)
+		|| (network->departureOffsets == NULL) || (network->departures == NULL)
+		|| (network->departureMinutes == NULL) || (network->arrivalMinutes == NULL)
+		|| (network->soonestOnwardFlight == NULL))
+	{
+		return 0;
+	}
+
+	// Fill in each leg's destination and first flight, counting the legs from each airport.
+	for (int i = 0; i < flightCount; i++)
+	{
+		if ((i == 0) || (flights[i].originCity != flights[i - 1].originCity)
+			|| (flights[i].destinationCity != flights[i - 1].destinationCity))
+		{
+			leg++;
+			network->legDestinations[leg] = flights[i].destinationCity;
+			network->departureOffsets[leg] = i;
+			network->legOffsets[flights[i].originCity + 1]++;
+		}
+
+		network->departures[i] = flights[i];
+		network->departureMinutes[i] = flights[i].departureTime;
+		network->arrivalMinutes[i] = flights[i].departureTime + flights[i].flightDuration;
+	}
+	network->departureOffsets[legCount] = flightCount;
+
+	/* With a calendar, keep each flight's row of days next to its times, and the days any
+	flight on each leg runs. */
+	if (network->serviceDayCount > 0)
+	{
+		network->flightServices = allocateSearchArray(flightCount + 1);
+		network->legServiceDays = (unsigned int*)calloc((size_t)(legCount + 1)
+			* network->serviceWords, sizeof(unsigned int));
+
+		if ((network->flightServices == NULL) || (network->legServiceDays == NULL))
+		{
+			return 0;
+		}
+
+		leg = -1;
+		for (int i = 0; i < flightCount; i++)
+		{
+			const unsigned int* days = &network->serviceDays[(size_t)flights[i].serviceID
+				* network->serviceWords];
+
+			if (network->departureOffsets[leg + 1] == i)
+			{
+				leg++;
+			}
+
+			network->flightServices[i] = flights[i].serviceID;
+			for (int word = 0; word < network->serviceWords; word++)
+			{
+				network->legServiceDays[(size_t)leg * network->serviceWords + word] |= days[word];
+			}
+		}
+	}
+
+	/* Work back from the last flight of each leg, keeping track of the soonest-landing flight
+	seen so far. Flights are sorted by departure, so on a tie the earlier flight replaces the
+	later one. */
+	for (int i = flightCount - 1; i >= 0; i--)
+	{
+		int lastOnLeg = (i == flightCount - 1)
+			|| (flights[i].originCity != flights[i + 1].originCity)
+			|| (flights[i].destinationCity != flights[i + 1].destinationCity);
+
+		if ((lastOnLeg == 1)
+			|| (network->arrivalMinutes[i] <= network->arrivalMinutes[network->soonestOnwardFlight[i + 1]]))
+		{
+			network->soonestOnwardFlight[i] = i;
+		}
+		else
+		{
+			network->soonestOnwardFlight[i] = network->soonestOnwardFlight[i + 1];
+		}
+	}
+
+	/* Turn the per-airport leg counts into offsets. legOffsets[a + 1] held the number of
+	legs leaving airport a, so a running total gives where each airport's legs start. */
+	for (int i = 1; i <= network->airportCount + 1; i++)
+	{
+		network->legOffsets[i] += network->legOffsets[i - 1];
+	}
+
+	return 1;
+}
+
+
+
+/*
+* Function:			allocateSearchArray()
+* Description:		Allocates one of the timetable's search arrays, starting on a cache line
+*					boundary. Must be released with freeSearchArray().
+* Parameters:		int count		The number of ints the array holds.
+* Return Values:	The array, or NULL if there wasn't enough memory.
+*/
+static int* allocateSearchArray(int count)
+{
+#ifdef _WIN32
+	return (int*)_aligned_malloc((size_t)count * sizeof(int), kCacheLineSize);
+#else
+	void* searchArray = NULL;
+
+	if (posix_memalign(&searchArray, kCacheLineSize, (size_t)count * sizeof(int)) != 0)
+	{
+		return NULL;
+	}
+
+	return (int*)searchArray;
+#endif
+}
+
+
+
+/*
+* Function:			freeSearchArray()
+* Description:		Releases an array from allocateSearchArray(). NULL is allowed.
+* Parameters:		int* searchArray		The array to release.
+*/
+static void freeSearchArray(int* searchArray)
+{
+#ifdef _WIN32
+	_aligned_free(searchArray);
+#else
+	free(searchArray);
+#endif
+}
+
+
+
+/*
+* Function:			releaseTimetable()
+* Description:		Frees every array a timetable owns and empties it.
+* Parameters:		Timetable* network		The timetable to release.
+*/
+static void releaseTimetable(Timetable* network)
+{
+	Timetable emptyTimetable = { 0 };
+
+	free(network->airports);
+	free(network->legOffsets);
+	free(network->legDestinations);
+	free(network->departureOffsets);
+	free(network->departures);
+	freeSearchArray(network->departureMinutes);
+	freeSearchArray(network->arrivalMinutes);
+	freeSearchArray(network->soonestOnwardFlight);
+	free(network->serviceDays);
+	freeSearchArray(network->flightServices);
+	free(network->legServiceDays);
+	free(network->daylightDays);
+	free(network->airportNameTable);
+
+	*network = emptyTimetable;
+}
+
+
+
+/*
+* Function:			nextRandom()
+* Description:		A small xorshift random number generator, so generated networks don't
+*					depend on the platform's rand().
+* Parameters:		unsigned int* state		The generator's state. Must not be 0. Updated.
+* Return Values:	The next random number.
+*/
+static unsigned int nextRandom(unsigned int* state)
+{
+	unsigned int x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+
+	*state = x;
+	return x;
+}
+
+
+
+/*
+* Function:			randomBelow()
+* Description:		Picks a random number from 0 up to (but not including) limit.
+* Parameters:		unsigned int* state		The generator's state. Updated.
+*					int limit				One more than the largest number wanted.
+* Return Values:	The random number.
+*/
+static int randomBelow(unsigned int* state, int limit)
+{
+	return (int)(nextRandom(state) % (unsigned int)limit);
+}
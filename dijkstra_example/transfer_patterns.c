@@ -0,0 +1,938 @@
+/*
+* Filename:				transfer_patterns.c
+* Description:			The transfer pattern engine for the Amazing Race flight planner. A transfer
+*						pattern is the list of airports a best plan passes through, without its
+*						times: origin, where it changes flights, destination. However many flights
+*						a day there are, each origin and destination pair only has a handful of
+*						patterns that are ever best, so they can be found ahead of time, and a
+*						query only has to try those few instead of searching the network.
+*
+*						Keeping every pattern between every pair of airports grows with the square
+*						of the airports, so patterns are only kept locally. A few of the busiest
+*						airports are hubs, and each airport's local patterns stop at the first hub
+*						they reach: they are the best plans that change flights only at airports
+*						that aren't hubs. Every best plan is then a run of local patterns, from the
+*						origin to a hub, from hub to hub, and from the last hub to the destination.
+*						A query searches over those runs: a Dijkstra search whose only stops are
+*						the origin and the hubs, which flies each stop's local patterns to the
+*						other hubs and to the destination. The index holds one small tree of
+*						patterns per airport, so it grows with the airports, not their square.
+*
+*						The patterns are found when the program starts, spread over worker threads
+*						one origin at a time. Since the flights are the same every day, a start
+*						time only matters up to the origin's next departure, so one search from
+*						just before each distinct departure time out of the origin finds every best
+*						plan from there. As for profiles (see profile.c), the searches run from the
+*						latest departure to the earliest, and each stops at any airport it can't
+*						reach sooner than a later departure did. A search also stops at every hub
+*						but the origin. The airports of every plan found are merged into one tree
+*						of patterns (a trie): each node is a leg, and its parent is the pattern up
+*						to that leg's origin. Every node is a pattern, to the airport its leg
+*						flies to.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+/* The patterns. Airport a's nodes are nodeOffsets[a] up to nodeOffsets[a + 1]. Each node's
+parent is the index of the node before it, or -1 where the pattern starts at the airport, and
+its leg is the last leg of its pattern. destinationNodes[] holds the same range of node
+indices again, sorted by the airport each pattern ends at. hubNodes[] holds just the ones that
+end at a hub, airport a's from hubNodeOffsets[a] up to hubNodeOffsets[a + 1]. Empty until
+buildTransferPatterns() is called. */
+static int patternAirportCount = 0;
+static char* hubAirports = NULL;	// [airportCount + 1] 1 for a hub, 0 otherwise.
+static int* nodeOffsets = NULL;
+static int* nodeParents = NULL;
+static int* nodeLegs = NULL;
+static int* destinationNodes = NULL;
+static int* hubNodeOffsets = NULL;
+static int* hubNodes = NULL;
+
+// One origin's patterns, as found by a worker, waiting to be packed.
+typedef struct
+{
+	int nodeCount;					// The number of nodes.
+	int* parents;					// Each node's parent, as an index into this origin's nodes.
+	int* legs;						// Each node's leg.
+} OriginPatterns;
+
+/* What each thread finding patterns is given: where to keep them, and its own working memory.
+The trie being built for the current origin is kept here, and grown as needed. */
+typedef struct
+{
+	OriginPatterns* origins;		// [airportCount + 1] Each origin's patterns, shared.
+	QueryScratch scratch;
+
+	int* departureTimes;			// Every departure time out of the current origin, sorted.
+	int* bestArrivals;				// [airportCount + 1] Soonest arrival from later departures.
+	int* bestOrigins;				// [airportCount + 1] The origin bestArrivals[] is for, or 0.
+	int* parents;					// Each trie node's parent, or -1.
+	int* legs;						// Each trie node's leg.
+	int* firstChildren;				// Each trie node's first child, or -1.
+	int* nextSiblings;				// The next child of each trie node's parent, or -1.
+	int* rootChildren;				// [airportCount + 1] The node for each first leg, or -1.
+	int nodeCount;					// The number of trie nodes in use.
+	int nodesAllocated;				// The number of trie nodes there's room for.
+} PatternBuilder;
+
+// An airport and how many flights leave it, for picking the hubs.
+typedef struct
+{
+	int airport;
+	int departureCount;
+} AirportDepartures;
+
+
+
+static int chooseHubs(int hubCount);
+static int findOriginPatterns(void* builder, int origin);
+static int findTrieChild(PatternBuilder* self, int parent, int leg);
+static int flyPattern(int* patternLegs, int node, int groundTime, int arrivalLimit);
+static int compareMinutes(const void* first, const void* second);
+static int compareDepartureCounts(const void* first, const void* second);
+
+
+
+/*
+* Function:			buildTransferPatterns()
+* Description:		Picks the hubs, finds every airport's local transfer patterns and packs them
+*					into the index used by transferEarliestArrivals(), reporting how long it took
+*					and how big the index is. Must be called again whenever the timetable changes.
+* Parameters:		int hubCount		The number of hubs: the airports with the most flights
+*										out. 0 for every airport with at least kTransferHubFactor
+*										times the average.
+*					int threadCount		The number of threads to build with. 0 for one per core.
+* Return Values:	1 if the index was built, 0 if there wasn't enough memory.
+*/
+int buildTransferPatterns(int hubCount, int threadCount)
+{
+	const Timetable* network = flightTimetable();
+	int airportCount = network->airportCount;
+
+	double startSeconds = wallClockSeconds();
+	OriginPatterns* origins = NULL;
+	PatternBuilder* builders = NULL;
+	int threadsUsed = 0;
+	int isOutOfMemory = 0;
+	int nodeCount = 0;
+	int hubNodeCount = 0;
+
+	int* newOffsets = NULL;
+	int* newParents = NULL;
+	int* newLegs = NULL;
+	int* newDestinationNodes = NULL;
+	int* newHubOffsets = NULL;
+	int* newHubNodes = NULL;
+
+	// The hubs are needed while the patterns are found, so they replace the old ones first.
+	freeTransferPatterns();
+	hubCount = chooseHubs(hubCount);
+	if (hubCount < 0)
+	{
+		return 0;
+	}
+
+	threadCount = workerThreadCount(threadCount, airportCount);
+	origins = (OriginPatterns*)calloc(airportCount + 1, sizeof(OriginPatterns));
+	builders = (PatternBuilder*)calloc(threadCount, sizeof(PatternBuilder));
+
+	if ((origins == NULL) || (builders == NULL))
+	{
+		free(origins);
+		free(builders);
+		freeTransferPatterns();
+		return 0;
+	}
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		builders[i].origins = origins;
+		builders[i].departureTimes = (int*)malloc((network->flightCount + 1) * sizeof(int));
+		builders[i].bestArrivals = (int*)malloc((airportCount + 1) * sizeof(int));
+		builders[i].bestOrigins = (int*)calloc(airportCount + 1, sizeof(int));
+		builders[i].rootChildren = (int*)malloc((airportCount + 1) * sizeof(int));
+
+		if ((initQueryScratch(&builders[i].scratch) == 0)
+			|| (builders[i].departureTimes == NULL) || (builders[i].bestArrivals == NULL)
+			|| (builders[i].bestOrigins == NULL) || (builders[i].rootChildren == NULL))
+		{
+			isOutOfMemory = 1;
+			break;
+		}
+
+		for (int airport = 0; airport <= airportCount; airport++)
+		{
+			builders[i].rootChildren[airport] = -1;
+		}
+	}
+
+	if ((isOutOfMemory == 0) && (runForEachOrigin(airportCount, builders, threadCount,
+		sizeof(PatternBuilder), findOriginPatterns, &threadsUsed) == 0))
+	{
+		isOutOfMemory = 1;
+	}
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		freeQueryScratch(&builders[i].scratch);
+		free(builders[i].departureTimes);
+		free(builders[i].bestArrivals);
+		free(builders[i].bestOrigins);
+		free(builders[i].parents);
+		free(builders[i].legs);
+		free(builders[i].firstChildren);
+		free(builders[i].nextSiblings);
+		free(builders[i].rootChildren);
+	}
+	free(builders);
+
+	// <Index packing>
+	// Lay every origin's nodes end to end, and sort each origin's nodes by destination.
+	if (isOutOfMemory == 0)
+	{
+		newOffsets = (int*)malloc((airportCount + 2) * sizeof(int));
+		newHubOffsets = (int*)malloc((airportCount + 2) * sizeof(int));
+
+		if ((newOffsets != NULL) && (newHubOffsets != NULL))
+		{
+			newOffsets[0] = 0;
+			newHubOffsets[0] = 0;
+			for (int origin = 0; origin <= airportCount; origin++)
+			{
+				const OriginPatterns* patterns = &origins[origin];
+
+				for (int node = 0; node < patterns->nodeCount; node++)
+				{
+					hubNodeCount += hubAirports[network->legDestinations[patterns->legs[node]]];
+				}
+
+				nodeCount += patterns->nodeCount;
+				newOffsets[origin + 1] = nodeCount;
+				newHubOffsets[origin + 1] = hubNodeCount;
+			}
+
+			newParents = (int*)malloc((nodeCount + 1) * sizeof(int));
+			newLegs = (int*)malloc((nodeCount + 1) * sizeof(int));
+			newDestinationNodes = (int*)malloc((nodeCount + 1) * sizeof(int));
+			newHubNodes = (int*)malloc((hubNodeCount + 1) * sizeof(int));
+		}
+
+		if ((newOffsets == NULL) || (newHubOffsets == NULL) || (newParents == NULL)
+			|| (newLegs == NULL) || (newDestinationNodes == NULL) || (newHubNodes == NULL))
+		{
+			isOutOfMemory = 1;
+		}
+	}
+
+	if (isOutOfMemory == 0)
+	{
+		// Counts of each origin's nodes per destination, then where each destination starts.
+		int* destinationStarts = (int*)malloc((airportCount + 2) * sizeof(int));
+
+		if (destinationStarts == NULL)
+		{
+			isOutOfMemory = 1;
+		}
+
+		for (int origin = 1; (origin <= airportCount) && (isOutOfMemory == 0); origin++)
+		{
+			const OriginPatterns* patterns = &origins[origin];
+			int first = newOffsets[origin];
+			int nextHubNode = newHubOffsets[origin];
+
+			memset(destinationStarts, 0, (airportCount + 2) * sizeof(int));
+
+			for (int node = 0; node < patterns->nodeCount; node++)
+			{
+				int airport = network->legDestinations[patterns->legs[node]];
+
+				newParents[first + node] = (patterns->parents[node] < 0) ? -1
+					: first + patterns->parents[node];
+				newLegs[first + node] = patterns->legs[node];
+				destinationStarts[airport + 1]++;
+
+				if (hubAirports[airport] == 1)
+				{
+					newHubNodes[nextHubNode] = first + node;
+					nextHubNode++;
+				}
+			}
+
+			for (int airport = 1; airport <= airportCount; airport++)
+			{
+				destinationStarts[airport] += destinationStarts[airport - 1];
+			}
+
+			for (int node = 0; node < patterns->nodeCount; node++)
+			{
+				int airport = network->legDestinations[patterns->legs[node]];
+
+				newDestinationNodes[first + destinationStarts[airport]] = first + node;
+				destinationStarts[airport]++;
+			}
+		}
+
+		free(destinationStarts);
+	} // End of index packing.
+
+	for (int origin = 0; origin <= airportCount; origin++)
+	{
+		free(origins[origin].parents);
+		free(origins[origin].legs);
+	}
+	free(origins);
+
+	if (isOutOfMemory == 1)
+	{
+		free(newOffsets);
+		free(newParents);
+		free(newLegs);
+		free(newDestinationNodes);
+		free(newHubOffsets);
+		free(newHubNodes);
+		freeTransferPatterns();
+		return 0;
+	}
+
+	patternAirportCount = airportCount;
+	nodeOffsets = newOffsets;
+	nodeParents = newParents;
+	nodeLegs = newLegs;
+	destinationNodes = newDestinationNodes;
+	hubNodeOffsets = newHubOffsets;
+	hubNodes = newHubNodes;
+
+	fprintf(stderr, "Found %d transfer patterns for %d airports and %d hub%s on %d thread%s in "
+		"%.3f seconds (%.1f MB).\n", nodeCount, airportCount, hubCount,
+		(hubCount != 1) ? "s" : "", threadsUsed, (threadsUsed > 1) ? "s" : "",
+		wallClockSeconds() - startSeconds,
+		(2 * (airportCount + 2) * sizeof(int) + (airportCount + 1) * sizeof(char)
+		+ ((size_t)nodeCount * 3 + hubNodeCount) * sizeof(int)) / (1024.0 * 1024.0));
+
+	return 1;
+}
+
+
+
+/*
+* Function:			freeTransferPatterns()
+* Description:		Releases the transfer patterns and the hubs.
+*/
+void freeTransferPatterns(void)
+{
+	free(hubAirports);
+	free(nodeOffsets);
+	free(nodeParents);
+	free(nodeLegs);
+	free(destinationNodes);
+	free(hubNodeOffsets);
+	free(hubNodes);
+
+	hubAirports = NULL;
+	nodeOffsets = NULL;
+	nodeParents = NULL;
+	nodeLegs = NULL;
+	destinationNodes = NULL;
+	hubNodeOffsets = NULL;
+	hubNodes = NULL;
+	patternAirportCount = 0;
+}
+
+
+
+/*
+* Function:			transferEarliestArrivals()
+* Description:		Finds the flights to take to the destination by flying runs of local transfer
+*					patterns. A Dijkstra search settles the origin and the hubs in order of the
+*					earliest time each can be reached. Each one settled flies its patterns to the
+*					destination, keeping the soonest arrival, and its patterns to the other hubs,
+*					to reach them. Once the next stop is no sooner than the best arrival, nothing
+*					can beat it. Only the destination's chain of flights is filled in
+*					earliestArrivals[], which is all createFastestFlightplan() needs, and listed
+*					(see beginReachedList()).
+* Parameters:		QueryScratch* scratch		Working memory for the query.
+*					int startTimeMinutes		The user's starting time, in the local timezone.
+*					int originAirport			The user's starting airport.
+*					int destinationAirport		The airport to find the flights to.
+*					Flight earliestArrivals[]	An array to pass the flights to, as for
+*												mapEarliestArrivals().
+*/
+void transferEarliestArrivals(QueryScratch* scratch, const int startTimeInMinutes,
+	int originAirport, int destinationAirport, const Flight* earliestArrivals[])
+{
+	const Timetable* network = flightTimetable();
+	int startTimeUTC = startTimeInMinutes - timezoneOffset(originAirport);
+
+	int* groundTimes = scratch->groundTimes;
+	AirportHeap* stops = &scratch->heap;
+	unsigned int* airportStamps = scratch->airportStamps;
+	unsigned int reachedStamp = startSearchGeneration(scratch);
+	unsigned int settledStamp = reachedStamp + 1;
+
+	/* For each hub reached, the pattern it was reached by and the stop that pattern starts
+	from. Only meaningful for airports stamped by this search. */
+	int* entryNodes = scratch->markedAirports;
+	int* entryStops = scratch->nextMarkedAirports;
+	int* patternLegs = scratch->estimatedArrivals;
+
+	int bestArrival = INT_MAX;
+	int bestNode = -1;
+	int bestStop = 0;
+	int listReached = beginReachedList(scratch, earliestArrivals);
+
+	groundTimes[originAirport] = startTimeUTC;
+	airportStamps[originAirport] = reachedStamp;
+	pushAirport(stops, originAirport, groundTimes);
+
+	// <Stop settle loop>
+	while (stops->size > 0)
+	{
+		int stop = popEarliestAirport(stops, groundTimes);
+		int low = nodeOffsets[stop];
+		int high = nodeOffsets[stop + 1];
+
+		airportStamps[stop] = settledStamp;
+
+		// Every pattern from here arrives no sooner than now.
+		if (groundTimes[stop] >= bestArrival)
+		{
+			emptyAirportHeap(stops);
+			break;
+		}
+
+		// Binary search for the stop's first pattern to the destination.
+		while (low < high)
+		{
+			int middle = low + (high - low) / 2;
+
+			if (network->legDestinations[nodeLegs[destinationNodes[middle]]] < destinationAirport)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+
+		for (int i = low; (i < nodeOffsets[stop + 1])
+			&& (network->legDestinations[nodeLegs[destinationNodes[i]]] == destinationAirport); i++)
+		{
+			int arrivalTime = flyPattern(patternLegs, destinationNodes[i], groundTimes[stop],
+				bestArrival);
+
+			if (arrivalTime < bestArrival)
+			{
+				bestArrival = arrivalTime;
+				bestNode = destinationNodes[i];
+				bestStop = stop;
+			}
+		}
+
+		// Then on to the hubs this stop's patterns reach.
+		for (int i = hubNodeOffsets[stop]; i < hubNodeOffsets[stop + 1]; i++)
+		{
+			int hub = network->legDestinations[nodeLegs[hubNodes[i]]];
+			int arrivalLimit = bestArrival;
+			int arrivalTime = 0;
+
+			if ((hub == originAirport) || (hub == destinationAirport)
+				|| (airportStamps[hub] == settledStamp))
+			{
+				continue;
+			}
+
+			if ((airportStamps[hub] == reachedStamp) && (groundTimes[hub] < arrivalLimit))
+			{
+				arrivalLimit = groundTimes[hub];
+			}
+
+			arrivalTime = flyPattern(patternLegs, hubNodes[i], groundTimes[stop], arrivalLimit);
+
+			if (arrivalTime < arrivalLimit)
+			{
+				airportStamps[hub] = reachedStamp;
+				groundTimes[hub] = arrivalTime;
+				entryNodes[hub] = hubNodes[i];
+				entryStops[hub] = stop;
+				pushAirport(stops, hub, groundTimes);
+			}
+		}
+	} // End of stop settle loop.
+
+	if (bestNode < 0)
+	{
+		return;
+	}
+
+	// <Route flying>
+	/* Fly the best run of patterns again, this time keeping its flights. The run is listed
+	from the destination back, one pattern per stop, then flown from the origin. */
+	{
+		// The search is over, so its ground times can make way for the run.
+		int* runNodes = scratch->groundTimes;
+		const Flight** route = scratch->latestDepartures;
+		int runLength = 0;
+		int routeLength = 0;
+		int groundTime = startTimeUTC;
+
+		runNodes[runLength] = bestNode;
+		runLength++;
+		for (int stop = bestStop; stop != originAirport; stop = entryStops[stop])
+		{
+			runNodes[runLength] = entryNodes[stop];
+			runLength++;
+		}
+
+		while (runLength > 0)
+		{
+			int legCount = 0;
+
+			runLength--;
+			for (int node = runNodes[runLength]; node >= 0; node = nodeParents[node])
+			{
+				patternLegs[legCount] = nodeLegs[node];
+				legCount++;
+			}
+
+			while (legCount > 0)
+			{
+				const Flight* flight = NULL;
+				int landing = 0;
+
+				legCount--;
+				groundTime = soonestArrival(groundTime, patternLegs[legCount], &flight);
+				landing = flight->destinationCity;
+
+				/* Patterns from different stops can pass through the same airport when plans
+				tie. Landing somewhere the route has already been, the loop since is dropped:
+				the flyer was there sooner, and can still catch the next flight. */
+				if (landing == originAirport)
+				{
+					routeLength = 0;
+					continue;
+				}
+
+				for (int i = 0; i < routeLength; i++)
+				{
+					if (route[i]->destinationCity == landing)
+					{
+						routeLength = i;
+						flight = route[i];
+						break;
+					}
+				}
+
+				route[routeLength] = flight;
+				routeLength++;
+			}
+		}
+
+		for (int i = 0; i < routeLength; i++)
+		{
+			if ((listReached == 1) && (earliestArrivals[route[i]->destinationCity] == NULL))
+			{
+				scratch->reachedAirports[scratch->reachedCount] = route[i]->destinationCity;
+				scratch->reachedCount++;
+			}
+			earliestArrivals[route[i]->destinationCity] = route[i];
+		}
+	} // End of route flying.
+}
+
+
+
+/*
+* Function:			chooseHubs()
+* Description:		Picks the hubs the local patterns stop at: the airports with the most flights
+*					leaving them, ties going to the lower cityID.
+* Parameters:		int hubCount		The number of hubs to pick. 0 to pick every airport with
+*										at least kTransferHubFactor times the average number of
+*										flights out.
+* Return Values:	The number of hubs picked, or -1 if there wasn't enough memory.
+*/
+static int chooseHubs(int hubCount)
+{
+	const Timetable* network = flightTimetable();
+	int airportCount = network->airportCount;
+	AirportDepartures* airports = (AirportDepartures*)malloc((airportCount + 1)
+		* sizeof(AirportDepartures));
+
+	hubAirports = (char*)calloc(airportCount + 1, sizeof(char));
+
+	if ((airports == NULL) || (hubAirports == NULL))
+	{
+		free(airports);
+		return -1;
+	}
+
+	for (int airport = 1; airport <= airportCount; airport++)
+	{
+		airports[airport - 1].airport = airport;
+		airports[airport - 1].departureCount
+			= network->departureOffsets[network->legOffsets[airport + 1]]
+			- network->departureOffsets[network->legOffsets[airport]];
+	}
+
+	qsort(airports, airportCount, sizeof(AirportDepartures), compareDepartureCounts);
+
+	if (hubCount <= 0)
+	{
+		double hubDepartures = kTransferHubFactor * network->flightCount / (double)airportCount;
+
+		hubCount = 0;
+		while ((hubCount < airportCount) && (airports[hubCount].departureCount >= hubDepartures))
+		{
+			hubCount++;
+		}
+	}
+	if (hubCount > airportCount)
+	{
+		hubCount = airportCount;
+	}
+
+	for (int i = 0; i < hubCount; i++)
+	{
+		hubAirports[airports[i].airport] = 1;
+	}
+
+	free(airports);
+
+	return hubCount;
+}
+
+
+
+/*
+* Function:			findOriginPatterns()
+* Description:		Finds every local transfer pattern from one origin, and copies them out of the
+*					builder's trie into the origin's OriginPatterns. Called by runForEachOrigin().
+*					One search is run from just before each distinct departure time out of the
+*					origin, latest first. Each search stops at any airport a later departure
+*					reached as soon, and at every hub but the origin, and adds the pattern to
+*					every other airport it settles to the trie.
+* Parameters:		void* builder			The PatternBuilder for this thread.
+*					int origin				The origin to find the patterns from.
+* Return Values:	1 if they were found, 0 if there wasn't enough memory.
+*/
+static int findOriginPatterns(void* builder, int origin)
+{
+	PatternBuilder* self = (PatternBuilder*)builder;
+	const Timetable* network = flightTimetable();
+	OriginPatterns* patterns = &self->origins[origin];
+	QueryScratch* scratch = &self->scratch;
+	int departureCount = 0;
+
+	int* groundTimes = scratch->groundTimes;
+	unsigned int* airportStamps = scratch->airportStamps;
+	AirportHeap* unsettledAirports = &scratch->heap;
+
+	/* For each airport a search reaches: the leg it was reached by, and once it is settled,
+	its trie node. Only meaningful for airports stamped by the current search. */
+	int* reachedLegs = scratch->markedAirports;
+	int* airportNodes = scratch->nextMarkedAirports;
+
+	// The searches fill in earliestArrivals without listing the airports they reach.
+	scratch->reachedCount = -1;
+
+	// Only the origin's first legs were put in rootChildren[], by the last origin's trie.
+	self->nodeCount = 0;
+	for (int leg = network->legOffsets[origin]; leg < network->legOffsets[origin + 1]; leg++)
+	{
+		self->rootChildren[network->legDestinations[leg]] = -1;
+	}
+
+	/* The day repeats, so a departure at midnight is the one at the end of the day: starting
+	a minute before it is the same as starting any time after the one before it. */
+	for (int leg = network->legOffsets[origin]; leg < network->legOffsets[origin + 1]; leg++)
+	{
+		for (int flight = network->departureOffsets[leg];
+			flight < network->departureOffsets[leg + 1]; flight++)
+		{
+			int departureTime = network->departureMinutes[flight];
+
+			self->departureTimes[departureCount] = (departureTime == 0) ? kMinutesPerDay
+				: departureTime;
+			departureCount++;
+		}
+	}
+
+	qsort(self->departureTimes, departureCount, sizeof(int), compareMinutes);
+
+	// <Departure loop>
+	// One search per distinct departure time, from the latest to the earliest.
+	for (int i = departureCount - 1; i >= 0; i--)
+	{
+		unsigned int reachedStamp = 0;
+		unsigned int settledStamp = 0;
+
+		if ((i < departureCount - 1) && (self->departureTimes[i] == self->departureTimes[i + 1]))
+		{
+			continue;
+		}
+
+		reachedStamp = startSearchGeneration(scratch);
+		settledStamp = reachedStamp + 1;
+
+		groundTimes[origin] = self->departureTimes[i] - 1;
+		airportStamps[origin] = reachedStamp;
+		pushAirport(unsettledAirports, origin, groundTimes);
+
+		// <Airport settle loop>
+		while (unsettledAirports->size > 0)
+		{
+			int departureAirport = popEarliestAirport(unsettledAirports, groundTimes);
+
+			airportStamps[departureAirport] = settledStamp;
+
+			/* Every airport settled here was reached sooner than from any later departure,
+			so its pattern is added, as a child of the pattern to where its flight left. */
+			if (departureAirport != origin)
+			{
+				int parentAirport = scratch->earliestArrivals[departureAirport]->originCity;
+
+				self->bestOrigins[departureAirport] = origin;
+				self->bestArrivals[departureAirport] = groundTimes[departureAirport];
+
+				airportNodes[departureAirport] = findTrieChild(self,
+					(parentAirport == origin) ? -1 : airportNodes[parentAirport],
+					reachedLegs[departureAirport]);
+
+				if (airportNodes[departureAirport] < 0)
+				{
+					emptyAirportHeap(unsettledAirports);
+					return 0;
+				}
+
+				// A local pattern ends at the first hub it reaches.
+				if (hubAirports[departureAirport] == 1)
+				{
+					continue;
+				}
+			}
+
+			for (int leg = network->legOffsets[departureAirport];
+				leg < network->legOffsets[departureAirport + 1]; leg++)
+			{
+				int arrivalAirport = network->legDestinations[leg];
+				const Flight* flight = NULL;
+				int arrivalTime = 0;
+
+				if ((arrivalAirport == origin) || (airportStamps[arrivalAirport] == settledStamp))
+				{
+					continue;
+				}
+
+				arrivalTime = soonestArrival(groundTimes[departureAirport], leg, &flight);
+
+				/* A later departure that gets there as soon has already found everything
+				onward from there. */
+				if ((flight == NULL) || ((self->bestOrigins[arrivalAirport] == origin)
+					&& (arrivalTime >= self->bestArrivals[arrivalAirport])))
+				{
+					continue;
+				}
+
+				if ((airportStamps[arrivalAirport] != reachedStamp)
+					|| (arrivalTime < groundTimes[arrivalAirport]))
+				{
+					airportStamps[arrivalAirport] = reachedStamp;
+					groundTimes[arrivalAirport] = arrivalTime;
+					scratch->earliestArrivals[arrivalAirport] = flight;
+					reachedLegs[arrivalAirport] = leg;
+					pushAirport(unsettledAirports, arrivalAirport, groundTimes);
+				}
+			}
+		} // End of airport settle loop.
+	} // End of departure loop.
+
+	patterns->nodeCount = self->nodeCount;
+	patterns->parents = (int*)malloc((self->nodeCount + 1) * sizeof(int));
+	patterns->legs = (int*)malloc((self->nodeCount + 1) * sizeof(int));
+
+	if ((patterns->parents == NULL) || (patterns->legs == NULL))
+	{
+		return 0;
+	}
+
+	memcpy(patterns->parents, self->parents, self->nodeCount * sizeof(int));
+	memcpy(patterns->legs, self->legs, self->nodeCount * sizeof(int));
+
+	return 1;
+}
+
+
+
+/*
+* Function:			findTrieChild()
+* Description:		Finds a trie node's child for a leg, adding it if there isn't one yet.
+* Parameters:		PatternBuilder* self	The builder holding the trie.
+*					int parent				The parent node, or -1 for the origin.
+*					int leg					The child's leg.
+* Return Values:	The child node, or -1 if there wasn't enough memory to add it.
+*/
+static int findTrieChild(PatternBuilder* self, int parent, int leg)
+{
+	int firstLegDestination = flightTimetable()->legDestinations[leg];
+	int node = -1;
+
+	/* The origin has at most one leg to each airport, so its children are found by where they
+	fly to. Every other node's children are listed through nextSiblings[]. */
+	if (parent < 0)
+	{
+		node = self->rootChildren[firstLegDestination];
+	}
+	else
+	{
+		node = self->firstChildren[parent];
+
+		while ((node >= 0) && (self->legs[node] != leg))
+		{
+			node = self->nextSiblings[node];
+		}
+	}
+
+	if (node >= 0)
+	{
+		return node;
+	}
+
+	if (self->nodeCount == self->nodesAllocated)
+	{
+		int newNodes = (self->nodesAllocated == 0) ? 1024 : self->nodesAllocated * 2;
+		int* grownParents = (int*)realloc(self->parents, newNodes * sizeof(int));
+		int* grownLegs = NULL;
+		int* grownChildren = NULL;
+		int* grownSiblings = NULL;
+
+		if (grownParents == NULL)
+		{
+			return -1;
+		}
+		self->parents = grownParents;
+
+		grownLegs = (int*)realloc(self->legs, newNodes * sizeof(int));
+		if (grownLegs == NULL)
+		{
+			return -1;
+		}
+		self->legs = grownLegs;
+
+		grownChildren = (int*)realloc(self->firstChildren, newNodes * sizeof(int));
+		if (grownChildren == NULL)
+		{
+			return -1;
+		}
+		self->firstChildren = grownChildren;
+
+		grownSiblings = (int*)realloc(self->nextSiblings, newNodes * sizeof(int));
+		if (grownSiblings == NULL)
+		{
+			return -1;
+		}
+		self->nextSiblings = grownSiblings;
+
+		self->nodesAllocated = newNodes;
+	}
+
+	node = self->nodeCount;
+	self->nodeCount++;
+
+	self->parents[node] = parent;
+	self->legs[node] = leg;
+	self->firstChildren[node] = -1;
+
+	if (parent < 0)
+	{
+		self->nextSiblings[node] = -1;
+		self->rootChildren[firstLegDestination] = node;
+	}
+	else
+	{
+		self->nextSiblings[node] = self->firstChildren[parent];
+		self->firstChildren[parent] = node;
+	}
+
+	return node;
+}
+
+
+
+/*
+* Function:			flyPattern()
+* Description:		Flies one pattern from a ground time, taking the soonest arrival on each of
+*					its legs in turn.
+* Parameters:		int* patternLegs		Room for the pattern's legs. Patterns never visit an
+*											airport twice, so they have fewer legs than airports.
+*					int node				The pattern's last node.
+*					int groundTime			When the flyer is at the pattern's first airport, in
+*											minutes since midnight UTC of the first day.
+*					int arrivalLimit		Stop flying once the pattern can't land before this.
+* Return Values:	The arrival at the pattern's last airport, or arrivalLimit (or later) if it
+*					can't beat it.
+*/
+static int flyPattern(int* patternLegs, int node, int groundTime, int arrivalLimit)
+{
+	int legCount = 0;
+
+	// Walk back to the pattern's first airport for its legs, last first.
+	for (; node >= 0; node = nodeParents[node])
+	{
+		patternLegs[legCount] = nodeLegs[node];
+		legCount++;
+	}
+
+	// Then fly them in order.
+	while ((legCount > 0) && (groundTime < arrivalLimit))
+	{
+		const Flight* flight = NULL;
+
+		legCount--;
+		groundTime = soonestArrival(groundTime, patternLegs[legCount], &flight);
+	}
+
+	return (legCount == 0) ? groundTime : arrivalLimit;
+}
+
+
+
+/*
+* Function:			compareMinutes()
+* Description:		Orders two times for qsort(), earliest first.
+* Parameters:		const void* first		The first time.
+*					const void* second		The second time.
+* Return Values:	Less than, equal to or greater than 0, as first is before, at or after second.
+*/
+static int compareMinutes(const void* first, const void* second)
+{
+	return *(const int*)first - *(const int*)second;
+}
+
+
+
+/*
+* Function:			compareDepartureCounts()
+* Description:		Orders two airports for qsort(), the one with the most flights out first, and
+*					the lower cityID first if they have as many.
+* Parameters:		const void* first		The first AirportDepartures.
+*					const void* second		The second AirportDepartures.
+* Return Values:	Less than, equal to or greater than 0, as first goes before, with or after
+*					second.
+*/
+static int compareDepartureCounts(const void* first, const void* second)
+{
+	const AirportDepartures* firstAirport = (const AirportDepartures*)first;
+	const AirportDepartures* secondAirport = (const AirportDepartures*)second;
+
+	if (firstAirport->departureCount != secondAirport->departureCount)
+	{
+		return secondAirport->departureCount - firstAirport->departureCount;
+	}
+
+	return firstAirport->airport - secondAirport->airport;
+}
@@ -0,0 +1,304 @@
+/*
+* Filename:				updates.c
+* Description:			Live updates for the Amazing Race flight planner. Delays and cancellations
+*						are applied to the loaded timetable as they come in (see delayFlight() and
+*						cancelFlight() in timetable.c); this module repairs the earliest-arrival
+*						trees already found, so the arrival cache can keep answering from them
+*						instead of searching every cached origin again.
+*
+*						A change to one flight only touches two parts of a tree. The airports
+*						reached through the flight (its subtree) may now be reached later, or not
+*						at all; everything else was reached without it, and still is. And a
+*						delayed flight may now be caught by someone who used to miss it, so its
+*						destination may be reached sooner. So the subtree is taken out, each of its
+*						airports is given the best flight in from the rest of the tree, and a
+*						Dijkstra search carries on from those airports and the delayed flight's
+*						destination only. A tree that neither uses the flight nor gains from the
+*						delay is left as it was.
+*
+*						The cache keeps each tree's ground times, and the airports reached from
+*						each airport (see ArrivalTree), so the subtree is walked directly, and the
+*						search compares against when the tree reached each airport before the
+*						update.
+*/
+
+#include "dijkstra_example.h"
+
+
+#pragma warning(disable: 4996)
+
+
+
+/* The legs into each airport, for finding the best flight into an airport from the rest of a
+tree. The legs into airport a are incomingLegs[incomingOffsets[a]] up to
+incomingLegs[incomingOffsets[a + 1]], and legOrigins[] gives where each leg flies from. Empty
+until initFlightUpdates() is called. */
+static int* incomingOffsets = NULL;
+static int* incomingLegs = NULL;
+static int* legOrigins = NULL;
+
+
+
+/*
+* Function:			initFlightUpdates()
+* Description:		Builds the index of legs into each airport that repairArrivals() needs.
+*					Delays and cancellations never add or remove legs, so it's only built once.
+* Return Values:	1 if it was built, 0 if there wasn't enough memory.
+*/
+int initFlightUpdates(void)
+{
+	const Timetable* network = flightTimetable();
+	int airportCount = network->airportCount;
+
+	freeFlightUpdates();
+
+	incomingOffsets = (int*)calloc(airportCount + 2, sizeof(int));
+	incomingLegs = (int*)malloc((network->legCount + 1) * sizeof(int));
+	legOrigins = (int*)malloc((network->legCount + 1) * sizeof(int));
+
+	if ((incomingOffsets == NULL) || (incomingLegs == NULL) || (legOrigins == NULL))
+	{
+		freeFlightUpdates();
+		return 0;
+	}
+
+	// Count the legs into each airport, then turn the counts into where each airport's legs end.
+	for (int airport = 1; airport <= airportCount; airport++)
+	{
+		for (int leg = network->legOffsets[airport]; leg < network->legOffsets[airport + 1]; leg++)
+		{
+			legOrigins[leg] = airport;
+			incomingOffsets[network->legDestinations[leg] + 1]++;
+		}
+	}
+
+	for (int airport = 1; airport <= airportCount + 1; airport++)
+	{
+		incomingOffsets[airport] += incomingOffsets[airport - 1];
+	}
+
+	/* Fill each airport's legs in from the back, using the end of its range as a cursor. Once
+	every leg is in, each cursor is at its airport's start, one place along from where the
+	offsets belong. */
+	for (int leg = network->legCount - 1; leg >= 0; leg--)
+	{
+		int destination = network->legDestinations[leg];
+
+		incomingOffsets[destination + 1]--;
+		incomingLegs[incomingOffsets[destination + 1]] = leg;
+	}
+
+	for (int airport = 0; airport <= airportCount; airport++)
+	{
+		incomingOffsets[airport] = incomingOffsets[airport + 1];
+	}
+	incomingOffsets[airportCount + 1] = network->legCount;
+
+	return 1;
+}
+
+
+
+/*
+* Function:			freeFlightUpdates()
+* Description:		Releases the index built by initFlightUpdates().
+*/
+void freeFlightUpdates(void)
+{
+	free(incomingOffsets);
+	free(incomingLegs);
+	free(legOrigins);
+
+	incomingOffsets = NULL;
+	incomingLegs = NULL;
+	legOrigins = NULL;
+}
+
+
+
+/*
+* Function:			movedFlight()
+* Description:		Gives where a flight is after an update. Only flights on the updated leg,
+*					between the delayed flight's old and new places, ever move.
+* Parameters:		const FlightUpdate* update		The update.
+*					const Flight* flight			The flight, as it was before the update.
+* Return Values:	The same flight, as it is now. NULL stays NULL.
+*/
+const Flight* movedFlight(const FlightUpdate* update, const Flight* flight)
+{
+	const Flight* departures = flightTimetable()->departures;
+	int flightID = 0;
+
+	if (flight == NULL)
+	{
+		return NULL;
+	}
+
+	flightID = (int)(flight - departures);
+
+	if (flightID == update->oldFlight)
+	{
+		flightID = update->newFlight;
+	}
+	else if ((update->oldFlight < flightID) && (flightID <= update->newFlight))
+	{
+		flightID--;
+	}
+	else if ((update->newFlight <= flightID) && (flightID < update->oldFlight))
+	{
+		flightID++;
+	}
+
+	return &departures[flightID];
+}
+
+
+
+/*
+* Function:			repairArrivals()
+* Description:		Brings a cached tree up to date after a flight is delayed or cancelled,
+*					searching again only from the airports the change could affect. A tree that
+*					neither uses the flight nor can catch it now is passed over in constant time.
+* Parameters:		QueryScratch* scratch		Working memory for the repair.
+*					const FlightUpdate* update	The change made to the timetable.
+*					ArrivalTree* tree			The tree, as found before the update. Repaired.
+* Return Values:	1 if any airport's flight changed, 0 if the tree didn't need repairing.
+*/
+int repairArrivals(QueryScratch* scratch, const FlightUpdate* update, ArrivalTree* tree)
+{
+	const Timetable* network = flightTimetable();
+	int originAirport = tree->originAirport;
+	int delayedOrigin = legOrigins[update->leg];
+	int delayedDestination = network->legDestinations[update->leg];
+	const Flight** earliestArrivals = tree->arrivals;
+	int* groundTimes = tree->groundTimes;
+	AirportHeap* unsettledAirports = &scratch->heap;
+	int isRepaired = 0;
+
+	/* Only flights on the updated leg move, and the tree can only use one of them: its flight
+	into the leg's destination. Keep that pointing at the same flight, wherever it is now. */
+	earliestArrivals[delayedDestination] = movedFlight(update,
+		earliestArrivals[delayedDestination]);
+
+	// <Subtree removal>
+	// Take out every airport reached through the updated flight.
+	if (earliestArrivals[delayedDestination] == &network->departures[update->newFlight])
+	{
+		unsigned int* airportStamps = scratch->airportStamps;
+		unsigned int removedStamp = startSearchGeneration(scratch);
+		int* removedAirports = scratch->markedAirports;
+		int removedCount = 0;
+
+		setTreeArrival(tree, delayedDestination, NULL);
+
+		for (int airport = delayedDestination; airport != 0;
+			airport = nextTreeAirport(tree, airport, delayedDestination))
+		{
+			removedAirports[removedCount] = airport;
+			removedCount++;
+			airportStamps[airport] = removedStamp;
+		}
+
+		for (int i = 0; i < removedCount; i++)
+		{
+			int airport = removedAirports[i];
+
+			earliestArrivals[airport] = NULL;
+			groundTimes[airport] = INT_MAX;
+			tree->firstChildren[airport] = 0;
+			tree->nextSiblings[airport] = 0;
+			tree->previousSiblings[airport] = 0;
+		}
+
+		// Give each one the best flight in from what's left of the tree, to start from.
+		for (int i = 0; i < removedCount; i++)
+		{
+			int airport = removedAirports[i];
+			const Flight* bestFlight = NULL;
+
+			for (int j = incomingOffsets[airport]; j < incomingOffsets[airport + 1]; j++)
+			{
+				int leg = incomingLegs[j];
+				int from = legOrigins[leg];
+				const Flight* flight = NULL;
+				int arrivalTime = 0;
+
+				if ((airportStamps[from] == removedStamp)
+					|| ((from != originAirport) && (earliestArrivals[from] == NULL)))
+				{
+					continue;
+				}
+
+				arrivalTime = soonestArrival(groundTimes[from], leg, &flight);
+
+				if ((flight != NULL) && (arrivalTime < groundTimes[airport]))
+				{
+					groundTimes[airport] = arrivalTime;
+					bestFlight = flight;
+				}
+			}
+
+			if (bestFlight != NULL)
+			{
+				setTreeArrival(tree, airport, bestFlight);
+				pushAirport(unsettledAirports, airport, groundTimes);
+			}
+		}
+
+		isRepaired = 1;
+	} // End of subtree removal.
+
+	/* A delayed flight may now be caught from its origin. Cancelling one only ever makes
+	things later, which the subtree removal has seen to. */
+	if ((update->isCancelled == 0) && (delayedDestination != originAirport)
+		&& ((delayedOrigin == originAirport) || (earliestArrivals[delayedOrigin] != NULL)))
+	{
+		const Flight* flight = NULL;
+		int arrivalTime = soonestArrival(groundTimes[delayedOrigin], update->leg, &flight);
+
+		if ((flight != NULL) && (arrivalTime < groundTimes[delayedDestination]))
+		{
+			groundTimes[delayedDestination] = arrivalTime;
+			setTreeArrival(tree, delayedDestination, flight);
+			pushAirport(unsettledAirports, delayedDestination, groundTimes);
+			isRepaired = 1;
+		}
+	}
+
+	// <Repair search>
+	/* Carry on from the airports that changed, as mapEarliestArrivals() would. Every other
+	airport still has the ground time it had before the update, so it only joins in if it's
+	reached sooner than that. */
+	while (unsettledAirports->size > 0)
+	{
+		int departureAirport = popEarliestAirport(unsettledAirports, groundTimes);
+
+		countSearch(airportsSettled, 1);
+
+		for (int leg = network->legOffsets[departureAirport];
+			leg < network->legOffsets[departureAirport + 1]; leg++)
+		{
+			int arrivalAirport = network->legDestinations[leg];
+			const Flight* flight = NULL;
+			int arrivalTime = 0;
+
+			if (arrivalAirport == originAirport)
+			{
+				continue;
+			}
+
+			countSearch(legsRelaxed, 1);
+			arrivalTime = soonestArrival(groundTimes[departureAirport], leg, &flight);
+
+			if ((flight != NULL) && (arrivalTime < groundTimes[arrivalAirport]))
+			{
+				groundTimes[arrivalAirport] = arrivalTime;
+				setTreeArrival(tree, arrivalAirport, flight);
+				pushAirport(unsettledAirports, arrivalAirport, groundTimes);
+				countSearch(improvements, 1);
+			}
+		}
+	} // End of repair search.
+
+	return isRepaired;
+}